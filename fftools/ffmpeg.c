@@ -63,6 +63,7 @@
 #include "libavutil/time.h"
 #include "libavutil/thread.h"
 #include "libavutil/threadmessage.h"
+#include "libavutil/trace.h"
 #include "libavcodec/mathops.h"
 #include "libavformat/os_support.h"
 
@@ -489,6 +490,31 @@ static int decode_interrupt_cb(void *ctx)
 
 const AVIOInterruptCB int_cb = { decode_interrupt_cb, NULL };
 
+static void write_trace_file(void)
+{
+    char *json;
+    FILE *f;
+    int ret;
+
+    av_trace_disable();
+    if ((ret = av_trace_get_json(&json)) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Error exporting the trace: %s\n",
+               av_err2str(ret));
+        av_trace_free();
+        return;
+    }
+    f = fopen(trace_filename, "w");
+    if (f) {
+        ret = fputs(json, f) < 0;
+        ret |= fclose(f);
+    }
+    if (!f || ret)
+        av_log(NULL, AV_LOG_ERROR, "Error writing trace file '%s'\n",
+               trace_filename);
+    av_free(json);
+    av_trace_free();
+}
+
 static void ffmpeg_cleanup(int ret)
 {
     int i, j;
@@ -628,6 +654,11 @@ static void ffmpeg_cleanup(int ret)
     }
     av_freep(&vstats_filename);
 
+    if (trace_filename) {
+        write_trace_file();
+        av_freep(&trace_filename);
+    }
+
     av_freep(&input_streams);
     av_freep(&input_files);
     av_freep(&output_streams);
@@ -1533,7 +1564,9 @@ static int reap_filters(int flush)
                 if (!ost->frame_aspect_ratio.num)
                     enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
 
+                av_trace_begin("ffmpeg", "encode");
                 do_video_out(of, ost, filtered_frame);
+                av_trace_end("ffmpeg", "encode");
                 break;
             case AVMEDIA_TYPE_AUDIO:
                 if (!(enc->codec->capabilities & AV_CODEC_CAP_PARAM_CHANGE) &&
@@ -1542,7 +1575,9 @@ static int reap_filters(int flush)
                            "Audio filter graph output is not normalized and encoder does not support parameter changes\n");
                     break;
                 }
+                av_trace_begin("ffmpeg", "encode");
                 do_audio_out(of, ost, filtered_frame);
+                av_trace_end("ffmpeg", "encode");
                 break;
             default:
                 // TODO support subtitle filters
@@ -1673,6 +1708,26 @@ static void print_final_stats(int64_t total_size)
     }
 }
 
+static void print_mem_stats(AVBPrint *bp)
+{
+    AVMemTagStats *stats;
+    char key[128];
+    int i, j, nb_stats;
+
+    if (av_mem_get_stats(&stats, &nb_stats) < 0)
+        return;
+    for (i = 0; i < nb_stats; i++) {
+        /* tag names may contain any character, keep keys to [0-9A-Za-z_] */
+        av_strlcpy(key, stats[i].name, sizeof(key));
+        for (j = 0; key[j]; j++)
+            if (!av_isdigit(key[j]) && (av_tolower(key[j]) < 'a' || av_tolower(key[j]) > 'z'))
+                key[j] = '_';
+        av_bprintf(bp, "mem_%s_live_bytes=%"PRId64"\n", key, stats[i].live);
+        av_bprintf(bp, "mem_%s_peak_bytes=%"PRId64"\n", key, stats[i].peak);
+    }
+    av_free(stats);
+}
+
 static void print_report(int is_last_report, int64_t timer_start, int64_t cur_time)
 {
     AVBPrint buf, buf_script;
@@ -1715,7 +1770,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
 
     vid = 0;
     av_bprint_init(&buf, 0, AV_BPRINT_SIZE_AUTOMATIC);
-    av_bprint_init(&buf_script, 0, AV_BPRINT_SIZE_AUTOMATIC);
+    av_bprint_init(&buf_script, 0, AV_BPRINT_SIZE_UNLIMITED);
     for (i = 0; i < nb_output_streams; i++) {
         float q = -1;
         ost = output_streams[i];
@@ -1863,6 +1918,8 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     av_bprint_finalize(&buf, NULL);
 
     if (progress_avio) {
+        if (do_mem_stats)
+            print_mem_stats(&buf_script);
         av_bprintf(&buf_script, "progress=%s\n",
                    is_last_report ? "end" : "continue");
         avio_write(progress_avio, buf_script.str,
@@ -4060,7 +4117,9 @@ static void *input_thread(void *arg)
 
     while (1) {
         AVPacket pkt;
+        av_trace_begin("ffmpeg", "demux");
         ret = av_read_frame(f->ctx, &pkt);
+        av_trace_end("ffmpeg", "demux");
 
         if (ret == AVERROR(EAGAIN)) {
             av_usleep(10000);
@@ -4130,8 +4189,9 @@ static int init_input_thread(int i)
     if (f->ctx->pb ? !f->ctx->pb->seekable :
         strcmp(f->ctx->iformat->name, "lavfi"))
         f->non_blocking = 1;
-    ret = av_thread_message_queue_alloc(&f->in_thread_queue,
-                                        f->thread_queue_size, sizeof(AVPacket));
+    ret = av_thread_message_queue_alloc2(&f->in_thread_queue,
+                                         f->thread_queue_size, sizeof(AVPacket),
+                                         AV_THREAD_MESSAGE_QUEUE_SPSC);
     if (ret < 0)
         return ret;
 
@@ -4166,6 +4226,8 @@ static int get_input_packet_mt(InputFile *f, AVPacket *pkt)
 
 static int get_input_packet(InputFile *f, AVPacket *pkt)
 {
+    int ret;
+
     if (f->rate_emu) {
         int i;
         for (i = 0; i < f->nb_streams; i++) {
@@ -4181,7 +4243,10 @@ static int get_input_packet(InputFile *f, AVPacket *pkt)
     if (f->thread_queue_size)
         return get_input_packet_mt(f, pkt);
 #endif
-    return av_read_frame(f->ctx, pkt);
+    av_trace_begin("ffmpeg", "demux");
+    ret = av_read_frame(f->ctx, pkt);
+    av_trace_end("ffmpeg", "demux");
+    return ret;
 }
 
 static int got_eagain(void)
@@ -4561,7 +4626,9 @@ static int process_input(int file_index)
 
     sub2video_heartbeat(ist, pkt.pts);
 
+    av_trace_begin("ffmpeg", "decode");
     process_input_packet(ist, &pkt, 0);
+    av_trace_end("ffmpeg", "decode");
 
 discard_packet:
     av_packet_unref(&pkt);
@@ -4584,7 +4651,9 @@ static int transcode_from_filter(FilterGraph *graph, InputStream **best_ist)
     InputStream *ist;
 
     *best_ist = NULL;
+    av_trace_begin("ffmpeg", "filter");
     ret = avfilter_graph_request_oldest(graph->graph);
+    av_trace_end("ffmpeg", "filter");
     if (ret >= 0)
         return reap_filters(0);
 
@@ -4954,6 +5023,10 @@ int main(int argc, char **argv)
             want_sdp = 0;
     }
 
+    if (trace_filename && (ret = av_trace_enable(1 << 16)) < 0)
+        av_log(NULL, AV_LOG_WARNING, "Tracing is not available: %s\n",
+               av_err2str(ret));
+
     current_time = ti = get_benchmark_time_stamps();
     if (transcode() < 0)
         exit_program(1);
@@ -4967,6 +5040,17 @@ int main(int argc, char **argv)
                "bench: utime=%0.3fs stime=%0.3fs rtime=%0.3fs\n",
                utime / 1000000.0, stime / 1000000.0, rtime / 1000000.0);
     }
+    if (do_mem_stats) {
+        AVMemTagStats *stats;
+        int nb_stats;
+
+        if (av_mem_get_stats(&stats, &nb_stats) >= 0) {
+            for (i = 0; i < nb_stats; i++)
+                av_log(NULL, AV_LOG_INFO, "mem: %s live=%"PRId64" peak=%"PRId64"\n",
+                       stats[i].name, stats[i].live, stats[i].peak);
+            av_free(stats);
+        }
+    }
     av_log(NULL, AV_LOG_DEBUG, "%"PRIu64" frames successfully decoded, %"PRIu64" decoding errors\n",
            decode_error_stat[0], decode_error_stat[1]);
     if ((decode_error_stat[0] + decode_error_stat[1]) * max_error_rate < decode_error_stat[1])
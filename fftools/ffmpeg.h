@@ -593,6 +593,7 @@ extern int        nb_filtergraphs;
 
 extern char *vstats_filename;
 extern char *sdp_filename;
+extern char *trace_filename;
 
 extern float audio_drift_threshold;
 extern float dts_delta_threshold;
@@ -604,6 +605,7 @@ extern int video_sync_method;
 extern float frame_drop_threshold;
 extern int do_benchmark;
 extern int do_benchmark_all;
+extern int do_mem_stats;
 extern int do_deinterlace;
 extern int do_hex_dump;
 extern int do_pkt_dump;
@@ -622,6 +624,7 @@ extern float max_error_rate;
 extern char *videotoolbox_pixfmt;
 
 extern int filter_nbthreads;
+extern int filter_large_buffers;
 extern int filter_complex_nbthreads;
 extern int vstats_version;
 extern int auto_conversion_filters;
@@ -1060,6 +1060,9 @@ int configure_filtergraph(FilterGraph *fg)
         fg->graph->nb_threads = filter_complex_nbthreads;
     }
 
+    if (filter_large_buffers)
+        av_opt_set_int(fg->graph, "large_buffers", 1, 0);
+
     if ((ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs)) < 0)
         goto fail;
 
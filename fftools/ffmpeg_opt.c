@@ -145,6 +145,7 @@ HWDevice *filter_hw_device;
 
 char *vstats_filename;
 char *sdp_filename;
+char *trace_filename;
 
 float audio_drift_threshold = 0.1;
 float dts_delta_threshold   = 10;
@@ -157,6 +158,7 @@ float frame_drop_threshold = 0;
 int do_deinterlace    = 0;
 int do_benchmark      = 0;
 int do_benchmark_all  = 0;
+int do_mem_stats      = 0;
 int do_hex_dump       = 0;
 int do_pkt_dump       = 0;
 int copy_ts           = 0;
@@ -172,6 +174,7 @@ int frame_bits_per_raw_sample = 0;
 float max_error_rate  = 2.0/3;
 int filter_nbthreads = 0;
 int filter_complex_nbthreads = 0;
+int filter_large_buffers = 0;
 int vstats_version = 2;
 int auto_conversion_filters = 1;
 
@@ -537,6 +540,27 @@ static int opt_sdp_file(void *optctx, const char *opt, const char *arg)
     return 0;
 }
 
+static int opt_trace_file(void *optctx, const char *opt, const char *arg)
+{
+    av_free(trace_filename);
+    trace_filename = av_strdup(arg);
+    return 0;
+}
+
+static int opt_mem_stats(void *optctx, const char *opt, const char *arg)
+{
+    int ret;
+
+    /* enabled while parsing, so that opening the files is accounted too */
+    if ((ret = av_mem_accounting_enable(1)) < 0) {
+        av_log(NULL, AV_LOG_WARNING, "Memory accounting is not available: %s\n",
+               av_err2str(ret));
+        return 0;
+    }
+    do_mem_stats = 1;
+    return 0;
+}
+
 #if CONFIG_VAAPI
 static int opt_vaapi_device(void *optctx, const char *opt, const char *arg)
 {
@@ -3472,6 +3496,10 @@ const OptionDef options[] = {
         "add timings for benchmarking" },
     { "benchmark_all",  OPT_BOOL | OPT_EXPERT,                       { &do_benchmark_all },
       "add timings for each task" },
+    { "trace_file",     HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_trace_file },
+        "write a Chrome trace of the processing stages to file", "file" },
+    { "mem_stats",      OPT_EXPERT,                                  { .func_arg = opt_mem_stats },
+        "report the memory used by each component" },
     { "progress",       HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_progress },
       "write program-readable progress information", "url" },
     { "stdin",          OPT_BOOL | OPT_EXPERT,                       { &stdin_interaction },
@@ -3549,6 +3577,8 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_threads", HAS_ARG | OPT_INT,                   { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "filter_large_buffers", OPT_BOOL | OPT_EXPERT,                 { &filter_large_buffers },
+        "allocate filtered video frames in huge pages on the local NUMA node" },
     { "lavfi",          HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
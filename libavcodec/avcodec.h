@@ -374,6 +374,11 @@ typedef struct RcOverride{
  * Show all frames before the first keyframe
  */
 #define AV_CODEC_FLAG2_SHOW_ALL       (1 << 22)
+/**
+ * Allocate the video frames of the default get_buffer2() with
+ * av_buffer_alloc_large().
+ */
+#define AV_CODEC_FLAG2_LARGE_BUFFERS  (1 << 23)
 /**
  * Export motion vectors through frame side data
  */
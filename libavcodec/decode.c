@@ -37,6 +37,7 @@
 #include "libavutil/internal.h"
 #include "libavutil/intmath.h"
 #include "libavutil/opt.h"
+#include "libavutil/trace.h"
 
 #include "avcodec.h"
 #include "bytestream.h"
@@ -466,7 +467,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
 
         if ((avctx->flags2 & AV_CODEC_FLAG2_SKIP_MANUAL) && got_frame) {
-            AVFrameSideData *fside = av_frame_new_side_data(frame, AV_FRAME_DATA_SKIP_SAMPLES, 10);
+            AVFrameSideData *fside = ff_frame_new_side_data(avctx, frame, AV_FRAME_DATA_SKIP_SAMPLES, 10);
             if (fside) {
                 AV_WL32(fside->data, avci->skip_samples);
                 AV_WL32(fside->data + 4, discard_padding);
@@ -557,16 +558,21 @@ static int decode_simple_receive_frame(AVCodecContext *avctx, AVFrame *frame)
 static int decode_receive_frame_internal(AVCodecContext *avctx, AVFrame *frame)
 {
     AVCodecInternal *avci = avctx->internal;
+    void *mem_tag;
     int ret;
 
     av_assert0(!frame->buf[0]);
 
+    mem_tag = av_mem_tag_enter(avctx);
+    av_trace_begin("decode", avctx->codec->name);
     if (avctx->codec->receive_frame) {
         ret = avctx->codec->receive_frame(avctx, frame);
         if (ret != AVERROR(EAGAIN))
             av_packet_unref(avci->last_pkt_props);
     } else
         ret = decode_simple_receive_frame(avctx, frame);
+    av_trace_end("decode", avctx->codec->name);
+    av_mem_tag_leave(mem_tag);
 
     if (ret == AVERROR_EOF)
         avci->draining_done = 1;
@@ -1525,6 +1531,8 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
                     goto fail;
                 }
                 pool->pools[i] = av_buffer_pool_init(size[i] + 16 + STRIDE_ALIGN - 1,
+                                                     avctx->flags2 & AV_CODEC_FLAG2_LARGE_BUFFERS ?
+                                                        av_buffer_alloc_large :
                                                      CONFIG_MEMORY_POISONING ?
                                                         NULL :
                                                         av_buffer_allocz);
@@ -1698,6 +1706,13 @@ static int add_metadata_from_side_data(const AVPacket *avpkt, AVFrame *frame)
     return av_packet_unpack_dictionary(side_metadata, size, frame_md);
 }
 
+AVFrameSideData *ff_frame_new_side_data(AVCodecContext *avctx, AVFrame *frame,
+                                        enum AVFrameSideDataType type, int size)
+{
+    return avpriv_frame_new_side_data_pooled(&avctx->internal->side_data_pools,
+                                             frame, type, size);
+}
+
 int ff_decode_frame_props(AVCodecContext *avctx, AVFrame *frame)
 {
     AVPacket *pkt = avctx->internal->last_pkt_props;
@@ -1738,7 +1753,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
             int size;
             uint8_t *packet_sd = av_packet_get_side_data(pkt, sd[i].packet, &size);
             if (packet_sd) {
-                AVFrameSideData *frame_sd = av_frame_new_side_data(frame,
+                AVFrameSideData *frame_sd = ff_frame_new_side_data(avctx, frame,
                                                                    sd[i].frame,
                                                                    size);
                 if (!frame_sd)
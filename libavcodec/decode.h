@@ -69,6 +69,13 @@ int ff_decode_get_packet(AVCodecContext *avctx, AVPacket *pkt);
  */
 int ff_decode_frame_props(AVCodecContext *avctx, AVFrame *frame);
 
+/**
+ * Add side data to a decoded frame, like av_frame_new_side_data(), but take
+ * its payload from buffer pools owned by the decoder.
+ */
+AVFrameSideData *ff_frame_new_side_data(AVCodecContext *avctx, AVFrame *frame,
+                                        enum AVFrameSideDataType type, int size);
+
 /**
  * Called during avcodec_open2() to initialize avctx->internal->bsf.
  * The bsf should be freed with av_bsf_free().
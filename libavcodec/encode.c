@@ -24,6 +24,7 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/internal.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/trace.h"
 
 #include "avcodec.h"
 #include "encode.h"
@@ -226,6 +227,7 @@ static int encode_simple_receive_packet(AVCodecContext *avctx, AVPacket *avpkt)
 static int encode_receive_packet_internal(AVCodecContext *avctx, AVPacket *avpkt)
 {
     AVCodecInternal *avci = avctx->internal;
+    void *mem_tag;
     int ret;
 
     if (avci->draining_done)
@@ -240,6 +242,8 @@ static int encode_receive_packet_internal(AVCodecContext *avctx, AVPacket *avpkt
             return AVERROR(EINVAL);
     }
 
+    mem_tag = av_mem_tag_enter(avctx);
+    av_trace_begin("encode", avctx->codec->name);
     if (avctx->codec->receive_packet) {
         ret = avctx->codec->receive_packet(avctx, avpkt);
         if (ret < 0)
@@ -250,6 +254,8 @@ static int encode_receive_packet_internal(AVCodecContext *avctx, AVPacket *avpkt
             av_assert0(!avpkt->data || avpkt->buf);
     } else
         ret = encode_simple_receive_packet(avctx, avpkt);
+    av_trace_end("encode", avctx->codec->name);
+    av_mem_tag_leave(mem_tag);
 
     if (ret == AVERROR_EOF)
         avci->draining_done = 1;
@@ -27,6 +27,7 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
+#include "libavutil/trace.h"
 #include "avcodec.h"
 #include "internal.h"
 #include "thread.h"
@@ -68,6 +69,7 @@ static void * attribute_align_arg worker(void *v){
     while (!atomic_load(&c->exit)) {
         int got_packet = 0, ret;
         AVFrame *frame;
+        void *mem_tag;
         Task task;
 
         if(!pkt) pkt = av_packet_alloc();
@@ -86,7 +88,11 @@ static void * attribute_align_arg worker(void *v){
         pthread_mutex_unlock(&c->task_fifo_mutex);
         frame = task.indata;
 
+        mem_tag = av_mem_tag_enter(avctx);
+        av_trace_begin("encode", avctx->codec->name);
         ret = avctx->codec->encode2(avctx, pkt, frame, &got_packet);
+        av_trace_end("encode", avctx->codec->name);
+        av_mem_tag_leave(mem_tag);
         if(got_packet) {
             int ret2 = av_packet_make_refcounted(pkt);
             if (ret >= 0 && ret2 < 0)
@@ -37,6 +37,7 @@
 #include "bswapdsp.h"
 #include "bytestream.h"
 #include "cabac_functions.h"
+#include "decode.h"
 #include "golomb.h"
 #include "hevc.h"
 #include "hevc_data.h"
@@ -2737,7 +2738,7 @@ static int set_side_data(HEVCContext *s)
         (s->sei.display_orientation.anticlockwise_rotation ||
          s->sei.display_orientation.hflip || s->sei.display_orientation.vflip)) {
         double angle = s->sei.display_orientation.anticlockwise_rotation * 360 / (double) (1 << 16);
-        AVFrameSideData *rotation = av_frame_new_side_data(out,
+        AVFrameSideData *rotation = ff_frame_new_side_data(s->avctx, out,
                                                            AV_FRAME_DATA_DISPLAYMATRIX,
                                                            sizeof(int32_t) * 9);
         if (!rotation)
@@ -2844,7 +2845,7 @@ static int set_side_data(HEVCContext *s)
     if (s->sei.timecode.present) {
         uint32_t *tc_sd;
         char tcbuf[AV_TIMECODE_STR_SIZE];
-        AVFrameSideData *tcside = av_frame_new_side_data(out, AV_FRAME_DATA_S12M_TIMECODE,
+        AVFrameSideData *tcside = ff_frame_new_side_data(s->avctx, out, AV_FRAME_DATA_S12M_TIMECODE,
                                                          sizeof(uint32_t) * 4);
         if (!tcside)
             return AVERROR(ENOMEM);
@@ -28,6 +28,7 @@
 
 #include "libavutil/buffer.h"
 #include "libavutil/channel_layout.h"
+#include "libavutil/frame_internal.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/pixfmt.h"
 #include "avcodec.h"
@@ -135,6 +136,9 @@ typedef struct AVCodecInternal {
 
     AVBufferRef *pool;
 
+    /* payloads of the side data attached to decoded frames */
+    FrameSideDataPools *side_data_pools;
+
     void *thread_ctx;
 
     DecodeSimpleContext ds;
@@ -35,6 +35,7 @@
 
 #include "avcodec.h"
 #include "bytestream.h"
+#include "decode.h"
 #include "error_resilience.h"
 #include "hwconfig.h"
 #include "idctdsp.h"
@@ -1623,7 +1624,7 @@ static int mpeg_field_start(MpegEncContext *s, const uint8_t *buf, int buf_size)
             }
         }
 
-        pan_scan = av_frame_new_side_data(s->current_picture_ptr->f,
+        pan_scan = ff_frame_new_side_data(s->avctx, s->current_picture_ptr->f,
                                           AV_FRAME_DATA_PANSCAN,
                                           sizeof(s1->pan_scan));
         if (!pan_scan)
@@ -1650,7 +1651,7 @@ static int mpeg_field_start(MpegEncContext *s, const uint8_t *buf, int buf_size)
 
         if (s1->has_afd) {
             AVFrameSideData *sd =
-                av_frame_new_side_data(s->current_picture_ptr->f,
+                ff_frame_new_side_data(s->avctx, s->current_picture_ptr->f,
                                        AV_FRAME_DATA_AFD, 1);
             if (!sd)
                 return AVERROR(ENOMEM);
@@ -2852,7 +2853,7 @@ static int mpeg_decode_frame(AVCodecContext *avctx, void *data,
 
         if (s2->timecode_frame_start != -1 && *got_output) {
             char tcbuf[AV_TIMECODE_STR_SIZE];
-            AVFrameSideData *tcside = av_frame_new_side_data(picture,
+            AVFrameSideData *tcside = ff_frame_new_side_data(avctx, picture,
                                                              AV_FRAME_DATA_GOP_TIMECODE,
                                                              sizeof(int64_t));
             if (!tcside)
@@ -27,6 +27,7 @@
 #include "libavutil/avassert.h"
 
 #include "avcodec.h"
+#include "decode.h"
 #include "mpegutils.h"
 
 static int add_mb(AVMotionVector *mb, uint32_t mb_type,
@@ -177,7 +178,7 @@ void ff_print_debug_info2(AVCodecContext *avctx, AVFrame *pict, uint8_t *mbskip_
             AVFrameSideData *sd;
 
             av_log(avctx, AV_LOG_DEBUG, "Adding %d MVs info to frame %d\n", mbcount, avctx->frame_number);
-            sd = av_frame_new_side_data(pict, AV_FRAME_DATA_MOTION_VECTORS, mbcount * sizeof(AVMotionVector));
+            sd = ff_frame_new_side_data(avctx, pict, AV_FRAME_DATA_MOTION_VECTORS, mbcount * sizeof(AVMotionVector));
             if (!sd) {
                 av_freep(&mvs);
                 return;
@@ -44,6 +44,7 @@
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
+#include "libavutil/trace.h"
 
 enum {
     ///< Set when the thread is awaiting a packet.
@@ -174,6 +175,7 @@ static attribute_align_arg void *frame_worker_thread(void *arg)
     PerThreadContext *p = arg;
     AVCodecContext *avctx = p->avctx;
     const AVCodec *codec = avctx->codec;
+    void *mem_tag;
 
     pthread_mutex_lock(&p->mutex);
     while (1) {
@@ -208,7 +210,11 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
         av_frame_unref(p->frame);
         p->got_frame = 0;
+        mem_tag = av_mem_tag_enter(avctx);
+        av_trace_begin("decode", codec->name);
         p->result = codec->decode(avctx, p->frame, &p->got_frame, &p->avpkt);
+        av_trace_end("decode", codec->name);
+        av_mem_tag_leave(mem_tag);
 
         if ((p->result < 0 || !p->got_frame) && p->frame->buf[0]) {
             if (avctx->codec->caps_internal & FF_CODEC_CAP_ALLOCATE_PROGRESS)
@@ -744,6 +750,7 @@ void ff_frame_thread_free(AVCodecContext *avctx, int thread_count)
 
         if (p->avctx) {
             av_buffer_unref(&p->avctx->internal->pool);
+            avpriv_frame_side_data_pools_free(&p->avctx->internal->side_data_pools);
             av_freep(&p->avctx->internal);
             av_buffer_unref(&p->avctx->hw_frames_ctx);
         }
@@ -846,6 +853,7 @@ int ff_frame_thread_init(AVCodecContext *avctx)
         }
         *copy->internal = *src->internal;
         copy->internal->thread_ctx = p;
+        copy->internal->side_data_pools = NULL;
         copy->internal->last_pkt_props = &p->avpkt;
 
         copy->delay = avctx->delay;
@@ -868,8 +876,11 @@ int ff_frame_thread_init(AVCodecContext *avctx)
         if (i)
             copy->internal->is_copy = 1;
 
-        if (codec->init)
+        if (codec->init) {
+            void *mem_tag = av_mem_tag_enter(copy);
             err = codec->init(copy);
+            av_mem_tag_leave(mem_tag);
+        }
 
         if (err) goto error;
 
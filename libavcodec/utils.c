@@ -939,7 +939,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
     if (   avctx->codec->init && (!(avctx->active_thread_type&FF_THREAD_FRAME)
         || avci->frame_thread_encoder)) {
+        void *mem_tag = av_mem_tag_enter(avctx);
         ret = avctx->codec->init(avctx);
+        av_mem_tag_leave(mem_tag);
         if (ret < 0) {
             codec_init_ok = -1;
             goto free_and_end;
@@ -1070,6 +1072,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
     av_bsf_free(&avci->bsf);
 
     av_buffer_unref(&avci->pool);
+    avpriv_frame_side_data_pools_free(&avci->side_data_pools);
     av_freep(&avci);
     avctx->internal = NULL;
     avctx->codec = NULL;
@@ -1175,6 +1178,7 @@ av_cold int avcodec_close(AVCodecContext *avctx)
         av_frame_free(&avctx->internal->es.in_frame);
 
         av_buffer_unref(&avctx->internal->pool);
+        avpriv_frame_side_data_pools_free(&avctx->internal->side_data_pools);
 
         if (avctx->hwaccel && avctx->hwaccel->uninit)
             avctx->hwaccel->uninit(avctx);
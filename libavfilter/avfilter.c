@@ -25,6 +25,7 @@
 #include "libavutil/channel_layout.h"
 #include "libavutil/common.h"
 #include "libavutil/eval.h"
+#include "libavutil/frame_internal.h"
 #include "libavutil/hwcontext.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/internal.h"
@@ -33,6 +34,7 @@
 #include "libavutil/rational.h"
 #include "libavutil/samplefmt.h"
 #include "libavutil/thread.h"
+#include "libavutil/trace.h"
 
 #define FF_INTERNAL_FIELDS 1
 #include "framequeue.h"
@@ -179,6 +181,7 @@ void avfilter_link_free(AVFilterLink **link)
     av_frame_free(&(*link)->partial_buf);
     ff_framequeue_free(&(*link)->fifo);
     ff_frame_pool_uninit((FFFramePool**)&(*link)->frame_pool);
+    avpriv_frame_side_data_pools_free(&(*link)->side_data_pools);
 
     av_freep(link);
 }
@@ -190,6 +193,13 @@ int avfilter_link_get_channels(AVFilterLink *link)
 }
 #endif
 
+AVFrameSideData *ff_filter_new_side_data(AVFilterLink *link, AVFrame *frame,
+                                         enum AVFrameSideDataType type, int size)
+{
+    return avpriv_frame_new_side_data_pooled(&link->side_data_pools,
+                                             frame, type, size);
+}
+
 void ff_filter_set_ready(AVFilterContext *filter, unsigned priority)
 {
     filter->ready = FFMAX(filter->ready, priority);
@@ -897,6 +907,7 @@ int ff_filter_process_command(AVFilterContext *ctx, const char *cmd,
 
 int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
 {
+    void *mem_tag;
     int ret = 0;
 
     ret = av_opt_set_dict(ctx, options);
@@ -922,12 +933,14 @@ int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
         }
     }
 
+    mem_tag = av_mem_tag_enter(ctx);
     if (ctx->filter->init_opaque)
         ret = ctx->filter->init_opaque(ctx, NULL);
     else if (ctx->filter->init)
         ret = ctx->filter->init(ctx);
     else if (ctx->filter->init_dict)
         ret = ctx->filter->init_dict(ctx, options);
+    av_mem_tag_leave(mem_tag);
 
     return ret;
 }
@@ -1428,14 +1441,19 @@ static int ff_filter_activate_default(AVFilterContext *filter)
 
 int ff_filter_activate(AVFilterContext *filter)
 {
+    void *mem_tag;
     int ret;
 
     /* Generic timeline support is not yet implemented but should be easy */
     av_assert1(!(filter->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC &&
                  filter->filter->activate));
     filter->ready = 0;
+    mem_tag = av_mem_tag_enter(filter);
+    av_trace_begin("filter", filter->filter->name);
     ret = filter->filter->activate ? filter->filter->activate(filter) :
           ff_filter_activate_default(filter);
+    av_trace_end("filter", filter->filter->name);
+    av_mem_tag_leave(mem_tag);
     if (ret == FFERROR_NOT_READY)
         ret = 0;
     return ret;
@@ -657,6 +657,12 @@ struct AVFilterLink {
      */
     int status_out;
 
+    /**
+     * Pools for the payloads of side data attached to frames sent on the
+     * link, see ff_filter_new_side_data().
+     */
+    struct FrameSideDataPools *side_data_pools;
+
 #endif /* FF_INTERNAL_FIELDS */
 
 };
@@ -922,6 +928,12 @@ typedef struct AVFilterGraph {
     int sink_links_count;
 
     unsigned disable_auto_convert;
+
+    /**
+     * Allocate the video frames of the graph with av_buffer_alloc_large().
+     * Access ONLY through AVOptions.
+     */
+    int large_buffers;
 } AVFilterGraph;
 
 /**
@@ -56,6 +56,8 @@ static const AVOption filtergraph_options[] = {
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|V },
     {"aresample_swr_opts"   , "default aresample filter options"    , OFFSET(aresample_swr_opts)    ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|A },
+    { "large_buffers", "allocate video frames in huge pages on the local NUMA node",
+        OFFSET(large_buffers), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, F|V },
     { NULL },
 };
 
@@ -315,6 +315,13 @@ int ff_request_frame(AVFilterLink *link);
  */
 int ff_filter_frame(AVFilterLink *link, AVFrame *frame);
 
+/**
+ * Add side data to a frame to be sent on link, like av_frame_new_side_data(),
+ * but take its payload from buffer pools owned by the link.
+ */
+AVFrameSideData *ff_filter_new_side_data(AVFilterLink *link, AVFrame *frame,
+                                         enum AVFrameSideDataType type, int size);
+
 /**
  * Allocate a new filter context and return it.
  *
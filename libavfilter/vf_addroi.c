@@ -159,8 +159,9 @@ static int addroi_filter_frame(AVFilterLink *inlink, AVFrame *frame)
         }
 
     } else {
-        sd = av_frame_new_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST,
-                                    sizeof(AVRegionOfInterest));
+        sd = ff_filter_new_side_data(avctx->outputs[0], frame,
+                                     AV_FRAME_DATA_REGIONS_OF_INTEREST,
+                                     sizeof(AVRegionOfInterest));
         if (!sd) {
             err = AVERROR(ENOMEM);
             goto fail;
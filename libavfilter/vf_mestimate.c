@@ -180,7 +180,8 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
     if (!out)
         return AVERROR(ENOMEM);
 
-    sd = av_frame_new_side_data(out, AV_FRAME_DATA_MOTION_VECTORS, 2 * s->b_count * sizeof(AVMotionVector));
+    sd = ff_filter_new_side_data(ctx->outputs[0], out, AV_FRAME_DATA_MOTION_VECTORS,
+                                 2 * s->b_count * sizeof(AVMotionVector));
     if (!sd) {
         av_frame_free(&out);
         return AVERROR(ENOMEM);
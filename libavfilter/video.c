@@ -43,6 +43,8 @@ AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h)
 
 AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
 {
+    AVBufferRef *(*alloc)(int size) = link->graph && link->graph->large_buffers ?
+                                      av_buffer_alloc_large : av_buffer_allocz;
     AVFrame *frame = NULL;
     int pool_width = 0;
     int pool_height = 0;
@@ -65,7 +67,7 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
     }
 
     if (!link->frame_pool) {
-        link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
+        link->frame_pool = ff_frame_pool_video_init(alloc, w, h,
                                                     link->format, BUFFER_ALIGN);
         if (!link->frame_pool)
             return NULL;
@@ -80,7 +82,7 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
             pool_format != link->format || pool_align != BUFFER_ALIGN) {
 
             ff_frame_pool_uninit((FFFramePool **)&link->frame_pool);
-            link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
+            link->frame_pool = ff_frame_pool_video_init(alloc, w, h,
                                                         link->format, BUFFER_ALIGN);
             if (!link->frame_pool)
                 return NULL;
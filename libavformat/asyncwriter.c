@@ -0,0 +1,394 @@
+/*
+ * Background output for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/avassert.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "asyncwriter.h"
+#include "avio_internal.h"
+#include "internal.h"
+
+enum AsyncJobType {
+    ASYNC_JOB_WRITE,
+    ASYNC_JOB_RENAME,
+    ASYNC_JOB_DELETE,
+};
+
+typedef struct AsyncJob {
+    enum AsyncJobType type;
+    char *url;
+    char *url_dst;
+    AVDictionary *options;
+    uint8_t *buf;
+    int size;
+    struct AsyncJob *next;
+} AsyncJob;
+
+typedef struct AsyncBuffer {
+    AVIOContext **pb;
+    char *url;
+    AVDictionary *options;
+} AsyncBuffer;
+
+struct AsyncWriter {
+    AVFormatContext *s;
+    int64_t max_queued;
+    int ignore_errors;
+
+    AsyncBuffer *buffers;
+    int nb_buffers;
+
+    /* the following fields are protected by mutex */
+    AsyncJob *first, *last;
+    int64_t queued;
+    int busy;
+    int error;
+    int exit;
+
+#if HAVE_THREADS
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+};
+
+static void free_job(AsyncJob **pjob)
+{
+    AsyncJob *job = *pjob;
+
+    if (!job)
+        return;
+    av_freep(&job->url);
+    av_freep(&job->url_dst);
+    av_dict_free(&job->options);
+    av_freep(&job->buf);
+    av_freep(pjob);
+}
+
+static int run_job(AsyncWriter *w, AsyncJob *job)
+{
+    AVFormatContext *s = w->s;
+    AVIOContext *pb = NULL;
+    AVDictionary *opts = NULL;
+    int ret;
+
+    switch (job->type) {
+    case ASYNC_JOB_WRITE:
+        av_dict_copy(&opts, job->options, 0);
+        ret = s->io_open(s, &pb, job->url, AVIO_FLAG_WRITE, &opts);
+        av_dict_free(&opts);
+        if (ret < 0) {
+            av_log(s, AV_LOG_ERROR, "Failed to open '%s' for writing: %s\n",
+                   job->url, av_err2str(ret));
+            return ret;
+        }
+        avio_write(pb, job->buf, job->size);
+        avio_flush(pb);
+        ret = pb->error;
+        ff_format_io_close(s, &pb);
+        if (ret < 0)
+            av_log(s, AV_LOG_ERROR, "Failed to write '%s': %s\n",
+                   job->url, av_err2str(ret));
+        return ret;
+    case ASYNC_JOB_RENAME:
+        return ff_rename(job->url, job->url_dst, s);
+    case ASYNC_JOB_DELETE:
+        if (job->options) {
+            av_dict_copy(&opts, job->options, 0);
+            ret = s->io_open(s, &pb, job->url, AVIO_FLAG_WRITE, &opts);
+            av_dict_free(&opts);
+            ff_format_io_close(s, &pb);
+        } else {
+            ret = avpriv_io_delete(job->url);
+        }
+        if (ret < 0)
+            av_log(s, ret == AVERROR(ENOENT) ? AV_LOG_WARNING : AV_LOG_ERROR,
+                   "Failed to delete '%s': %s\n", job->url, av_err2str(ret));
+        /* a leftover file is not fatal for the output */
+        return 0;
+    }
+    return AVERROR_BUG;
+}
+
+static void job_done(AsyncWriter *w, int ret)
+{
+    if (ret < 0 && !w->ignore_errors && !w->error)
+        w->error = ret;
+}
+
+#if HAVE_THREADS
+static void *writer_thread(void *arg)
+{
+    AsyncWriter *w = arg;
+
+    pthread_mutex_lock(&w->mutex);
+    for (;;) {
+        AsyncJob *job;
+        int ret;
+
+        while (!w->first && !w->exit)
+            pthread_cond_wait(&w->cond, &w->mutex);
+        /* pending jobs are still performed on exit */
+        if (!w->first)
+            break;
+
+        job = w->first;
+        w->first = job->next;
+        if (!w->first)
+            w->last = NULL;
+        w->busy = 1;
+        pthread_mutex_unlock(&w->mutex);
+
+        ret = run_job(w, job);
+
+        pthread_mutex_lock(&w->mutex);
+        job_done(w, ret);
+        w->queued -= job->size;
+        w->busy = 0;
+        pthread_cond_broadcast(&w->cond);
+        free_job(&job);
+    }
+    pthread_mutex_unlock(&w->mutex);
+
+    return NULL;
+}
+#endif
+
+static int submit_job(AsyncWriter *w, AsyncJob *job)
+{
+#if HAVE_THREADS
+    pthread_mutex_lock(&w->mutex);
+    /* back-pressure: a single job larger than the limit is still accepted */
+    while (w->queued > 0 && w->queued + job->size > w->max_queued)
+        pthread_cond_wait(&w->cond, &w->mutex);
+    if (w->last)
+        w->last->next = job;
+    else
+        w->first = job;
+    w->last = job;
+    w->queued += job->size;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+#else
+    job_done(w, run_job(w, job));
+    free_job(&job);
+#endif
+    return 0;
+}
+
+static AsyncJob *alloc_job(enum AsyncJobType type, const char *url)
+{
+    AsyncJob *job = av_mallocz(sizeof(*job));
+
+    if (!job)
+        return NULL;
+    job->type = type;
+    job->url  = av_strdup(url);
+    if (!job->url)
+        av_freep(&job);
+    return job;
+}
+
+int ff_async_writer_alloc(AsyncWriter **pw, AVFormatContext *s,
+                          int64_t max_queued, int ignore_errors)
+{
+    AsyncWriter *w = av_mallocz(sizeof(*w));
+#if HAVE_THREADS
+    int ret;
+#endif
+
+    if (!w)
+        return AVERROR(ENOMEM);
+    w->s             = s;
+    w->max_queued    = max_queued;
+    w->ignore_errors = ignore_errors;
+
+#if HAVE_THREADS
+    if ((ret = pthread_mutex_init(&w->mutex, NULL))) {
+        av_free(w);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&w->cond, NULL))) {
+        pthread_mutex_destroy(&w->mutex);
+        av_free(w);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_create(&w->thread, NULL, writer_thread, w))) {
+        av_log(s, AV_LOG_ERROR, "Failed to create writer thread: %s\n",
+               av_err2str(AVERROR(ret)));
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->mutex);
+        av_free(w);
+        return AVERROR(ret);
+    }
+#endif
+
+    *pw = w;
+    return 0;
+}
+
+void ff_async_writer_free(AsyncWriter **pw)
+{
+    AsyncWriter *w = *pw;
+    int i;
+
+    if (!w)
+        return;
+
+#if HAVE_THREADS
+    pthread_mutex_lock(&w->mutex);
+    w->exit = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+    pthread_join(w->thread, NULL);
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->mutex);
+#endif
+    av_assert0(!w->first);
+
+    for (i = 0; i < w->nb_buffers; i++) {
+        ffio_free_dyn_buf(w->buffers[i].pb);
+        av_freep(&w->buffers[i].url);
+        av_dict_free(&w->buffers[i].options);
+    }
+    av_freep(&w->buffers);
+    av_freep(pw);
+}
+
+int ff_async_writer_open(AsyncWriter *w, AVIOContext **pb, const char *url,
+                         AVDictionary *options)
+{
+    AsyncBuffer *buf;
+    int ret;
+
+    buf = av_realloc_array(w->buffers, w->nb_buffers + 1, sizeof(*w->buffers));
+    if (!buf)
+        return AVERROR(ENOMEM);
+    w->buffers = buf;
+    buf = &w->buffers[w->nb_buffers];
+    memset(buf, 0, sizeof(*buf));
+    buf->url = av_strdup(url);
+    if (!buf->url)
+        return AVERROR(ENOMEM);
+    if ((ret = av_dict_copy(&buf->options, options, 0)) < 0 ||
+        (ret = avio_open_dyn_buf(pb)) < 0) {
+        av_freep(&buf->url);
+        av_dict_free(&buf->options);
+        return ret;
+    }
+    buf->pb = pb;
+    w->nb_buffers++;
+    return 0;
+}
+
+int ff_async_writer_close(AsyncWriter *w, AVIOContext **pb)
+{
+    AsyncBuffer buf;
+    AsyncJob *job;
+    int i;
+
+    for (i = 0; i < w->nb_buffers; i++)
+        if (w->buffers[i].pb == pb)
+            break;
+    if (i == w->nb_buffers)
+        return AVERROR_BUG;
+    buf = w->buffers[i];
+    w->buffers[i] = w->buffers[--w->nb_buffers];
+
+    job = av_mallocz(sizeof(*job));
+    if (!job) {
+        ffio_free_dyn_buf(pb);
+        av_freep(&buf.url);
+        av_dict_free(&buf.options);
+        return AVERROR(ENOMEM);
+    }
+    job->type    = ASYNC_JOB_WRITE;
+    job->url     = buf.url;
+    job->options = buf.options;
+    job->size    = avio_close_dyn_buf(*pb, &job->buf);
+    *pb = NULL;
+
+    if (!job->buf) {
+        free_job(&job);
+        return AVERROR(ENOMEM);
+    }
+    return submit_job(w, job);
+}
+
+int ff_async_writer_rename(AsyncWriter *w, const char *url_src, const char *url_dst)
+{
+    AsyncJob *job = alloc_job(ASYNC_JOB_RENAME, url_src);
+
+    if (!job)
+        return AVERROR(ENOMEM);
+    job->url_dst = av_strdup(url_dst);
+    if (!job->url_dst) {
+        free_job(&job);
+        return AVERROR(ENOMEM);
+    }
+    return submit_job(w, job);
+}
+
+int ff_async_writer_delete(AsyncWriter *w, const char *url, AVDictionary *options)
+{
+    AsyncJob *job = alloc_job(ASYNC_JOB_DELETE, url);
+    int ret;
+
+    if (!job)
+        return AVERROR(ENOMEM);
+    if ((ret = av_dict_copy(&job->options, options, 0)) < 0) {
+        free_job(&job);
+        return ret;
+    }
+    return submit_job(w, job);
+}
+
+int ff_async_writer_flush(AsyncWriter *w)
+{
+    int ret;
+
+#if HAVE_THREADS
+    pthread_mutex_lock(&w->mutex);
+    while (w->first || w->busy)
+        pthread_cond_wait(&w->cond, &w->mutex);
+    ret = w->error;
+    pthread_mutex_unlock(&w->mutex);
+#else
+    ret = w->error;
+#endif
+    return ret;
+}
+
+int ff_async_writer_get_error(AsyncWriter *w)
+{
+    int ret;
+
+#if HAVE_THREADS
+    pthread_mutex_lock(&w->mutex);
+    ret = w->error;
+    pthread_mutex_unlock(&w->mutex);
+#else
+    ret = w->error;
+#endif
+    return ret;
+}
@@ -0,0 +1,103 @@
+/*
+ * Background output for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_ASYNCWRITER_H
+#define AVFORMAT_ASYNCWRITER_H
+
+#include "libavutil/dict.h"
+
+#include "avformat.h"
+#include "avio.h"
+
+/**
+ * A writer thread that performs the file operations of a segmenting muxer
+ * (writing whole files, renaming and deleting them) in submission order,
+ * so that a slow output target does not stall the muxer.
+ *
+ * Files are opened as memory buffers with ff_async_writer_open(); once
+ * closed with ff_async_writer_close(), their content is written to the
+ * target URL in the background through AVFormatContext.io_open. io_open and
+ * io_close are thus called from the writer thread while the muxer runs on
+ * the calling thread, so custom callbacks must be thread-safe.
+ *
+ * The amount of data waiting to be written is bounded: submitting a file
+ * blocks while the queue holds more than max_queued bytes.
+ *
+ * A failing write or rename makes all later calls to
+ * ff_async_writer_get_error() return that error, unless the writer was
+ * created with ignore_errors set, in which case it is only logged.
+ * A failing delete is always only logged.
+ *
+ * Without thread support, the operations are performed synchronously.
+ */
+typedef struct AsyncWriter AsyncWriter;
+
+/**
+ * @param s              muxer context, used for io_open/io_close and logging
+ * @param max_queued     maximum number of bytes waiting to be written
+ * @param ignore_errors  only log write and rename errors
+ */
+int ff_async_writer_alloc(AsyncWriter **pw, AVFormatContext *s,
+                          int64_t max_queued, int ignore_errors);
+
+/**
+ * Wait for all pending operations, stop the thread and free the writer.
+ * Buffers which are still open are discarded and their *pb set to NULL.
+ */
+void ff_async_writer_free(AsyncWriter **pw);
+
+/**
+ * Open a memory buffer in *pb standing in for url.
+ *
+ * @param options  passed to io_open when the file is written, may be NULL
+ */
+int ff_async_writer_open(AsyncWriter *w, AVIOContext **pb, const char *url,
+                         AVDictionary *options);
+
+/**
+ * Close a buffer opened with ff_async_writer_open() and queue writing its
+ * content. The buffer is freed and *pb set to NULL even on failure.
+ */
+int ff_async_writer_close(AsyncWriter *w, AVIOContext **pb);
+
+/**
+ * Queue renaming url_src to url_dst.
+ */
+int ff_async_writer_rename(AsyncWriter *w, const char *url_src, const char *url_dst);
+
+/**
+ * Queue deleting url. If options is not NULL, the URL is opened for writing
+ * with them instead (e.g. to send an HTTP DELETE request).
+ */
+int ff_async_writer_delete(AsyncWriter *w, const char *url, AVDictionary *options);
+
+/**
+ * Wait until all queued operations have been performed.
+ *
+ * @return the first write or rename error, 0 otherwise
+ */
+int ff_async_writer_flush(AsyncWriter *w);
+
+/**
+ * @return the first write or rename error, 0 otherwise
+ */
+int ff_async_writer_get_error(AsyncWriter *w);
+
+#endif /* AVFORMAT_ASYNCWRITER_H */
@@ -2232,6 +2232,51 @@ int av_demuxer_open(AVFormatContext *ic);
  */
 int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options);
 
+/**
+ * Serialize the stream information of an opened input, as found by
+ * avformat_find_stream_info(), so that later opens of the same content
+ * can restore it with avformat_import_stream_info() instead of analyzing
+ * the input again.
+ *
+ * The data contains the codec parameters and frame rates of all streams,
+ * and a fingerprint of the input made of the demuxer name, the size of the
+ * input and a hash of its first bytes. It is not meant to be portable
+ * between different versions of libavformat.
+ *
+ * The input must allow seeking back to its start, as the fingerprint is
+ * computed from its first bytes. The read position is restored afterwards.
+ *
+ * @param ic    media file handle, after avformat_find_stream_info()
+ * @param data  set to the allocated data, to be freed with av_free()
+ * @param size  set to the size of the data
+ * @return 0 on success, AVERROR(ENOSYS) if the input cannot be
+ *         fingerprinted, another negative AVERROR on failure
+ */
+int avformat_export_stream_info(AVFormatContext *ic, uint8_t **data, int *size);
+
+/**
+ * Import stream information exported by avformat_export_stream_info().
+ *
+ * Must be called after avformat_open_input() and before
+ * avformat_find_stream_info(). If the data matches the input, the following
+ * avformat_find_stream_info() call sets the parameters of the streams found
+ * in the data instead of decoding packets to find them, and returns as soon
+ * as all of these streams have been created by the demuxer. Streams which
+ * are not in the data, or whose id or time base differ, are analyzed as
+ * usual.
+ *
+ * The read position is not changed by this function.
+ *
+ * @param ic    media file handle
+ * @param data  data returned by avformat_export_stream_info()
+ * @param size  size of the data
+ * @return 0 if the data was imported, AVERROR(EINVAL) if it does not match
+ *         the input, AVERROR_INVALIDDATA if it is damaged, another negative
+ *         AVERROR on failure. On failure, avformat_find_stream_info()
+ *         works as if this function had not been called.
+ */
+int avformat_import_stream_info(AVFormatContext *ic, const uint8_t *data, int size);
+
 /**
  * Find the programs which belong to a given stream.
  *
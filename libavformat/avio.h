@@ -700,6 +700,14 @@ int avio_get_str16be(AVIOContext *pb, int maxlen, char *buf, int buflen);
  */
 #define AVIO_FLAG_DIRECT 0x8000
 
+/**
+ * Let demuxers that support it return packets referencing the read buffer
+ * instead of copying their payload out of it. The read buffer is made larger
+ * and a new one is used whenever a filled buffer is still referenced.
+ * Such packets are not writable.
+ */
+#define AVIO_FLAG_ZEROCOPY 0x10000
+
 /**
  * Create and initialize a AVIOContext for accessing the
  * resource indicated by url.
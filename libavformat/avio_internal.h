@@ -22,6 +22,7 @@
 #include "avio.h"
 #include "url.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/log.h"
 
 extern const AVClass ff_avio_class;
@@ -53,6 +54,19 @@ int ffio_init_context(AVIOContext *s,
  */
 int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsigned char **data);
 
+/**
+ * Read size bytes as a reference to the read buffer, without copying them.
+ * This is only possible if the context was opened with AVIO_FLAG_ZEROCOPY
+ * and the data is available at contiguous addresses in the buffer.
+ *
+ * @param buf  set to a new reference to the buffer holding the data, or
+ *             to NULL if nothing was read
+ * @param data set to the start of the data
+ * @return size, 0 if the data can not be referenced (nothing is read in
+ *         this case) or a negative AVERROR code
+ */
+int ffio_read_ref(AVIOContext *s, AVBufferRef **buf, uint8_t **data, int size);
+
 void ffio_fill(AVIOContext *s, int b, int count);
 
 static av_always_inline void ffio_wfourcc(AVIOContext *pb, const uint8_t *s)
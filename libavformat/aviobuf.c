@@ -20,6 +20,7 @@
  */
 
 #include "libavutil/bprint.h"
+#include "libavutil/buffer.h"
 #include "libavutil/crc.h"
 #include "libavutil/dict.h"
 #include "libavutil/intreadwrite.h"
@@ -42,6 +43,38 @@
  */
 #define SHORT_SEEK_THRESHOLD 32768
 
+/**
+ * Read buffer size with AVIO_FLAG_ZEROCOPY, large enough to hold many
+ * packets, and the smallest packet referencing it instead of being copied,
+ * as each such packet keeps a whole buffer alive.
+ */
+#define ZEROCOPY_BUFFER_SIZE (1 << 20)
+#define ZEROCOPY_MIN_SIZE    4096
+
+/**
+ * AVIOContext allocated by ffio_fdopen(), with the state needed to share the
+ * read buffer with packets.
+ */
+typedef struct FDIOContext {
+    AVIOContext pub;
+
+    /**
+     * Reference owning the buffer, if the buffer can be shared with packets
+     * (AVIO_FLAG_ZEROCOPY), NULL otherwise.
+     */
+    AVBufferRef *buffer_ref;
+
+    /**
+     * Pool of orig_buffer_size buffers used for buffer_ref.
+     */
+    AVBufferPool *buffer_pool;
+} FDIOContext;
+
+static FDIOContext *fdio_context(AVIOContext *s)
+{
+    return ffio_geturlcontext(s) ? (FDIOContext *)s : NULL;
+}
+
 static void *ff_avio_child_next(void *obj, void *prev)
 {
     AVIOContext *s = obj;
@@ -157,6 +190,51 @@ void avio_context_free(AVIOContext **ps)
     av_freep(ps);
 }
 
+/**
+ * Allocate a buffer of buf_size bytes, from the pool if the buffer may be
+ * referenced by packets. The pool is reallocated if buf_size differs from
+ * orig_buffer_size, which is expected to be updated by the caller.
+ */
+static int alloc_buffer(AVIOContext *s, int buf_size,
+                        uint8_t **buffer, AVBufferRef **ref)
+{
+    FDIOContext *ctx = fdio_context(s);
+
+    *ref = NULL;
+    if (ctx && ctx->buffer_pool) {
+        if (buf_size != s->orig_buffer_size) {
+            AVBufferPool *pool = av_buffer_pool_init(buf_size + AV_INPUT_BUFFER_PADDING_SIZE, NULL);
+            if (!pool)
+                return AVERROR(ENOMEM);
+            av_buffer_pool_uninit(&ctx->buffer_pool);
+            ctx->buffer_pool = pool;
+        }
+        *ref = av_buffer_pool_get(ctx->buffer_pool);
+        if (!*ref)
+            return AVERROR(ENOMEM);
+        *buffer = (*ref)->data;
+    } else {
+        *buffer = av_malloc(buf_size);
+        if (!*buffer)
+            return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+/* Replace the buffer, freeing the current one. */
+static void set_buffer(AVIOContext *s, uint8_t *buffer, AVBufferRef *ref)
+{
+    FDIOContext *ctx = fdio_context(s);
+
+    if (ctx && ctx->buffer_ref)
+        av_buffer_unref(&ctx->buffer_ref);
+    else
+        av_free(s->buffer);
+    s->buffer = buffer;
+    if (ctx)
+        ctx->buffer_ref = ref;
+}
+
 static void writeout(AVIOContext *s, const uint8_t *data, int len)
 {
     if (!s->error) {
@@ -538,11 +616,13 @@ static int read_packet_wrapper(AVIOContext *s, uint8_t *buf, int size)
 
 static void fill_buffer(AVIOContext *s)
 {
+    FDIOContext *ctx    = fdio_context(s);
     int max_buffer_size = s->max_packet_size ?
                           s->max_packet_size : IO_BUFFER_SIZE;
     uint8_t *dst        = s->buf_end - s->buffer + max_buffer_size <= s->buffer_size ?
                           s->buf_end : s->buffer;
     int len             = s->buffer_size - (dst - s->buffer);
+    AVBufferRef *new_ref = NULL;
 
     /* can't fill the buffer without read_packet, just set EOF if appropriate */
     if (!s->read_packet && s->buf_ptr >= s->buf_end)
@@ -571,7 +651,22 @@ static void fill_buffer(AVIOContext *s)
         len = s->orig_buffer_size;
     }
 
+    /* Do not write to a buffer still referenced by packets, not even after
+     * the buffered data, which is the padding of the last packet. Read into
+     * a new buffer instead, which replaces the current one once filled. */
+    if (ctx && ctx->buffer_pool && s->buffer_size == s->orig_buffer_size &&
+        (ctx->buffer_ref ? !av_buffer_is_writable(ctx->buffer_ref) : dst == s->buffer)) {
+        if (alloc_buffer(s, s->buffer_size, &dst, &new_ref) < 0) {
+            s->eof_reached = 1;
+            s->error = AVERROR(ENOMEM);
+            return;
+        }
+        len = s->buffer_size;
+    }
+
     len = read_packet_wrapper(s, dst, len);
+    if (len < 0)
+        av_buffer_unref(&new_ref);
     if (len == AVERROR_EOF) {
         /* do not modify buffer if EOF reached so that a seek back can
            be done without rereading data */
@@ -580,6 +675,10 @@ static void fill_buffer(AVIOContext *s)
         s->eof_reached = 1;
         s->error= len;
     } else {
+        if (new_ref) {
+            set_buffer(s, dst, new_ref);
+            s->checksum_ptr = s->buffer;
+        }
         s->pos += len;
         s->buf_ptr = dst;
         s->buf_end = dst + len;
@@ -693,6 +792,66 @@ int ffio_read_size(AVIOContext *s, unsigned char *buf, int size)
     return AVERROR_INVALIDDATA;
 }
 
+int ffio_read_ref(AVIOContext *s, AVBufferRef **buf, uint8_t **data, int size)
+{
+    FDIOContext *ctx = fdio_context(s);
+    int avail, len;
+
+    *buf = NULL;
+    if (!ctx || !ctx->buffer_ref || s->write_flag || s->direct ||
+        s->update_checksum || size < ZEROCOPY_MIN_SIZE || size > s->buffer_size)
+        return 0;
+
+    /* The packet must end where the buffered data ends, so that its padding
+     * can be zeroed: data following it would end up in the padding. */
+    avail = s->buf_end - s->buf_ptr;
+    if (avail > size)
+        return 0;
+    if (avail < size) {
+        if (s->eof_reached || !s->read_packet)
+            return 0;
+        if (!av_buffer_is_writable(ctx->buffer_ref) ||
+            s->buf_end - s->buffer + size - avail > s->buffer_size) {
+            /* no room after the buffered data, or it is the padding of
+             * another packet: start over if nothing is left to be read */
+            if (avail)
+                return 0;
+            if (!av_buffer_is_writable(ctx->buffer_ref)) {
+                AVBufferRef *ref;
+                uint8_t *buffer;
+                int ret = alloc_buffer(s, s->buffer_size, &buffer, &ref);
+                if (ret < 0)
+                    return ret;
+                set_buffer(s, buffer, ref);
+            }
+            s->buf_ptr = s->buf_end = s->buffer;
+        }
+        /* read exactly the rest of the packet */
+        while (s->buf_end - s->buf_ptr < size) {
+            len = read_packet_wrapper(s, s->buf_end, size - (s->buf_end - s->buf_ptr));
+            if (len < 0) {
+                s->eof_reached = 1;
+                if (len != AVERROR_EOF)
+                    s->error = len;
+                return 0;
+            }
+            s->pos        += len;
+            s->buf_end    += len;
+            s->bytes_read += len;
+        }
+    }
+
+    *buf = av_buffer_ref(ctx->buffer_ref);
+    if (!*buf)
+        return AVERROR(ENOMEM);
+    /* Nothing is written to the buffer while the packet references it,
+     * see fill_buffer(). */
+    memset(s->buf_end, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    *data = s->buf_ptr;
+    s->buf_ptr += size;
+    return size;
+}
+
 int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsigned char **data)
 {
     if (s->buf_end - s->buf_ptr >= size && !s->write_flag) {
@@ -924,6 +1083,9 @@ uint64_t ffio_read_varlen(AVIOContext *bc){
 
 int ffio_fdopen(AVIOContext **s, URLContext *h)
 {
+    FDIOContext *ctx;
+    AVBufferPool *pool = NULL;
+    AVBufferRef *ref = NULL;
     uint8_t *buffer = NULL;
     int buffer_size, max_packet_size;
 
@@ -938,16 +1100,36 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
             return AVERROR(EINVAL);
         buffer_size *= 2;
     }
-    buffer = av_malloc(buffer_size);
-    if (!buffer)
-        return AVERROR(ENOMEM);
+    if (!(h->flags & AVIO_FLAG_WRITE) && (h->flags & AVIO_FLAG_ZEROCOPY)) {
+        buffer_size = FFMAX(buffer_size, ZEROCOPY_BUFFER_SIZE);
+        pool = av_buffer_pool_init(buffer_size + AV_INPUT_BUFFER_PADDING_SIZE, NULL);
+        if (!pool || !(ref = av_buffer_pool_get(pool))) {
+            av_buffer_pool_uninit(&pool);
+            return AVERROR(ENOMEM);
+        }
+        buffer = ref->data;
+    } else {
+        buffer = av_malloc(buffer_size);
+        if (!buffer)
+            return AVERROR(ENOMEM);
+    }
 
-    *s = avio_alloc_context(buffer, buffer_size, h->flags & AVIO_FLAG_WRITE, h,
-                            (int (*)(void *, uint8_t *, int))  ffurl_read,
-                            (int (*)(void *, uint8_t *, int))  ffurl_write,
-                            (int64_t (*)(void *, int64_t, int))ffurl_seek);
-    if (!*s)
+    ctx = av_mallocz(sizeof(*ctx));
+    if (!ctx) {
+        if (ref) {
+            av_buffer_unref(&ref);
+            av_buffer_pool_uninit(&pool);
+            return AVERROR(ENOMEM);
+        }
         goto fail;
+    }
+    ffio_init_context(&ctx->pub, buffer, buffer_size, h->flags & AVIO_FLAG_WRITE, h,
+                      (int (*)(void *, uint8_t *, int))  ffurl_read,
+                      (int (*)(void *, uint8_t *, int))  ffurl_write,
+                      (int64_t (*)(void *, int64_t, int))ffurl_seek);
+    ctx->buffer_ref  = ref;
+    ctx->buffer_pool = pool;
+    *s = &ctx->pub;
 
     (*s)->protocol_whitelist = av_strdup(h->protocol_whitelist);
     if (!(*s)->protocol_whitelist && h->protocol_whitelist) {
@@ -1001,6 +1183,7 @@ static void update_checksum(AVIOContext *s)
 
 int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size)
 {
+    FDIOContext *ctx = fdio_context(s);
     uint8_t *buffer;
     int max_buffer_size = s->max_packet_size ?
                           s->max_packet_size : IO_BUFFER_SIZE;
@@ -1015,17 +1198,19 @@ int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size)
         return 0;
     av_assert0(!s->write_flag);
 
-    if (buf_size <= s->buffer_size) {
+    /* A buffer that may be shared with packets is replaced, as data in it
+     * can not be kept for seeking back once a packet references it. */
+    if (buf_size <= s->buffer_size && !(ctx && ctx->buffer_ref)) {
         update_checksum(s);
         memmove(s->buffer, s->buf_ptr, filled);
     } else {
+        buf_size = FFMAX(buf_size, s->buffer_size);
         buffer = av_malloc(buf_size);
         if (!buffer)
             return AVERROR(ENOMEM);
         update_checksum(s);
         memcpy(buffer, s->buf_ptr, filled);
-        av_free(s->buffer);
-        s->buffer = buffer;
+        set_buffer(s, buffer, NULL);
         s->buffer_size = buf_size;
     }
     s->buf_ptr = s->buffer;
@@ -1036,13 +1221,14 @@ int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size)
 
 int ffio_set_buf_size(AVIOContext *s, int buf_size)
 {
+    AVBufferRef *ref;
     uint8_t *buffer;
-    buffer = av_malloc(buf_size);
-    if (!buffer)
-        return AVERROR(ENOMEM);
+    int ret;
 
-    av_free(s->buffer);
-    s->buffer = buffer;
+    if ((ret = alloc_buffer(s, buf_size, &buffer, &ref)) < 0)
+        return ret;
+
+    set_buffer(s, buffer, ref);
     s->orig_buffer_size =
     s->buffer_size = buf_size;
     s->buf_ptr = s->buf_ptr_max = buffer;
@@ -1052,8 +1238,9 @@ int ffio_set_buf_size(AVIOContext *s, int buf_size)
 
 int ffio_realloc_buf(AVIOContext *s, int buf_size)
 {
+    AVBufferRef *ref;
     uint8_t *buffer;
-    int data_size;
+    int data_size, ret;
 
     if (!s->buffer_size)
         return ffio_set_buf_size(s, buf_size);
@@ -1061,15 +1248,13 @@ int ffio_realloc_buf(AVIOContext *s, int buf_size)
     if (buf_size <= s->buffer_size)
         return 0;
 
-    buffer = av_malloc(buf_size);
-    if (!buffer)
-        return AVERROR(ENOMEM);
+    if ((ret = alloc_buffer(s, buf_size, &buffer, &ref)) < 0)
+        return ret;
 
     data_size = s->write_flag ? (s->buf_ptr - s->buffer) : (s->buf_end - s->buf_ptr);
     if (data_size > 0)
         memcpy(buffer, s->write_flag ? s->buffer : s->buf_ptr, data_size);
-    av_free(s->buffer);
-    s->buffer = buffer;
+    set_buffer(s, buffer, ref);
     s->orig_buffer_size = buf_size;
     s->buffer_size = buf_size;
     s->buf_ptr = s->write_flag ? (s->buffer + data_size) : s->buffer;
@@ -1128,8 +1313,8 @@ int ffio_rewind_with_probe_data(AVIOContext *s, unsigned char **bufp, int buf_si
         buf_size = new_size;
     }
 
-    av_free(s->buffer);
-    s->buf_ptr = s->buffer = buf;
+    set_buffer(s, buf, NULL);
+    s->buf_ptr = buf;
     s->buffer_size = alloc_size;
     s->pos = buf_size;
     s->buf_end = s->buf_ptr + buf_size;
@@ -1172,16 +1357,20 @@ int avio_open2(AVIOContext **s, const char *filename, int flags,
 
 int avio_close(AVIOContext *s)
 {
+    FDIOContext *ctx;
     URLContext *h;
 
     if (!s)
         return 0;
 
     avio_flush(s);
+    ctx = fdio_context(s);
+    set_buffer(s, NULL, NULL);
+    if (ctx)
+        av_buffer_pool_uninit(&ctx->buffer_pool);
+
     h         = s->opaque;
     s->opaque = NULL;
-
-    av_freep(&s->buffer);
     if (s->write_flag)
         av_log(s, AV_LOG_VERBOSE, "Statistics: %d seeks, %d writeouts\n", s->seek_count, s->writeout_count);
     else
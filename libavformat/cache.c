@@ -23,16 +23,20 @@
 
 /**
  * @TODO
- *      support keeping files
  *      support filling with a background thread
  */
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
 #include "libavutil/internal.h"
+#include "libavutil/md5.h"
 #include "libavutil/opt.h"
+#include "libavutil/random_seed.h"
+#include "libavutil/time.h"
 #include "libavutil/tree.h"
 #include "avformat.h"
+#include "internal.h"
 #include <fcntl.h>
 #if HAVE_IO_H
 #include <io.h>
@@ -41,16 +45,47 @@
 #include <unistd.h>
 #endif
 #include <sys/stat.h>
+#if HAVE_FLOCK
+#include <sys/file.h>
+#endif
 #include <stdlib.h>
 #include "os_support.h"
 #include "url.h"
 
+#define INDEX_VERSION 1
+/* leftovers of interrupted writers are removed after this many seconds */
+#define ORPHAN_AGE 3600
+/* files in cache_dir shared by all entries */
+#define LOCK_FILE  "lock"
+#define TOTAL_FILE "size"
+
 typedef struct CacheEntry {
     int64_t logical_pos;
     int64_t physical_pos;
-    int size;
+    int64_t size;
 } CacheEntry;
 
+typedef struct CacheRange {
+    int64_t start, end;
+} CacheRange;
+
+/**
+ * Content of the index file of a persistent cache entry.
+ *
+ * The cached data of an entry is stored at its logical position in a
+ * sparse data file, whose name is the key of the entry followed by a
+ * random suffix; a new data file is used whenever the resource changes.
+ */
+typedef struct CacheIndex {
+    char data[9];
+    char *etag;
+    char *last_modified;
+    int64_t size;
+    int64_t hit_bytes, miss_bytes;
+    CacheRange *ranges;
+    int nb_ranges;
+} CacheIndex;
+
 typedef struct Context {
     AVClass *class;
     int fd;
@@ -63,7 +98,24 @@ typedef struct Context {
     int is_true_eof;
     URLContext *inner;
     int64_t cache_hit, cache_miss;
+    int64_t hit_bytes, miss_bytes;
     int read_ahead_limit;
+
+    char *cache_dir;
+    int64_t cache_max_size;
+    int cache_validate;
+
+    /* persistent cache state */
+    char *url;
+    int flags;
+    AVDictionary *inner_options;
+    char key[33];
+    char *index_path;
+    char *data_path;
+    CacheIndex index;
+    char outdated[9];
+    int persistent;
+    int stale;
 } Context;
 
 static int cmp(const void *key, const void *node)
@@ -71,6 +123,603 @@ static int cmp(const void *key, const void *node)
     return FFDIFFSIGN(*(const int64_t *)key, ((const CacheEntry *) node)->logical_pos);
 }
 
+static void free_index(CacheIndex *idx)
+{
+    av_freep(&idx->etag);
+    av_freep(&idx->last_modified);
+    av_freep(&idx->ranges);
+    idx->nb_ranges = 0;
+}
+
+static int add_range(CacheIndex *idx, int64_t start, int64_t end)
+{
+    CacheRange *r = idx->ranges;
+
+    if (start >= end)
+        return 0;
+    if (!(idx->nb_ranges & (idx->nb_ranges - 1))) {
+        r = av_realloc_array(idx->ranges, FFMAX(1, 2 * idx->nb_ranges), sizeof(*r));
+        if (!r)
+            return AVERROR(ENOMEM);
+        idx->ranges = r;
+    }
+    r[idx->nb_ranges].start = start;
+    r[idx->nb_ranges].end   = end;
+    idx->nb_ranges++;
+    return 0;
+}
+
+static int cmp_range(const void *a, const void *b)
+{
+    return FFDIFFSIGN(((const CacheRange *)a)->start, ((const CacheRange *)b)->start);
+}
+
+/* sort the ranges and merge the overlapping and adjacent ones */
+static void merge_ranges(CacheIndex *idx)
+{
+    int i, n = 0;
+
+    qsort(idx->ranges, idx->nb_ranges, sizeof(*idx->ranges), cmp_range);
+    for (i = 0; i < idx->nb_ranges; i++) {
+        if (n && idx->ranges[i].start <= idx->ranges[n - 1].end)
+            idx->ranges[n - 1].end = FFMAX(idx->ranges[n - 1].end, idx->ranges[i].end);
+        else
+            idx->ranges[n++] = idx->ranges[i];
+    }
+    idx->nb_ranges = n;
+}
+
+static int64_t cached_bytes(const CacheIndex *idx)
+{
+    int64_t bytes = 0;
+    int i;
+
+    for (i = 0; i < idx->nb_ranges; i++)
+        bytes += idx->ranges[i].end - idx->ranges[i].start;
+    return bytes;
+}
+
+static int read_index(void *logctx, const char *path, CacheIndex *idx)
+{
+    AVBPrint bp;
+    char buf[4096], *line, *next;
+    const char *p;
+    int fd, ret, version = 0;
+
+    memset(idx, 0, sizeof(*idx));
+    idx->size = -1;
+
+    fd = avpriv_open(path, O_RDONLY);
+    if (fd < 0)
+        return AVERROR(errno);
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    while ((ret = read(fd, buf, sizeof(buf))) > 0)
+        av_bprint_append_data(&bp, buf, ret);
+    close(fd);
+    if (ret < 0 || !av_bprint_is_complete(&bp)) {
+        ret = ret < 0 ? AVERROR(errno) : AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    for (line = bp.str; *line; line = next) {
+        int64_t start, end;
+
+        next = line + strcspn(line, "\n");
+        if (*next)
+            *next++ = 0;
+        if (av_strstart(line, "ffcache ", &p)) {
+            version = strtol(p, NULL, 10);
+        } else if (av_strstart(line, "data ", &p)) {
+            av_strlcpy(idx->data, p, sizeof(idx->data));
+        } else if (av_strstart(line, "etag ", &p)) {
+            av_free(idx->etag);
+            idx->etag = av_strdup(p);
+        } else if (av_strstart(line, "last_modified ", &p)) {
+            av_free(idx->last_modified);
+            idx->last_modified = av_strdup(p);
+        } else if (av_strstart(line, "size ", &p)) {
+            idx->size = strtoll(p, NULL, 10);
+        } else if (av_strstart(line, "hits ", &p)) {
+            idx->hit_bytes = strtoll(p, NULL, 10);
+        } else if (av_strstart(line, "misses ", &p)) {
+            idx->miss_bytes = strtoll(p, NULL, 10);
+        } else if (av_strstart(line, "range ", &p) &&
+                   sscanf(p, "%"SCNd64" %"SCNd64, &start, &end) == 2 &&
+                   start >= 0 && start <= end) {
+            if ((ret = add_range(idx, start, end)) < 0)
+                goto fail;
+        }
+    }
+    av_bprint_finalize(&bp, NULL);
+
+    if (version != INDEX_VERSION || strlen(idx->data) != 8 ||
+        strspn(idx->data, "0123456789abcdef") != 8) {
+        free_index(idx);
+        return AVERROR_INVALIDDATA;
+    }
+    merge_ranges(idx);
+    return 0;
+fail:
+    av_bprint_finalize(&bp, NULL);
+    free_index(idx);
+    return ret;
+}
+
+static int collect_range(void *opaque, void *elem)
+{
+    CacheEntry *entry = elem;
+    return add_range(opaque, entry->logical_pos, entry->logical_pos + entry->size);
+}
+
+/**
+ * Take the lock serializing the updates of the index files and of the
+ * total size, and the eviction, between the processes sharing cache_dir.
+ *
+ * @return the file descriptor to pass to unlock_cache(), or -1
+ */
+static int lock_cache(URLContext *h)
+{
+#if HAVE_FLOCK
+    Context *c = h->priv_data;
+    char *path = av_asprintf("%s/" LOCK_FILE, c->cache_dir);
+    int fd = path ? avpriv_open(path, O_RDWR | O_CREAT, 0666) : -1;
+    int ret;
+
+    av_free(path);
+    if (fd >= 0) {
+        while ((ret = flock(fd, LOCK_EX)) < 0 && errno == EINTR)
+            ;
+        if (ret < 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0)
+        av_log(h, AV_LOG_WARNING, "Could not lock %s, updating it unlocked\n",
+               c->cache_dir);
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+static void unlock_cache(int fd)
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+/**
+ * @return the number of cached bytes in cache_dir as last stored, or -1 if
+ *         unknown
+ */
+static int64_t read_total(URLContext *h)
+{
+    Context *c = h->priv_data;
+    char *path = av_asprintf("%s/" TOTAL_FILE, c->cache_dir), buf[32], *end;
+    int64_t total = -1;
+    int fd = path ? avpriv_open(path, O_RDONLY) : -1, len;
+
+    av_free(path);
+    if (fd < 0)
+        return -1;
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len > 0) {
+        buf[len] = 0;
+        total = strtoll(buf, &end, 10);
+        if (end == buf || total < 0)
+            total = -1;
+    }
+    return total;
+}
+
+/* store the number of cached bytes in cache_dir, -1 if unknown */
+static void write_total(URLContext *h, int64_t total)
+{
+    Context *c = h->priv_data;
+    char *path = av_asprintf("%s/" TOTAL_FILE, c->cache_dir), buf[32];
+    int fd, len;
+
+    if (!path)
+        return;
+    fd = total < 0 ? -1 : avpriv_open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    len = snprintf(buf, sizeof(buf), "%"PRId64"\n", total);
+    if (fd < 0 || write(fd, buf, len) != len) {
+        if (total >= 0)
+            av_log(h, AV_LOG_WARNING, "Could not write %s\n", path);
+        unlink(path);
+    }
+    if (fd >= 0)
+        close(fd);
+    av_free(path);
+}
+
+/**
+ * Write the index of the current entry, merged with the data other
+ * processes have added to the same data file meanwhile. Must be called
+ * with the cache locked, so that no update of the index is lost.
+ *
+ * Data is always written to the data file before the range is published
+ * in the index, and the index is replaced atomically, so that concurrent
+ * readers never see a range which is not backed by data.
+ *
+ * @param added set to the number of bytes added to the cache on success
+ */
+static int write_index(URLContext *h, int64_t *added)
+{
+    Context *c = h->priv_data;
+    CacheIndex disk, *idx = &c->index;
+    AVBPrint bp;
+    char *tmp_path = NULL;
+    int64_t disk_bytes = 0;
+    int fd, i, ret;
+
+    av_freep(&idx->ranges);
+    idx->nb_ranges = 0;
+    av_tree_enumerate(c->root, idx, NULL, collect_range);
+    if (c->is_true_eof)
+        idx->size = c->end;
+
+    *added = 0;
+    if (read_index(h, c->index_path, &disk) >= 0) {
+        disk_bytes = cached_bytes(&disk);
+        if (!strcmp(disk.data, c->outdated)) {
+            /* replace the version found outdated on open */
+            char *old_path = av_asprintf("%s/%s.%s", c->cache_dir, c->key, disk.data);
+            if (old_path)
+                unlink(old_path);
+            av_free(old_path);
+        } else if (strcmp(disk.data, idx->data)) {
+            /* another version of the resource was stored meanwhile, keep it */
+            free_index(&disk);
+            unlink(c->data_path);
+            return 0;
+        } else {
+            for (i = 0; i < disk.nb_ranges; i++)
+                if (add_range(idx, disk.ranges[i].start, disk.ranges[i].end) < 0)
+                    break;
+            idx->hit_bytes  = disk.hit_bytes;
+            idx->miss_bytes = disk.miss_bytes;
+            if (idx->size < 0)
+                idx->size = disk.size;
+        }
+        free_index(&disk);
+    }
+    merge_ranges(idx);
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&bp, "ffcache %d\ndata %s\n", INDEX_VERSION, idx->data);
+    if (idx->etag)
+        av_bprintf(&bp, "etag %s\n", idx->etag);
+    if (idx->last_modified)
+        av_bprintf(&bp, "last_modified %s\n", idx->last_modified);
+    av_bprintf(&bp, "size %"PRId64"\nhits %"PRId64"\nmisses %"PRId64"\n",
+               idx->size, idx->hit_bytes + c->hit_bytes,
+               idx->miss_bytes + c->miss_bytes);
+    for (i = 0; i < idx->nb_ranges; i++)
+        av_bprintf(&bp, "range %"PRId64" %"PRId64"\n",
+                   idx->ranges[i].start, idx->ranges[i].end);
+    if (!av_bprint_is_complete(&bp)) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    tmp_path = av_asprintf("%s.tmp%08x", c->index_path, av_get_random_seed());
+    if (!tmp_path) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    fd = avpriv_open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        ret = AVERROR(errno);
+        goto end;
+    }
+    ret = write(fd, bp.str, bp.len);
+    ret = ret < 0 ? AVERROR(errno) : ret != bp.len ? AVERROR(EIO) : 0;
+    close(fd);
+    if (!ret && rename(tmp_path, c->index_path) < 0)
+        ret = AVERROR(errno);
+    if (ret < 0)
+        unlink(tmp_path);
+    else
+        *added = cached_bytes(idx) - disk_bytes;
+
+end:
+    if (ret < 0)
+        av_log(h, AV_LOG_ERROR, "Failed to write cache index %s: %s\n",
+               c->index_path, av_err2str(ret));
+    av_free(tmp_path);
+    av_bprint_finalize(&bp, NULL);
+    return ret;
+}
+
+static void get_validators(URLContext *h, CacheIndex *v)
+{
+    Context *c = h->priv_data;
+
+    memset(v, 0, sizeof(*v));
+    av_opt_get(c->inner, "etag", AV_OPT_SEARCH_CHILDREN, (uint8_t **)&v->etag);
+    av_opt_get(c->inner, "last_modified", AV_OPT_SEARCH_CHILDREN,
+               (uint8_t **)&v->last_modified);
+    if (v->etag && !*v->etag)
+        av_freep(&v->etag);
+    if (v->last_modified && !*v->last_modified)
+        av_freep(&v->last_modified);
+    v->size = ffurl_seek(c->inner, 0, AVSEEK_SIZE);
+    if (v->size < 0)
+        v->size = -1;
+}
+
+static int validators_match(const CacheIndex *a, const CacheIndex *b)
+{
+    if (a->size >= 0 && b->size >= 0 && a->size != b->size)
+        return 0;
+    if (a->etag || b->etag)
+        return a->etag && b->etag && !strcmp(a->etag, b->etag);
+    if (a->last_modified || b->last_modified)
+        return a->last_modified && b->last_modified &&
+               !strcmp(a->last_modified, b->last_modified);
+    return a->size >= 0 && b->size >= 0;
+}
+
+static int open_inner(URLContext *h, AVDictionary **options)
+{
+    Context *c = h->priv_data;
+    CacheIndex cur;
+    int ret;
+
+    ret = ffurl_open_whitelist(&c->inner, c->url, c->flags, &h->interrupt_callback,
+                               options, h->protocol_whitelist, h->protocol_blacklist, h);
+    if (ret < 0 || !c->persistent)
+        return ret;
+
+    /* the cached data was used without validation so far */
+    get_validators(h, &cur);
+    ret = validators_match(&c->index, &cur);
+    free_index(&cur);
+    if (!ret) {
+        av_log(h, AV_LOG_ERROR, "Cached copy of %s is outdated\n", c->url);
+        c->stale = 1;
+        ffurl_closep(&c->inner);
+        return AVERROR(EIO);
+    }
+    return 0;
+}
+
+static int persistent_open(URLContext *h, AVDictionary **options)
+{
+    Context *c = h->priv_data;
+    uint8_t md5[16];
+    int i, ret, have_index;
+
+    c->fd = -1;
+    ff_mkdir_p(c->cache_dir);
+    av_md5_sum(md5, c->url, strlen(c->url));
+    ff_data_to_hex(c->key, md5, sizeof(md5), 1);
+    c->key[32] = 0;
+
+    c->index_path = av_asprintf("%s/%s.idx", c->cache_dir, c->key);
+    if (!c->index_path)
+        return AVERROR(ENOMEM);
+
+    have_index = read_index(h, c->index_path, &c->index) >= 0;
+    if (have_index) {
+        c->data_path = av_asprintf("%s/%s.%s", c->cache_dir, c->key, c->index.data);
+        if (!c->data_path)
+            return AVERROR(ENOMEM);
+        c->fd = avpriv_open(c->data_path, O_RDWR);
+        if (c->fd < 0) {
+            have_index = 0;
+            av_freep(&c->data_path);
+            free_index(&c->index);
+        }
+    }
+
+    if (!have_index || c->cache_validate) {
+        CacheIndex cur;
+
+        ret = ffurl_open_whitelist(&c->inner, c->url, c->flags, &h->interrupt_callback,
+                                   options, h->protocol_whitelist, h->protocol_blacklist, h);
+        if (ret < 0)
+            return ret;
+        get_validators(h, &cur);
+        if (have_index && !validators_match(&c->index, &cur)) {
+            av_log(h, AV_LOG_VERBOSE, "Cached copy of %s is outdated\n", c->url);
+            av_strlcpy(c->outdated, c->index.data, sizeof(c->outdated));
+            have_index = 0;
+            close(c->fd);
+            c->fd = -1;
+            av_freep(&c->data_path);
+        }
+        if (!have_index) {
+            free_index(&c->index);
+            c->index = cur;
+        } else {
+            free_index(&cur);
+        }
+    } else {
+        ret = av_dict_copy(&c->inner_options, options ? *options : NULL, 0);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (have_index) {
+        for (i = 0; i < c->index.nb_ranges; i++) {
+            CacheEntry *entry = av_malloc(sizeof(*entry));
+            struct AVTreeNode *node = av_tree_node_alloc();
+
+            if (!entry || !node) {
+                av_free(entry);
+                av_free(node);
+                return AVERROR(ENOMEM);
+            }
+            entry->logical_pos  = c->index.ranges[i].start;
+            entry->physical_pos = entry->logical_pos;
+            entry->size         = c->index.ranges[i].end - entry->logical_pos;
+            av_tree_insert(&c->root, entry, cmp, &node);
+            c->end = FFMAX(c->end, c->index.ranges[i].end);
+        }
+        if (c->index.size >= 0) {
+            c->end = c->index.size;
+            c->is_true_eof = 1;
+        }
+        c->persistent = 1;
+        av_log(h, AV_LOG_VERBOSE, "Using %"PRId64" cached bytes of %s\n",
+               cached_bytes(&c->index), c->url);
+        return 0;
+    }
+
+    snprintf(c->index.data, sizeof(c->index.data), "%08x", av_get_random_seed());
+    c->data_path = av_asprintf("%s/%s.%s", c->cache_dir, c->key, c->index.data);
+    if (!c->data_path)
+        return AVERROR(ENOMEM);
+    c->fd = avpriv_open(c->data_path, O_RDWR | O_CREAT | O_EXCL, 0666);
+    if (c->fd < 0) {
+        ret = AVERROR(errno);
+        av_log(h, AV_LOG_ERROR, "Failed to create %s: %s\n",
+               c->data_path, av_err2str(ret));
+        return ret;
+    }
+
+    /* without validators a later change of the resource can not be
+     * detected, so its data is not kept */
+    c->persistent = c->index.etag || c->index.last_modified || c->index.size >= 0;
+    if (!c->persistent)
+        unlink(c->data_path);
+    return 0;
+}
+
+typedef struct DirEntry {
+    char *name;
+    int64_t mtime;
+    int64_t bytes;
+    int is_index;
+    int used;
+} DirEntry;
+
+static int cmp_mtime(const void *a, const void *b)
+{
+    return FFDIFFSIGN(((const DirEntry *)a)->mtime, ((const DirEntry *)b)->mtime);
+}
+
+static void remove_file(URLContext *h, const char *name)
+{
+    Context *c = h->priv_data;
+    char *path = av_asprintf("%s/%s", c->cache_dir, name);
+
+    if (path && unlink(path) < 0 && errno != ENOENT)
+        av_log(h, AV_LOG_WARNING, "Could not delete %s.\n", path);
+    av_free(path);
+}
+
+/**
+ * Remove the least recently used entries until the cached data fits into
+ * cache_max_size, as well as the files left behind by writers which did
+ * not complete. Must be called with the cache locked.
+ *
+ * @return the number of bytes left in the cache, or -1 on error
+ */
+static int64_t evict_entries(URLContext *h)
+{
+    Context *c = h->priv_data;
+    AVIODirContext *dir = NULL;
+    AVIODirEntry *de;
+    DirEntry *entries = NULL, *tmp;
+    int nb_entries = 0, i, j;
+    int64_t total = 0, now = av_gettime();
+
+    if (avio_open_dir(&dir, c->cache_dir, NULL) < 0)
+        return -1;
+    while (avio_read_dir(dir, &de) >= 0 && de) {
+        /* only consider the files written by us */
+        if (de->type == AVIO_ENTRY_FILE && strspn(de->name, "0123456789abcdef") == 32 &&
+            de->name[32] == '.' &&
+            (tmp = av_realloc_array(entries, nb_entries + 1, sizeof(*entries)))) {
+            entries = tmp;
+            tmp = &entries[nb_entries];
+            memset(tmp, 0, sizeof(*tmp));
+            tmp->name     = de->name;
+            tmp->mtime    = de->modification_timestamp;
+            tmp->is_index = !strcmp(de->name + 32, ".idx");
+            de->name      = NULL;
+            nb_entries++;
+        }
+        avio_free_directory_entry(&de);
+    }
+    avio_close_dir(&dir);
+
+    for (i = 0; i < nb_entries; i++) {
+        CacheIndex idx;
+        char *path;
+
+        if (!entries[i].is_index)
+            continue;
+        path = av_asprintf("%s/%s", c->cache_dir, entries[i].name);
+        if (!path || read_index(h, path, &idx) < 0) {
+            av_free(path);
+            continue;
+        }
+        av_free(path);
+        entries[i].bytes = cached_bytes(&idx);
+        entries[i].used  = 1;
+        for (j = 0; j < nb_entries; j++)
+            if (!entries[j].is_index && !strncmp(entries[j].name, entries[i].name, 33) &&
+                !strcmp(entries[j].name + 33, idx.data))
+                entries[j].used = 1;
+        total += entries[i].bytes;
+        free_index(&idx);
+    }
+
+    for (i = 0; i < nb_entries; i++)
+        if (!entries[i].used && entries[i].mtime < now - ORPHAN_AGE * INT64_C(1000000) &&
+            strncmp(entries[i].name, c->key, 32))
+            remove_file(h, entries[i].name);
+
+    if (c->cache_max_size > 0 && total > c->cache_max_size) {
+        qsort(entries, nb_entries, sizeof(*entries), cmp_mtime);
+        for (i = 0; i < nb_entries && total > c->cache_max_size; i++) {
+            if (!entries[i].is_index || !entries[i].used ||
+                !strncmp(entries[i].name, c->key, 32))
+                continue;
+            av_log(h, AV_LOG_VERBOSE, "Evicting %s from the cache\n", entries[i].name);
+            remove_file(h, entries[i].name);
+            for (j = 0; j < nb_entries; j++)
+                if (!entries[j].is_index && entries[j].used &&
+                    !strncmp(entries[j].name, entries[i].name, 33))
+                    remove_file(h, entries[j].name);
+            total -= entries[i].bytes;
+        }
+    }
+
+    for (i = 0; i < nb_entries; i++)
+        av_free(entries[i].name);
+    av_free(entries);
+    return total;
+}
+
+static int enu_free(void *opaque, void *elem)
+{
+    av_free(elem);
+    return 0;
+}
+
+static void free_context(Context *c)
+{
+    if (c->fd >= 0)
+        close(c->fd);
+    c->fd = -1;
+    ffurl_closep(&c->inner);
+    av_tree_enumerate(c->root, NULL, NULL, enu_free);
+    av_tree_destroy(c->root);
+    c->root = NULL;
+    av_freep(&c->url);
+    av_freep(&c->index_path);
+    av_freep(&c->data_path);
+    av_dict_free(&c->inner_options);
+    free_index(&c->index);
+}
+
 static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
 {
     int ret;
@@ -79,6 +728,17 @@ static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **
 
     av_strstart(arg, "cache:", &arg);
 
+    if (c->cache_dir && *c->cache_dir) {
+        c->url   = av_strdup(arg);
+        c->flags = flags;
+        if (!c->url)
+            return AVERROR(ENOMEM);
+        ret = persistent_open(h, options);
+        if (ret < 0)
+            free_context(c);
+        return ret;
+    }
+
     c->fd = avpriv_tempfile("ffcache", &buffername, 0, h);
     if (c->fd < 0){
         av_log(h, AV_LOG_ERROR, "Failed to create tempfile\n");
@@ -106,7 +766,12 @@ static int add_entry(URLContext *h, const unsigned char *buf, int size)
     struct AVTreeNode *node = NULL;
 
     //FIXME avoid lseek
-    pos = lseek(c->fd, 0, SEEK_END);
+    if (c->persistent)
+        /* the persistent data file has the same layout as the resource */
+        pos = c->cache_pos == c->logical_pos ? c->cache_pos :
+              lseek(c->fd, c->logical_pos, SEEK_SET);
+    else
+        pos = lseek(c->fd, 0, SEEK_END);
     if (pos < 0) {
         ret = AVERROR(errno);
         av_log(h, AV_LOG_ERROR, "seek in cache failed\n");
@@ -142,6 +807,13 @@ static int add_entry(URLContext *h, const unsigned char *buf, int size)
         entry->size = ret;
 
         entry_ret = av_tree_insert(&c->root, entry, cmp, &node);
+        if (entry_ret && entry_ret != entry && c->persistent &&
+            entry_ret->physical_pos == pos) {
+            /* rewritten after a failed read from the cache */
+            entry_ret->size = FFMAX(entry_ret->size, ret);
+            ret = 0;
+            goto fail;
+        }
         if (entry_ret && entry_ret != entry) {
             ret = -1;
             av_log(h, AV_LOG_ERROR, "av_tree_insert failed\n");
@@ -190,6 +862,7 @@ static int cache_read(URLContext *h, unsigned char *buf, int size)
                 c->cache_pos += r;
                 c->logical_pos += r;
                 c->cache_hit ++;
+                c->hit_bytes += r;
                 return r;
             }
         }
@@ -197,6 +870,9 @@ static int cache_read(URLContext *h, unsigned char *buf, int size)
 
     // Cache miss or some kind of fault with the cache
 
+    if (!c->inner && (r = open_inner(h, &c->inner_options)) < 0)
+        return r;
+
     if (c->logical_pos != c->inner_pos) {
         r = ffurl_seek(c->inner, c->logical_pos, SEEK_SET);
         if (r<0) {
@@ -216,6 +892,7 @@ static int cache_read(URLContext *h, unsigned char *buf, int size)
     c->inner_pos += r;
 
     c->cache_miss ++;
+    c->miss_bytes += r;
 
     add_entry(h, buf, r);
     c->logical_pos += r;
@@ -230,6 +907,10 @@ static int64_t cache_seek(URLContext *h, int64_t pos, int whence)
     int64_t ret;
 
     if (whence == AVSEEK_SIZE) {
+        if (!c->inner && c->is_true_eof)
+            return c->end;
+        if (!c->inner && (ret = open_inner(h, &c->inner_options)) < 0)
+            return ret;
         pos= ffurl_seek(c->inner, pos, whence);
         if(pos <= 0){
             pos= ffurl_seek(c->inner, -1, SEEK_END);
@@ -258,6 +939,8 @@ resolve_eof:
     }
 
     //cache miss
+    if (!c->inner && (ret = open_inner(h, &c->inner_options)) < 0)
+        return ret;
     ret= ffurl_seek(c->inner, pos, whence);
     if ((whence == SEEK_SET && pos >= c->logical_pos ||
          whence == SEEK_END && pos <= 0) && ret < 0) {
@@ -289,12 +972,6 @@ resolve_eof:
     return ret;
 }
 
-static int enu_free(void *opaque, void *elem)
-{
-    av_free(elem);
-    return 0;
-}
-
 static int cache_close(URLContext *h)
 {
     Context *c= h->priv_data;
@@ -303,6 +980,43 @@ static int cache_close(URLContext *h)
     av_log(h, AV_LOG_INFO, "Statistics, cache hits:%"PRId64" cache misses:%"PRId64"\n",
            c->cache_hit, c->cache_miss);
 
+    if (c->cache_dir && *c->cache_dir) {
+        int lock = lock_cache(h);
+        int64_t total, added = 0;
+
+        ret = 0;
+        if (c->stale) {
+            CacheIndex idx;
+            if (read_index(h, c->index_path, &idx) >= 0) {
+                if (!strcmp(idx.data, c->index.data)) {
+                    unlink(c->index_path);
+                    added = -cached_bytes(&idx);
+                }
+                free_index(&idx);
+            }
+            unlink(c->data_path);
+        } else if (c->persistent) {
+            ret = write_index(h, &added);
+            av_log(h, AV_LOG_VERBOSE, "Statistics, bytes read from cache:%"PRId64
+                   " downloaded:%"PRId64", total for this entry:%"PRId64"/%"PRId64"\n",
+                   c->hit_bytes, c->miss_bytes, c->index.hit_bytes + c->hit_bytes,
+                   c->index.miss_bytes + c->miss_bytes);
+        }
+        free_context(c);
+
+        /* The directory is only scanned if the total size is unknown or
+         * exceeds the limit, not on every close. */
+        total = ret < 0 ? -1 : read_total(h);
+        if (total >= 0)
+            total = FFMAX(total + added, 0);
+        if (total < 0 || c->cache_max_size > 0 && total > c->cache_max_size)
+            write_total(h, evict_entries(h));
+        else if (added)
+            write_total(h, total);
+        unlock_cache(lock);
+        return 0;
+    }
+
     close(c->fd);
     if (c->filename) {
         ret = unlink(c->filename);
@@ -322,6 +1036,9 @@ static int cache_close(URLContext *h)
 
 static const AVOption options[] = {
     { "read_ahead_limit", "Amount in bytes that may be read ahead when seeking isn't supported, -1 for unlimited", OFFSET(read_ahead_limit), AV_OPT_TYPE_INT, { .i64 = 65536 }, -1, INT_MAX, D },
+    { "cache_dir", "Directory keeping the cached data across sessions, a temporary file is used if not set", OFFSET(cache_dir), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+    { "cache_max_size", "Maximum amount in bytes of data kept in cache_dir, 0 for unlimited", OFFSET(cache_max_size), AV_OPT_TYPE_INT64, { .i64 = 1 << 30 }, 0, INT64_MAX, D },
+    { "cache_validate", "Check that the cached data is up to date before using it", OFFSET(cache_validate), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, D },
     {NULL},
 };
 
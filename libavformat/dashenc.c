@@ -36,6 +36,7 @@
 #include "libavutil/time.h"
 #include "libavutil/time_internal.h"
 
+#include "asyncwriter.h"
 #include "av1.h"
 #include "avc.h"
 #include "avformat.h"
@@ -199,6 +200,9 @@ typedef struct DASHContext {
     AVRational min_playback_rate;
     AVRational max_playback_rate;
     int64_t update_period;
+    int async_io;
+    int64_t async_io_queue_size;
+    AsyncWriter *writer; /* performs the output in the background if async_io is set */
 } DASHContext;
 
 static struct codec_string {
@@ -228,6 +232,8 @@ static int dashenc_io_open(AVFormatContext *s, AVIOContext **pb, char *filename,
     DASHContext *c = s->priv_data;
     int http_base_proto = filename ? ff_is_http_proto(filename) : 0;
     int err = AVERROR_MUXER_NOT_FOUND;
+    if (c->writer)
+        return ff_async_writer_open(c->writer, pb, filename, options ? *options : NULL);
     if (!*pb || !http_base_proto || !c->http_persistent) {
         err = s->io_open(s, pb, filename, AVIO_FLAG_WRITE, options);
 #if CONFIG_HTTP_PROTOCOL
@@ -249,6 +255,14 @@ static void dashenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filenam
     if (!*pb)
         return;
 
+    if (c->writer) {
+        int ret = ff_async_writer_close(c->writer, pb);
+        if (ret < 0)
+            av_log(s, AV_LOG_ERROR, "Failed to queue writing %s: %s\n",
+                   filename, av_err2str(ret));
+        return;
+    }
+
     if (!http_base_proto || !c->http_persistent) {
         ff_format_io_close(s, pb);
 #if CONFIG_HTTP_PROTOCOL
@@ -261,6 +275,14 @@ static void dashenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filenam
     }
 }
 
+static int dashenc_rename(AVFormatContext *s, const char *url_src, const char *url_dst)
+{
+    DASHContext *c = s->priv_data;
+    if (c->writer)
+        return ff_async_writer_rename(c->writer, url_src, url_dst);
+    return ff_rename(url_src, url_dst, s);
+}
+
 static const char *get_format_str(SegmentType segment_type) {
     int i;
     for (i = 0; i < SEGMENT_TYPE_NB; i++)
@@ -590,7 +612,7 @@ static void write_hls_media_playlist(OutputStream *os, AVFormatContext *s,
     dashenc_io_close(s, &c->m3u8_out, temp_filename_hls);
 
     if (use_rename)
-        ff_rename(temp_filename_hls, filename_hls, os->ctx);
+        dashenc_rename(s, temp_filename_hls, filename_hls);
 }
 
 static int flush_init_segment(AVFormatContext *s, OutputStream *os)
@@ -616,6 +638,8 @@ static void dash_free(AVFormatContext *s)
     DASHContext *c = s->priv_data;
     int i, j;
 
+    ff_async_writer_free(&c->writer);
+
     if (c->as) {
         for (i = 0; i < c->nb_as; i++) {
             av_dict_free(&c->as[i].metadata);
@@ -1253,7 +1277,7 @@ static int write_manifest(AVFormatContext *s, int final)
     dashenc_io_close(s, &c->mpd_out, temp_filename);
 
     if (use_rename) {
-        if ((ret = ff_rename(temp_filename, s->url, s)) < 0)
+        if ((ret = dashenc_rename(s, temp_filename, s->url)) < 0)
             return ret;
     }
 
@@ -1341,7 +1365,7 @@ static int write_manifest(AVFormatContext *s, int final)
         }
         dashenc_io_close(s, &c->m3u8_out, temp_filename);
         if (use_rename)
-            if ((ret = ff_rename(temp_filename, filename_hls, s)) < 0)
+            if ((ret = dashenc_rename(s, temp_filename, filename_hls)) < 0)
                 return ret;
         c->master_playlist_created = 1;
     }
@@ -1420,6 +1444,18 @@ static int dash_init(AVFormatContext *s)
         c->frag_type = FRAG_TYPE_EVERY_FRAME;
     }
 
+    if (c->async_io) {
+        if (c->single_file || c->streaming || c->http_persistent) {
+            av_log(s, AV_LOG_ERROR, "async_io cannot be used with single_file, "
+                   "streaming or http_persistent\n");
+            return AVERROR(EINVAL);
+        }
+        ret = ff_async_writer_alloc(&c->writer, s, c->async_io_queue_size,
+                                    c->ignore_io_errors);
+        if (ret < 0)
+            return ret;
+    }
+
     if (c->write_prft < 0) {
         c->write_prft = c->ldash;
         if (c->ldash)
@@ -1574,7 +1610,7 @@ static int dash_init(AVFormatContext *s)
         if (!c->single_file) {
             if ((ret = avio_open_dyn_buf(&ctx->pb)) < 0)
                 return ret;
-            ret = s->io_open(s, &os->out, filename, AVIO_FLAG_WRITE, &opts);
+            ret = dashenc_io_open(s, &os->out, filename, &opts);
         } else {
             ctx->url = av_strdup(filename);
             ret = avio_open2(&ctx->pb, filename, AVIO_FLAG_WRITE, NULL, &opts);
@@ -1839,7 +1875,17 @@ static void dashenc_delete_file(AVFormatContext *s, char *filename) {
     DASHContext *c = s->priv_data;
     int http_base_proto = ff_is_http_proto(filename);
 
-    if (http_base_proto) {
+    if (c->writer) {
+        AVDictionary *http_opts = NULL;
+
+        if (http_base_proto) {
+            set_http_options(&http_opts, c);
+            av_dict_set(&http_opts, "method", "DELETE", 0);
+        }
+        if (ff_async_writer_delete(c->writer, filename, http_opts) < 0)
+            av_log(s, AV_LOG_ERROR, "failed to delete %s\n", filename);
+        av_dict_free(&http_opts);
+    } else if (http_base_proto) {
         AVIOContext *out = NULL;
         AVDictionary *http_opts = NULL;
 
@@ -1957,7 +2003,7 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
             dashenc_io_close(s, &os->out, os->temp_path);
 
             if (use_rename) {
-                ret = ff_rename(os->temp_path, os->full_path, os->ctx);
+                ret = dashenc_rename(s, os->temp_path, os->full_path);
                 if (ret < 0)
                     break;
             }
@@ -2061,6 +2107,9 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
     int64_t seg_end_duration, elapsed_duration;
     int ret;
 
+    if (c->writer && (ret = ff_async_writer_get_error(c->writer)) < 0)
+        return ret;
+
     ret = update_stream_extradata(s, os, pkt, &st->avg_frame_rate);
     if (ret < 0)
         return ret;
@@ -2309,6 +2358,8 @@ static int dash_write_trailer(AVFormatContext *s)
         }
     }
 
+    if (c->writer)
+        return ff_async_writer_flush(c->writer);
     return 0;
 }
 
@@ -2384,6 +2435,8 @@ static const AVOption options[] = {
     { "min_playback_rate", "Set desired minimum playback rate", OFFSET(min_playback_rate), AV_OPT_TYPE_RATIONAL, { .dbl = 1.0 }, 0.5, 1.5, E },
     { "max_playback_rate", "Set desired maximum playback rate", OFFSET(max_playback_rate), AV_OPT_TYPE_RATIONAL, { .dbl = 1.0 }, 0.5, 1.5, E },
     { "update_period", "Set the mpd update interval", OFFSET(update_period), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, E},
+    { "async_io", "write segments and manifests, and delete old segments, from a background thread", OFFSET(async_io), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
+    { "async_io_queue_size", "max size in bytes of the output waiting to be written in async_io mode", OFFSET(async_io_queue_size), AV_OPT_TYPE_INT64, { .i64 = 64 << 20 }, 0, INT64_MAX, E },
     { NULL },
 };
 
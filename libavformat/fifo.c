@@ -529,8 +529,11 @@ static int fifo_init(AVFormatContext *avf)
     if (ret < 0)
         return ret;
 
-    ret = av_thread_message_queue_alloc(&fifo->queue, (unsigned) fifo->queue_size,
-                                        sizeof(FifoMessage));
+    /* packets are only sent by the muxing thread and received by the
+     * writer thread */
+    ret = av_thread_message_queue_alloc2(&fifo->queue, (unsigned) fifo->queue_size,
+                                         sizeof(FifoMessage),
+                                         AV_THREAD_MESSAGE_QUEUE_SPSC);
     if (ret < 0)
         return ret;
 
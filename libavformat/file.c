@@ -22,6 +22,7 @@
 #include "libavutil/avstring.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 #include "avformat.h"
 #if HAVE_DIRENT_H
 #include <dirent.h>
@@ -35,6 +36,9 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include "os_support.h"
 #include "url.h"
 
@@ -65,6 +69,12 @@
 #  endif
 #endif
 
+#define FILE_READAHEAD (HAVE_PTHREADS && HAVE_PREAD)
+
+/* O_DIRECT needs buffers, offsets and sizes aligned to the logical block size
+ * of the device; 4096 covers all common devices. */
+#define DIRECT_IO_ALIGN 4096
+
 /* standard file protocol */
 
 typedef struct FileContext {
@@ -74,9 +84,38 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int readahead;
+    int readahead_size;
+    int direct;
+    int mmap;
+    int mmap_advice;
+    int own_pos;        ///< reads use pos instead of the file offset
+    int64_t pos;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
+#if HAVE_MMAP
+    uint8_t *map;
+    size_t map_size;
+#endif
+#if FILE_READAHEAD
+    /* Read-ahead state: a ring of readahead blocks of readahead_size bytes,
+     * filled in file order by a thread with pread(). Block ra_head holds the
+     * data at file offset ra_start, ra_filled blocks are ready. */
+    int ra_active;
+    pthread_t ra_thread;
+    pthread_mutex_t ra_mutex;
+    pthread_cond_t ra_cond;
+    uint8_t *ra_alloc;
+    uint8_t *ra_buf;
+    int *ra_sizes;
+    int ra_head;
+    int ra_filled;
+    int ra_status;      ///< EOF or error met by the thread, 0 otherwise
+    int ra_exit;
+    unsigned ra_generation;
+    int64_t ra_start;
+#endif
 } FileContext;
 
 static const AVOption file_options[] = {
@@ -84,6 +123,15 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "readahead", "number of blocks to read ahead in a background thread, 0 to disable", offsetof(FileContext, readahead), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1024, AV_OPT_FLAG_DECODING_PARAM },
+    { "readahead_size", "size in bytes of each read-ahead block", offsetof(FileContext, readahead_size), AV_OPT_TYPE_INT, { .i64 = 1 << 20 }, DIRECT_IO_ALIGN, 1 << 28, AV_OPT_FLAG_DECODING_PARAM },
+    { "direct", "bypass the page cache (O_DIRECT) when reading ahead", offsetof(FileContext, direct), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "mmap", "read from a memory mapping of the file", offsetof(FileContext, mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "mmap_advice", "expected access pattern of the mapping", offsetof(FileContext, mmap_advice), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 3, AV_OPT_FLAG_DECODING_PARAM, "mmap_advice" },
+        { "normal",     NULL, 0, AV_OPT_TYPE_CONST, { .i64 = 0 }, 0, 0, AV_OPT_FLAG_DECODING_PARAM, "mmap_advice" },
+        { "sequential", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = 1 }, 0, 0, AV_OPT_FLAG_DECODING_PARAM, "mmap_advice" },
+        { "random",     NULL, 0, AV_OPT_TYPE_CONST, { .i64 = 2 }, 0, 0, AV_OPT_FLAG_DECODING_PARAM, "mmap_advice" },
+        { "willneed",   NULL, 0, AV_OPT_TYPE_CONST, { .i64 = 3 }, 0, 0, AV_OPT_FLAG_DECODING_PARAM, "mmap_advice" },
     { NULL }
 };
 
@@ -106,10 +154,269 @@ static const AVClass pipe_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if FILE_READAHEAD
+static int readahead_pread(FileContext *c, uint8_t *buf, int size, int64_t pos)
+{
+    int done = 0;
+
+    while (done < size) {
+        ssize_t ret = pread(c->fd, buf + done, size - done, pos + done);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return AVERROR(errno);
+        }
+        done += ret;
+        /* short O_DIRECT reads only happen at EOF, and a retry at the
+         * unaligned offset would fail */
+        if (!ret || c->direct)
+            break;
+    }
+    return done;
+}
+
+static void *readahead_thread(void *arg)
+{
+    FileContext *c = arg;
+
+    pthread_mutex_lock(&c->ra_mutex);
+    while (!c->ra_exit) {
+        unsigned generation;
+        int64_t pos;
+        int slot, ret;
+
+        if (c->ra_status || c->ra_filled == c->readahead) {
+            pthread_cond_wait(&c->ra_cond, &c->ra_mutex);
+            continue;
+        }
+        slot       = (c->ra_head + c->ra_filled) % c->readahead;
+        pos        = c->ra_start + (int64_t)c->ra_filled * c->readahead_size;
+        generation = c->ra_generation;
+        pthread_mutex_unlock(&c->ra_mutex);
+
+        ret = readahead_pread(c, c->ra_buf + (size_t)slot * c->readahead_size,
+                              c->readahead_size, pos);
+
+        pthread_mutex_lock(&c->ra_mutex);
+        /* the reader moved elsewhere meanwhile */
+        if (generation != c->ra_generation)
+            continue;
+        if (ret < 0) {
+            c->ra_status = ret;
+        } else {
+            c->ra_sizes[slot] = ret;
+            c->ra_filled++;
+            if (ret < c->readahead_size)
+                c->ra_status = AVERROR_EOF;
+        }
+        pthread_cond_broadcast(&c->ra_cond);
+    }
+    pthread_mutex_unlock(&c->ra_mutex);
+
+    return NULL;
+}
+
+static int readahead_read(URLContext *h, unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+    int64_t bs = c->readahead_size;
+    int ret, idx, slot, off;
+
+    pthread_mutex_lock(&c->ra_mutex);
+    if (c->pos < c->ra_start || c->pos >= c->ra_start + bs * c->readahead) {
+        /* outside of the window, restart reading ahead from here */
+        c->ra_start  = c->pos - c->pos % bs;
+        c->ra_head   = 0;
+        c->ra_filled = 0;
+        c->ra_status = 0;
+        c->ra_generation++;
+        pthread_cond_broadcast(&c->ra_cond);
+    }
+
+    idx = (c->pos - c->ra_start) / bs;
+    while (idx >= c->ra_filled) {
+        if (c->ra_status) {
+            ret = c->ra_status;
+            goto end;
+        }
+        if (ff_check_interrupt(&h->interrupt_callback)) {
+            ret = AVERROR_EXIT;
+            goto end;
+        }
+        pthread_cond_wait(&c->ra_cond, &c->ra_mutex);
+    }
+
+    slot = (c->ra_head + idx) % c->readahead;
+    off  = c->pos - c->ra_start - idx * bs;
+    ret  = FFMIN(size, c->ra_sizes[slot] - off);
+    if (ret <= 0) {
+        ret = AVERROR_EOF;
+        goto end;
+    }
+    memcpy(buf, c->ra_buf + slot * bs + off, ret);
+    c->pos += ret;
+
+    /* hand fully consumed blocks back to the thread */
+    while (c->ra_filled && c->pos >= c->ra_start + bs) {
+        c->ra_head = (c->ra_head + 1) % c->readahead;
+        c->ra_start += bs;
+        c->ra_filled--;
+        pthread_cond_broadcast(&c->ra_cond);
+    }
+end:
+    pthread_mutex_unlock(&c->ra_mutex);
+    return ret;
+}
+
+static int readahead_init(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+    size_t size;
+    int ret;
+
+    /* O_DIRECT is only set once the file is known to be read by the
+     * aligned reads of the read-ahead thread alone */
+    if (c->direct) {
+#ifdef O_DIRECT
+        int fl = fcntl(c->fd, F_GETFL);
+        if (fl != -1 && fcntl(c->fd, F_SETFL, fl | O_DIRECT) != -1) {
+            c->readahead_size = FFALIGN(c->readahead_size, DIRECT_IO_ALIGN);
+        } else
+#endif
+        {
+            av_log(h, AV_LOG_WARNING, "O_DIRECT not supported, using buffered reads\n");
+            c->direct = 0;
+        }
+    }
+    size = (size_t)c->readahead * c->readahead_size;
+
+    c->ra_alloc = av_malloc(size + DIRECT_IO_ALIGN);
+    c->ra_sizes = av_calloc(c->readahead, sizeof(*c->ra_sizes));
+    if (!c->ra_alloc || !c->ra_sizes) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    c->ra_buf = (uint8_t *)FFALIGN((uintptr_t)c->ra_alloc, DIRECT_IO_ALIGN);
+    c->pos    = lseek(c->fd, 0, SEEK_CUR);
+    if (c->pos < 0)
+        c->pos = 0;
+    c->ra_start = c->pos - c->pos % c->readahead_size;
+
+    if ((ret = pthread_mutex_init(&c->ra_mutex, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&c->ra_cond, NULL))) {
+        pthread_mutex_destroy(&c->ra_mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_create(&c->ra_thread, NULL, readahead_thread, c))) {
+        pthread_cond_destroy(&c->ra_cond);
+        pthread_mutex_destroy(&c->ra_mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    c->ra_active = 1;
+    c->own_pos   = 1;
+    return 0;
+fail:
+    av_freep(&c->ra_alloc);
+    av_freep(&c->ra_sizes);
+    return ret;
+}
+
+static void readahead_uninit(FileContext *c)
+{
+    if (!c->ra_active)
+        return;
+    pthread_mutex_lock(&c->ra_mutex);
+    c->ra_exit = 1;
+    pthread_cond_broadcast(&c->ra_cond);
+    pthread_mutex_unlock(&c->ra_mutex);
+    pthread_join(c->ra_thread, NULL);
+    pthread_cond_destroy(&c->ra_cond);
+    pthread_mutex_destroy(&c->ra_mutex);
+    av_freep(&c->ra_alloc);
+    av_freep(&c->ra_sizes);
+    c->ra_active = 0;
+}
+#endif /* FILE_READAHEAD */
+
+#if HAVE_MMAP
+static int map_init(URLContext *h, const struct stat *st)
+{
+    FileContext *c = h->priv_data;
+    void *map;
+
+    /* an empty file can not be mapped */
+    if (st->st_size <= 0 || st->st_size > SIZE_MAX)
+        return AVERROR(EINVAL);
+
+    /* The mapping is never written to, so it stays backed by the page
+     * cache: writes to the file by others still show through it. */
+    map = mmap(NULL, st->st_size, PROT_READ, MAP_PRIVATE, c->fd, 0);
+    if (map == MAP_FAILED)
+        return AVERROR(errno);
+
+#if HAVE_POSIX_MADVISE
+    {
+        static const int advice[] = {
+            POSIX_MADV_NORMAL, POSIX_MADV_SEQUENTIAL,
+            POSIX_MADV_RANDOM, POSIX_MADV_WILLNEED,
+        };
+        posix_madvise(map, st->st_size, advice[c->mmap_advice]);
+    }
+#endif
+
+    c->map      = map;
+    c->map_size = st->st_size;
+    c->pos      = lseek(c->fd, 0, SEEK_CUR);
+    if (c->pos < 0)
+        c->pos = 0;
+    c->own_pos  = 1;
+    /* reads copy straight from the mapping to the caller, so buffering in
+     * the AVIOContext would only add a copy */
+    h->flags   |= AVIO_FLAG_DIRECT;
+    return 0;
+}
+
+static void map_uninit(FileContext *c)
+{
+    munmap(c->map, c->map_size);
+    c->map     = NULL;
+    c->own_pos = 0;
+}
+
+static int map_read(URLContext *h, unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+
+    /* The file must not shrink while it is mapped: pages past its new end
+     * raise SIGBUS. Checking the size here would cost the system call the
+     * mapping is meant to avoid and still race with the copy, so this is
+     * left to the caller, see the mmap option. */
+    if (c->pos >= c->map_size)
+        return AVERROR_EOF;
+    size = FFMIN(size, c->map_size - c->pos);
+    memcpy(buf, c->map + c->pos, size);
+    c->pos += size;
+    return size;
+}
+#endif /* HAVE_MMAP */
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
+#if HAVE_MMAP
+    if (c->map)
+        return map_read(h, buf, size);
+#endif
+#if FILE_READAHEAD
+    if (c->ra_active)
+        return readahead_read(h, buf, size);
+#endif
     size = FFMIN(size, c->blocksize);
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
@@ -235,6 +542,28 @@ static int file_open(URLContext *h, const char *filename, int flags)
 
     h->is_streamed = !fstat(fd, &st) && S_ISFIFO(st.st_mode);
 
+#if HAVE_MMAP
+    if (c->mmap && !(flags & AVIO_FLAG_WRITE) && !c->follow &&
+        S_ISREG(st.st_mode)) {
+        int ret = map_init(h, &st);
+        if (ret < 0)
+            av_log(h, AV_LOG_WARNING, "Could not map %s, using regular reads: %s\n",
+                   filename, av_err2str(ret));
+    }
+#endif
+
+#if FILE_READAHEAD
+    /* pread() only works on regular files */
+    if (c->readahead && !(flags & AVIO_FLAG_WRITE) && !c->follow &&
+        !c->own_pos && S_ISREG(st.st_mode)) {
+        int ret = readahead_init(h);
+        if (ret < 0) {
+            close(fd);
+            return ret;
+        }
+    }
+#endif
+
     /* Buffer writes more than the default 32k to improve throughput especially
      * with networked file systems */
     if (!h->is_streamed && flags & AVIO_FLAG_WRITE)
@@ -258,6 +587,24 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
         return ret < 0 ? AVERROR(errno) : (S_ISFIFO(st.st_mode) ? 0 : st.st_size);
     }
 
+    /* the file offset is not used by pread() and mapped reads, only track
+     * the position */
+    if (c->own_pos) {
+        if (whence == SEEK_CUR) {
+            pos += c->pos;
+        } else if (whence == SEEK_END) {
+            struct stat st;
+            if (fstat(c->fd, &st) < 0)
+                return AVERROR(errno);
+            pos += st.st_size;
+        } else if (whence != SEEK_SET) {
+            return AVERROR(EINVAL);
+        }
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        return c->pos = pos;
+    }
+
     ret = lseek(c->fd, pos, whence);
 
     return ret < 0 ? AVERROR(errno) : ret;
@@ -266,6 +613,13 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
+#if FILE_READAHEAD
+    readahead_uninit(c);
+#endif
+#if HAVE_MMAP
+    if (c->map)
+        map_uninit(c);
+#endif
     return close(c->fd);
 }
 
@@ -23,6 +23,7 @@
 #include "libavutil/avstring.h"
 #include "libavutil/hash.h"
 #include "libavutil/intreadwrite.h"
+#include "libavutil/md5_internal.h"
 #include "libavutil/opt.h"
 #include "avformat.h"
 #include "internal.h"
@@ -33,6 +34,7 @@ struct HashContext {
     char *hash_name;
     int per_stream;
     int format_version;
+    int md5_multi;
 };
 
 #define OFFSET(x) offsetof(struct HashContext, x)
@@ -275,6 +277,7 @@ static int framehash_init(struct AVFormatContext *s)
     res = av_hash_alloc(&c->hashes[0], c->hash_name);
     if (res < 0)
         return res;
+    c->md5_multi = !strcmp(av_hash_get_name(c->hashes[0]), "MD5");
     return 0;
 }
 
@@ -290,24 +293,70 @@ static int framehash_write_header(struct AVFormatContext *s)
     return 0;
 }
 
+#define MD5_MULTI_MAX 16
+
+/**
+ * Hash the packet data and side data with MD5 all at once, which is faster
+ * than hashing them one after the other.
+ *
+ * @return 0 on success, a negative value if they have to be hashed
+ *         one by one
+ */
+static int framehash_md5_multi(struct HashContext *c, const AVPacket *pkt,
+                               uint8_t (*md5)[16])
+{
+    const uint8_t *src[MD5_MULTI_MAX];
+    uint8_t *dst[MD5_MULTI_MAX];
+    size_t len[MD5_MULTI_MAX];
+    int i, nb = c->format_version > 1 ? 1 + pkt->side_data_elems : 1;
+
+    if (!c->md5_multi || nb > MD5_MULTI_MAX)
+        return -1;
+    for (i = 0; i < nb; i++) {
+        const AVPacketSideData *sd = i ? &pkt->side_data[i - 1] : NULL;
+        /* palettes are hashed in little-endian order */
+        if (HAVE_BIGENDIAN && sd && sd->type == AV_PKT_DATA_PALETTE)
+            return -1;
+        src[i] = sd ? sd->data : pkt->data;
+        len[i] = sd ? sd->size : pkt->size;
+        dst[i] = md5[i];
+    }
+    avpriv_md5_sum_multi(dst, src, len, nb);
+    return 0;
+}
+
 static int framehash_write_packet(struct AVFormatContext *s, AVPacket *pkt)
 {
     struct HashContext *c = s->priv_data;
     char buf[AV_HASH_MAX_SIZE*2+128];
-    int len;
-    av_hash_init(c->hashes[0]);
-    av_hash_update(c->hashes[0], pkt->data, pkt->size);
+    uint8_t md5[MD5_MULTI_MAX][16];
+    int len, multi = framehash_md5_multi(c, pkt, md5) >= 0;
 
     snprintf(buf, sizeof(buf) - (AV_HASH_MAX_SIZE * 2 + 1), "%d, %10"PRId64", %10"PRId64", %8"PRId64", %8d, ",
              pkt->stream_index, pkt->dts, pkt->pts, pkt->duration, pkt->size);
     len = strlen(buf);
-    av_hash_final_hex(c->hashes[0], buf + len, sizeof(buf) - len);
+    if (multi) {
+        ff_data_to_hex(buf + len, md5[0], 16, 1);
+        buf[len + 32] = 0;
+    } else {
+        av_hash_init(c->hashes[0]);
+        av_hash_update(c->hashes[0], pkt->data, pkt->size);
+        av_hash_final_hex(c->hashes[0], buf + len, sizeof(buf) - len);
+    }
     avio_write(s->pb, buf, strlen(buf));
 
     if (c->format_version > 1 && pkt->side_data_elems) {
         int i, j;
         avio_printf(s->pb, ", S=%d", pkt->side_data_elems);
         for (i = 0; i < pkt->side_data_elems; i++) {
+            snprintf(buf, sizeof(buf) - (AV_HASH_MAX_SIZE * 2 + 1), ", %8d, ", pkt->side_data[i].size);
+            len = strlen(buf);
+            if (multi) {
+                ff_data_to_hex(buf + len, md5[i + 1], 16, 1);
+                buf[len + 32] = 0;
+                avio_write(s->pb, buf, strlen(buf));
+                continue;
+            }
             av_hash_init(c->hashes[0]);
             if (HAVE_BIGENDIAN && pkt->side_data[i].type == AV_PKT_DATA_PALETTE) {
                 for (j = 0; j < pkt->side_data[i].size; j += sizeof(uint32_t)) {
@@ -316,8 +365,6 @@ static int framehash_write_packet(struct AVFormatContext *s, AVPacket *pkt)
                 }
             } else
                 av_hash_update(c->hashes[0], pkt->side_data[i].data, pkt->side_data[i].size);
-            snprintf(buf, sizeof(buf) - (AV_HASH_MAX_SIZE * 2 + 1), ", %8d, ", pkt->side_data[i].size);
-            len = strlen(buf);
             av_hash_final_hex(c->hashes[0], buf + len, sizeof(buf) - len);
             avio_write(s->pb, buf, strlen(buf));
         }
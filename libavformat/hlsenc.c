@@ -44,6 +44,7 @@
 #include "libavutil/time.h"
 #include "libavutil/time_internal.h"
 
+#include "asyncwriter.h"
 #include "avformat.h"
 #include "avio_internal.h"
 #include "avc.h"
@@ -258,6 +259,9 @@ typedef struct HLSContext {
     char *headers;
     int has_default_key; /* has DEFAULT field of var_stream_map */
     int has_video_m3u8; /* has video stream m3u8 list */
+    int async_io;
+    int64_t async_io_queue_size;
+    AsyncWriter *writer; /* performs the output in the background if async_io is set */
 } HLSContext;
 
 static int strftime_expand(const char *fmt, char **dest)
@@ -289,6 +293,8 @@ static int hlsenc_io_open(AVFormatContext *s, AVIOContext **pb, char *filename,
     HLSContext *hls = s->priv_data;
     int http_base_proto = filename ? ff_is_http_proto(filename) : 0;
     int err = AVERROR_MUXER_NOT_FOUND;
+    if (hls->writer)
+        return ff_async_writer_open(hls->writer, pb, filename, options ? *options : NULL);
     if (!*pb || !http_base_proto || !hls->http_persistent) {
         err = s->io_open(s, pb, filename, AVIO_FLAG_WRITE, options);
 #if CONFIG_HTTP_PROTOCOL
@@ -311,6 +317,8 @@ static int hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filename)
     int ret = 0;
     if (!*pb)
         return ret;
+    if (hls->writer)
+        return ff_async_writer_close(hls->writer, pb);
     if (!http_base_proto || !hls->http_persistent || hls->key_info_file || hls->encrypt) {
         ff_format_io_close(s, pb);
 #if CONFIG_HTTP_PROTOCOL
@@ -325,6 +333,14 @@ static int hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filename)
     return ret;
 }
 
+static int hlsenc_rename(AVFormatContext *s, const char *url_src, const char *url_dst)
+{
+    HLSContext *hls = s->priv_data;
+    if (hls->writer)
+        return ff_async_writer_rename(hls->writer, url_src, url_dst);
+    return ff_rename(url_src, url_dst, s);
+}
+
 static void set_http_options(AVFormatContext *s, AVDictionary **options, HLSContext *c)
 {
     int http_base_proto = ff_is_http_proto(s->url);
@@ -569,6 +585,15 @@ static void reflush_dynbuf(VariantStream *vs, int *range_length)
 static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
                            const char *path, const char *proto)
 {
+    if (hls->writer) {
+        AVDictionary *opt = NULL;
+        int ret;
+        if (hls->method || (proto && !av_strcasecmp(proto, "http")))
+            av_dict_set(&opt, "method", "DELETE", 0);
+        ret = ff_async_writer_delete(hls->writer, path, opt);
+        av_dict_free(&opt);
+        return ret;
+    }
     if (hls->method || (proto && !av_strcasecmp(proto, "http"))) {
         AVDictionary *opt = NULL;
         AVIOContext  *out = NULL;
@@ -1051,10 +1076,11 @@ static int sls_flag_check_duration_size(HLSContext *hls, VariantStream *vs)
     return ret;
 }
 
-static void sls_flag_file_rename(HLSContext *hls, VariantStream *vs, char *old_filename) {
+static void sls_flag_file_rename(AVFormatContext *s, VariantStream *vs, char *old_filename) {
+    HLSContext *hls = s->priv_data;
     if ((hls->flags & (HLS_SECOND_LEVEL_SEGMENT_SIZE | HLS_SECOND_LEVEL_SEGMENT_DURATION)) &&
         strlen(vs->current_segment_final_filename_fmt)) {
-        ff_rename(old_filename, vs->avf->url, hls);
+        hlsenc_rename(s, old_filename, vs->avf->url);
     }
 }
 
@@ -1330,7 +1356,7 @@ static int hls_rename_temp_file(AVFormatContext *s, AVFormatContext *oc)
     if (!final_filename)
         return AVERROR(ENOMEM);
     final_filename[len-4] = '\0';
-    ret = ff_rename(oc->url, final_filename, s);
+    ret = hlsenc_rename(s, oc->url, final_filename);
     oc->url[len-4] = '\0';
     av_freep(&final_filename);
     return ret;
@@ -1533,7 +1559,7 @@ fail:
         hls->master_m3u8_created = 1;
     hlsenc_io_close(s, &hls->m3u8_out, temp_filename);
     if (use_temp_file)
-        ff_rename(temp_filename, hls->master_m3u8_url, s);
+        hlsenc_rename(s, temp_filename, hls->master_m3u8_url);
 
     return ret;
 }
@@ -1662,9 +1688,9 @@ fail:
     }
     hlsenc_io_close(s, &hls->sub_m3u8_out, vs->vtt_m3u8_name);
     if (use_temp_file) {
-        ff_rename(temp_filename, vs->m3u8_name, s);
+        hlsenc_rename(s, temp_filename, vs->m3u8_name);
         if (vs->vtt_m3u8_name)
-            ff_rename(temp_vtt_filename, vs->vtt_m3u8_name, s);
+            hlsenc_rename(s, temp_vtt_filename, vs->vtt_m3u8_name);
     }
     if (ret >= 0 && hls->master_pl_name)
         if (create_master_playlist(s, vs) < 0)
@@ -2426,6 +2452,9 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
     VariantStream *vs = NULL;
     char *old_filename = NULL;
 
+    if (hls->writer && (ret = ff_async_writer_get_error(hls->writer)) < 0)
+        return ret;
+
     for (i = 0; i < hls->nb_varstreams; i++) {
         vs = &hls->var_streams[i];
         for (j = 0; j < vs->nb_streams; j++) {
@@ -2587,7 +2616,8 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
                 if (ret < 0) {
                     av_log(s, AV_LOG_WARNING, "upload segment failed,"
                            " will retry with a new http session.\n");
-                    ff_format_io_close(s, &vs->out);
+                    if (!hls->writer)
+                        ff_format_io_close(s, &vs->out);
                     ret = hlsenc_io_open(s, &vs->out, filename, &options);
                     reflush_dynbuf(vs, &range_length);
                     ret = hlsenc_io_close(s, &vs->out, filename);
@@ -2621,7 +2651,8 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         if (hls->pl_type != PLAYLIST_TYPE_VOD) {
             if ((ret = hls_window(s, 0, vs)) < 0) {
                 av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
-                ff_format_io_close(s, &vs->out);
+                if (!hls->writer)
+                    ff_format_io_close(s, &vs->out);
                 if ((ret = hls_window(s, 0, vs)) < 0) {
                     av_freep(&old_filename);
                     return ret;
@@ -2644,7 +2675,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         } else if (hls->max_seg_size > 0) {
             if (vs->size + vs->start_pos >= hls->max_seg_size) {
                 vs->sequence++;
-                sls_flag_file_rename(hls, vs, old_filename);
+                sls_flag_file_rename(s, vs, old_filename);
                 ret = hls_start(s, vs);
                 vs->start_pos = 0;
                 /* When split segment by byte, the duration is short than hls_time,
@@ -2654,7 +2685,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
             }
         } else {
             vs->start_pos = new_start_pos;
-            sls_flag_file_rename(hls, vs, old_filename);
+            sls_flag_file_rename(s, vs, old_filename);
             ret = hls_start(s, vs);
         }
         vs->number++;
@@ -2689,6 +2720,8 @@ static void hls_deinit(AVFormatContext *s)
     int i = 0;
     VariantStream *vs = NULL;
 
+    ff_async_writer_free(&hls->writer);
+
     for (i = 0; i < hls->nb_varstreams; i++) {
         vs = &hls->var_streams[i];
 
@@ -2768,7 +2801,8 @@ static int hls_write_trailer(struct AVFormatContext *s)
                 vs->start_pos = range_length;
                 byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
                 if (!byterange_mode) {
-                    ff_format_io_close(s, &vs->out);
+                    if (!hls->writer)
+                        ff_format_io_close(s, &vs->out);
                     hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
                 }
             }
@@ -2791,7 +2825,8 @@ static int hls_write_trailer(struct AVFormatContext *s)
         ret = hlsenc_io_close(s, &vs->out, filename);
         if (ret < 0) {
             av_log(s, AV_LOG_WARNING, "upload segment failed, will retry with a new http session.\n");
-            ff_format_io_close(s, &vs->out);
+            if (!hls->writer)
+                ff_format_io_close(s, &vs->out);
             ret = hlsenc_io_open(s, &vs->out, filename, &options);
             if (ret < 0) {
                 av_log(s, AV_LOG_ERROR, "Failed to open file '%s'\n", oc->url);
@@ -2832,18 +2867,22 @@ failed:
         /* after av_write_trailer, then duration + 1 duration per packet */
         hls_append_segment(s, hls, vs, vs->duration + vs->dpp, vs->start_pos, vs->size);
 
-        sls_flag_file_rename(hls, vs, old_filename);
+        sls_flag_file_rename(s, vs, old_filename);
 
         if (vtt_oc) {
             if (vtt_oc->pb)
                 av_write_trailer(vtt_oc);
             vs->size = avio_tell(vs->vtt_avf->pb) - vs->start_pos;
-            ff_format_io_close(s, &vtt_oc->pb);
+            if (hls->writer)
+                hlsenc_io_close(s, &vtt_oc->pb, vtt_oc->url);
+            else
+                ff_format_io_close(s, &vtt_oc->pb);
         }
         ret = hls_window(s, 1, vs);
         if (ret < 0) {
             av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
-            ff_format_io_close(s, &vs->out);
+            if (!hls->writer)
+                ff_format_io_close(s, &vs->out);
             hls_window(s, 1, vs);
         }
         ffio_free_dyn_buf(&oc->pb);
@@ -2851,6 +2890,8 @@ failed:
         av_free(old_filename);
     }
 
+    if (hls->writer)
+        return ff_async_writer_flush(hls->writer);
     return 0;
 }
 
@@ -2890,6 +2931,19 @@ static int hls_init(AVFormatContext *s)
         av_log(hls, AV_LOG_WARNING, "No HTTP method set, hls muxer defaulting to method PUT.\n");
     }
 
+    if (hls->async_io) {
+        if ((hls->flags & HLS_SINGLE_FILE) || hls->max_seg_size > 0 ||
+            hls->http_persistent || hls->key_info_file || hls->encrypt) {
+            av_log(s, AV_LOG_ERROR, "async_io cannot be used with single_file, "
+                   "hls_segment_size, http_persistent or encryption\n");
+            return AVERROR(EINVAL);
+        }
+        ret = ff_async_writer_alloc(&hls->writer, s, hls->async_io_queue_size,
+                                    hls->ignore_io_errors);
+        if (ret < 0)
+            return ret;
+    }
+
     ret = validate_name(hls->nb_varstreams, s->url);
     if (ret < 0)
         return ret;
@@ -3176,6 +3230,8 @@ static const AVOption options[] = {
     {"timeout", "set timeout for socket I/O operations", OFFSET(timeout), AV_OPT_TYPE_DURATION, { .i64 = -1 }, -1, INT_MAX, .flags = E },
     {"ignore_io_errors", "Ignore IO errors for stable long-duration runs with network output", OFFSET(ignore_io_errors), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     {"headers", "set custom HTTP headers, can override built in default headers", OFFSET(headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
+    {"async_io", "write segments and playlists, and delete old segments, from a background thread", OFFSET(async_io), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
+    {"async_io_queue_size", "max size in bytes of the output waiting to be written in async_io mode", OFFSET(async_io_queue_size), AV_OPT_TYPE_INT64, { .i64 = 64 << 20 }, 0, INT64_MAX, E },
     { NULL },
 };
 
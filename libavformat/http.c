@@ -31,6 +31,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
 
 #include "avformat.h"
 #include "http.h"
@@ -38,6 +39,9 @@
 #include "internal.h"
 #include "network.h"
 #include "os_support.h"
+#if CONFIG_TLS_PROTOCOL
+#include "tls.h"
+#endif
 #include "url.h"
 
 /* XXX: POST protocol is not completely implemented because ffmpeg uses
@@ -51,6 +55,7 @@
 #define HTTP_SINGLE   1
 #define HTTP_MUTLI    2
 #define MAX_EXPIRY    19
+#define HTTP_POOL_SIZE 16
 #define WHITESPACES " \n\t\r"
 typedef enum {
     LOWER_PROTO,
@@ -75,6 +80,8 @@ typedef struct HTTPContext {
     char *http_proxy;
     char *headers;
     char *mime_type;
+    char *etag;
+    char *last_modified;
     char *http_version;
     char *user_agent;
     char *referer;
@@ -127,8 +134,22 @@ typedef struct HTTPContext {
     int is_multi_client;
     HandshakeState handshake_step;
     int is_connected_server;
+    int keepalive_pool;
+    int keepalive_timeout;
+    /* Key of the connection pool slot s->hd belongs to, NULL if not poolable. */
+    char *pool_key;
 } HTTPContext;
 
+typedef struct HTTPPoolEntry {
+    char *key;
+    URLContext *hd;
+    int64_t idle_since;
+} HTTPPoolEntry;
+
+/* Idle keep-alive connections shared by all HTTP contexts of the process. */
+static HTTPPoolEntry http_pool[HTTP_POOL_SIZE];
+static AVMutex http_pool_mutex = AV_MUTEX_INITIALIZER;
+
 #define OFFSET(x) offsetof(HTTPContext, x)
 #define D AV_OPT_FLAG_DECODING_PARAM
 #define E AV_OPT_FLAG_ENCODING_PARAM
@@ -148,6 +169,8 @@ static const AVOption options[] = {
     { "multiple_requests", "use persistent connections", OFFSET(multiple_requests), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D | E },
     { "post_data", "set custom HTTP post data", OFFSET(post_data), AV_OPT_TYPE_BINARY, .flags = D | E },
     { "mime_type", "export the MIME type", OFFSET(mime_type), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "etag", "export the ETag of the resource", OFFSET(etag), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "last_modified", "export the Last-Modified date of the resource", OFFSET(last_modified), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { "http_version", "export the http response version", OFFSET(http_version), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { "cookies", "set cookies to be sent in applicable future requests, use newline delimited Set-Cookie HTTP field value syntax", OFFSET(cookies), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
     { "icy", "request ICY metadata", OFFSET(icy), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, D },
@@ -169,6 +192,8 @@ static const AVOption options[] = {
     { "listen", "listen on HTTP", OFFSET(listen), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 2, D | E },
     { "resource", "The resource requested by a client", OFFSET(resource), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { "reply_code", "The http status code to return to a client", OFFSET(reply_code), AV_OPT_TYPE_INT, { .i64 = 200}, INT_MIN, 599, E},
+    { "keepalive_pool", "keep idle persistent connections in a process-wide pool for reuse by later requests", OFFSET(keepalive_pool), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+    { "keepalive_timeout", "max time in seconds a pooled connection may stay idle before it is discarded", OFFSET(keepalive_timeout), AV_OPT_TYPE_INT, { .i64 = 5 }, 0, INT_MAX / 1000000, D },
     { NULL }
 };
 
@@ -188,6 +213,94 @@ void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
            sizeof(HTTPAuthState));
 }
 
+static void http_pool_set_interrupt_cb(URLContext *hd, const AVIOInterruptCB *cb)
+{
+    hd->interrupt_callback = *cb;
+#if CONFIG_TLS_PROTOCOL
+    if (!strcmp(hd->prot->name, "tls")) {
+        URLContext *tcp = ff_tls_get_underlying(hd);
+        if (tcp)
+            tcp->interrupt_callback = *cb;
+    }
+#endif
+}
+
+static URLContext *http_pool_get(const char *key, int64_t max_idle)
+{
+    URLContext *hd = NULL, *expired[HTTP_POOL_SIZE];
+    int64_t now = av_gettime_relative();
+    int i, nb_expired = 0;
+
+    ff_mutex_lock(&http_pool_mutex);
+    for (i = 0; i < HTTP_POOL_SIZE; i++) {
+        HTTPPoolEntry *e = &http_pool[i];
+        if (!e->hd)
+            continue;
+        if (now - e->idle_since > max_idle) {
+            expired[nb_expired++] = e->hd;
+        } else if (!hd && !strcmp(e->key, key)) {
+            hd = e->hd;
+        } else {
+            continue;
+        }
+        e->hd = NULL;
+        av_freep(&e->key);
+    }
+    ff_mutex_unlock(&http_pool_mutex);
+
+    /* closing may write to the network, so do it outside of the lock */
+    for (i = 0; i < nb_expired; i++)
+        ffurl_closep(&expired[i]);
+    return hd;
+}
+
+static void http_pool_put(char *key, URLContext *hd)
+{
+    static const AVIOInterruptCB no_cb = { 0 };
+    URLContext *evicted = NULL;
+    HTTPPoolEntry *slot = &http_pool[0];
+    int i;
+
+    /* The owner's interrupt callback must not outlive the owner. */
+    http_pool_set_interrupt_cb(hd, &no_cb);
+
+    ff_mutex_lock(&http_pool_mutex);
+    for (i = 0; i < HTTP_POOL_SIZE; i++) {
+        if (!http_pool[i].hd) {
+            slot = &http_pool[i];
+            break;
+        }
+        if (http_pool[i].idle_since < slot->idle_since)
+            slot = &http_pool[i];
+    }
+    evicted = slot->hd;
+    av_free(slot->key);
+    slot->key        = key;
+    slot->hd         = hd;
+    slot->idle_since = av_gettime_relative();
+    ff_mutex_unlock(&http_pool_mutex);
+
+    if (evicted)
+        ffurl_closep(&evicted);
+}
+
+/* Return 1 if the response has been fully consumed and the connection can
+ * carry another request. */
+static int http_conn_reusable(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    uint64_t target_end = s->end_off ? s->end_off : s->filesize;
+
+    if (!s->pool_key || !s->multiple_requests || s->willclose ||
+        (h->flags & AVIO_FLAG_WRITE))
+        return 0;
+    if (s->http_code < 200 || s->http_code >= 300 || s->buf_ptr != s->buf_end)
+        return 0;
+    if (s->chunksize != UINT64_MAX)
+        return s->chunkend;
+    return s->off == target_end;
+}
+
 static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 {
     const char *path, *proxy_path, *lower_proto = "tcp", *local_path;
@@ -196,8 +309,9 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
     char auth[1024], proxyauth[1024] = "";
     char path1[MAX_URL_SIZE], sanitized_path[MAX_URL_SIZE];
     char buf[1024], urlbuf[MAX_URL_SIZE];
-    int port, use_proxy, err, location_changed = 0;
+    int port, use_proxy, err, location_changed = 0, pooled = 0;
     HTTPContext *s = h->priv_data;
+    uint64_t off = s->off;
 
     av_url_split(proto, sizeof(proto), auth, sizeof(auth),
                  hostname, sizeof(hostname), &port,
@@ -242,6 +356,28 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 
     ff_url_join(buf, sizeof(buf), lower_proto, NULL, hostname, port, NULL);
 
+    if (!s->hd) {
+        av_freep(&s->pool_key);
+        if (s->keepalive_pool && !use_proxy && !s->listen) {
+            char *opts = NULL;
+            /* Connections opened with different lower protocol options
+             * (e.g. TLS verification settings) must not be shared. */
+            if (av_dict_get_string(*options, &opts, '=', '&') < 0)
+                return AVERROR(ENOMEM);
+            s->pool_key = av_asprintf("%s?%s", buf, opts);
+            av_free(opts);
+            if (!s->pool_key)
+                return AVERROR(ENOMEM);
+            s->hd = http_pool_get(s->pool_key, s->keepalive_timeout * 1000000LL);
+            if (s->hd) {
+                av_log(h, AV_LOG_DEBUG, "Reusing pooled connection to %s\n", buf);
+                http_pool_set_interrupt_cb(s->hd, &h->interrupt_callback);
+                pooled = 1;
+            }
+        }
+    }
+
+reconnect:
     if (!s->hd) {
         err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
                                    &h->interrupt_callback, options,
@@ -250,8 +386,21 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
             return err;
     }
 
+    /* http_code is only set once a status line was received */
+    if (pooled)
+        s->http_code = 0;
     err = http_connect(h, path, local_path, hoststr,
                        auth, proxyauth, &location_changed);
+    if (err < 0 && pooled && !s->http_code && err != AVERROR_HTTP_BAD_REQUEST) {
+        /* The server may have dropped the connection while it was idle.
+         * Only retry if no response arrived, so that the request is not
+         * handled twice by the server. */
+        av_log(h, AV_LOG_DEBUG, "Pooled connection failed, reconnecting\n");
+        ffurl_closep(&s->hd);
+        s->off = off;
+        pooled = 0;
+        goto reconnect;
+    }
     if (err < 0)
         return err;
 
@@ -587,6 +736,9 @@ static int http_open(URLContext *h, const char *uri, int flags,
     if (s->listen) {
         return http_listen(h, uri, flags, options);
     }
+    /* pooling only makes sense if the server keeps the connection open */
+    if (s->keepalive_pool)
+        s->multiple_requests = 1;
     ret = http_open_cnx(h, options);
 bail_out:
     if (ret < 0)
@@ -1036,6 +1188,12 @@ static int process_line(URLContext *h, char *line, int line_count,
         } else if (!av_strcasecmp(tag, "Content-Type")) {
             av_free(s->mime_type);
             s->mime_type = av_strdup(p);
+        } else if (!av_strcasecmp(tag, "ETag")) {
+            av_free(s->etag);
+            s->etag = av_strdup(p);
+        } else if (!av_strcasecmp(tag, "Last-Modified")) {
+            av_free(s->last_modified);
+            s->last_modified = av_strdup(p);
         } else if (!av_strcasecmp(tag, "Set-Cookie")) {
             if (parse_cookie(s, p, &s->cookie_dict))
                 av_log(h, AV_LOG_WARNING, "Unable to parse '%s'\n", p);
@@ -1710,8 +1868,14 @@ static int http_close(URLContext *h)
         /* Close the write direction by sending the end of chunked encoding. */
         ret = http_shutdown(h, h->flags);
 
+    if (s->hd && ret >= 0 && http_conn_reusable(h)) {
+        http_pool_put(s->pool_key, s->hd);
+        s->pool_key = NULL;
+        s->hd       = NULL;
+    }
     if (s->hd)
         ffurl_closep(&s->hd);
+    av_freep(&s->pool_key);
     av_dict_free(&s->chained_options);
     return ret;
 }
@@ -142,6 +142,17 @@ struct AVFormatInternal {
      * Prefer the codec framerate for avg_frame_rate computation.
      */
     int prefer_codec_framerate;
+
+    /**
+     * Stream information set by avformat_import_stream_info(), used and
+     * freed by avformat_find_stream_info().
+     */
+    struct StreamInfoCache *stream_info_cache;
+
+    /**
+     * Worker threads decoding audio packets in avformat_find_stream_info().
+     */
+    struct ProbeDecodePool *probe_decode_pool;
 };
 
 struct AVStreamInternal {
@@ -223,6 +234,18 @@ struct AVStreamInternal {
         int64_t fps_last_dts;
         int     fps_last_dts_idx;
 
+        /**
+         * 0  -> stream info cache not checked yet
+         * >0 -> parameters set from the stream info cache
+         * <0 -> no usable entry in the stream info cache
+         */
+        int from_cache;
+
+        /**
+         * A packet of this stream is queued or being decoded in the probe
+         * decode pool. Protected by the mutex of the pool.
+         */
+        int decode_pending;
     } *info;
 
     AVIndexEntry *index_entries; /**< Only used if the format does not
@@ -750,6 +773,14 @@ int ff_alloc_extradata(AVCodecParameters *par, int size);
  */
 int ff_get_extradata(AVFormatContext *s, AVCodecParameters *par, AVIOContext *pb, int size);
 
+/**
+ * Like av_get_packet(), but let the packet reference the read buffer instead
+ * of copying the data if pb was opened with AVIO_FLAG_ZEROCOPY. The packet
+ * is not writable then, so this must only be used by demuxers that do not
+ * modify the packet data.
+ */
+int ff_get_packet_zerocopy(AVIOContext *pb, AVPacket *pkt, int size);
+
 /**
  * add frame for rfps calculation.
  *
@@ -778,6 +809,30 @@ enum AVWriteUncodedFrameFlags {
  */
 int ff_copy_whiteblacklists(AVFormatContext *dst, const AVFormatContext *src);
 
+/**
+ * Set the parameters of a stream from the stream info imported with
+ * avformat_import_stream_info(), if it has a matching entry.
+ *
+ * @return 1 if the parameters were set, 0 if there is no matching entry,
+ *         a negative AVERROR on failure
+ */
+int ff_stream_info_cache_apply(AVFormatContext *s, AVStream *st);
+
+/**
+ * @return 1 if every stream of the imported stream info has been set with
+ *         ff_stream_info_cache_apply() and no other stream exists, 0 otherwise
+ */
+int ff_stream_info_cache_complete(AVFormatContext *s);
+
+/**
+ * Set the start time, duration and bitrate of s from the imported stream
+ * info, in place of estimating them. Only valid if
+ * ff_stream_info_cache_complete() returns 1.
+ */
+void ff_stream_info_cache_apply_timings(AVFormatContext *s);
+
+void ff_stream_info_cache_free(struct StreamInfoCache **pc);
+
 /**
  * Returned by demuxers to indicate that data was consumed but discarded
  * (ignored streams or junk data). The framework will re-call the demuxer.
@@ -69,4 +69,25 @@ int ff_ip_parse_blocks(void *log_ctx, const char *buf, IPSourceFilters *filters)
  */
 void ff_ip_reset_filters(IPSourceFilters *filters);
 
+/**
+ * Receive a datagram on a udp URLContext without waiting. When the socket
+ * receives in batches, datagrams of the last batch are returned first.
+ *
+ * @param addr      filled with the source address
+ * @param addr_len  in: size of addr, out: length of the source address
+ * @param timestamp if not NULL, set to the kernel receive time of the
+ *                  datagram in microseconds since the epoch, or
+ *                  AV_NOPTS_VALUE if unavailable
+ * @return size of the datagram or < 0 AVERROR code on error
+ */
+int ff_udp_recv(URLContext *h, uint8_t *buf, int size,
+                struct sockaddr_storage *addr, socklen_t *addr_len,
+                int64_t *timestamp);
+
+/**
+ * @return 1 if ff_udp_recv() can return a datagram of the last batch
+ *         without receiving, 0 otherwise
+ */
+int ff_udp_pending(URLContext *h);
+
 #endif /* AVFORMAT_IP_H */
@@ -44,6 +44,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/time_internal.h"
 #include "libavutil/spherical.h"
+#include "libavutil/thread.h"
 
 #include "libavcodec/bytestream.h"
 #include "libavcodec/flac.h"
@@ -339,6 +340,13 @@ typedef struct MatroskaLevel1Element {
     int parsed;
 } MatroskaLevel1Element;
 
+typedef struct MatroskaClusterPos {
+    int64_t  pos;
+    uint64_t timecode;
+    /* whether the keyframes of the cluster were added to the index */
+    int parsed;
+} MatroskaClusterPos;
+
 typedef struct MatroskaDemuxContext {
     const AVClass *class;
     AVFormatContext *ctx;
@@ -384,6 +392,29 @@ typedef struct MatroskaDemuxContext {
 
     MatroskaCluster current_cluster;
 
+    /* Coarse index of the clusters, built by jumping from one cluster
+     * header to the next without parsing the blocks. */
+    int use_cluster_index;
+    int cluster_scan_thread;
+    MatroskaClusterPos *clusters;
+    unsigned int clusters_size;
+    int nb_clusters;
+    /* position of the next level 1 element to scan, -1 when finished */
+    int64_t cluster_scan_pos;
+    int64_t cluster_scan_end;
+    /* Set once clusters were parsed out of order: the index of the
+     * streams then has gaps and only the clusters marked as parsed can
+     * be relied on. */
+    int index_has_gaps;
+#if HAVE_THREADS
+    AVIOContext *scan_pb;
+    pthread_t scan_thread;
+    pthread_mutex_t scan_mutex;
+    pthread_cond_t scan_cond;
+    int scan_thread_started;
+    int scan_stop;
+#endif
+
     /* WebM DASH Manifest live flag */
     int is_live;
 
@@ -772,6 +803,7 @@ static const CodecMime mkv_mime_tags[] = {
 static const char *const matroska_doctypes[] = { "matroska", "webm" };
 
 static int matroska_read_close(AVFormatContext *s);
+static void matroska_start_cluster_scan(MatroskaDemuxContext *matroska);
 
 /*
  * This function prepares the status for parsing of level 1 elements.
@@ -2896,9 +2928,17 @@ static int matroska_read_header(AVFormatContext *s)
         pos = avio_tell(matroska->ctx->pb);
         res = ebml_parse(matroska, matroska_segment, matroska);
     }
+    /* The cluster index starts at the first cluster, which is also where
+     * reading the level 1 elements stopped. */
+    matroska->cluster_scan_pos = -1;
+    matroska->cluster_scan_end = matroska->levels[0].length == EBML_UNKNOWN_LENGTH ?
+                                 INT64_MAX : matroska->levels[0].start + matroska->levels[0].length;
     /* Set data_offset as it might be needed later by seek_frame_generic. */
-    if (matroska->current_id == MATROSKA_ID_CLUSTER)
+    if (matroska->current_id == MATROSKA_ID_CLUSTER) {
         s->internal->data_offset = avio_tell(matroska->ctx->pb) - 4;
+        if (s->pb->seekable & AVIO_SEEKABLE_NORMAL)
+            matroska->cluster_scan_pos = s->internal->data_offset;
+    }
     matroska_execute_seekhead(matroska);
 
     if (!matroska->time_scale)
@@ -2988,6 +3028,10 @@ static int matroska_read_header(AVFormatContext *s)
 
     matroska_convert_tags(s);
 
+    if (matroska->use_cluster_index && matroska->cluster_scan_thread &&
+        matroska->cluster_scan_pos >= 0)
+        matroska_start_cluster_scan(matroska);
+
     return 0;
 fail:
     matroska_read_close(s);
@@ -3767,6 +3811,334 @@ static int matroska_read_packet(AVFormatContext *s, AVPacket *pkt)
     return 0;
 }
 
+/*
+ * Read the header of the level 1 element at pos and set *next to the
+ * position of the following one. If the element is a cluster, its
+ * timecode is read as well.
+ * Returns 1 if *cluster was set, 0 for other elements, < 0 if no element
+ * could be read.
+ */
+static int matroska_scan_level1_elem(MatroskaDemuxContext *matroska,
+                                     AVIOContext *pb, int64_t pos,
+                                     MatroskaClusterPos *cluster, int64_t *next)
+{
+    uint64_t id, length;
+    int64_t end;
+    int res;
+
+    if (pos >= matroska->cluster_scan_end)
+        return AVERROR_EOF;
+    if (avio_seek(pb, pos, SEEK_SET) != pos)
+        return AVERROR(EIO);
+    if ((res = ebml_read_num(matroska, pb, 4, &id, 0)) < 0)
+        return res;
+    id |= 1ULL << 7 * res;
+    if ((res = ebml_read_length(matroska, pb, &length)) < 0)
+        return res;
+    /* The end of an element of unknown length can only be found by
+     * parsing its content. */
+    if (!is_ebml_id_valid(id) || length == EBML_UNKNOWN_LENGTH ||
+        length > INT64_MAX - avio_tell(pb))
+        return AVERROR_INVALIDDATA;
+    end   = avio_tell(pb) + length;
+    *next = end;
+    if (id != MATROSKA_ID_CLUSTER)
+        return 0;
+
+    /* The timecode has to precede the blocks. */
+    while (avio_tell(pb) < end) {
+        uint64_t child, size;
+
+        if ((res = ebml_read_num(matroska, pb, 4, &child, 1)) < 0)
+            return res;
+        child |= 1ULL << 7 * res;
+        if ((res = ebml_read_length(matroska, pb, &size)) < 0)
+            return res;
+        if (child == MATROSKA_ID_CLUSTERTIMECODE && size <= 8) {
+            ebml_read_uint(pb, size, &cluster->timecode);
+            cluster->pos    = pos;
+            cluster->parsed = 0;
+            return pb->eof_reached ? AVERROR_EOF : 1;
+        }
+        if (size == EBML_UNKNOWN_LENGTH ||
+            child == MATROSKA_ID_SIMPLEBLOCK || child == MATROSKA_ID_BLOCKGROUP)
+            break;
+        avio_skip(pb, size);
+    }
+    return 0;
+}
+
+static int matroska_add_cluster_pos(MatroskaDemuxContext *matroska,
+                                    const MatroskaClusterPos *cluster)
+{
+    MatroskaClusterPos *clusters;
+
+    /* The index is searched by timecode; ignore clusters out of order. */
+    if (matroska->nb_clusters &&
+        cluster->timecode < matroska->clusters[matroska->nb_clusters - 1].timecode)
+        return 0;
+    if (matroska->nb_clusters >= INT_MAX / sizeof(*clusters) - 1)
+        return AVERROR(ENOMEM);
+    clusters = av_fast_realloc(matroska->clusters, &matroska->clusters_size,
+                               (matroska->nb_clusters + 1) * sizeof(*clusters));
+    if (!clusters)
+        return AVERROR(ENOMEM);
+    matroska->clusters = clusters;
+    clusters[matroska->nb_clusters++] = *cluster;
+    return 0;
+}
+
+#if HAVE_THREADS
+static void *cluster_scan_thread(void *arg)
+{
+    MatroskaDemuxContext *matroska = arg;
+    int64_t pos = matroska->cluster_scan_pos;
+
+    while (pos >= 0) {
+        MatroskaClusterPos cluster;
+        int64_t next;
+        int ret;
+
+        ret = matroska_scan_level1_elem(matroska, matroska->scan_pb, pos,
+                                        &cluster, &next);
+
+        pthread_mutex_lock(&matroska->scan_mutex);
+        if (ret > 0)
+            ret = matroska_add_cluster_pos(matroska, &cluster);
+        pos = ret < 0 || matroska->scan_stop ? -1 : next;
+        matroska->cluster_scan_pos = pos;
+        pthread_cond_broadcast(&matroska->scan_cond);
+        pthread_mutex_unlock(&matroska->scan_mutex);
+    }
+    return NULL;
+}
+#endif
+
+static void matroska_start_cluster_scan(MatroskaDemuxContext *matroska)
+{
+#if HAVE_THREADS
+    AVFormatContext *s = matroska->ctx;
+    int ret;
+
+    /* The thread reads the file through a context of its own. */
+    ret = s->io_open(s, &matroska->scan_pb, s->url, AVIO_FLAG_READ, NULL);
+    if (ret < 0) {
+        av_log(s, AV_LOG_WARNING, "Cannot open '%s' for scanning the "
+               "clusters: %s\n", s->url, av_err2str(ret));
+        return;
+    }
+    if ((ret = pthread_mutex_init(&matroska->scan_mutex, NULL))) {
+        ff_format_io_close(s, &matroska->scan_pb);
+        return;
+    }
+    if ((ret = pthread_cond_init(&matroska->scan_cond, NULL))) {
+        pthread_mutex_destroy(&matroska->scan_mutex);
+        ff_format_io_close(s, &matroska->scan_pb);
+        return;
+    }
+    ret = pthread_create(&matroska->scan_thread, NULL, cluster_scan_thread, matroska);
+    if (ret) {
+        av_log(s, AV_LOG_WARNING, "Failed to create cluster scan thread: %s\n",
+               av_err2str(AVERROR(ret)));
+        pthread_cond_destroy(&matroska->scan_cond);
+        pthread_mutex_destroy(&matroska->scan_mutex);
+        ff_format_io_close(s, &matroska->scan_pb);
+        return;
+    }
+    matroska->scan_thread_started = 1;
+#endif
+}
+
+static void matroska_stop_cluster_scan(MatroskaDemuxContext *matroska)
+{
+#if HAVE_THREADS
+    if (!matroska->scan_thread_started)
+        return;
+    pthread_mutex_lock(&matroska->scan_mutex);
+    matroska->scan_stop = 1;
+    pthread_mutex_unlock(&matroska->scan_mutex);
+    pthread_join(matroska->scan_thread, NULL);
+    pthread_cond_destroy(&matroska->scan_cond);
+    pthread_mutex_destroy(&matroska->scan_mutex);
+    ff_format_io_close(matroska->ctx, &matroska->scan_pb);
+    matroska->scan_thread_started = 0;
+#endif
+}
+
+static void matroska_lock_clusters(MatroskaDemuxContext *matroska)
+{
+#if HAVE_THREADS
+    if (matroska->scan_thread_started)
+        pthread_mutex_lock(&matroska->scan_mutex);
+#endif
+}
+
+static void matroska_unlock_clusters(MatroskaDemuxContext *matroska)
+{
+#if HAVE_THREADS
+    if (matroska->scan_thread_started)
+        pthread_mutex_unlock(&matroska->scan_mutex);
+#endif
+}
+
+/*
+ * Extend the cluster index until it contains nb clusters or the whole file
+ * has been scanned. Returns the number of clusters in the index.
+ */
+static int matroska_scan_clusters(MatroskaDemuxContext *matroska, int nb)
+{
+    int ret;
+
+    matroska_lock_clusters(matroska);
+#if HAVE_THREADS
+    if (matroska->scan_thread_started) {
+        while (matroska->cluster_scan_pos >= 0 && matroska->nb_clusters < nb)
+            pthread_cond_wait(&matroska->scan_cond, &matroska->scan_mutex);
+    }
+#endif
+    while (matroska->cluster_scan_pos >= 0 && matroska->nb_clusters < nb) {
+        MatroskaClusterPos cluster;
+        int64_t next;
+
+        ret = matroska_scan_level1_elem(matroska, matroska->ctx->pb,
+                                        matroska->cluster_scan_pos,
+                                        &cluster, &next);
+        if (ret > 0)
+            ret = matroska_add_cluster_pos(matroska, &cluster);
+        matroska->cluster_scan_pos = ret < 0 ? -1 : next;
+    }
+    ret = matroska->nb_clusters;
+    matroska_unlock_clusters(matroska);
+    return ret;
+}
+
+/*
+ * Return the index of the last cluster starting at or before timecode,
+ * scanning the file as far as needed.
+ */
+static int matroska_find_cluster(MatroskaDemuxContext *matroska, uint64_t timecode)
+{
+    int nb = 0, prev, lo = 0, hi;
+
+    do {
+        prev = nb;
+        nb   = matroska_scan_clusters(matroska, nb + 1);
+        matroska_lock_clusters(matroska);
+        hi   = nb && matroska->clusters[nb - 1].timecode <= timecode;
+        matroska_unlock_clusters(matroska);
+    } while (nb > prev && hi);
+
+    matroska_lock_clusters(matroska);
+    hi = matroska->nb_clusters;
+    while (hi - lo > 1) {
+        int mid = (lo + hi) >> 1;
+        if (matroska->clusters[mid].timecode <= timecode)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    matroska_unlock_clusters(matroska);
+    return hi ? lo : -1;
+}
+
+static int matroska_get_cluster(MatroskaDemuxContext *matroska, int i,
+                                MatroskaClusterPos *cluster)
+{
+    int ret = 0;
+
+    matroska_lock_clusters(matroska);
+    if (i >= 0 && i < matroska->nb_clusters)
+        *cluster = matroska->clusters[i];
+    else
+        ret = AVERROR_EOF;
+    matroska_unlock_clusters(matroska);
+    return ret;
+}
+
+/*
+ * Parse the i-th cluster of the cluster index, unless this was already
+ * done, and add its keyframes to the index.
+ */
+static int matroska_parse_indexed_cluster(MatroskaDemuxContext *matroska, int i)
+{
+    MatroskaClusterPos cluster, next;
+    int64_t end;
+    int ret;
+
+    matroska_scan_clusters(matroska, i + 2);
+    if ((ret = matroska_get_cluster(matroska, i, &cluster)) < 0 || cluster.parsed)
+        return ret;
+    end = matroska_get_cluster(matroska, i + 1, &next) < 0 ? INT64_MAX : next.pos;
+
+    matroska->index_has_gaps = 1;
+    ret = matroska_reset_status(matroska, 0, cluster.pos);
+    while (ret >= 0 &&
+           (matroska->num_levels > 1 || avio_tell(matroska->ctx->pb) < end)) {
+        ret = matroska_parse_cluster(matroska);
+        matroska_clear_queue(matroska);
+    }
+
+    matroska_lock_clusters(matroska);
+    matroska->clusters[i].parsed = 1;
+    matroska_unlock_clusters(matroska);
+    return ret == AVERROR_EOF ? 0 : ret;
+}
+
+/*
+ * Add the keyframes around timestamp to the index of st, by parsing only
+ * the clusters located with the cluster index instead of all the clusters
+ * following the last known index entry.
+ */
+static void matroska_index_from_clusters(MatroskaDemuxContext *matroska,
+                                         AVStream *st, int64_t timestamp,
+                                         int flags)
+{
+    MatroskaTrack *tracks = matroska->tracks.elem;
+    MatroskaTrack *track  = NULL;
+    MatroskaClusterPos cluster;
+    uint64_t timecode;
+    int i, j, index;
+
+    for (i = 0; i < matroska->tracks.nb_elem; i++)
+        if (tracks[i].stream == st)
+            track = &tracks[i];
+    if (!track || st->discard >= AVDISCARD_ALL)
+        return;
+
+    /* inverse of the timecode computation in matroska_parse_block() */
+    timecode = FFMAX(timestamp + (int64_t)track->codec_delay_in_track_tb, 0) *
+               track->time_scale;
+    if ((i = matroska_find_cluster(matroska, timecode)) < 0)
+        return;
+
+    /* Blocks may precede the timecode of their cluster, so the clusters
+     * following the one containing timestamp are parsed as well. When
+     * seeking forward, parsing continues up to the next keyframe. */
+    for (j = i; ; j++) {
+        if (matroska_parse_indexed_cluster(matroska, j) < 0 ||
+            matroska_get_cluster(matroska, j, &cluster) < 0)
+            break;
+        if (j < i + 2)
+            continue;
+        if (flags & AVSEEK_FLAG_BACKWARD)
+            break;
+        index = av_index_search_timestamp(st, timestamp, flags);
+        if (index >= 0 && st->internal->index_entries[index].pos <= cluster.pos)
+            return;
+    }
+    if (!(flags & AVSEEK_FLAG_BACKWARD))
+        return;
+
+    /* The keyframe preceding timestamp may lie in an earlier cluster. */
+    while (i > 0 && matroska_get_cluster(matroska, i, &cluster) >= 0) {
+        index = av_index_search_timestamp(st, timestamp, flags);
+        if (index >= 0 && st->internal->index_entries[index].pos >= cluster.pos)
+            break;
+        if (matroska_parse_indexed_cluster(matroska, --i) < 0)
+            break;
+    }
+}
+
 static int matroska_read_seek(AVFormatContext *s, int stream_index,
                               int64_t timestamp, int flags)
 {
@@ -3781,6 +4153,12 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
         matroska_parse_cues(matroska);
     }
 
+    if (matroska->use_cluster_index &&
+        (matroska->index_has_gaps ||
+         (index = av_index_search_timestamp(st, timestamp, flags)) < 0 ||
+         index == st->internal->nb_index_entries - 1))
+        matroska_index_from_clusters(matroska, st, timestamp, flags);
+
     if (!st->internal->nb_index_entries)
         goto err;
     timestamp = FFMAX(timestamp, st->internal->index_entries[0].timestamp);
@@ -3838,6 +4216,8 @@ static int matroska_read_close(AVFormatContext *s)
     int n;
 
     matroska_clear_queue(matroska);
+    matroska_stop_cluster_scan(matroska);
+    av_freep(&matroska->clusters);
 
     for (n = 0; n < matroska->tracks.nb_elem; n++)
         if (tracks[n].type == MATROSKA_TRACK_TYPE_AUDIO)
@@ -4253,6 +4633,19 @@ static const AVOption options[] = {
     { NULL },
 };
 
+static const AVOption matroska_options[] = {
+    { "cluster_index", "build an index of the clusters to seek in files lacking a complete index", OFFSET(use_cluster_index), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "cluster_index_thread", "build the index of the clusters on a separate thread", OFFSET(cluster_scan_thread), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { NULL },
+};
+
+static const AVClass matroska_class = {
+    .class_name = "matroska,webm demuxer",
+    .item_name  = av_default_item_name,
+    .option     = matroska_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 static const AVClass webm_dash_class = {
     .class_name = "WebM DASH Manifest demuxer",
     .item_name  = av_default_item_name,
@@ -4270,6 +4663,7 @@ AVInputFormat ff_matroska_demuxer = {
     .read_packet    = matroska_read_packet,
     .read_close     = matroska_read_close,
     .read_seek      = matroska_read_seek,
+    .priv_class     = &matroska_class,
     .mime_type      = "audio/webm,audio/x-matroska,video/webm,video/x-matroska"
 };
 
@@ -7947,8 +7947,11 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 
         if (st->codecpar->codec_id == AV_CODEC_ID_EIA_608 && sample->size > 8)
             ret = get_eia608_packet(sc->pb, pkt, sample->size);
-        else
+        else if (mov->aax_mode || mov->decryption_key)
+            /* decrypted in place */
             ret = av_get_packet(sc->pb, pkt, sample->size);
+        else
+            ret = ff_get_packet_zerocopy(sc->pb, pkt, sample->size);
         if (ret < 0) {
             if (should_retry(sc->pb, ret)) {
                 mov_current_sample_dec(sc);
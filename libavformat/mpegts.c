@@ -45,6 +45,7 @@
 /* maximum size in which we look for synchronization if
  * synchronization is lost */
 #define MAX_RESYNC_SIZE 65536
+#define RESYNC_CHUNK_SIZE 4096
 
 #define MAX_PES_PAYLOAD 200 * 1024
 
@@ -161,6 +162,11 @@ struct MpegTSContext {
     unsigned int nb_prg;
     struct Program *prg;
 
+    /** PIDs skipped on arrival because of AVProgram/AVStream.discard,
+     *  see update_discard_pids() */
+    int discard_pids_active;
+    uint32_t discard_pids[NB_PID_MAX / 32];
+
     int8_t crc_validity[NB_PID_MAX];
     /** filters for various streams specified by PMT + for the PAT and PMT */
     MpegTSFilter *pids[NB_PID_MAX];
@@ -366,46 +372,71 @@ static void update_av_program_info(AVFormatContext *s, unsigned int programid,
     }
 }
 
+#define PID_MAP_SET(map, pid)   ((map)[(pid) >> 5] |=  (1U << ((pid) & 31)))
+#define PID_MAP_CLEAR(map, pid) ((map)[(pid) >> 5] &= ~(1U << ((pid) & 31)))
+#define PID_MAP_TEST(map, pid)  ((map)[(pid) >> 5] &   (1U << ((pid) & 31)))
+
 /**
- * @brief discard_pid() decides if the pid is to be discarded according
- *                      to caller's programs selection
- * @param ts    : - TS context
- * @param pid   : - pid
- * @return 1 if the pid is only comprised in programs that have .discard=AVDISCARD_ALL
- *         0 otherwise
+ * Build the map of the PIDs which can be skipped according to the
+ * caller's selection:
+ * - PIDs only comprised in programs that have .discard=AVDISCARD_ALL,
+ * - PES PIDs whose streams all have .discard=AVDISCARD_ALL, unless they
+ *   carry the PCR of a program in use.
+ * The map is applied at the next payload unit start of each PID.
  */
-static int discard_pid(MpegTSContext *ts, unsigned int pid)
+static void update_discard_pids(MpegTSContext *ts)
 {
-    int i, j, k;
-    int used = 0, discarded = 0;
-    struct Program *p;
-
-    /* If none of the programs have .discard=AVDISCARD_ALL then there's
-     * no way we have to discard this packet */
-    for (k = 0; k < ts->stream->nb_programs; k++)
-        if (ts->stream->programs[k]->discard == AVDISCARD_ALL)
-            break;
-    if (k == ts->stream->nb_programs)
-        return 0;
+    AVFormatContext *s = ts->stream;
+    uint32_t used[NB_PID_MAX / 32];
+    int i, j, k, any = 0;
+
+    for (k = 0; k < s->nb_programs && !any; k++)
+        any = s->programs[k]->discard == AVDISCARD_ALL;
+    for (i = 0; i < s->nb_streams && !any; i++)
+        any = s->streams[i]->discard == AVDISCARD_ALL;
+    ts->discard_pids_active = any;
+    if (!any)
+        return;
 
+    memset(ts->discard_pids, 0, sizeof(ts->discard_pids));
+    memset(used, 0, sizeof(used));
     for (i = 0; i < ts->nb_prg; i++) {
-        p = &ts->prg[i];
-        for (j = 0; j < p->nb_pids; j++) {
-            if (p->pids[j] != pid)
+        struct Program *p = &ts->prg[i];
+        for (k = 0; k < s->nb_programs; k++) {
+            if (s->programs[k]->id != p->id)
                 continue;
-            // is program with id p->id set to be discarded?
-            for (k = 0; k < ts->stream->nb_programs; k++) {
-                if (ts->stream->programs[k]->id == p->id) {
-                    if (ts->stream->programs[k]->discard == AVDISCARD_ALL)
-                        discarded++;
-                    else
-                        used++;
-                }
+            for (j = 0; j < p->nb_pids; j++) {
+                if (s->programs[k]->discard == AVDISCARD_ALL)
+                    PID_MAP_SET(ts->discard_pids, p->pids[j]);
+                else
+                    PID_MAP_SET(used, p->pids[j]);
             }
         }
     }
+    for (i = 0; i < FF_ARRAY_ELEMS(used); i++)
+        ts->discard_pids[i] &= ~used[i];
 
-    return !used && discarded;
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        MpegTSFilter *f;
+        PESContext *pes;
+
+        if (st->discard != AVDISCARD_ALL || st->id < 0 || st->id >= NB_PID_MAX)
+            continue;
+        f = ts->pids[st->id];
+        if (!f || f->type != MPEGTS_PES)
+            continue;
+        pes = f->u.pes_filter.opaque;
+        if (pes->st != st || (pes->sub_st && pes->sub_st->discard != AVDISCARD_ALL))
+            continue;
+        PID_MAP_SET(ts->discard_pids, st->id);
+    }
+    for (k = 0; k < s->nb_programs; k++) {
+        AVProgram *program = s->programs[k];
+        if (program->discard != AVDISCARD_ALL &&
+            program->pcr_pid >= 0 && program->pcr_pid < NB_PID_MAX)
+            PID_MAP_CLEAR(ts->discard_pids, program->pcr_pid);
+    }
 }
 
 /**
@@ -2718,8 +2749,17 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet, int64_t pos)
     }
     if (!tss)
         return 0;
-    if (is_start)
-        tss->discard = discard_pid(ts, pid);
+    if (is_start) {
+        int discard = ts->discard_pids_active && PID_MAP_TEST(ts->discard_pids, pid);
+        if (discard && !tss->discard && tss->type == MPEGTS_PES) {
+            /* drop the pending PES so that it is not output later */
+            PESContext *pes = tss->u.pes_filter.opaque;
+            av_buffer_unref(&pes->buffer);
+            pes->data_index = 0;
+            pes->state = MPEGTS_SKIP;
+        }
+        tss->discard = discard;
+    }
     if (tss->discard)
         return 0;
     ts->current_pid = pid;
@@ -2844,7 +2884,7 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
 {
     MpegTSContext *ts = s->priv_data;
     AVIOContext *pb = s->pb;
-    int c, i;
+    int i, len;
     uint64_t pos = avio_tell(pb);
     int64_t back = FFMIN(seekback, pos);
 
@@ -2856,13 +2896,23 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
 
     avio_seek(pb, -back, SEEK_CUR);
 
-    for (i = 0; i < ts->resync_size; i++) {
-        c = avio_r8(pb);
-        if (avio_feof(pb))
+    for (i = 0; i < ts->resync_size; i += len) {
+        uint8_t buf[RESYNC_CHUNK_SIZE];
+        const uint8_t *data, *sync;
+        int ret;
+
+        /* search a whole chunk at once, and seek back to the sync byte */
+        len = FFMIN(RESYNC_CHUNK_SIZE, ts->resync_size - i);
+        ret = ffio_ensure_seekback(pb, len);
+        if (ret < 0)
+            return ret;
+        len = ffio_read_indirect(pb, buf, len, &data);
+        if (len <= 0)
             return AVERROR_EOF;
-        if (c == 0x47) {
-            int new_packet_size, ret;
-            avio_seek(pb, -1, SEEK_CUR);
+        sync = memchr(data, 0x47, len);
+        if (sync) {
+            int new_packet_size;
+            avio_seek(pb, sync - data - len, SEEK_CUR);
             pos = avio_tell(pb);
             ret = ffio_ensure_seekback(pb, PROBE_PACKET_MAX_BUF);
             if (ret < 0)
@@ -2919,10 +2969,12 @@ static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
 static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
 {
     AVFormatContext *s = ts->stream;
+    AVIOContext *pb = s->pb;
     uint8_t packet[TS_PACKET_SIZE + AV_INPUT_BUFFER_PADDING_SIZE];
     const uint8_t *data;
+    MpegTSFilter *tss;
     int64_t packet_num;
-    int ret = 0;
+    int is_start, ret = 0;
 
     if (avio_tell(s->pb) != ts->last_pos) {
         int i;
@@ -2944,6 +2996,8 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         }
     }
 
+    update_discard_pids(ts);
+
     ts->stop_parse = 0;
     packet_num = 0;
     memset(packet + TS_PACKET_SIZE, 0, AV_INPUT_BUFFER_PADDING_SIZE);
@@ -2960,7 +3014,11 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
-        ret = handle_packet(ts, data, avio_tell(s->pb));
+        /* skip the packets of unused PIDs without further processing */
+        tss = ts->pids[AV_RB16(data + 1) & 0x1fff];
+        is_start = data[1] & 0x40;
+        if (tss ? !tss->discard || is_start : ts->auto_guess && is_start)
+            ret = handle_packet(ts, data, avio_tell(pb));
         finished_reading_packet(s, ts->raw_packet_size);
         if (ret != 0)
             break;
@@ -3350,6 +3408,7 @@ int avpriv_mpegts_parse_packet(MpegTSContext *ts, AVPacket *pkt,
 
     len1 = len;
     ts->pkt = pkt;
+    update_discard_pids(ts);
     for (;;) {
         ts->stop_parse = 0;
         if (len < TS_PACKET_SIZE)
@@ -115,8 +115,18 @@ typedef struct MpegTSWrite {
     int64_t last_sdt_ts;
 
     int omit_video_pes_length;
+
+    /* TS packets are assembled in this block and written with a single
+     * avio_write() per PES */
+    uint8_t *out_buf;
+    unsigned int out_buf_size;
+    int out_len;
+    int packet_size; ///< size of a packet in the output, with the m2ts header
 } MpegTSWrite;
 
+/* minimum size of the output block, in TS packets */
+#define OUT_BUF_MIN_PACKETS 32
+
 /* a PES packet header is generated every DEFAULT_PES_HEADER_FREQ packets */
 #define DEFAULT_PES_HEADER_FREQ  16
 #define DEFAULT_PES_PAYLOAD_SIZE ((DEFAULT_PES_HEADER_FREQ - 1) * 184 + 170)
@@ -249,6 +259,14 @@ typedef struct MpegTSWriteStream {
     int opus_pending_trim_start;
 
     DVBAC3Descriptor *dvb_ac3_desc;
+
+    /* per stream constant parts of the TS and PES headers */
+    uint8_t ts_header[2];       ///< TS header bytes 1 and 2, without the start flag
+    int pes_stream_id;
+    int pes_data_stream;        ///< stream_id may be given by the packet side data
+    int pes_data_alignment;
+    int is_dvb_subtitle;
+    int is_dvb_teletext;
 } MpegTSWriteStream;
 
 static void mpegts_write_pat(AVFormatContext *s)
@@ -838,17 +856,72 @@ static int64_t get_pcr(const MpegTSWrite *ts)
            ts->first_pcr;
 }
 
+static void flush_packets(AVFormatContext *s)
+{
+    MpegTSWrite *ts = s->priv_data;
+
+    if (ts->out_len > 0)
+        avio_write(s->pb, ts->out_buf, ts->out_len);
+    ts->out_len = 0;
+}
+
+/**
+ * Make room for nb_packets TS packets in the output block, writing out
+ * its content if needed.
+ *
+ * @return 0 if the block could not be allocated, 1 otherwise
+ */
+static int reserve_packets(AVFormatContext *s, int nb_packets)
+{
+    MpegTSWrite *ts = s->priv_data;
+    int64_t size = (int64_t)nb_packets * ts->packet_size;
+
+    if (ts->out_len + size <= ts->out_buf_size)
+        return 1;
+    flush_packets(s);
+    if (size > ts->out_buf_size) {
+        size = FFMAX(size, OUT_BUF_MIN_PACKETS * ts->packet_size);
+        if (size > INT_MAX)
+            size = ts->packet_size;
+        av_fast_malloc(&ts->out_buf, &ts->out_buf_size, size);
+    }
+    return !!ts->out_buf;
+}
+
+/* Get the place of the next TS packet in the output block, so that it is
+ * built in place; fallback is used if the block is not available. */
+static uint8_t *get_packet_buf(AVFormatContext *s, uint8_t *fallback)
+{
+    MpegTSWrite *ts = s->priv_data;
+
+    if (!reserve_packets(s, 1))
+        return fallback;
+    return ts->out_buf + ts->out_len + ts->packet_size - TS_PACKET_SIZE;
+}
+
 static void write_packet(AVFormatContext *s, const uint8_t *packet)
 {
     MpegTSWrite *ts = s->priv_data;
+    uint8_t tp_extra_header[4];
+
     if (ts->m2ts_mode) {
         int64_t pcr = get_pcr(s->priv_data);
-        uint32_t tp_extra_header = pcr % 0x3fffffff;
-        tp_extra_header = AV_RB32(&tp_extra_header);
-        avio_write(s->pb, (unsigned char *) &tp_extra_header,
-                   sizeof(tp_extra_header));
+        AV_WB32(tp_extra_header, pcr % 0x3fffffff);
+    }
+    if (reserve_packets(s, 1)) {
+        uint8_t *dst = ts->out_buf + ts->out_len;
+        if (ts->m2ts_mode) {
+            memcpy(dst, tp_extra_header, sizeof(tp_extra_header));
+            dst += sizeof(tp_extra_header);
+        }
+        if (dst != packet)
+            memcpy(dst, packet, TS_PACKET_SIZE);
+        ts->out_len += ts->packet_size;
+    } else {
+        if (ts->m2ts_mode)
+            avio_write(s->pb, tp_extra_header, sizeof(tp_extra_header));
+        avio_write(s->pb, packet, TS_PACKET_SIZE);
     }
-    avio_write(s->pb, packet, TS_PACKET_SIZE);
     ts->total_size += TS_PACKET_SIZE;
 }
 
@@ -963,6 +1036,52 @@ static void select_pcr_streams(AVFormatContext *s)
     }
 }
 
+static void init_header_templates(AVFormatContext *s, AVStream *st)
+{
+    MpegTSWrite *ts = s->priv_data;
+    MpegTSWriteStream *ts_st = st->priv_data;
+    enum AVMediaType type = st->codecpar->codec_type;
+    enum AVCodecID codec_id = st->codecpar->codec_id;
+
+    ts_st->ts_header[0] = ts_st->pid >> 8;
+    if (ts->m2ts_mode && codec_id == AV_CODEC_ID_AC3)
+        ts_st->ts_header[0] |= 0x20;
+    ts_st->ts_header[1] = ts_st->pid;
+
+    if (type == AVMEDIA_TYPE_VIDEO) {
+        if (codec_id == AV_CODEC_ID_DIRAC)
+            ts_st->pes_stream_id = STREAM_ID_EXTENDED_STREAM_ID;
+        else
+            ts_st->pes_stream_id = STREAM_ID_VIDEO_STREAM_0;
+    } else if (type == AVMEDIA_TYPE_AUDIO &&
+               (codec_id == AV_CODEC_ID_MP2 ||
+                codec_id == AV_CODEC_ID_MP3 ||
+                codec_id == AV_CODEC_ID_AAC)) {
+        ts_st->pes_stream_id = STREAM_ID_AUDIO_STREAM_0;
+    } else if (type == AVMEDIA_TYPE_AUDIO &&
+               codec_id == AV_CODEC_ID_AC3 &&
+               ts->m2ts_mode) {
+        ts_st->pes_stream_id = STREAM_ID_EXTENDED_STREAM_ID;
+    } else if (type == AVMEDIA_TYPE_DATA &&
+               codec_id == AV_CODEC_ID_TIMED_ID3) {
+        ts_st->pes_stream_id = STREAM_ID_PRIVATE_STREAM_1;
+    } else if (type == AVMEDIA_TYPE_DATA) {
+        ts_st->pes_stream_id   = STREAM_ID_METADATA_STREAM;
+        ts_st->pes_data_stream = 1;
+    } else {
+        ts_st->pes_stream_id = STREAM_ID_PRIVATE_STREAM_1;
+        if (type == AVMEDIA_TYPE_SUBTITLE) {
+            if (codec_id == AV_CODEC_ID_DVB_SUBTITLE) {
+                ts_st->is_dvb_subtitle = 1;
+            } else if (codec_id == AV_CODEC_ID_DVB_TELETEXT) {
+                ts_st->is_dvb_teletext = 1;
+            }
+        }
+    }
+    /* data alignment indicator is required for subtitle and data streams */
+    ts_st->pes_data_alignment = type == AVMEDIA_TYPE_SUBTITLE || type == AVMEDIA_TYPE_DATA;
+}
+
 static int mpegts_init(AVFormatContext *s)
 {
     MpegTSWrite *ts = s->priv_data;
@@ -977,6 +1096,8 @@ static int mpegts_init(AVFormatContext *s)
         }
     }
 
+    ts->packet_size = TS_PACKET_SIZE + (ts->m2ts_mode ? 4 : 0);
+
     ts->m2ts_video_pid   = M2TS_VIDEO_PID;
     ts->m2ts_audio_pid   = M2TS_AUDIO_START_PID;
     ts->m2ts_pgssub_pid  = M2TS_PGSSUB_START_PID;
@@ -1103,6 +1224,7 @@ static int mpegts_init(AVFormatContext *s)
         ts_st->payload_dts     = AV_NOPTS_VALUE;
         ts_st->cc              = 15;
         ts_st->discontinuity   = ts->flags & MPEGTS_FLAG_DISCONT;
+        init_header_templates(s, st);
         if (st->codecpar->codec_id == AV_CODEC_ID_AAC &&
             st->codecpar->extradata_size > 0) {
             AVStream *ast;
@@ -1197,7 +1319,8 @@ static int write_pcr_bits(uint8_t *buf, int64_t pcr)
 static void mpegts_insert_null_packet(AVFormatContext *s)
 {
     uint8_t *q;
-    uint8_t buf[TS_PACKET_SIZE];
+    uint8_t stack_buf[TS_PACKET_SIZE];
+    uint8_t *buf = get_packet_buf(s, stack_buf);
 
     q    = buf;
     *q++ = 0x47;
@@ -1214,7 +1337,8 @@ static void mpegts_insert_pcr_only(AVFormatContext *s, AVStream *st)
     MpegTSWrite *ts = s->priv_data;
     MpegTSWriteStream *ts_st = st->priv_data;
     uint8_t *q;
-    uint8_t buf[TS_PACKET_SIZE];
+    uint8_t stack_buf[TS_PACKET_SIZE];
+    uint8_t *buf = get_packet_buf(s, stack_buf);
 
     q    = buf;
     *q++ = 0x47;
@@ -1294,15 +1418,16 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
 {
     MpegTSWriteStream *ts_st = st->priv_data;
     MpegTSWrite *ts = s->priv_data;
-    uint8_t buf[TS_PACKET_SIZE];
-    uint8_t *q;
-    int val, is_start, len, header_len, write_pcr, is_dvb_subtitle, is_dvb_teletext, flags;
+    uint8_t stack_buf[TS_PACKET_SIZE];
+    uint8_t *buf, *q;
+    int val, is_start, len, header_len, write_pcr, flags;
+    int is_dvb_subtitle = ts_st->is_dvb_subtitle;
+    int is_dvb_teletext = ts_st->is_dvb_teletext;
     int afc_len, stuffing_len;
     int64_t delay = av_rescale(s->max_delay, 90000, AV_TIME_BASE);
     int force_pat = st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && key && !ts_st->prev_payload_key;
     int force_sdt = 0;
 
-    av_assert0(ts_st->payload != buf || st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO);
     if (ts->flags & MPEGTS_FLAG_PAT_PMT_AT_FRAMES && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
         force_pat = 1;
     }
@@ -1313,6 +1438,9 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
         ts->flags &= ~MPEGTS_FLAG_REEMIT_PAT_PMT;
     }
 
+    /* room for the whole PES, the tables and a few PCR packets */
+    reserve_packets(s, payload_size / (TS_PACKET_SIZE - 4 - 8) + 8 + ts->nb_services);
+
     is_start = 1;
     while (payload_size > 0) {
         int64_t pcr = AV_NOPTS_VALUE;
@@ -1369,15 +1497,14 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
         }
 
         /* prepare packet header */
+        buf  = get_packet_buf(s, stack_buf);
         q    = buf;
         *q++ = 0x47;
-        val  = ts_st->pid >> 8;
-        if (ts->m2ts_mode && st->codecpar->codec_id == AV_CODEC_ID_AC3)
-            val |= 0x20;
+        val  = ts_st->ts_header[0];
         if (is_start)
             val |= 0x40;
         *q++      = val;
-        *q++      = ts_st->pid;
+        *q++      = ts_st->ts_header[1];
         ts_st->cc = ts_st->cc + 1 & 0xf;
         *q++      = 0x10 | ts_st->cc; // payload indicator + CC
         if (ts_st->discontinuity) {
@@ -1408,39 +1535,13 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
             *q++ = 0x00;
             *q++ = 0x00;
             *q++ = 0x01;
-            is_dvb_subtitle = 0;
-            is_dvb_teletext = 0;
-            if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-                if (st->codecpar->codec_id == AV_CODEC_ID_DIRAC)
-                    *q++ = STREAM_ID_EXTENDED_STREAM_ID;
-                else
-                    *q++ = STREAM_ID_VIDEO_STREAM_0;
-            } else if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
-                       (st->codecpar->codec_id == AV_CODEC_ID_MP2 ||
-                        st->codecpar->codec_id == AV_CODEC_ID_MP3 ||
-                        st->codecpar->codec_id == AV_CODEC_ID_AAC)) {
-                *q++ = STREAM_ID_AUDIO_STREAM_0;
-            } else if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
-                        st->codecpar->codec_id == AV_CODEC_ID_AC3 &&
-                        ts->m2ts_mode) {
-                *q++ = STREAM_ID_EXTENDED_STREAM_ID;
-            } else if (st->codecpar->codec_type == AVMEDIA_TYPE_DATA &&
-                       st->codecpar->codec_id == AV_CODEC_ID_TIMED_ID3) {
-                *q++ = STREAM_ID_PRIVATE_STREAM_1;
-            } else if (st->codecpar->codec_type == AVMEDIA_TYPE_DATA) {
-                *q++ = stream_id != -1 ? stream_id : STREAM_ID_METADATA_STREAM;
+            if (ts_st->pes_data_stream && stream_id != -1) {
+                *q++ = stream_id;
 
                 if (stream_id == STREAM_ID_PRIVATE_STREAM_1) /* asynchronous KLV */
                     pts = dts = AV_NOPTS_VALUE;
             } else {
-                *q++ = STREAM_ID_PRIVATE_STREAM_1;
-                if (st->codecpar->codec_type == AVMEDIA_TYPE_SUBTITLE) {
-                    if (st->codecpar->codec_id == AV_CODEC_ID_DVB_SUBTITLE) {
-                        is_dvb_subtitle = 1;
-                    } else if (st->codecpar->codec_id == AV_CODEC_ID_DVB_TELETEXT) {
-                        is_dvb_teletext = 1;
-                    }
-                }
+                *q++ = ts_st->pes_stream_id;
             }
             header_len = 0;
             flags      = 0;
@@ -1492,8 +1593,7 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
             *q++ = len >> 8;
             *q++ = len;
             val  = 0x80;
-            /* data alignment indicator is required for subtitle and data streams */
-            if (st->codecpar->codec_type == AVMEDIA_TYPE_SUBTITLE || st->codecpar->codec_type == AVMEDIA_TYPE_DATA)
+            if (ts_st->pes_data_alignment)
                 val |= 0x04;
             *q++ = val;
             *q++ = flags;
@@ -1578,6 +1678,7 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
         payload_size -= len;
         write_packet(s, buf);
     }
+    flush_packets(s);
     ts_st->prev_payload_key = key;
 }
 
@@ -1993,6 +2094,7 @@ static void mpegts_write_flush(AVFormatContext *s)
         int packets = (avio_tell(s->pb) / (TS_PACKET_SIZE + 4)) % 32;
         while (packets++ < 32)
             mpegts_insert_null_packet(s);
+        flush_packets(s);
     }
 }
 
@@ -2038,6 +2140,7 @@ static void mpegts_deinit(AVFormatContext *s)
         av_freep(&service);
     }
     av_freep(&ts->services);
+    av_freep(&ts->out_buf);
 }
 
 static int mpegts_check_bitstream(struct AVFormatContext *s, const AVPacket *pkt)
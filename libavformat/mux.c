@@ -26,6 +26,7 @@
 #include "libavutil/dict.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/timestamp.h"
+#include "libavutil/trace.h"
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/internal.h"
@@ -679,6 +680,7 @@ static void guess_pkt_duration(AVFormatContext *s, AVStream *st, AVPacket *pkt)
  */
 static int write_packet(AVFormatContext *s, AVPacket *pkt)
 {
+    void *mem_tag;
     int ret;
 
     // If the timestamp offsetting below is adjusted, adjust
@@ -740,6 +742,8 @@ static int write_packet(AVFormatContext *s, AVPacket *pkt)
         }
     }
 
+    mem_tag = av_mem_tag_enter(s);
+    av_trace_begin("mux", s->oformat->name);
     if ((pkt->flags & AV_PKT_FLAG_UNCODED_FRAME)) {
         AVFrame **frame = (AVFrame **)pkt->data;
         av_assert0(pkt->size == sizeof(*frame));
@@ -747,6 +751,8 @@ static int write_packet(AVFormatContext *s, AVPacket *pkt)
     } else {
         ret = s->oformat->write_packet(s, pkt);
     }
+    av_trace_end("mux", s->oformat->name);
+    av_mem_tag_leave(mem_tag);
 
     if (s->pb && ret >= 0) {
         flush_if_needed(s);
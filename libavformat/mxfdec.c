@@ -53,6 +53,7 @@
 #include "libavcodec/bytestream.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/qsort.h"
 #include "libavutil/timecode.h"
 #include "libavutil/opt.h"
 #include "avformat.h"
@@ -104,8 +105,15 @@ typedef struct MXFPartition {
     int64_t pack_ofs;               ///< absolute offset of pack in file, including run-in
     int64_t body_offset;
     KLVPacket first_essence_klv;
+    int64_t index_ofs;              ///< absolute offset of the index table segments if they were skipped
+    int pack_skipped;               ///< partition known only from the RIP, pack not parsed
 } MXFPartition;
 
+typedef struct MXFRandomIndexEntry {
+    int body_sid;
+    uint64_t offset;                ///< ThisPartition, not including run-in
+} MXFRandomIndexEntry;
+
 typedef struct MXFCryptoContext {
     UID uid;
     enum MXFMetadataSetType type;
@@ -272,7 +280,9 @@ typedef struct MXFIndexTable {
     int64_t *ptses;             /* maps EditUnit -> PTS */
     int nb_segments;
     MXFIndexTableSegment **segments;    /* sorted by IndexStartPosition */
-    AVIndexEntry *fake_index;   /* used for calling ff_index_search_timestamp() */
+    int64_t *segment_ends;      /* running maximum of the segment end positions, for binary search */
+    int64_t *segment_offsets;   /* stream offset at the start of each segment for CBR segments */
+    uint8_t *fake_index_flags;  /* keyframe flags of edit units in display order */
     int8_t *offsets;            /* temporal offsets for display order to stored order conversion */
 } MXFIndexTable;
 
@@ -300,6 +310,9 @@ typedef struct MXFContext {
     int last_forward_partition;
     int nb_index_tables;
     MXFIndexTable *index_tables;
+    MXFRandomIndexEntry *random_index;
+    int random_index_count;
+    int skipped_index_partitions;
     int eia608_extract;
 } MXFContext;
 
@@ -328,6 +341,7 @@ static const uint8_t mxf_apple_coll_prefix[]               = { 0x06,0x0e,0x2b,0x
 static const uint8_t mxf_crypto_source_container_ul[]      = { 0x06,0x0e,0x2b,0x34,0x01,0x01,0x01,0x09,0x06,0x01,0x01,0x02,0x02,0x00,0x00,0x00 };
 static const uint8_t mxf_encrypted_triplet_key[]           = { 0x06,0x0e,0x2b,0x34,0x02,0x04,0x01,0x07,0x0d,0x01,0x03,0x01,0x02,0x7e,0x01,0x00 };
 static const uint8_t mxf_encrypted_essence_container[]     = { 0x06,0x0e,0x2b,0x34,0x04,0x01,0x01,0x07,0x0d,0x01,0x03,0x01,0x02,0x0b,0x01,0x00 };
+static const uint8_t mxf_index_table_segment_key[]         = { 0x06,0x0e,0x2b,0x34,0x02,0x53,0x01,0x01,0x0d,0x01,0x02,0x01,0x01,0x10,0x01,0x00 };
 static const uint8_t mxf_random_index_pack_key[]           = { 0x06,0x0e,0x2b,0x34,0x02,0x05,0x01,0x01,0x0d,0x01,0x02,0x01,0x01,0x11,0x01,0x00 };
 static const uint8_t mxf_sony_mpeg4_extradata[]            = { 0x06,0x0e,0x2b,0x34,0x04,0x01,0x01,0x01,0x0e,0x06,0x06,0x02,0x02,0x01,0x00,0x00 };
 static const uint8_t mxf_avid_project_name[]               = { 0xa5,0xfb,0x7b,0x25,0xf6,0x15,0x94,0xb9,0x62,0xfc,0x37,0x17,0x49,0x2d,0x42,0xbf };
@@ -668,21 +682,13 @@ static int mxf_read_primer_pack(void *arg, AVIOContext *pb, int tag, int size, U
     return 0;
 }
 
-static int mxf_read_partition_pack(void *arg, AVIOContext *pb, int tag, int size, UID uid, int64_t klv_offset)
+static MXFPartition *mxf_add_partition(MXFContext *mxf)
 {
-    MXFContext *mxf = arg;
-    AVFormatContext *s = mxf->fc;
     MXFPartition *partition, *tmp_part;
-    UID op;
-    uint64_t footer_partition;
-    uint32_t nb_essence_containers;
-
-    if (mxf->partitions_count >= INT_MAX / 2)
-        return AVERROR_INVALIDDATA;
 
     tmp_part = av_realloc_array(mxf->partitions, mxf->partitions_count + 1, sizeof(*mxf->partitions));
     if (!tmp_part)
-        return AVERROR(ENOMEM);
+        return NULL;
     mxf->partitions = tmp_part;
 
     if (mxf->parsing_backward) {
@@ -691,14 +697,32 @@ static int mxf_read_partition_pack(void *arg, AVIOContext *pb, int tag, int size
         memmove(&mxf->partitions[mxf->last_forward_partition+1],
                 &mxf->partitions[mxf->last_forward_partition],
                 (mxf->partitions_count - mxf->last_forward_partition)*sizeof(*mxf->partitions));
-        partition = mxf->current_partition = &mxf->partitions[mxf->last_forward_partition];
+        partition = &mxf->partitions[mxf->last_forward_partition];
     } else {
         mxf->last_forward_partition++;
-        partition = mxf->current_partition = &mxf->partitions[mxf->partitions_count];
+        partition = &mxf->partitions[mxf->partitions_count];
     }
 
     memset(partition, 0, sizeof(*partition));
     mxf->partitions_count++;
+    return partition;
+}
+
+static int mxf_read_partition_pack(void *arg, AVIOContext *pb, int tag, int size, UID uid, int64_t klv_offset)
+{
+    MXFContext *mxf = arg;
+    AVFormatContext *s = mxf->fc;
+    MXFPartition *partition;
+    UID op;
+    uint64_t footer_partition;
+    uint32_t nb_essence_containers;
+
+    if (mxf->partitions_count >= INT_MAX / 2)
+        return AVERROR_INVALIDDATA;
+
+    partition = mxf->current_partition = mxf_add_partition(mxf);
+    if (!partition)
+        return AVERROR(ENOMEM);
     partition->pack_length = avio_tell(pb) - klv_offset + size;
     partition->pack_ofs    = klv_offset;
 
@@ -1499,11 +1523,29 @@ static MXFWrappingScheme mxf_get_wrapping_kind(UID *essence_container_ul)
     return UnknownWrapped;
 }
 
+/**
+ * Orders index table segments by {BodySID, IndexSID, IndexStartPosition},
+ * putting the segment with the largest IndexDuration first among those
+ * starting at the same position.
+ */
+static int mxf_compare_index_segments(const void *a, const void *b)
+{
+    const MXFIndexTableSegment *s1 = *(const MXFIndexTableSegment *const *)a;
+    const MXFIndexTableSegment *s2 = *(const MXFIndexTableSegment *const *)b;
+
+    if (s1->body_sid != s2->body_sid)
+        return FFDIFFSIGN(s1->body_sid, s2->body_sid);
+    if (s1->index_sid != s2->index_sid)
+        return FFDIFFSIGN(s1->index_sid, s2->index_sid);
+    if (s1->index_start_position != s2->index_start_position)
+        return FFDIFFSIGN(s1->index_start_position, s2->index_start_position);
+    return FFDIFFSIGN(s2->index_duration, s1->index_duration);
+}
+
 static int mxf_get_sorted_table_segments(MXFContext *mxf, int *nb_sorted_segments, MXFIndexTableSegment ***sorted_segments)
 {
-    int i, j, nb_segments = 0;
-    MXFIndexTableSegment **unsorted_segments;
-    int last_body_sid = -1, last_index_sid = -1, last_index_start = -1;
+    int i, nb_segments = 0;
+    MXFIndexTableSegment **segments;
 
     /* count number of segments, allocate arrays and copy unsorted segments */
     for (i = 0; i < mxf->metadata_sets_count; i++)
@@ -1513,18 +1555,14 @@ static int mxf_get_sorted_table_segments(MXFContext *mxf, int *nb_sorted_segment
     if (!nb_segments)
         return AVERROR_INVALIDDATA;
 
-    if (!(unsorted_segments = av_calloc(nb_segments, sizeof(*unsorted_segments))) ||
-        !(*sorted_segments  = av_calloc(nb_segments, sizeof(**sorted_segments)))) {
-        av_freep(sorted_segments);
-        av_free(unsorted_segments);
+    if (!(segments = *sorted_segments = av_calloc(nb_segments, sizeof(**sorted_segments))))
         return AVERROR(ENOMEM);
-    }
 
     for (i = nb_segments = 0; i < mxf->metadata_sets_count; i++) {
         if (mxf->metadata_sets[i]->type == IndexTableSegment) {
             MXFIndexTableSegment *s = (MXFIndexTableSegment*)mxf->metadata_sets[i];
             if (s->edit_unit_byte_count || s->nb_index_entries)
-                unsorted_segments[nb_segments++] = s;
+                segments[nb_segments++] = s;
             else
                 av_log(mxf->fc, AV_LOG_WARNING, "IndexSID %i segment at %"PRId64" missing EditUnitByteCount and IndexEntryArray\n",
                        s->index_sid, s->index_start_position);
@@ -1533,53 +1571,26 @@ static int mxf_get_sorted_table_segments(MXFContext *mxf, int *nb_sorted_segment
 
     if (!nb_segments) {
         av_freep(sorted_segments);
-        av_free(unsorted_segments);
         return AVERROR_INVALIDDATA;
     }
 
-    *nb_sorted_segments = 0;
-
     /* sort segments by {BodySID, IndexSID, IndexStartPosition}, remove duplicates while we're at it */
-    for (i = 0; i < nb_segments; i++) {
-        int best = -1, best_body_sid = -1, best_index_sid = -1, best_index_start = -1;
-        uint64_t best_index_duration = 0;
-
-        for (j = 0; j < nb_segments; j++) {
-            MXFIndexTableSegment *s = unsorted_segments[j];
+    AV_QSORT(segments, nb_segments, MXFIndexTableSegment*, mxf_compare_index_segments);
 
-            /* Require larger BosySID, IndexSID or IndexStartPosition then the previous entry. This removes duplicates.
-             * We want the smallest values for the keys than what we currently have, unless this is the first such entry this time around.
-             * If we come across an entry with the same IndexStartPosition but larger IndexDuration, then we'll prefer it over the one we currently have.
-             */
-            if ((i == 0 ||
-                 s->body_sid >  last_body_sid ||
-                 s->body_sid == last_body_sid && s->index_sid >  last_index_sid ||
-                 s->body_sid == last_body_sid && s->index_sid == last_index_sid && s->index_start_position > last_index_start) &&
-                (best == -1 ||
-                 s->body_sid <  best_body_sid ||
-                 s->body_sid == best_body_sid && s->index_sid <  best_index_sid ||
-                 s->body_sid == best_body_sid && s->index_sid == best_index_sid && s->index_start_position <  best_index_start ||
-                 s->body_sid == best_body_sid && s->index_sid == best_index_sid && s->index_start_position == best_index_start && s->index_duration > best_index_duration)) {
-                best             = j;
-                best_body_sid    = s->body_sid;
-                best_index_sid   = s->index_sid;
-                best_index_start = s->index_start_position;
-                best_index_duration = s->index_duration;
-            }
-        }
+    *nb_sorted_segments = 0;
+    for (i = 0; i < nb_segments; i++) {
+        MXFIndexTableSegment *s = segments[i];
+        MXFIndexTableSegment *last = *nb_sorted_segments ? segments[*nb_sorted_segments - 1] : NULL;
 
-        /* no suitable entry found -> we're done */
-        if (best == -1)
-            break;
+        /* keep the longest of the segments starting at the same position */
+        if (last && s->body_sid             == last->body_sid  &&
+                    s->index_sid            == last->index_sid &&
+                    s->index_start_position == last->index_start_position)
+            continue;
 
-        (*sorted_segments)[(*nb_sorted_segments)++] = unsorted_segments[best];
-        last_body_sid    = best_body_sid;
-        last_index_sid   = best_index_sid;
-        last_index_start = best_index_start;
+        segments[(*nb_sorted_segments)++] = s;
     }
 
-    av_free(unsorted_segments);
-
     return 0;
 }
 
@@ -1649,48 +1660,84 @@ static int64_t mxf_essence_container_end(MXFContext *mxf, int body_sid)
 /* EditUnit -> absolute offset */
 static int mxf_edit_unit_absolute_offset(MXFContext *mxf, MXFIndexTable *index_table, int64_t edit_unit, AVRational edit_rate, int64_t *edit_unit_out, int64_t *offset_out, MXFPartition **partition_out, int nag)
 {
-    int i;
-    int64_t offset_temp = 0;
+    MXFIndexTableSegment *s;
+    int64_t index, offset_temp;
+    int a, b, m;
 
     edit_unit = av_rescale_q(edit_unit, index_table->segments[0]->index_edit_rate, edit_rate);
 
-    for (i = 0; i < index_table->nb_segments; i++) {
-        MXFIndexTableSegment *s = index_table->segments[i];
+    /* find the first segment ending after edit_unit */
+    a = -1;
+    b = index_table->nb_segments;
 
-        edit_unit = FFMAX(edit_unit, s->index_start_position);  /* clamp if trying to seek before start */
+    while (b - a > 1) {
+        m = (a + b) >> 1;
+        if (edit_unit < index_table->segment_ends[m])
+            b = m;
+        else
+            a = m;
+    }
 
-        if (edit_unit < s->index_start_position + s->index_duration) {
-            int64_t index = edit_unit - s->index_start_position;
+    if (edit_unit < 0 || b == index_table->nb_segments) {
+        if (nag)
+            av_log(mxf->fc, AV_LOG_ERROR, "failed to map EditUnit %"PRId64" in IndexSID %i to an offset\n", edit_unit, index_table->index_sid);
+        return AVERROR_INVALIDDATA;
+    }
 
-            if (s->edit_unit_byte_count)
-                offset_temp += s->edit_unit_byte_count * index;
-            else {
-                if (s->nb_index_entries == 2 * s->index_duration + 1)
-                    index *= 2;     /* Avid index */
+    s = index_table->segments[b];
+    edit_unit = FFMAX(edit_unit, s->index_start_position);  /* clamp if trying to seek before start */
+    index = edit_unit - s->index_start_position;
 
-                if (index < 0 || index >= s->nb_index_entries) {
-                    av_log(mxf->fc, AV_LOG_ERROR, "IndexSID %i segment at %"PRId64" IndexEntryArray too small\n",
-                           index_table->index_sid, s->index_start_position);
-                    return AVERROR_INVALIDDATA;
-                }
+    if (s->edit_unit_byte_count)
+        offset_temp = index_table->segment_offsets[b] + s->edit_unit_byte_count * index;
+    else {
+        if (s->nb_index_entries == 2 * s->index_duration + 1)
+            index *= 2;     /* Avid index */
 
-                offset_temp = s->stream_offset_entries[index];
-            }
+        if (index < 0 || index >= s->nb_index_entries) {
+            av_log(mxf->fc, AV_LOG_ERROR, "IndexSID %i segment at %"PRId64" IndexEntryArray too small\n",
+                   index_table->index_sid, s->index_start_position);
+            return AVERROR_INVALIDDATA;
+        }
 
-            if (edit_unit_out)
-                *edit_unit_out = av_rescale_q(edit_unit, edit_rate, s->index_edit_rate);
+        offset_temp = s->stream_offset_entries[index];
+    }
 
-            return mxf_absolute_bodysid_offset(mxf, index_table->body_sid, offset_temp, offset_out, partition_out);
-        } else {
-            /* EditUnitByteCount == 0 for VBR indexes, which is fine since they use explicit StreamOffsets */
-            offset_temp += s->edit_unit_byte_count * s->index_duration;
-        }
+    if (edit_unit_out)
+        *edit_unit_out = av_rescale_q(edit_unit, edit_rate, s->index_edit_rate);
+
+    return mxf_absolute_bodysid_offset(mxf, index_table->body_sid, offset_temp, offset_out, partition_out);
+}
+
+/**
+ * Computes the lookup tables used by mxf_edit_unit_absolute_offset() to find
+ * the segment containing an edit unit with a binary search.
+ */
+static int mxf_compute_segment_map(MXFIndexTable *index_table)
+{
+    int64_t end = 0, offset = 0;
+    int i;
+
+    if (!(index_table->segment_ends    = av_malloc_array(index_table->nb_segments, sizeof(*index_table->segment_ends))) ||
+        !(index_table->segment_offsets = av_malloc_array(index_table->nb_segments, sizeof(*index_table->segment_offsets)))) {
+        av_freep(&index_table->segment_ends);
+        return AVERROR(ENOMEM);
     }
 
-    if (nag)
-        av_log(mxf->fc, AV_LOG_ERROR, "failed to map EditUnit %"PRId64" in IndexSID %i to an offset\n", edit_unit, index_table->index_sid);
+    for (i = 0; i < index_table->nb_segments; i++) {
+        MXFIndexTableSegment *s = index_table->segments[i];
+
+        /* empty segments never contain the edit unit searched for */
+        if (s->index_duration)
+            end = FFMAX(end, s->index_start_position + s->index_duration);
+        index_table->segment_ends[i] = end;
 
-    return AVERROR_INVALIDDATA;
+        /* EditUnitByteCount == 0 for VBR indexes, which is fine since they use explicit StreamOffsets */
+        index_table->segment_offsets[i] = offset;
+        offset += s->edit_unit_byte_count * s->index_duration;
+    }
+
+    return 0;
 }
 
 static int mxf_compute_ptses_fake_index(MXFContext *mxf, MXFIndexTable *index_table)
@@ -1721,12 +1768,12 @@ static int mxf_compute_ptses_fake_index(MXFContext *mxf, MXFIndexTable *index_ta
     if (index_table->nb_ptses <= 0)
         return 0;
 
-    if (!(index_table->ptses      = av_calloc(index_table->nb_ptses, sizeof(int64_t))) ||
-        !(index_table->fake_index = av_calloc(index_table->nb_ptses, sizeof(AVIndexEntry))) ||
-        !(index_table->offsets    = av_calloc(index_table->nb_ptses, sizeof(int8_t))) ||
-        !(flags                   = av_calloc(index_table->nb_ptses, sizeof(uint8_t)))) {
+    if (!(index_table->ptses            = av_calloc(index_table->nb_ptses, sizeof(int64_t))) ||
+        !(index_table->fake_index_flags = av_calloc(index_table->nb_ptses, sizeof(uint8_t))) ||
+        !(index_table->offsets          = av_calloc(index_table->nb_ptses, sizeof(int8_t))) ||
+        !(flags                         = av_calloc(index_table->nb_ptses, sizeof(uint8_t)))) {
         av_freep(&index_table->ptses);
-        av_freep(&index_table->fake_index);
+        av_freep(&index_table->fake_index_flags);
         av_freep(&index_table->offsets);
         return AVERROR(ENOMEM);
     }
@@ -1800,12 +1847,11 @@ static int mxf_compute_ptses_fake_index(MXFContext *mxf, MXFIndexTable *index_ta
         }
     }
 
-    /* calculate the fake index table in display order */
-    for (x = 0; x < index_table->nb_ptses; x++) {
-        index_table->fake_index[x].timestamp = x;
+    /* calculate the fake index table in display order,
+     * entry x has the timestamp x so only the flags need to be stored */
+    for (x = 0; x < index_table->nb_ptses; x++)
         if (index_table->ptses[x] != AV_NOPTS_VALUE)
-            index_table->fake_index[index_table->ptses[x]].flags = flags[x];
-    }
+            index_table->fake_index_flags[index_table->ptses[x]] = flags[x];
     av_freep(&flags);
 
     index_table->first_dts = -max_temporal_offset;
@@ -1917,6 +1963,9 @@ static int mxf_compute_index_tables(MXFContext *mxf)
             t->segments[k]->index_duration = mxf_track->original_duration;
             break;
         }
+
+        if ((ret = mxf_compute_segment_map(t)) < 0)
+            goto finish_decoding_index;
     }
 
     ret = 0;
@@ -2956,6 +3005,73 @@ static int mxf_parse_klv(MXFContext *mxf, KLVPacket klv, MXFMetadataReadFunc *re
     return 0;
 }
 
+/**
+ * Skips the partitions listed in the RIP without essence, starting at
+ * *partition_ofs and going backward. Such partitions only hold index table
+ * segments, which are read by mxf_read_skipped_index_segments() if needed.
+ * @return <= 0 if we should stop parsing, > 0 if we should keep going
+ */
+static int mxf_skip_index_partitions(MXFContext *mxf, uint64_t *partition_ofs)
+{
+    for (;;) {
+        MXFPartition *partition;
+        int a = -1, b = mxf->random_index_count, m;
+
+        while (b - a > 1) {
+            m = (a + b) >> 1;
+            if (mxf->random_index[m].offset <= *partition_ofs)
+                a = m;
+            else
+                b = m;
+        }
+
+        /* never skip the header partition */
+        if (a <= 0 || mxf->random_index[a].offset != *partition_ofs ||
+            mxf->random_index[a].body_sid)
+            return 1;
+
+        if (!(partition = mxf_add_partition(mxf)))
+            return AVERROR(ENOMEM);
+        partition->type           = BodyPartition;
+        partition->this_partition = *partition_ofs;
+        partition->pack_ofs       = mxf->run_in + *partition_ofs;
+        partition->pack_skipped   = 1;
+        mxf->skipped_index_partitions++;
+
+        *partition_ofs = mxf->random_index[a - 1].offset;
+        if (mxf->run_in + *partition_ofs <= mxf->last_forward_tell)
+            return 0;
+    }
+}
+
+/**
+ * Skips the index table segments of a body partition parsed backward, the
+ * footer usually repeats them. They are read by
+ * mxf_read_skipped_index_segments() if the index turns out to be incomplete.
+ * @return 1 if the segments were skipped, 0 if they should be parsed
+ */
+static int mxf_skip_index_segments(MXFContext *mxf, KLVPacket *klv)
+{
+    AVIOContext *pb = mxf->fc->pb;
+    MXFPartition *partition = mxf->current_partition;
+    int64_t end = klv->offset + partition->index_byte_count;
+
+    if (partition->type != BodyPartition || partition->index_ofs ||
+        partition->index_byte_count <= 0 || end < klv->next_klv)
+        return 0;
+
+    /* only trust IndexByteCount if a KLV follows the segments */
+    if (avio_seek(pb, end, SEEK_SET) < 0 || avio_rb32(pb) != AV_RB32(mxf_klv_key)) {
+        avio_seek(pb, klv->next_klv - klv->length, SEEK_SET);
+        return 0;
+    }
+
+    avio_seek(pb, end, SEEK_SET);
+    partition->index_ofs = klv->offset;
+    mxf->skipped_index_partitions++;
+    return 1;
+}
+
 /**
  * Seeks to the previous partition and parses it, if possible
  * @return <= 0 if we should stop parsing, > 0 if we should keep going
@@ -2965,17 +3081,23 @@ static int mxf_seek_to_previous_partition(MXFContext *mxf)
     AVIOContext *pb = mxf->fc->pb;
     KLVPacket klv;
     int64_t current_partition_ofs;
+    uint64_t previous_partition;
     int ret;
 
     if (!mxf->current_partition ||
         mxf->run_in + mxf->current_partition->previous_partition <= mxf->last_forward_tell)
         return 0;   /* we've parsed all partitions */
 
-    /* seek to previous partition */
     current_partition_ofs = mxf->current_partition->pack_ofs;   //includes run-in
-    avio_seek(pb, mxf->run_in + mxf->current_partition->previous_partition, SEEK_SET);
+    previous_partition    = mxf->current_partition->previous_partition;
     mxf->current_partition = NULL;
 
+    if (mxf->random_index && (ret = mxf_skip_index_partitions(mxf, &previous_partition)) <= 0)
+        return ret;
+
+    /* seek to previous partition */
+    avio_seek(pb, mxf->run_in + previous_partition, SEEK_SET);
+
     av_log(mxf->fc, AV_LOG_TRACE, "seeking to previous partition\n");
 
     /* Make sure this is actually a PartitionPack, and if so parse it.
@@ -3230,12 +3352,146 @@ static int mxf_handle_missing_index_segment(MXFContext *mxf, AVStream *st)
     return 0;
 }
 
+/**
+ * Checks whether the index table segments read so far cover all edit units
+ * of the tracks using the given IndexSID.
+ * @return 1 if they do, 0 if not, <0 on error
+ */
+static int mxf_index_covers_tracks(MXFContext *mxf, int index_sid)
+{
+    MXFIndexTableSegment **segments;
+    AVRational edit_rate = { 0, 0 };
+    int64_t covered = 0;
+    int i, nb_segments = 0, ret = 1;
+
+    for (i = 0; i < mxf->metadata_sets_count; i++)
+        if (mxf->metadata_sets[i]->type == IndexTableSegment)
+            nb_segments++;
+
+    if (!(segments = av_calloc(nb_segments, sizeof(*segments))))
+        return nb_segments ? AVERROR(ENOMEM) : 0;
+
+    for (i = nb_segments = 0; i < mxf->metadata_sets_count; i++) {
+        MXFIndexTableSegment *s = (MXFIndexTableSegment*)mxf->metadata_sets[i];
+        if (s->type == IndexTableSegment && s->index_sid == index_sid &&
+            (s->edit_unit_byte_count || s->nb_index_entries))
+            segments[nb_segments++] = s;
+    }
+
+    AV_QSORT(segments, nb_segments, MXFIndexTableSegment*, mxf_compare_index_segments);
+
+    for (i = 0; i < nb_segments && ret; i++) {
+        MXFIndexTableSegment *s = segments[i];
+
+        /* a zero IndexDuration covers the whole track, see mxf_compute_index_tables() */
+        if (!s->index_duration) {
+            covered = INT64_MAX;
+            break;
+        }
+        if (s->index_edit_rate.num > 0 && s->index_edit_rate.den > 0) {
+            if (!edit_rate.num)
+                edit_rate = s->index_edit_rate;
+            else if (av_cmp_q(edit_rate, s->index_edit_rate))
+                ret = 0;
+        }
+        if (s->index_start_position > covered)
+            ret = 0;
+        covered = FFMAX(covered, s->index_start_position + s->index_duration);
+    }
+    av_free(segments);
+
+    for (i = 0; i < mxf->fc->nb_streams && ret; i++) {
+        MXFTrack *track = mxf->fc->streams[i]->priv_data;
+
+        if (!track || track->index_sid != index_sid)
+            continue;
+        if (track->original_duration <= 0 || !nb_segments ||
+            covered < (edit_rate.num ? av_rescale_q(track->original_duration, track->edit_rate, edit_rate)
+                                     : track->original_duration))
+            ret = 0;
+    }
+
+    return ret;
+}
+
+static int mxf_read_index_segments(MXFContext *mxf, int64_t start, int64_t end)
+{
+    AVIOContext *pb = mxf->fc->pb;
+    KLVPacket klv;
+    int ret;
+
+    avio_seek(pb, start, SEEK_SET);
+
+    while (avio_tell(pb) < end && klv_read_packet(&klv, pb) >= 0 && klv.offset < end) {
+        if (IS_KLV_KEY(klv.key, mxf_index_table_segment_key)) {
+            if ((ret = mxf_parse_klv(mxf, klv, mxf_read_index_table_segment,
+                                     sizeof(MXFIndexTableSegment), IndexTableSegment)) < 0)
+                return ret;
+        } else if (klv.offset > start && mxf_is_partition_pack_key(klv.key)) {
+            break;
+        } else {
+            avio_skip(pb, klv.length);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Reads the index table segments skipped while parsing the partitions,
+ * if the other segments don't cover all tracks.
+ */
+static int mxf_read_skipped_index_segments(MXFContext *mxf)
+{
+    AVIOContext *pb = mxf->fc->pb;
+    int64_t pos = avio_tell(pb);
+    int i, ret = 1;
+
+    if (!mxf->skipped_index_partitions)
+        return 0;
+
+    for (i = 0; i < mxf->fc->nb_streams && ret > 0; i++) {
+        MXFTrack *track = mxf->fc->streams[i]->priv_data;
+        if (track)
+            ret = mxf_index_covers_tracks(mxf, track->index_sid);
+    }
+    if (ret < 0)
+        return ret;
+    if (ret) {
+        av_log(mxf->fc, AV_LOG_VERBOSE, "skipped index table segments of %d partitions\n",
+               mxf->skipped_index_partitions);
+        return 0;
+    }
+
+    av_log(mxf->fc, AV_LOG_VERBOSE, "incomplete index, reading index table segments of %d partitions\n",
+           mxf->skipped_index_partitions);
+
+    for (i = 0; i < mxf->partitions_count; i++) {
+        MXFPartition *p = &mxf->partitions[i];
+
+        if (p->pack_skipped)
+            ret = mxf_read_index_segments(mxf, p->pack_ofs,
+                                          i + 1 < mxf->partitions_count ? mxf->partitions[i + 1].pack_ofs : INT64_MAX);
+        else if (p->index_ofs)
+            ret = mxf_read_index_segments(mxf, p->index_ofs, p->index_ofs + p->index_byte_count);
+        if (ret < 0)
+            break;
+        p->index_ofs = 0;
+    }
+    mxf->skipped_index_partitions = 0;
+
+    avio_seek(pb, pos, SEEK_SET);
+    return ret;
+}
+
 static void mxf_read_random_index_pack(AVFormatContext *s)
 {
     MXFContext *mxf = s->priv_data;
+    MXFRandomIndexEntry *entries;
     uint32_t length;
     int64_t file_size, max_rip_length, min_rip_length;
     KLVPacket klv;
+    int i, nb_entries;
 
     if (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL))
         return;
@@ -3271,15 +3527,36 @@ static void mxf_read_random_index_pack(AVFormatContext *s)
         goto end;
     }
 
-    avio_skip(s->pb, klv.length - 12);
-    mxf->footer_partition = avio_rb64(s->pb);
+    nb_entries = (klv.length - 4) / 12;
+    entries = av_malloc_array(nb_entries, sizeof(*entries));
+    if (!entries)
+        goto end;
+    for (i = 0; i < nb_entries; i++) {
+        entries[i].body_sid = avio_rb32(s->pb);
+        entries[i].offset   = avio_rb64(s->pb);
+    }
+    mxf->footer_partition = entries[nb_entries - 1].offset;
 
     /* sanity check */
     if (mxf->run_in + mxf->footer_partition >= file_size) {
         av_log(s, AV_LOG_WARNING, "bad FooterPartition in RIP - ignoring\n");
         mxf->footer_partition = 0;
+        av_free(entries);
+        goto end;
     }
 
+    /* the partition list is only used to skip partitions if it is consistent */
+    for (i = 1; i < nb_entries; i++)
+        if (entries[i].offset <= entries[i - 1].offset)
+            break;
+    if (i < nb_entries || entries[0].offset) {
+        av_log(s, AV_LOG_VERBOSE, "partitions in RIP are not in order\n");
+        av_free(entries);
+        goto end;
+    }
+    mxf->random_index       = entries;
+    mxf->random_index_count = nb_entries;
+
 end:
     avio_seek(s->pb, mxf->run_in, SEEK_SET);
 }
@@ -3347,6 +3624,10 @@ static int mxf_read_header(AVFormatContext *s)
             else if (mxf->parsing_backward)
                 continue;
             /* we're still parsing forward. proceed to parsing this partition pack */
+        } else if (mxf->parsing_backward && mxf->current_partition &&
+                   IS_KLV_KEY(klv.key, mxf_index_table_segment_key) &&
+                   mxf_skip_index_segments(mxf, &klv)) {
+            continue;
         }
 
         for (metadata = mxf_metadata_read_table; metadata->read; metadata++) {
@@ -3375,6 +3656,9 @@ static int mxf_read_header(AVFormatContext *s)
     if ((ret = mxf_parse_structural_metadata(mxf)) < 0)
         goto fail;
 
+    if ((ret = mxf_read_skipped_index_segments(mxf)) < 0)
+        goto fail;
+
     for (int i = 0; i < s->nb_streams; i++)
         mxf_handle_missing_index_segment(mxf, s->streams[i]);
 
@@ -3702,11 +3986,14 @@ static int mxf_read_close(AVFormatContext *s)
         for (i = 0; i < mxf->nb_index_tables; i++) {
             av_freep(&mxf->index_tables[i].segments);
             av_freep(&mxf->index_tables[i].ptses);
-            av_freep(&mxf->index_tables[i].fake_index);
+            av_freep(&mxf->index_tables[i].segment_ends);
+            av_freep(&mxf->index_tables[i].segment_offsets);
+            av_freep(&mxf->index_tables[i].fake_index_flags);
             av_freep(&mxf->index_tables[i].offsets);
         }
     }
     av_freep(&mxf->index_tables);
+    av_freep(&mxf->random_index);
 
     return 0;
 }
@@ -3738,6 +4025,26 @@ static int mxf_probe(const AVProbeData *p) {
 
 /* rudimentary byte seek */
 /* XXX: use MXF Index */
+/**
+ * Equivalent of ff_index_search_timestamp() for the fake index,
+ * whose entry x has the timestamp x.
+ */
+static int64_t mxf_search_fake_index(const MXFIndexTable *t, int64_t wanted_timestamp, int flags)
+{
+    int backward = flags & AVSEEK_FLAG_BACKWARD;
+    int64_t m = backward ? av_clip64(wanted_timestamp, -1, t->nb_ptses - 1)
+                         : av_clip64(wanted_timestamp,  0, t->nb_ptses);
+
+    if (!(flags & AVSEEK_FLAG_ANY))
+        while (m >= 0 && m < t->nb_ptses &&
+               !(t->fake_index_flags[m] & AVINDEX_KEYFRAME))
+            m += backward ? -1 : 1;
+
+    if (m == t->nb_ptses)
+        return -1;
+    return m;
+}
+
 static int mxf_read_seek(AVFormatContext *s, int stream_index, int64_t sample_time, int flags)
 {
     AVStream *st = s->streams[stream_index];
@@ -3788,11 +4095,11 @@ static int mxf_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
                 return AVERROR_INVALIDDATA;
         }
 
-        /* clamp above zero, else ff_index_search_timestamp() returns negative
+        /* clamp above zero, else mxf_search_fake_index() returns negative
          * this also means we allow seeking before the start */
         sample_time = FFMAX(sample_time, 0);
 
-        if (t->fake_index) {
+        if (t->fake_index_flags) {
             /* The first frames may not be keyframes in presentation order, so
              * we have to advance the target to be able to find the first
              * keyframe backwards... */
@@ -3800,11 +4107,11 @@ static int mxf_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
                 (flags & AVSEEK_FLAG_BACKWARD) &&
                 t->ptses[0] != AV_NOPTS_VALUE &&
                 sample_time < t->ptses[0] &&
-                (t->fake_index[t->ptses[0]].flags & AVINDEX_KEYFRAME))
+                (t->fake_index_flags[t->ptses[0]] & AVINDEX_KEYFRAME))
                 sample_time = t->ptses[0];
 
             /* behave as if we have a proper index */
-            if ((sample_time = ff_index_search_timestamp(t->fake_index, t->nb_ptses, sample_time, flags)) < 0)
+            if ((sample_time = mxf_search_fake_index(t, sample_time, flags)) < 0)
                 return sample_time;
             /* get the stored order index from the display order index */
             sample_time += t->offsets[sample_time];
@@ -45,7 +45,7 @@ int ff_pcm_read_packet(AVFormatContext *s, AVPacket *pkt)
         size = par->block_align;
     }
 
-    ret = av_get_packet(s->pb, pkt, size);
+    ret = ff_get_packet_zerocopy(s->pb, pkt, size);
 
     pkt->flags &= ~AV_PKT_FLAG_CORRUPT;
     pkt->stream_index = 0;
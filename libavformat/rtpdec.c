@@ -33,6 +33,11 @@
 
 #define MIN_FEEDBACK_INTERVAL 200000 /* 200 ms in us */
 
+/* The reordering ring spans at least twice the queue size, so that
+ * packets with gaps in between still fit. */
+#define RTP_REORDER_RING_MIN 16
+#define RTP_REORDER_RING_MAX (1 << 15)
+
 static RTPDynamicProtocolHandler l24_dynamic_handler = {
     .enc_name   = "L24",
     .codec_type = AVMEDIA_TYPE_AUDIO,
@@ -438,28 +443,28 @@ void ff_rtp_send_punch_packets(URLContext *rtp_handle)
 static int find_missing_packets(RTPDemuxContext *s, uint16_t *first_missing,
                                 uint16_t *missing_mask)
 {
-    int i;
+    int i, found = 0;
     uint16_t next_seq = s->seq + 1;
-    RTPPacket *pkt = s->queue;
+    uint16_t pending  = 0;
 
-    if (!pkt || pkt->seq == next_seq)
+    if (!s->queue_len || s->queue_first == next_seq)
         return 0;
 
+    /* Only report packets before the last one we have received */
     *missing_mask = 0;
     for (i = 1; i <= 16; i++) {
         uint16_t missing_seq = next_seq + i;
-        while (pkt) {
-            int16_t diff = pkt->seq - missing_seq;
-            if (diff >= 0)
-                break;
-            pkt = pkt->next;
+        const RTPPacket *pkt = &s->queue[missing_seq & s->queue_mask];
+        if (pkt->buf && pkt->seq == missing_seq) {
+            *missing_mask |= pending;
+            pending = 0;
+            found++;
+        } else {
+            pending |= 1 << (i - 1);
         }
-        if (!pkt)
-            break;
-        if (pkt->seq == missing_seq)
-            continue;
-        *missing_mask |= 1 << (i - 1);
     }
+    if (found < s->queue_len)
+        *missing_mask |= pending;
 
     *first_missing = next_seq;
     return 1;
@@ -551,6 +556,22 @@ RTPDemuxContext *ff_rtp_parse_open(AVFormatContext *s1, AVStream *st,
     av_log(s->ic, AV_LOG_VERBOSE, "setting jitter buffer size to %d\n",
            s->queue_size);
 
+    if (queue_size > 1) {
+        int ring_size = RTP_REORDER_RING_MIN;
+        while (ring_size / 2 < queue_size && ring_size < RTP_REORDER_RING_MAX)
+            ring_size <<= 1;
+        s->queue      = av_mallocz_array(ring_size, sizeof(*s->queue));
+        s->queue_pool = av_buffer_pool_init(RTP_MAX_PACKET_LENGTH +
+                                            AV_INPUT_BUFFER_PADDING_SIZE, NULL);
+        if (!s->queue || !s->queue_pool) {
+            av_free(s->queue);
+            av_buffer_pool_uninit(&s->queue_pool);
+            av_free(s);
+            return NULL;
+        }
+        s->queue_mask = ring_size - 1;
+    }
+
     rtp_init_statistics(&s->statistics, 0);
     if (st) {
         switch (st->codecpar->codec_id) {
@@ -707,39 +728,44 @@ static int rtp_parse_packet_internal(RTPDemuxContext *s, AVPacket *pkt,
 
 void ff_rtp_reset_packet_queue(RTPDemuxContext *s)
 {
-    while (s->queue) {
-        RTPPacket *next = s->queue->next;
-        av_freep(&s->queue->buf);
-        av_freep(&s->queue);
-        s->queue = next;
-    }
+    int i;
+
+    if (s->queue)
+        for (i = 0; i <= s->queue_mask; i++)
+            av_buffer_unref(&s->queue[i].buf);
+    av_buffer_unref(&s->overflow.buf);
     s->seq       = 0;
     s->queue_len = 0;
     s->prev_ret  = 0;
 }
 
-static int enqueue_packet(RTPDemuxContext *s, uint8_t *buf, int len)
+static int copy_packet(RTPDemuxContext *s, RTPPacket *packet,
+                       const uint8_t *buf, int len)
 {
-    uint16_t seq   = AV_RB16(buf + 2);
-    RTPPacket **cur = &s->queue, *packet;
-
-    /* Find the correct place in the queue to insert the packet */
-    while (*cur) {
-        int16_t diff = seq - (*cur)->seq;
-        if (diff < 0)
-            break;
-        cur = &(*cur)->next;
-    }
-
-    packet = av_mallocz(sizeof(*packet));
-    if (!packet)
+    if (len <= RTP_MAX_PACKET_LENGTH)
+        packet->buf = av_buffer_pool_get(s->queue_pool);
+    else
+        packet->buf = av_buffer_alloc(len + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!packet->buf)
         return AVERROR(ENOMEM);
+    memcpy(packet->buf->data, buf, len);
+    memset(packet->buf->data + len, 0, AV_INPUT_BUFFER_PADDING_SIZE);
     packet->recvtime = av_gettime_relative();
-    packet->seq      = seq;
+    packet->seq      = AV_RB16(buf + 2);
     packet->len      = len;
-    packet->buf      = buf;
-    packet->next     = *cur;
-    *cur = packet;
+    return 0;
+}
+
+static int enqueue_packet(RTPDemuxContext *s, const uint8_t *buf, int len)
+{
+    uint16_t seq = AV_RB16(buf + 2);
+    int ret;
+
+    ret = copy_packet(s, &s->queue[seq & s->queue_mask], buf, len);
+    if (ret < 0)
+        return ret;
+    if (!s->queue_len || (int16_t)(seq - s->queue_first) < 0)
+        s->queue_first = seq;
     s->queue_len++;
 
     return 0;
@@ -747,40 +773,56 @@ static int enqueue_packet(RTPDemuxContext *s, uint8_t *buf, int len)
 
 static int has_next_packet(RTPDemuxContext *s)
 {
-    return s->queue && s->queue->seq == (uint16_t) (s->seq + 1);
+    /* A pending overflow packet forces the queue to be drained */
+    if (s->overflow.buf)
+        return 1;
+    return s->queue_len && s->queue_first == (uint16_t) (s->seq + 1);
 }
 
 int64_t ff_rtp_queued_packet_time(RTPDemuxContext *s)
 {
-    return s->queue ? s->queue->recvtime : 0;
+    if (s->queue_len)
+        return s->queue[s->queue_first & s->queue_mask].recvtime;
+    return s->overflow.buf ? s->overflow.recvtime : 0;
 }
 
 static int rtp_parse_queued_packet(RTPDemuxContext *s, AVPacket *pkt)
 {
     int rv;
-    RTPPacket *next;
+    RTPPacket packet;
 
-    if (s->queue_len <= 0)
-        return -1;
+    if (s->queue_len <= 0) {
+        if (!s->overflow.buf)
+            return -1;
+        packet = s->overflow;
+        s->overflow.buf = NULL;
+    } else {
+        RTPPacket *first = &s->queue[s->queue_first & s->queue_mask];
+
+        packet = *first;
+        first->buf = NULL;
+        /* Dequeue it, and look up the next packet in the ring */
+        if (--s->queue_len) {
+            uint16_t seq = s->queue_first;
+            do {
+                seq++;
+            } while (!s->queue[seq & s->queue_mask].buf);
+            s->queue_first = seq;
+        }
+    }
 
-    if (!has_next_packet(s))
+    if (packet.seq != (uint16_t) (s->seq + 1))
         av_log(s->ic, AV_LOG_WARNING,
-               "RTP: missed %d packets\n", s->queue->seq - s->seq - 1);
+               "RTP: missed %d packets\n", (int16_t) (packet.seq - s->seq - 1));
 
-    /* Parse the first packet in the queue, and dequeue it */
-    rv   = rtp_parse_packet_internal(s, pkt, s->queue->buf, s->queue->len);
-    next = s->queue->next;
-    av_freep(&s->queue->buf);
-    av_freep(&s->queue);
-    s->queue = next;
-    s->queue_len--;
+    rv = rtp_parse_packet_internal(s, pkt, packet.buf->data, packet.len);
+    av_buffer_unref(&packet.buf);
     return rv;
 }
 
 static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
-                                uint8_t **bufptr, int len)
+                                uint8_t *buf, int len)
 {
-    uint8_t *buf = bufptr ? *bufptr : NULL;
     int flags = 0;
     uint32_t timestamp;
     int rv = 0;
@@ -823,7 +865,7 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
         rtcp_update_jitter(&s->statistics, timestamp, arrival_ts);
     }
 
-    if ((s->seq == 0 && !s->queue) || s->queue_size <= 1) {
+    if ((s->seq == 0 && !s->queue_len && !s->overflow.buf) || s->queue_size <= 1) {
         /* First packet, or no reordering */
         return rtp_parse_packet_internal(s, pkt, buf, len);
     } else {
@@ -839,11 +881,34 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
             rv = rtp_parse_packet_internal(s, pkt, buf, len);
             return rv;
         } else {
+            const RTPPacket *slot = &s->queue[seq & s->queue_mask];
+
+            if (diff > s->queue_mask || (slot->buf && slot->seq != seq)) {
+                /* Too far ahead to fit into the ring: with nothing queued,
+                 * resynchronize on it, otherwise return it after all the
+                 * queued packets. */
+                if (!s->queue_len && !s->overflow.buf)
+                    return rtp_parse_packet_internal(s, pkt, buf, len);
+                if (s->overflow.buf) {
+                    av_log(s->ic, AV_LOG_WARNING,
+                           "RTP: dropping packet too far ahead of the queue\n");
+                    return -1;
+                }
+                rv = copy_packet(s, &s->overflow, buf, len);
+                if (rv < 0)
+                    return rv;
+                return rtp_parse_queued_packet(s, pkt);
+            }
+            if (slot->buf) {
+                av_log(s->ic, AV_LOG_DEBUG,
+                       "RTP: dropping duplicate packet %d\n", seq);
+                return -1;
+            }
+
             /* Still missing some packet, enqueue this one. */
             rv = enqueue_packet(s, buf, len);
             if (rv < 0)
                 return rv;
-            *bufptr = NULL;
             /* Return the first enqueued packet if the queue is full,
              * even if we're missing something */
             if (s->queue_len >= s->queue_size) {
@@ -859,18 +924,19 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
  * Parse an RTP or RTCP packet directly sent as a buffer.
  * @param s RTP parse context.
  * @param pkt returned packet
- * @param bufptr pointer to the input buffer or NULL to read the next packets
+ * @param buf input buffer, not kept after the call, or NULL to read the
+ *            next packets
  * @param len buffer len
  * @return 0 if a packet is returned, 1 if a packet is returned and more can follow
  * (use buf as NULL to read the next). -1 if no packet (error or no more packet).
  */
 int ff_rtp_parse_packet(RTPDemuxContext *s, AVPacket *pkt,
-                        uint8_t **bufptr, int len)
+                        uint8_t *buf, int len)
 {
     int rv;
-    if (s->srtp_enabled && bufptr && ff_srtp_decrypt(&s->srtp, *bufptr, &len) < 0)
+    if (s->srtp_enabled && buf && ff_srtp_decrypt(&s->srtp, buf, &len) < 0)
         return -1;
-    rv = rtp_parse_one_packet(s, pkt, bufptr, len);
+    rv = rtp_parse_one_packet(s, pkt, buf, len);
     s->prev_ret = rv;
     while (rv < 0 && has_next_packet(s))
         rv = rtp_parse_queued_packet(s, pkt);
@@ -880,10 +946,37 @@ int ff_rtp_parse_packet(RTPDemuxContext *s, AVPacket *pkt,
 void ff_rtp_parse_close(RTPDemuxContext *s)
 {
     ff_rtp_reset_packet_queue(s);
+    av_freep(&s->queue);
+    av_buffer_pool_uninit(&s->queue_pool);
     ff_srtp_free(&s->srtp);
     av_free(s);
 }
 
+int ff_rtp_new_packet(AVBufferPool **pool, AVPacket *pkt, int size)
+{
+    AVBufferRef *buf;
+
+    if (size > RTP_MAX_PACKET_LENGTH)
+        return av_new_packet(pkt, size);
+
+    if (!*pool) {
+        *pool = av_buffer_pool_init(RTP_MAX_PACKET_LENGTH +
+                                    AV_INPUT_BUFFER_PADDING_SIZE, NULL);
+        if (!*pool)
+            return AVERROR(ENOMEM);
+    }
+    buf = av_buffer_pool_get(*pool);
+    if (!buf)
+        return AVERROR(ENOMEM);
+
+    av_init_packet(pkt);
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    pkt->size = size;
+    memset(pkt->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    return 0;
+}
+
 int ff_parse_fmtp(AVFormatContext *s,
                   AVStream *stream, PayloadContext *data, const char *p,
                   int (*parse_fmtp)(AVFormatContext *s,
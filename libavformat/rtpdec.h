@@ -23,6 +23,7 @@
 #ifndef AVFORMAT_RTPDEC_H
 #define AVFORMAT_RTPDEC_H
 
+#include "libavutil/buffer.h"
 #include "libavcodec/avcodec.h"
 #include "avformat.h"
 #include "rtp.h"
@@ -47,11 +48,20 @@ void ff_rtp_parse_set_dynamic_protocol(RTPDemuxContext *s, PayloadContext *ctx,
 void ff_rtp_parse_set_crypto(RTPDemuxContext *s, const char *suite,
                              const char *params);
 int ff_rtp_parse_packet(RTPDemuxContext *s, AVPacket *pkt,
-                        uint8_t **buf, int len);
+                        uint8_t *buf, int len);
 void ff_rtp_parse_close(RTPDemuxContext *s);
 int64_t ff_rtp_queued_packet_time(RTPDemuxContext *s);
 void ff_rtp_reset_packet_queue(RTPDemuxContext *s);
 
+/**
+ * Allocate a packet payload of size bytes for a depacketizer.
+ *
+ * Payloads up to RTP_MAX_PACKET_LENGTH bytes are taken from *pool, which
+ * is created on first use and must be freed with av_buffer_pool_uninit()
+ * by the caller. Larger payloads are allocated with av_new_packet().
+ */
+int ff_rtp_new_packet(AVBufferPool **pool, AVPacket *pkt, int size);
+
 /**
  * Send a dummy packet on both port pairs to set up the connection
  * state in potential NAT routers, so that we're able to receive
@@ -140,10 +150,9 @@ struct RTPDynamicProtocolHandler {
 
 typedef struct RTPPacket {
     uint16_t seq;
-    uint8_t *buf;
+    AVBufferRef *buf;
     int len;
     int64_t recvtime;
-    struct RTPPacket *next;
 } RTPPacket;
 
 struct RTPDemuxContext {
@@ -168,9 +177,13 @@ struct RTPDemuxContext {
 
     /** Fields for packet reordering @{ */
     int prev_ret;     ///< The return value of the actual parsing of the previous packet
-    RTPPacket* queue; ///< A sorted queue of buffered packets not yet returned
-    int queue_len;    ///< The number of packets in queue
-    int queue_size;   ///< The size of queue, or 0 if reordering is disabled
+    RTPPacket *queue;     ///< Ring of buffered packets not yet returned, indexed by seq & queue_mask
+    int queue_len;        ///< The number of packets in queue
+    int queue_size;       ///< The size of queue, or 0 if reordering is disabled
+    int queue_mask;       ///< The number of entries in the ring minus one
+    uint16_t queue_first; ///< The lowest sequence number in queue, if queue_len > 0
+    AVBufferPool *queue_pool; ///< Pool for the buffers of queued packets
+    RTPPacket overflow;   ///< A packet too far ahead for the ring, returned once queue is drained
     /*@}*/
 
     /* rtcp sender statistics receive */
@@ -38,11 +38,13 @@ int ff_h263_handle_packet(AVFormatContext *ctx, PayloadContext *data,
 int ff_h264_parse_sprop_parameter_sets(AVFormatContext *s,
                                        uint8_t **data_ptr, int *size_ptr,
                                        const char *value);
-int ff_h264_handle_aggregated_packet(AVFormatContext *ctx, PayloadContext *data, AVPacket *pkt,
+int ff_h264_handle_aggregated_packet(AVFormatContext *ctx, PayloadContext *data,
+                                     AVBufferPool **pool, AVPacket *pkt,
                                      const uint8_t *buf, int len,
                                      int start_skip, int *nal_counters,
                                      int nal_mask);
-int ff_h264_handle_frag_packet(AVPacket *pkt, const uint8_t *buf, int len,
+int ff_h264_handle_frag_packet(AVBufferPool **pool, AVPacket *pkt,
+                               const uint8_t *buf, int len,
                                int start_bit, const uint8_t *nal_header,
                                int nal_header_len);
 void ff_h264_parse_framesize(AVCodecParameters *par, const char *p);
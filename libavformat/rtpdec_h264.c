@@ -48,6 +48,7 @@ struct PayloadContext {
     uint8_t profile_iop;
     uint8_t level_idc;
     int packetization_mode;
+    AVBufferPool *pkt_pool;
 #ifdef DEBUG
     int packet_types_received[32];
 #endif
@@ -203,7 +204,8 @@ void ff_h264_parse_framesize(AVCodecParameters *par, const char *p)
     par->height  = atoi(p + 1); // skip the -
 }
 
-int ff_h264_handle_aggregated_packet(AVFormatContext *ctx, PayloadContext *data, AVPacket *pkt,
+int ff_h264_handle_aggregated_packet(AVFormatContext *ctx, PayloadContext *data,
+                                     AVBufferPool **pool, AVPacket *pkt,
                                      const uint8_t *buf, int len,
                                      int skip_between, int *nal_counters,
                                      int nal_mask)
@@ -252,7 +254,7 @@ int ff_h264_handle_aggregated_packet(AVFormatContext *ctx, PayloadContext *data,
         if (pass == 0) {
             /* now we know the total size of the packet (with the
              * start sequences added) */
-            if ((ret = av_new_packet(pkt, total_length)) < 0)
+            if ((ret = ff_rtp_new_packet(pool, pkt, total_length)) < 0)
                 return ret;
             dst = pkt->data;
         }
@@ -261,7 +263,8 @@ int ff_h264_handle_aggregated_packet(AVFormatContext *ctx, PayloadContext *data,
     return 0;
 }
 
-int ff_h264_handle_frag_packet(AVPacket *pkt, const uint8_t *buf, int len,
+int ff_h264_handle_frag_packet(AVBufferPool **pool, AVPacket *pkt,
+                               const uint8_t *buf, int len,
                                int start_bit, const uint8_t *nal_header,
                                int nal_header_len)
 {
@@ -270,7 +273,7 @@ int ff_h264_handle_frag_packet(AVPacket *pkt, const uint8_t *buf, int len,
     int pos = 0;
     if (start_bit)
         tot_len += sizeof(start_sequence) + nal_header_len;
-    if ((ret = av_new_packet(pkt, tot_len)) < 0)
+    if ((ret = ff_rtp_new_packet(pool, pkt, tot_len)) < 0)
         return ret;
     if (start_bit) {
         memcpy(pkt->data + pos, start_sequence, sizeof(start_sequence));
@@ -305,7 +308,8 @@ static int h264_handle_packet_fu_a(AVFormatContext *ctx, PayloadContext *data, A
 
     if (start_bit && nal_counters)
         nal_counters[nal_type & nal_mask]++;
-    return ff_h264_handle_frag_packet(pkt, buf, len, start_bit, &nal, 1);
+    return ff_h264_handle_frag_packet(&data->pkt_pool, pkt, buf, len,
+                                      start_bit, &nal, 1);
 }
 
 // return 0 on packet, no more left, 1 on packet, 1 on partial packet
@@ -332,7 +336,8 @@ static int h264_handle_packet(AVFormatContext *ctx, PayloadContext *data,
     switch (type) {
     case 0:                    // undefined, but pass them through
     case 1:
-        if ((result = av_new_packet(pkt, len + sizeof(start_sequence))) < 0)
+        if ((result = ff_rtp_new_packet(&data->pkt_pool, pkt,
+                                        len + sizeof(start_sequence))) < 0)
             return result;
         memcpy(pkt->data, start_sequence, sizeof(start_sequence));
         memcpy(pkt->data + sizeof(start_sequence), buf, len);
@@ -343,7 +348,8 @@ static int h264_handle_packet(AVFormatContext *ctx, PayloadContext *data,
         // consume the STAP-A NAL
         buf++;
         len--;
-        result = ff_h264_handle_aggregated_packet(ctx, data, pkt, buf, len, 0,
+        result = ff_h264_handle_aggregated_packet(ctx, data, &data->pkt_pool,
+                                                  pkt, buf, len, 0,
                                                   NAL_COUNTERS, NAL_MASK);
         break;
 
@@ -384,6 +390,7 @@ static void h264_close_context(PayloadContext *data)
                    data->packet_types_received[ii], ii);
     }
 #endif
+    av_buffer_pool_uninit(&data->pkt_pool);
 }
 
 static int parse_h264_sdp_line(AVFormatContext *s, int st_index,
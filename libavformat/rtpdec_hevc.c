@@ -42,6 +42,7 @@ struct PayloadContext {
     int profile_id;
     uint8_t *sps, *pps, *vps, *sei;
     int sps_size, pps_size, vps_size, sei_size;
+    AVBufferPool *pkt_pool;
 };
 
 static const uint8_t start_sequence[] = { 0x00, 0x00, 0x00, 0x01 };
@@ -242,7 +243,8 @@ static int hevc_handle_packet(AVFormatContext *ctx, PayloadContext *rtp_hevc_ctx
     /* single NAL unit packet */
     default:
         /* create A/V packet */
-        if ((res = av_new_packet(pkt, sizeof(start_sequence) + len)) < 0)
+        if ((res = ff_rtp_new_packet(&rtp_hevc_ctx->pkt_pool, pkt,
+                                     sizeof(start_sequence) + len)) < 0)
             return res;
         /* A/V packet: copy start sequence */
         memcpy(pkt->data, start_sequence, sizeof(start_sequence));
@@ -262,7 +264,9 @@ static int hevc_handle_packet(AVFormatContext *ctx, PayloadContext *rtp_hevc_ctx
             len -= RTP_HEVC_DONL_FIELD_SIZE;
         }
 
-        res = ff_h264_handle_aggregated_packet(ctx, rtp_hevc_ctx, pkt, buf, len,
+        res = ff_h264_handle_aggregated_packet(ctx, rtp_hevc_ctx,
+                                               &rtp_hevc_ctx->pkt_pool,
+                                               pkt, buf, len,
                                                rtp_hevc_ctx->using_donl_field ?
                                                RTP_HEVC_DOND_FIELD_SIZE : 0,
                                                NULL, 0);
@@ -323,7 +327,8 @@ static int hevc_handle_packet(AVFormatContext *ctx, PayloadContext *rtp_hevc_ctx
         new_nal_header[0] = (rtp_pl[0] & 0x81) | (fu_type << 1);
         new_nal_header[1] = rtp_pl[1];
 
-        res = ff_h264_handle_frag_packet(pkt, buf, len, first_fragment,
+        res = ff_h264_handle_frag_packet(&rtp_hevc_ctx->pkt_pool, pkt,
+                                         buf, len, first_fragment,
                                          new_nal_header, sizeof(new_nal_header));
 
         break;
@@ -340,6 +345,15 @@ static int hevc_handle_packet(AVFormatContext *ctx, PayloadContext *rtp_hevc_ctx
     return res;
 }
 
+static void hevc_close_context(PayloadContext *data)
+{
+    av_buffer_pool_uninit(&data->pkt_pool);
+    av_freep(&data->vps);
+    av_freep(&data->sps);
+    av_freep(&data->pps);
+    av_freep(&data->sei);
+}
+
 const RTPDynamicProtocolHandler ff_hevc_dynamic_handler = {
     .enc_name         = "H265",
     .codec_type       = AVMEDIA_TYPE_VIDEO,
@@ -347,5 +361,6 @@ const RTPDynamicProtocolHandler ff_hevc_dynamic_handler = {
     .need_parsing     = AVSTREAM_PARSE_FULL,
     .priv_data_size   = sizeof(PayloadContext),
     .parse_sdp_a_line = hevc_parse_sdp_line,
+    .close            = hevc_close_context,
     .parse_packet     = hevc_handle_packet,
 };
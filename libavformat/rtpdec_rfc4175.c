@@ -32,7 +32,8 @@ struct PayloadContext {
     int width;
     int height;
 
-    uint8_t *frame;
+    AVBufferPool *pool;
+    AVBufferRef *frame;  /* frame being reassembled, taken from pool */
     unsigned int frame_size;
     unsigned int pgroup; /* size of the pixel group in bytes */
     unsigned int xinc;
@@ -70,6 +71,12 @@ static int rfc4175_parse_format(AVStream *stream, PayloadContext *data)
     stream->codecpar->bits_per_coded_sample = bits_per_sample;
     data->frame_size = data->width * data->height * data->pgroup / data->xinc;
 
+    av_buffer_pool_uninit(&data->pool);
+    data->pool = av_buffer_pool_init(data->frame_size + AV_INPUT_BUFFER_PADDING_SIZE,
+                                     NULL);
+    if (!data->pool)
+        return AVERROR(ENOMEM);
+
     return 0;
 }
 
@@ -123,17 +130,16 @@ static int rfc4175_parse_sdp_line(AVFormatContext *s, int st_index,
 static int rfc4175_finalize_packet(PayloadContext *data, AVPacket *pkt,
                                    int stream_index)
 {
-   int ret;
-
+   av_init_packet(pkt);
    pkt->stream_index = stream_index;
-   ret = av_packet_from_data(pkt, data->frame, data->frame_size);
-   if (ret < 0) {
-       av_freep(&data->frame);
-   }
+   pkt->buf          = data->frame;
+   pkt->data         = data->frame->data;
+   pkt->size         = data->frame_size;
+   memset(pkt->data + pkt->size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
 
    data->frame = NULL;
 
-   return ret;
+   return 0;
 }
 
 static int rfc4175_handle_packet(AVFormatContext *ctx, PayloadContext *data,
@@ -149,7 +155,7 @@ static int rfc4175_handle_packet(AVFormatContext *ctx, PayloadContext *data,
 
     uint8_t *dest;
 
-    if (*timestamp != data->timestamp) {
+    if (*timestamp != data->timestamp || !data->frame) {
         if (data->frame) {
             /*
              * if we're here, it means that two RTP packets didn't have the
@@ -163,7 +169,9 @@ static int rfc4175_handle_packet(AVFormatContext *ctx, PayloadContext *data,
             rfc4175_finalize_packet(data, pkt, st->index);
         }
 
-        data->frame = av_malloc(data->frame_size);
+        if (!data->pool)
+            return AVERROR_INVALIDDATA;
+        data->frame = av_buffer_pool_get(data->pool);
 
         data->timestamp = *timestamp;
 
@@ -210,7 +218,7 @@ static int rfc4175_handle_packet(AVFormatContext *ctx, PayloadContext *data,
         if (copy_offset + length > data->frame_size)
             return AVERROR_INVALIDDATA;
 
-        dest = data->frame + copy_offset;
+        dest = data->frame->data + copy_offset;
         memcpy(dest, payload, length);
 
         payload += length;
@@ -226,11 +234,18 @@ static int rfc4175_handle_packet(AVFormatContext *ctx, PayloadContext *data,
     return AVERROR(EAGAIN);
 }
 
+static void rfc4175_close(PayloadContext *data)
+{
+    av_buffer_unref(&data->frame);
+    av_buffer_pool_uninit(&data->pool);
+}
+
 const RTPDynamicProtocolHandler ff_rfc4175_rtp_handler = {
     .enc_name           = "raw",
     .codec_type         = AVMEDIA_TYPE_VIDEO,
     .codec_id           = AV_CODEC_ID_BITPACKED,
     .priv_data_size     = sizeof(PayloadContext),
     .parse_sdp_a_line   = rfc4175_parse_sdp_line,
+    .close              = rfc4175_close,
     .parse_packet       = rfc4175_handle_packet,
 };
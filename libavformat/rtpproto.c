@@ -61,6 +61,10 @@ typedef struct RTPContext {
     char *block;
     char *fec_options_str;
     int64_t rw_timeout;
+    int batch;
+    int gso;
+    int timestamps;
+    int64_t rx_timestamp;
 } RTPContext;
 
 #define OFFSET(x) offsetof(RTPContext, x)
@@ -80,6 +84,10 @@ static const AVOption options[] = {
     { "sources",            "Source list",                                                      OFFSET(sources),         AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",              "Block list",                                                       OFFSET(block),           AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "fec",                "FEC",                                                              OFFSET(fec_options_str), AV_OPT_TYPE_STRING, { .str = NULL },               .flags = E },
+    { "batch",              "Number of RTP packets received or sent per system call",           OFFSET(batch),           AV_OPT_TYPE_INT,    { .i64 =  1 },     1, 256,     .flags = D|E },
+    { "gso",                "Send batched RTP packets with UDP segmentation offload",           OFFSET(gso),             AV_OPT_TYPE_BOOL,   { .i64 =  0 },     0, 1,       .flags = E },
+    { "timestamps",         "Capture the kernel receive time of the RTP packets",               OFFSET(timestamps),      AV_OPT_TYPE_BOOL,   { .i64 =  0 },     0, 1,       .flags = D },
+    { "rx_timestamp",       "Kernel receive time of the last RTP packet read, in microseconds since the epoch", OFFSET(rx_timestamp), AV_OPT_TYPE_INT64, { .i64 = AV_NOPTS_VALUE }, INT64_MIN, INT64_MAX, .flags = D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { NULL }
 };
 
@@ -209,6 +217,9 @@ static void build_udp_url(RTPContext *s,
  *         'block=ip[,ip]'    : list disallowed source IP addresses
  *         'write_to_source=0/1' : send packets to the source address of the latest received packet
  *         'dscp=n'           : set DSCP value to n (QoS)
+ *         'batch=n'          : receive or send up to n RTP packets per system call
+ *         'gso=0/1'          : send batched RTP packets with UDP segmentation offload
+ *         'timestamps=0/1'   : capture the kernel receive time of the RTP packets
  * deprecated option:
  *         'localport=n'      : set the local port to n
  *
@@ -232,6 +243,7 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
     int i, max_retry_count = 3;
     int rtcpflags;
 
+    s->rx_timestamp = AV_NOPTS_VALUE;
     av_url_split(NULL, 0, NULL, 0, hostname, sizeof(hostname), &rtp_port,
                  path, sizeof(path), uri);
     /* extract parameters */
@@ -270,6 +282,15 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "timeout", p)) {
             s->rw_timeout = strtol(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "batch", p)) {
+            s->batch = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "gso", p)) {
+            s->gso = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "timestamps", p)) {
+            s->timestamps = strtol(buf, NULL, 10);
+        }
         if (av_find_info_tag(buf, sizeof(buf), "sources", p)) {
             av_strlcpy(include_sources, buf, sizeof(include_sources));
             ff_ip_parse_sources(h, buf, &s->filters);
@@ -316,6 +337,13 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
         build_udp_url(s, buf, sizeof(buf),
                       hostname, rtp_port, s->local_rtpport,
                       sources, block);
+        /* RTCP is sparse and latency sensitive, only the RTP socket is batched */
+        if (s->batch > 1)
+            url_add_option(buf, sizeof(buf), "batch=%d", s->batch);
+        if (s->gso)
+            url_add_option(buf, sizeof(buf), "gso=1");
+        if (s->timestamps)
+            url_add_option(buf, sizeof(buf), "timestamps=1");
         if (ffurl_open_whitelist(&s->rtp_hd, buf, flags, &h->interrupt_callback,
                                  NULL, h->protocol_whitelist, h->protocol_blacklist, h) < 0)
             goto fail;
@@ -382,6 +410,7 @@ static int rtp_read(URLContext *h, uint8_t *buf, int size)
     RTPContext *s = h->priv_data;
     int len, n, i;
     struct pollfd p[2] = {{s->rtp_fd, POLLIN, 0}, {s->rtcp_fd, POLLIN, 0}};
+    URLContext *hds[2] = { s->rtp_hd, s->rtcp_hd };
     int poll_delay = h->flags & AVIO_FLAG_NONBLOCK ? 0 : POLLING_TIME;
     struct sockaddr_storage *addrs[2] = { &s->last_rtp_source, &s->last_rtcp_source };
     socklen_t *addr_lens[2] = { &s->last_rtp_source_len, &s->last_rtcp_source_len };
@@ -390,18 +419,23 @@ static int rtp_read(URLContext *h, uint8_t *buf, int size)
     for(;;) {
         if (ff_check_interrupt(&h->interrupt_callback))
             return AVERROR_EXIT;
-        n = poll(p, 2, poll_delay);
+        /* RTP packets left from an earlier batch need no polling */
+        if (ff_udp_pending(s->rtp_hd)) {
+            p[0].revents = POLLIN;
+            p[1].revents = 0;
+            n = 1;
+        } else
+            n = poll(p, 2, poll_delay);
         if (n > 0) {
             /* first try RTCP, then RTP */
             for (i = 1; i >= 0; i--) {
                 if (!(p[i].revents & POLLIN))
                     continue;
                 *addr_lens[i] = sizeof(*addrs[i]);
-                len = recvfrom(p[i].fd, buf, size, 0,
-                                (struct sockaddr *)addrs[i], addr_lens[i]);
+                len = ff_udp_recv(hds[i], buf, size, addrs[i], addr_lens[i],
+                                  i ? NULL : &s->rx_timestamp);
                 if (len < 0) {
-                    if (ff_neterrno() == AVERROR(EAGAIN) ||
-                        ff_neterrno() == AVERROR(EINTR))
+                    if (len == AVERROR(EAGAIN) || len == AVERROR(EINTR))
                         continue;
                     return AVERROR(EIO);
                 }
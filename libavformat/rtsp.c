@@ -2187,7 +2187,8 @@ redo:
         }
     }
 
-    /* read next RTP packet */
+    /* read next RTP packet; the parsers copy the packets they keep, so the
+     * buffer is allocated once and reused */
     if (!rt->recvbuf) {
         rt->recvbuf = av_malloc(RECVBUF_SIZE);
         if (!rt->recvbuf)
@@ -2207,9 +2208,9 @@ redo:
         return len;
 
     if (rt->transport == RTSP_TRANSPORT_RDT) {
-        ret = ff_rdt_parse_packet(rtsp_st->transport_priv, pkt, &rt->recvbuf, len);
+        ret = ff_rdt_parse_packet(rtsp_st->transport_priv, pkt, rt->recvbuf, len);
     } else if (rt->transport == RTSP_TRANSPORT_RTP) {
-        ret = ff_rtp_parse_packet(rtsp_st->transport_priv, pkt, &rt->recvbuf, len);
+        ret = ff_rtp_parse_packet(rtsp_st->transport_priv, pkt, rt->recvbuf, len);
         if (rtsp_st->feedback) {
             AVIOContext *pb = NULL;
             if (rt->lower_transport == RTSP_LOWER_TRANSPORT_CUSTOM)
@@ -0,0 +1,484 @@
+/*
+ * Export and import of the stream information found by probing
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/avassert.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/md5.h"
+#include "libavutil/mem.h"
+
+#include "avformat.h"
+#include "avio_internal.h"
+#include "internal.h"
+
+#define STREAM_INFO_TAG     MKBETAG('F','F','S','I')
+#define STREAM_INFO_VERSION 1
+
+/* number of bytes at the start of the input covered by the fingerprint */
+#define FINGERPRINT_SIZE    (64 * 1024)
+
+typedef struct StreamInfoEntry {
+    int id;
+    AVRational time_base;
+    int64_t start_time;
+    int64_t duration;
+    int disposition;
+    AVRational sample_aspect_ratio;
+    AVRational avg_frame_rate;
+    AVRational r_frame_rate;
+    int codec_info_nb_frames;
+    /* fields of the internal codec context used when demuxing */
+    AVRational codec_time_base;
+    AVRational codec_framerate;
+    int ticks_per_frame;
+    AVCodecParameters *par;
+    AVPacketSideData *side_data;
+    int nb_side_data;
+} StreamInfoEntry;
+
+typedef struct StreamInfoCache {
+    int64_t start_time;
+    int64_t duration;
+    int64_t bit_rate;
+    int duration_estimation_method;
+    StreamInfoEntry *streams;
+    int nb_streams;
+    int nb_applied;
+} StreamInfoCache;
+
+static int compute_fingerprint(AVFormatContext *s, int64_t *size,
+                               uint8_t digest[16])
+{
+    AVIOContext *pb = s->pb;
+    struct AVMD5 *md5;
+    uint8_t *buf;
+    int64_t pos;
+    int len, ret = 0;
+
+    if (!pb || (s->iformat->flags & AVFMT_NOFILE))
+        return AVERROR(ENOSYS);
+
+    pos = avio_tell(pb);
+    if (avio_seek(pb, 0, SEEK_SET) < 0)
+        return AVERROR(ENOSYS);
+
+    buf = av_malloc(FINGERPRINT_SIZE);
+    md5 = av_md5_alloc();
+    if (!buf || !md5) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    len = avio_read(pb, buf, FINGERPRINT_SIZE);
+    if (len < 0 && len != AVERROR_EOF) {
+        ret = len;
+        goto end;
+    }
+    av_md5_init(md5);
+    av_md5_update(md5, buf, FFMAX(len, 0));
+    av_md5_final(md5, digest);
+    *size = avio_size(pb);
+
+end:
+    av_free(md5);
+    av_free(buf);
+    if (avio_seek(pb, pos, SEEK_SET) < 0) {
+        av_log(s, AV_LOG_ERROR, "Failed to seek back after fingerprinting\n");
+        return AVERROR(EIO);
+    }
+    return ret;
+}
+
+static void write_rational(AVIOContext *pb, AVRational q)
+{
+    avio_wb32(pb, q.num);
+    avio_wb32(pb, q.den);
+}
+
+static AVRational read_rational(AVIOContext *pb)
+{
+    AVRational q;
+
+    q.num = avio_rb32(pb);
+    q.den = avio_rb32(pb);
+    return q;
+}
+
+static void write_codecpar(AVIOContext *pb, const AVCodecParameters *par)
+{
+    avio_wb32(pb, par->codec_type);
+    avio_wb32(pb, par->codec_id);
+    avio_wb32(pb, par->codec_tag);
+    avio_wb32(pb, par->extradata_size);
+    avio_write(pb, par->extradata, par->extradata_size);
+    avio_wb32(pb, par->format);
+    avio_wb64(pb, par->bit_rate);
+    avio_wb32(pb, par->bits_per_coded_sample);
+    avio_wb32(pb, par->bits_per_raw_sample);
+    avio_wb32(pb, par->profile);
+    avio_wb32(pb, par->level);
+    avio_wb32(pb, par->width);
+    avio_wb32(pb, par->height);
+    write_rational(pb, par->sample_aspect_ratio);
+    avio_wb32(pb, par->field_order);
+    avio_wb32(pb, par->color_range);
+    avio_wb32(pb, par->color_primaries);
+    avio_wb32(pb, par->color_trc);
+    avio_wb32(pb, par->color_space);
+    avio_wb32(pb, par->chroma_location);
+    avio_wb32(pb, par->video_delay);
+    avio_wb64(pb, par->channel_layout);
+    avio_wb32(pb, par->channels);
+    avio_wb32(pb, par->sample_rate);
+    avio_wb32(pb, par->block_align);
+    avio_wb32(pb, par->frame_size);
+    avio_wb32(pb, par->initial_padding);
+    avio_wb32(pb, par->trailing_padding);
+    avio_wb32(pb, par->seek_preroll);
+}
+
+/* the blob is read from memory, all of it is in the buffer */
+static int64_t bytes_left(AVIOContext *pb)
+{
+    return pb->buf_end - pb->buf_ptr;
+}
+
+static int read_codecpar(AVIOContext *pb, AVCodecParameters *par)
+{
+    int size;
+
+    par->codec_type = avio_rb32(pb);
+    par->codec_id   = avio_rb32(pb);
+    par->codec_tag  = avio_rb32(pb);
+    size            = avio_rb32(pb);
+    if (size < 0 || size > bytes_left(pb))
+        return AVERROR_INVALIDDATA;
+    if (size) {
+        par->extradata = av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!par->extradata)
+            return AVERROR(ENOMEM);
+        par->extradata_size = size;
+        if (avio_read(pb, par->extradata, size) != size)
+            return AVERROR_INVALIDDATA;
+    }
+    par->format                = avio_rb32(pb);
+    par->bit_rate              = avio_rb64(pb);
+    par->bits_per_coded_sample = avio_rb32(pb);
+    par->bits_per_raw_sample   = avio_rb32(pb);
+    par->profile               = avio_rb32(pb);
+    par->level                 = avio_rb32(pb);
+    par->width                 = avio_rb32(pb);
+    par->height                = avio_rb32(pb);
+    par->sample_aspect_ratio   = read_rational(pb);
+    par->field_order           = avio_rb32(pb);
+    par->color_range           = avio_rb32(pb);
+    par->color_primaries       = avio_rb32(pb);
+    par->color_trc             = avio_rb32(pb);
+    par->color_space           = avio_rb32(pb);
+    par->chroma_location       = avio_rb32(pb);
+    par->video_delay           = avio_rb32(pb);
+    par->channel_layout        = avio_rb64(pb);
+    par->channels              = avio_rb32(pb);
+    par->sample_rate           = avio_rb32(pb);
+    par->block_align           = avio_rb32(pb);
+    par->frame_size            = avio_rb32(pb);
+    par->initial_padding       = avio_rb32(pb);
+    par->trailing_padding      = avio_rb32(pb);
+    par->seek_preroll          = avio_rb32(pb);
+    return 0;
+}
+
+int avformat_export_stream_info(AVFormatContext *ic, uint8_t **data, int *size)
+{
+    AVIOContext *pb;
+    uint8_t digest[16];
+    int64_t input_size;
+    int i, j, ret;
+
+    *data = NULL;
+    *size = 0;
+
+    if (!ic->iformat)
+        return AVERROR(EINVAL);
+    ret = compute_fingerprint(ic, &input_size, digest);
+    if (ret < 0)
+        return ret;
+
+    ret = avio_open_dyn_buf(&pb);
+    if (ret < 0)
+        return ret;
+
+    avio_wb32(pb, STREAM_INFO_TAG);
+    avio_wb32(pb, STREAM_INFO_VERSION);
+    avio_put_str(pb, ic->iformat->name);
+    avio_wb64(pb, input_size);
+    avio_write(pb, digest, sizeof(digest));
+
+    avio_wb64(pb, ic->start_time);
+    avio_wb64(pb, ic->duration);
+    avio_wb64(pb, ic->bit_rate);
+    avio_wb32(pb, ic->duration_estimation_method);
+
+    avio_wb32(pb, ic->nb_streams);
+    for (i = 0; i < ic->nb_streams; i++) {
+        AVStream *st = ic->streams[i];
+        AVCodecContext *avctx = st->internal->avctx;
+
+        avio_wb32(pb, st->id);
+        write_rational(pb, st->time_base);
+        avio_wb64(pb, st->start_time);
+        avio_wb64(pb, st->duration);
+        avio_wb32(pb, st->disposition);
+        write_rational(pb, st->sample_aspect_ratio);
+        write_rational(pb, st->avg_frame_rate);
+        write_rational(pb, st->r_frame_rate);
+        avio_wb32(pb, st->codec_info_nb_frames);
+        write_rational(pb, avctx->time_base);
+        write_rational(pb, avctx->framerate);
+        avio_wb32(pb, avctx->ticks_per_frame);
+        write_codecpar(pb, st->codecpar);
+
+        avio_wb32(pb, st->nb_side_data);
+        for (j = 0; j < st->nb_side_data; j++) {
+            avio_wb32(pb, st->side_data[j].type);
+            avio_wb32(pb, st->side_data[j].size);
+            avio_write(pb, st->side_data[j].data, st->side_data[j].size);
+        }
+    }
+
+    ret = avio_close_dyn_buf(pb, data);
+    if (!*data)
+        return AVERROR(ENOMEM);
+    *size = ret;
+    return 0;
+}
+
+void ff_stream_info_cache_free(StreamInfoCache **pc)
+{
+    StreamInfoCache *c = *pc;
+    int i, j;
+
+    if (!c)
+        return;
+    for (i = 0; i < c->nb_streams; i++) {
+        StreamInfoEntry *e = &c->streams[i];
+
+        avcodec_parameters_free(&e->par);
+        for (j = 0; j < e->nb_side_data; j++)
+            av_freep(&e->side_data[j].data);
+        av_freep(&e->side_data);
+    }
+    av_freep(&c->streams);
+    av_freep(pc);
+}
+
+static int read_entry(AVIOContext *pb, StreamInfoEntry *e)
+{
+    int i, ret;
+
+    e->id                   = avio_rb32(pb);
+    e->time_base            = read_rational(pb);
+    e->start_time           = avio_rb64(pb);
+    e->duration             = avio_rb64(pb);
+    e->disposition          = avio_rb32(pb);
+    e->sample_aspect_ratio  = read_rational(pb);
+    e->avg_frame_rate       = read_rational(pb);
+    e->r_frame_rate         = read_rational(pb);
+    e->codec_info_nb_frames = avio_rb32(pb);
+    e->codec_time_base      = read_rational(pb);
+    e->codec_framerate      = read_rational(pb);
+    e->ticks_per_frame      = avio_rb32(pb);
+
+    e->par = avcodec_parameters_alloc();
+    if (!e->par)
+        return AVERROR(ENOMEM);
+    ret = read_codecpar(pb, e->par);
+    if (ret < 0)
+        return ret;
+
+    e->nb_side_data = avio_rb32(pb);
+    if (e->nb_side_data < 0 || e->nb_side_data > AV_PKT_DATA_NB) {
+        e->nb_side_data = 0;
+        return AVERROR_INVALIDDATA;
+    }
+    if (e->nb_side_data) {
+        e->side_data = av_mallocz_array(e->nb_side_data, sizeof(*e->side_data));
+        if (!e->side_data) {
+            e->nb_side_data = 0;
+            return AVERROR(ENOMEM);
+        }
+    }
+    for (i = 0; i < e->nb_side_data; i++) {
+        AVPacketSideData *sd = &e->side_data[i];
+
+        sd->type = avio_rb32(pb);
+        sd->size = avio_rb32(pb);
+        if (sd->size < 0 || pb->eof_reached || sd->size > bytes_left(pb))
+            return AVERROR_INVALIDDATA;
+        sd->data = av_malloc(FFMAX(sd->size, 1));
+        if (!sd->data)
+            return AVERROR(ENOMEM);
+        if (avio_read(pb, sd->data, sd->size) != sd->size)
+            return AVERROR_INVALIDDATA;
+    }
+    return 0;
+}
+
+int avformat_import_stream_info(AVFormatContext *ic, const uint8_t *data, int size)
+{
+    AVIOContext pb;
+    StreamInfoCache *c = NULL;
+    uint8_t digest[16], stored_digest[16];
+    char name[64];
+    int64_t input_size, stored_size;
+    int i, ret;
+
+    ff_stream_info_cache_free(&ic->internal->stream_info_cache);
+
+    if (!ic->iformat || size < 8)
+        return AVERROR_INVALIDDATA;
+    ffio_init_context(&pb, (unsigned char *)data, size, 0,
+                      NULL, NULL, NULL, NULL);
+    if (avio_rb32(&pb) != STREAM_INFO_TAG ||
+        avio_rb32(&pb) != STREAM_INFO_VERSION)
+        return AVERROR_INVALIDDATA;
+
+    avio_get_str(&pb, INT_MAX, name, sizeof(name));
+    stored_size = avio_rb64(&pb);
+    if (avio_read(&pb, stored_digest, sizeof(stored_digest)) != sizeof(stored_digest))
+        return AVERROR_INVALIDDATA;
+    if (strcmp(name, ic->iformat->name)) {
+        av_log(ic, AV_LOG_VERBOSE, "Stream info was exported for format %s\n", name);
+        return AVERROR(EINVAL);
+    }
+
+    ret = compute_fingerprint(ic, &input_size, digest);
+    if (ret < 0)
+        return ret;
+    if (input_size != stored_size || memcmp(digest, stored_digest, sizeof(digest))) {
+        av_log(ic, AV_LOG_VERBOSE, "Stream info was exported for a different input\n");
+        return AVERROR(EINVAL);
+    }
+
+    c = av_mallocz(sizeof(*c));
+    if (!c)
+        return AVERROR(ENOMEM);
+    c->start_time                 = avio_rb64(&pb);
+    c->duration                   = avio_rb64(&pb);
+    c->bit_rate                   = avio_rb64(&pb);
+    c->duration_estimation_method = avio_rb32(&pb);
+    c->nb_streams = avio_rb32(&pb);
+    if (c->nb_streams <= 0 || c->nb_streams > ic->max_streams) {
+        c->nb_streams = 0;
+        ret = AVERROR_INVALIDDATA;
+        goto fail;
+    }
+    c->streams = av_mallocz_array(c->nb_streams, sizeof(*c->streams));
+    if (!c->streams) {
+        c->nb_streams = 0;
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (i = 0; i < c->nb_streams; i++) {
+        ret = read_entry(&pb, &c->streams[i]);
+        if (ret < 0)
+            goto fail;
+    }
+    if (pb.eof_reached || avio_tell(&pb) != size) {
+        ret = AVERROR_INVALIDDATA;
+        goto fail;
+    }
+
+    ic->internal->stream_info_cache = c;
+    return 0;
+
+fail:
+    ff_stream_info_cache_free(&c);
+    return ret;
+}
+
+int ff_stream_info_cache_apply(AVFormatContext *s, AVStream *st)
+{
+    StreamInfoCache *c = s->internal->stream_info_cache;
+    StreamInfoEntry *e;
+    int i, ret;
+
+    if (!c || st->index >= c->nb_streams)
+        return 0;
+    e = &c->streams[st->index];
+    if (e->id != st->id || av_cmp_q(e->time_base, st->time_base))
+        return 0;
+
+    if (st->codecpar->codec_type != AVMEDIA_TYPE_UNKNOWN &&
+        st->codecpar->codec_type != e->par->codec_type &&
+        st->internal->request_probe <= 0)
+        return 0;
+
+    if (st->codecpar->codec_id != e->par->codec_id)
+        st->internal->need_context_update = 1;
+    ret = avcodec_parameters_copy(st->codecpar, e->par);
+    if (ret < 0)
+        return ret;
+    if (st->internal->request_probe > 0)
+        st->internal->request_probe = -1;
+
+    for (i = 0; i < e->nb_side_data; i++) {
+        const AVPacketSideData *sd = &e->side_data[i];
+        uint8_t *dst;
+
+        if (av_stream_get_side_data(st, sd->type, NULL))
+            continue;
+        dst = av_stream_new_side_data(st, sd->type, sd->size);
+        if (!dst)
+            return AVERROR(ENOMEM);
+        memcpy(dst, sd->data, sd->size);
+    }
+
+    st->start_time           = e->start_time;
+    st->duration             = e->duration;
+    st->disposition          = e->disposition;
+    st->sample_aspect_ratio  = e->sample_aspect_ratio;
+    st->avg_frame_rate       = e->avg_frame_rate;
+    st->r_frame_rate         = e->r_frame_rate;
+    st->codec_info_nb_frames = e->codec_info_nb_frames;
+
+    st->internal->avctx->time_base       = e->codec_time_base;
+    st->internal->avctx->framerate       = e->codec_framerate;
+    st->internal->avctx->ticks_per_frame = e->ticks_per_frame;
+
+    c->nb_applied++;
+    av_assert1(c->nb_applied <= c->nb_streams);
+    return 1;
+}
+
+int ff_stream_info_cache_complete(AVFormatContext *s)
+{
+    StreamInfoCache *c = s->internal->stream_info_cache;
+
+    return c && c->nb_applied == c->nb_streams && s->nb_streams == c->nb_streams;
+}
+
+void ff_stream_info_cache_apply_timings(AVFormatContext *s)
+{
+    StreamInfoCache *c = s->internal->stream_info_cache;
+
+    s->start_time                 = c->start_time;
+    s->duration                   = c->duration;
+    s->bit_rate                   = c->bit_rate;
+    s->duration_estimation_method = c->duration_estimation_method;
+}
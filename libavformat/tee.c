@@ -20,9 +20,15 @@
  */
 
 
+#include <stdatomic.h>
+
 #include "libavutil/avutil.h"
 #include "libavutil/avstring.h"
 #include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+#include "libavutil/time.h"
 #include "internal.h"
 #include "avformat.h"
 #include "avio_internal.h"
@@ -35,7 +41,18 @@ typedef enum {
 
 #define DEFAULT_SLAVE_FAILURE_POLICY ON_SLAVE_FAILURE_ABORT
 
+typedef enum {
+    ON_OVERFLOW_BLOCK = 0,
+    ON_OVERFLOW_DROP  = 1,
+} SlaveOverflowPolicy;
+
+typedef struct TeeMessage {
+    AVPacket pkt;
+    int flush;
+} TeeMessage;
+
 typedef struct {
+    const AVClass *class;
     AVFormatContext *avf;
     AVBSFContext **bsfs; ///< bitstream filters per stream
 
@@ -47,6 +64,35 @@ typedef struct {
      * disabled output streams are set to -1 */
     int *stream_map;
     int header_written;
+
+    /** slave specification, used to open it again on restart */
+    char *spec;
+
+    int use_thread;
+    int queue_size;
+    SlaveOverflowPolicy overflow;
+    int restart;
+    int64_t restart_delay;
+
+    /** copy of the tee muxer context and its streams, and the tee muxer
+     * fifo options, with which the slave thread opens the slave again on
+     * restart */
+    AVFormatContext *parent;
+    int reopen_use_fifo;
+    AVDictionary *reopen_fifo_options;
+    AVThreadMessageQueue *queue;
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+    int thread_started;
+    int thread_ret;
+    atomic_int stop;
+    /** per input stream, drop packets until the next keyframe:
+     * after a restart (used by the slave thread) */
+    uint8_t *wait_keyframe;
+    /** after a packet was dropped (used by the muxing thread) */
+    uint8_t *dropping;
+    int64_t nb_dropped;
 } TeeSlave;
 
 typedef struct TeeContext {
@@ -56,6 +102,11 @@ typedef struct TeeContext {
     TeeSlave *slaves;
     int use_fifo;
     AVDictionary *fifo_options;
+    int use_thread;
+    int queue_size;
+    int overflow;
+    int restart;
+    int64_t restart_delay;
 } TeeContext;
 
 static const char *const slave_delim     = "|";
@@ -68,6 +119,18 @@ static const AVOption options[] = {
          OFFSET(use_fifo), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
         {"fifo_options", "fifo pseudo-muxer options", OFFSET(fifo_options),
          AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, AV_OPT_FLAG_ENCODING_PARAM},
+        {"use_thread", "Write each slave output in its own thread",
+         OFFSET(use_thread), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
+        {"queue_size", "Number of packets queued for each slave thread",
+         OFFSET(queue_size), AV_OPT_TYPE_INT, {.i64 = 256}, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM},
+        {"overflow", "Behaviour when the queue of a slave thread is full",
+         OFFSET(overflow), AV_OPT_TYPE_INT, {.i64 = ON_OVERFLOW_BLOCK}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM, "overflow"},
+        {"block", "Wait for the slave", 0, AV_OPT_TYPE_CONST, {.i64 = ON_OVERFLOW_BLOCK}, 0, 0, AV_OPT_FLAG_ENCODING_PARAM, "overflow"},
+        {"drop",  "Drop packets",       0, AV_OPT_TYPE_CONST, {.i64 = ON_OVERFLOW_DROP},  0, 0, AV_OPT_FLAG_ENCODING_PARAM, "overflow"},
+        {"restart", "Reopen a slave output with a thread after a failure",
+         OFFSET(restart), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
+        {"restart_delay", "Delay before reopening a failed slave output",
+         OFFSET(restart_delay), AV_OPT_TYPE_DURATION, {.i64 = 1000000}, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM},
         {NULL}
 };
 
@@ -78,6 +141,26 @@ static const AVClass tee_muxer_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#define SLAVE_OFFSET(x) offsetof(TeeSlave, x)
+/* thread options that can be overridden for each slave */
+static const AVOption slave_options[] = {
+        {"use_thread", NULL, SLAVE_OFFSET(use_thread), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
+        {"queue_size", NULL, SLAVE_OFFSET(queue_size), AV_OPT_TYPE_INT, {.i64 = 256}, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM},
+        {"overflow", NULL, SLAVE_OFFSET(overflow), AV_OPT_TYPE_INT, {.i64 = ON_OVERFLOW_BLOCK}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM, "overflow"},
+        {"block", NULL, 0, AV_OPT_TYPE_CONST, {.i64 = ON_OVERFLOW_BLOCK}, 0, 0, AV_OPT_FLAG_ENCODING_PARAM, "overflow"},
+        {"drop",  NULL, 0, AV_OPT_TYPE_CONST, {.i64 = ON_OVERFLOW_DROP},  0, 0, AV_OPT_FLAG_ENCODING_PARAM, "overflow"},
+        {"restart", NULL, SLAVE_OFFSET(restart), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
+        {"restart_delay", NULL, SLAVE_OFFSET(restart_delay), AV_OPT_TYPE_DURATION, {.i64 = 1000000}, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM},
+        {NULL}
+};
+
+static const AVClass tee_slave_class = {
+    .class_name = "Tee slave",
+    .item_name  = av_default_item_name,
+    .option     = slave_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 static inline int parse_slave_failure_policy_option(const char *opt, TeeSlave *tee_slave)
 {
     if (!opt) {
@@ -118,7 +201,37 @@ static int parse_slave_fifo_options(const char *use_fifo,
     return ret;
 }
 
-static int close_slave(TeeSlave *tee_slave)
+static void free_message(void *msg)
+{
+    av_packet_unref(&((TeeMessage *)msg)->pkt);
+}
+
+/**
+ * Stop the slave thread after it has written the queued packets.
+ *
+ * @return the error which made the thread stop early, 0 if none
+ */
+static int stop_slave_thread(TeeSlave *tee_slave)
+{
+    int ret = 0;
+
+#if HAVE_THREADS
+    if (tee_slave->thread_started) {
+        atomic_store(&tee_slave->stop, 1);
+        av_thread_message_queue_set_err_recv(tee_slave->queue, AVERROR_EOF);
+        pthread_join(tee_slave->thread, NULL);
+        tee_slave->thread_started = 0;
+        ret = tee_slave->thread_ret;
+    }
+#endif
+    av_thread_message_queue_free(&tee_slave->queue);
+    avformat_free_context(tee_slave->parent);
+    tee_slave->parent = NULL;
+    av_dict_free(&tee_slave->reopen_fifo_options);
+    return ret;
+}
+
+static int close_slave_output(TeeSlave *tee_slave)
 {
     AVFormatContext *avf;
     unsigned i;
@@ -130,12 +243,12 @@ static int close_slave(TeeSlave *tee_slave)
 
     if (tee_slave->header_written)
         ret = av_write_trailer(avf);
+    tee_slave->header_written = 0;
 
     if (tee_slave->bsfs) {
         for (i = 0; i < avf->nb_streams; ++i)
             av_bsf_free(&tee_slave->bsfs[i]);
     }
-    av_freep(&tee_slave->stream_map);
     av_freep(&tee_slave->bsfs);
 
     ff_format_io_close(avf, &avf->pb);
@@ -144,11 +257,28 @@ static int close_slave(TeeSlave *tee_slave)
     return ret;
 }
 
+static int close_slave(TeeSlave *tee_slave)
+{
+    int ret, ret2;
+
+    ret  = stop_slave_thread(tee_slave);
+    ret2 = close_slave_output(tee_slave);
+    if (ret >= 0)
+        ret = ret2;
+    av_freep(&tee_slave->stream_map);
+    av_freep(&tee_slave->wait_keyframe);
+    av_freep(&tee_slave->dropping);
+    av_freep(&tee_slave->spec);
+    return ret;
+}
+
 static void close_slaves(AVFormatContext *avf)
 {
     TeeContext *tee = avf->priv_data;
     unsigned i;
 
+    if (!tee->slaves)
+        return;
     for (i = 0; i < tee->nb_slaves; i++) {
         close_slave(&tee->slaves[i]);
     }
@@ -185,6 +315,12 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
     STEAL_OPTION("onfail", on_fail);
     STEAL_OPTION("use_fifo", use_fifo);
     STEAL_OPTION("fifo_options", fifo_options_str);
+    tee_slave->class = &tee_slave_class;
+    ret = av_opt_set_dict(tee_slave, &options);
+    if (ret < 0) {
+        av_log(avf, AV_LOG_ERROR, "Invalid thread option for slave '%s'\n", slave);
+        goto end;
+    }
     entry = NULL;
     while ((entry = av_dict_get(options, "bsfs", entry, AV_DICT_IGNORE_SUFFIX))) {
         /* trim out strlen("bsfs") characters from key */
@@ -451,6 +587,266 @@ static int tee_process_slave_failure(AVFormatContext *avf, unsigned slave_idx, i
     }
 }
 
+/**
+ * Filter and write a packet of input stream pkt->stream_index to a slave,
+ * or flush it if pkt is NULL.
+ */
+static int write_slave_packet(AVFormatContext *avf, TeeSlave *tee_slave, AVPacket *pkt)
+{
+    AVFormatContext *avf2 = tee_slave->avf;
+    AVBSFContext *bsfs;
+    AVPacket pkt2;
+    int ret, s2;
+
+    if (!pkt)
+        return av_interleaved_write_frame(avf2, NULL);
+
+    s2 = tee_slave->stream_map[pkt->stream_index];
+    if (s2 < 0)
+        return 0;
+
+    if ((ret = av_packet_ref(&pkt2, pkt)) < 0)
+        return ret;
+    bsfs = tee_slave->bsfs[s2];
+    pkt2.stream_index = s2;
+
+    ret = av_bsf_send_packet(bsfs, &pkt2);
+    if (ret < 0) {
+        av_log(avf, AV_LOG_ERROR, "Error while sending packet to bitstream filter: %s\n",
+               av_err2str(ret));
+        av_packet_unref(&pkt2);
+        return ret;
+    }
+
+    while(1) {
+        ret = av_bsf_receive_packet(bsfs, &pkt2);
+        if (ret == AVERROR(EAGAIN)) {
+            ret = 0;
+            break;
+        } else if (ret < 0) {
+            break;
+        }
+
+        av_packet_rescale_ts(&pkt2, bsfs->time_base_out,
+                             avf2->streams[s2]->time_base);
+        ret = av_interleaved_write_frame(avf2, &pkt2);
+        if (ret < 0)
+            break;
+    };
+
+    return ret;
+}
+
+#if HAVE_THREADS
+/**
+ * Copy the parts of the tee muxer context open_slave() uses, so that the
+ * slave thread can open the slave again without accessing the tee muxer.
+ */
+static int copy_parent(AVFormatContext *avf, TeeSlave *tee_slave)
+{
+    TeeContext *tee = avf->priv_data;
+    AVFormatContext *parent;
+    unsigned i;
+    int ret;
+
+    if (!(parent = tee_slave->parent = avformat_alloc_context()))
+        return AVERROR(ENOMEM);
+    /* only used as the name of the context in log messages */
+    parent->oformat = avf->oformat;
+    parent->opaque  = avf->opaque;
+    parent->io_open  = avf->io_open;
+    parent->io_close = avf->io_close;
+    parent->interrupt_callback = avf->interrupt_callback;
+    parent->flags = avf->flags;
+    parent->strict_std_compliance = avf->strict_std_compliance;
+    if ((ret = av_dict_copy(&parent->metadata, avf->metadata, 0)) < 0)
+        return ret;
+    for (i = 0; i < avf->nb_streams; i++) {
+        AVStream *st = avformat_new_stream(parent, NULL);
+        if (!st)
+            return AVERROR(ENOMEM);
+        if ((ret = ff_stream_encode_params_copy(st, avf->streams[i])) < 0)
+            return ret;
+    }
+    tee_slave->reopen_use_fifo = tee->use_fifo;
+    return av_dict_copy(&tee_slave->reopen_fifo_options, tee->fifo_options, 0);
+}
+
+/**
+ * Open a slave again after a failure, with the same specification.
+ */
+static int reopen_slave(TeeSlave *tee_slave)
+{
+    TeeSlave tmp = { 0 };
+    char *spec;
+    int ret;
+
+    spec = av_strdup(tee_slave->spec);
+    if (!spec)
+        return AVERROR(ENOMEM);
+    tmp.use_fifo = tee_slave->reopen_use_fifo;
+    ret = av_dict_copy(&tmp.fifo_options, tee_slave->reopen_fifo_options, 0);
+    if (ret >= 0)
+        ret = open_slave(tee_slave->parent, spec, &tmp);
+    av_free(spec);
+    if (ret < 0) {
+        close_slave(&tmp);
+        return ret;
+    }
+
+    tee_slave->avf            = tmp.avf;
+    tee_slave->bsfs           = tmp.bsfs;
+    tee_slave->header_written = tmp.header_written;
+    av_freep(&tmp.stream_map);
+    return 0;
+}
+
+static int restart_slave(TeeSlave *tee_slave, int err)
+{
+    AVFormatContext *avf = tee_slave->parent;
+    int ret;
+
+    av_log(avf, AV_LOG_WARNING, "Slave '%s' failed: %s, restarting.\n",
+           tee_slave->spec, av_err2str(err));
+    close_slave_output(tee_slave);
+
+    for (;;) {
+        int64_t restart_time = av_gettime_relative() + tee_slave->restart_delay;
+
+        while (av_gettime_relative() < restart_time) {
+            if (atomic_load(&tee_slave->stop))
+                return err;
+            av_usleep(FFMIN(restart_time - av_gettime_relative(), 10000));
+        }
+        if (atomic_load(&tee_slave->stop))
+            return err;
+
+        ret = reopen_slave(tee_slave);
+        if (ret >= 0)
+            break;
+        av_log(avf, AV_LOG_WARNING, "Restarting slave '%s' failed: %s.\n",
+               tee_slave->spec, av_err2str(ret));
+    }
+
+    /* the new output must start with a keyframe in each stream */
+    memset(tee_slave->wait_keyframe, 1, avf->nb_streams);
+    av_log(avf, AV_LOG_INFO, "Slave '%s' restarted.\n", tee_slave->spec);
+    return 0;
+}
+
+static void *slave_thread(void *arg)
+{
+    TeeSlave *tee_slave = arg;
+    AVFormatContext *avf = tee_slave->parent;
+    TeeMessage msg;
+    int ret;
+
+    while (av_thread_message_queue_recv(tee_slave->queue, &msg, 0) >= 0) {
+        AVPacket *pkt = msg.flush ? NULL : &msg.pkt;
+
+        if (pkt && tee_slave->wait_keyframe[pkt->stream_index]) {
+            if (!(pkt->flags & AV_PKT_FLAG_KEY)) {
+                av_packet_unref(pkt);
+                continue;
+            }
+            tee_slave->wait_keyframe[pkt->stream_index] = 0;
+        }
+
+        ret = write_slave_packet(avf, tee_slave, pkt);
+        av_packet_unref(&msg.pkt);
+        if (ret < 0 && tee_slave->restart)
+            ret = restart_slave(tee_slave, ret);
+        if (ret < 0) {
+            /* reported to the muxing thread by its next packet, or when
+             * the thread is stopped */
+            tee_slave->thread_ret = ret;
+            av_thread_message_queue_set_err_send(tee_slave->queue, ret);
+            break;
+        }
+    }
+    return NULL;
+}
+#endif
+
+static int start_slave_thread(AVFormatContext *avf, TeeSlave *tee_slave)
+{
+#if HAVE_THREADS
+    int ret;
+
+    tee_slave->wait_keyframe = av_mallocz(avf->nb_streams);
+    tee_slave->dropping      = av_mallocz(avf->nb_streams);
+    if (!tee_slave->wait_keyframe || !tee_slave->dropping)
+        return AVERROR(ENOMEM);
+    if ((ret = copy_parent(avf, tee_slave)) < 0)
+        return ret;
+    ret = av_thread_message_queue_alloc2(&tee_slave->queue, tee_slave->queue_size,
+                                         sizeof(TeeMessage),
+                                         AV_THREAD_MESSAGE_QUEUE_SPSC);
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(tee_slave->queue, free_message);
+
+    atomic_init(&tee_slave->stop, 0);
+    tee_slave->thread_ret = 0;
+    ret = pthread_create(&tee_slave->thread, NULL, slave_thread, tee_slave);
+    if (ret) {
+        av_log(avf, AV_LOG_ERROR, "Failed to create slave thread: %s\n",
+               av_err2str(AVERROR(ret)));
+        return AVERROR(ret);
+    }
+    tee_slave->thread_started = 1;
+    return 0;
+#else
+    av_log(avf, AV_LOG_ERROR, "Slave threads are not supported by this build\n");
+    return AVERROR(ENOSYS);
+#endif
+}
+
+/**
+ * Queue a packet, or a flush request if pkt is NULL, for a slave thread.
+ */
+static int queue_slave_packet(AVFormatContext *avf, TeeSlave *tee_slave,
+                              unsigned slave_idx, AVPacket *pkt)
+{
+    TeeMessage msg = { { 0 } };
+    int ret, s = -1;
+
+    if (pkt) {
+        s = pkt->stream_index;
+        if (tee_slave->stream_map[s] < 0)
+            return 0;
+        /* after a drop, video cannot continue before the next keyframe */
+        if (tee_slave->dropping[s] && !(pkt->flags & AV_PKT_FLAG_KEY)) {
+            tee_slave->nb_dropped++;
+            return 0;
+        }
+        if ((ret = av_packet_ref(&msg.pkt, pkt)) < 0)
+            return ret;
+    } else {
+        msg.flush = 1;
+    }
+
+    ret = av_thread_message_queue_send(tee_slave->queue, &msg,
+                                       tee_slave->overflow == ON_OVERFLOW_DROP ?
+                                       AV_THREAD_MESSAGE_NONBLOCK : 0);
+    if (ret == AVERROR(EAGAIN)) {
+        av_packet_unref(&msg.pkt);
+        if (!tee_slave->nb_dropped++)
+            av_log(avf, AV_LOG_WARNING, "Queue of slave muxer #%u is full, "
+                   "dropping packets.\n", slave_idx);
+        if (s >= 0)
+            tee_slave->dropping[s] = 1;
+        return 0;
+    }
+    if (ret < 0) {
+        av_packet_unref(&msg.pkt);
+        return ret;
+    }
+    if (s >= 0)
+        tee_slave->dropping[s] = 0;
+    return 0;
+}
+
 static int tee_write_header(AVFormatContext *avf)
 {
     TeeContext *tee = avf->priv_data;
@@ -482,25 +878,40 @@ static int tee_write_header(AVFormatContext *avf)
 
     for (i = 0; i < nb_slaves; i++) {
 
-        tee->slaves[i].use_fifo = tee->use_fifo;
-        ret = av_dict_copy(&tee->slaves[i].fifo_options, tee->fifo_options, 0);
+        TeeSlave *tee_slave = &tee->slaves[i];
+
+        tee_slave->use_fifo = tee->use_fifo;
+        ret = av_dict_copy(&tee_slave->fifo_options, tee->fifo_options, 0);
         if (ret < 0)
             goto fail;
+        tee_slave->use_thread    = tee->use_thread;
+        tee_slave->queue_size    = tee->queue_size;
+        tee_slave->overflow      = tee->overflow;
+        tee_slave->restart       = tee->restart;
+        tee_slave->restart_delay = tee->restart_delay;
+        /* open_slave() modifies the specification */
+        tee_slave->spec = av_strdup(slaves[i]);
+        if (!tee_slave->spec) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
 
-        if ((ret = open_slave(avf, slaves[i], &tee->slaves[i])) < 0) {
+        if ((ret = open_slave(avf, slaves[i], tee_slave)) < 0 ||
+            (tee_slave->use_thread && (ret = start_slave_thread(avf, tee_slave)) < 0)) {
             ret = tee_process_slave_failure(avf, i, ret);
             if (ret < 0)
                 goto fail;
         } else {
-            log_slave(&tee->slaves[i], avf, AV_LOG_VERBOSE);
+            log_slave(tee_slave, avf, AV_LOG_VERBOSE);
         }
         av_freep(&slaves[i]);
     }
 
     for (i = 0; i < avf->nb_streams; i++) {
         int j, mapped = 0;
+        /* avf of slaves with a thread belongs to the thread */
         for (j = 0; j < tee->nb_slaves; j++)
-            if (tee->slaves[j].avf)
+            if (tee->slaves[j].stream_map)
                 mapped += tee->slaves[j].stream_map[i] >= 0;
         if (!mapped)
             av_log(avf, AV_LOG_WARNING, "Input stream #%d is not mapped "
@@ -524,6 +935,9 @@ static int tee_write_trailer(AVFormatContext *avf)
     unsigned i;
 
     for (i = 0; i < tee->nb_slaves; i++) {
+        if (tee->slaves[i].nb_dropped)
+            av_log(avf, AV_LOG_WARNING, "Slave muxer #%u: %"PRId64" packets dropped.\n",
+                   i, tee->slaves[i].nb_dropped);
         if ((ret = close_slave(&tee->slaves[i])) < 0) {
             ret = tee_process_slave_failure(avf, i, ret);
             if (!ret_all && ret < 0)
@@ -537,66 +951,19 @@ static int tee_write_trailer(AVFormatContext *avf)
 static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
 {
     TeeContext *tee = avf->priv_data;
-    AVFormatContext *avf2;
-    AVBSFContext *bsfs;
-    AVPacket pkt2;
     int ret_all = 0, ret;
-    unsigned i, s;
-    int s2;
+    unsigned i;
 
     for (i = 0; i < tee->nb_slaves; i++) {
-        if (!(avf2 = tee->slaves[i].avf))
-            continue;
-
-        /* Flush slave if pkt is NULL*/
-        if (!pkt) {
-            ret = av_interleaved_write_frame(avf2, NULL);
-            if (ret < 0) {
-                ret = tee_process_slave_failure(avf, i, ret);
-                if (!ret_all && ret < 0)
-                    ret_all = ret;
-            }
+        TeeSlave *tee_slave = &tee->slaves[i];
+
+        /* avf of slaves with a thread belongs to the thread */
+        if (tee_slave->thread_started)
+            ret = queue_slave_packet(avf, tee_slave, i, pkt);
+        else if (tee_slave->avf)
+            ret = write_slave_packet(avf, tee_slave, pkt);
+        else
             continue;
-        }
-
-        s = pkt->stream_index;
-        s2 = tee->slaves[i].stream_map[s];
-        if (s2 < 0)
-            continue;
-
-        if ((ret = av_packet_ref(&pkt2, pkt)) < 0)
-            if (!ret_all) {
-                ret_all = ret;
-                continue;
-            }
-        bsfs = tee->slaves[i].bsfs[s2];
-        pkt2.stream_index = s2;
-
-        ret = av_bsf_send_packet(bsfs, &pkt2);
-        if (ret < 0) {
-            av_log(avf, AV_LOG_ERROR, "Error while sending packet to bitstream filter: %s\n",
-                   av_err2str(ret));
-            ret = tee_process_slave_failure(avf, i, ret);
-            if (!ret_all && ret < 0)
-                ret_all = ret;
-        }
-
-        while(1) {
-            ret = av_bsf_receive_packet(bsfs, &pkt2);
-            if (ret == AVERROR(EAGAIN)) {
-                ret = 0;
-                break;
-            } else if (ret < 0) {
-                break;
-            }
-
-            av_packet_rescale_ts(&pkt2, bsfs->time_base_out,
-                                 avf2->streams[s2]->time_base);
-            ret = av_interleaved_write_frame(avf2, &pkt2);
-            if (ret < 0)
-                break;
-        };
-
         if (ret < 0) {
             ret = tee_process_slave_failure(avf, i, ret);
             if (!ret_all && ret < 0)
@@ -606,6 +973,11 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
     return ret_all;
 }
 
+static void tee_deinit(AVFormatContext *avf)
+{
+    close_slaves(avf);
+}
+
 AVOutputFormat ff_tee_muxer = {
     .name              = "tee",
     .long_name         = NULL_IF_CONFIG_SMALL("Multiple muxer tee"),
@@ -613,6 +985,7 @@ AVOutputFormat ff_tee_muxer = {
     .write_header      = tee_write_header,
     .write_trailer     = tee_write_trailer,
     .write_packet      = tee_write_packet,
+    .deinit            = tee_deinit,
     .priv_class        = &tee_muxer_class,
     .flags             = AVFMT_NOFILE | AVFMT_ALLOW_FLUSH | AVFMT_TS_NEGATIVE,
 };
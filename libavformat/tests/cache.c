@@ -0,0 +1,189 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program checks the persistent mode of the cache protocol with
+ * files: data read once is read from the cache the next time, and the least
+ * recently used entry is evicted when the cache grows over its limit.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/md5.h"
+#include "libavformat/avformat.h"
+#include "libavformat/internal.h"
+
+#define SIZE 65536
+
+static char cache_dir[1024];
+
+static uint8_t data_byte(int file, int pos)
+{
+    return pos * (file + 3) >> 3;
+}
+
+static int write_file(const char *path, int file)
+{
+    FILE *f = fopen(path, "wb");
+    int i, ret = 0;
+
+    if (!f)
+        return -1;
+    for (i = 0; i < SIZE; i++)
+        ret |= fputc(data_byte(file, i), f) < 0;
+    return fclose(f) || ret ? -1 : 0;
+}
+
+static int read_file(const char *path, int file, int64_t max_size)
+{
+    AVIOContext *pb = NULL;
+    AVDictionary *opts = NULL;
+    char url[1100];
+    uint8_t buf[SIZE];
+    int i, ret;
+
+    snprintf(url, sizeof(url), "cache:file:%s", path);
+    av_dict_set(&opts, "cache_dir", cache_dir, 0);
+    av_dict_set_int(&opts, "cache_max_size", max_size, 0);
+    ret = avio_open2(&pb, url, AVIO_FLAG_READ, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+    ret = avio_read(pb, buf, SIZE);
+    avio_closep(&pb);
+    if (ret != SIZE)
+        return -1;
+    for (i = 0; i < SIZE; i++)
+        if (buf[i] != data_byte(file, i))
+            return -1;
+    return 0;
+}
+
+/* read a "name value" line of the index of path */
+static int64_t index_value(const char *path, const char *name)
+{
+    char url[1100], idx[1200], line[256];
+    uint8_t md5[16];
+    int64_t value = -1;
+    const char *p;
+    FILE *f;
+
+    snprintf(url, sizeof(url), "file:%s", path);
+    av_md5_sum(md5, url, strlen(url));
+    ff_data_to_hex(line, md5, sizeof(md5), 1);
+    line[32] = 0;
+    snprintf(idx, sizeof(idx), "%s/%s.idx", cache_dir, line);
+    if (!(f = fopen(idx, "r")))
+        return -1;
+    while (fgets(line, sizeof(line), f))
+        if (av_strstart(line, name, &p) && *p == ' ')
+            value = strtoll(p + 1, NULL, 10);
+    fclose(f);
+    return value;
+}
+
+static int64_t total_size(void)
+{
+    char path[1100];
+    int64_t total = -1;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/size", cache_dir);
+    if ((f = fopen(path, "r"))) {
+        if (fscanf(f, "%"SCNd64, &total) != 1)
+            total = -1;
+        fclose(f);
+    }
+    return total;
+}
+
+static void clean_cache_dir(void)
+{
+    AVIODirContext *dir = NULL;
+    AVIODirEntry *de;
+    char path[1400];
+
+    if (avio_open_dir(&dir, cache_dir, NULL) < 0)
+        return;
+    while (avio_read_dir(dir, &de) >= 0 && de) {
+        if (de->type == AVIO_ENTRY_FILE) {
+            snprintf(path, sizeof(path), "%s/%s", cache_dir, de->name);
+            avpriv_io_delete(path);
+        }
+        avio_free_directory_entry(&de);
+    }
+    avio_close_dir(&dir);
+}
+
+int main(int argc, char **argv)
+{
+    const char *dir = argc > 1 ? argv[1] : ".";
+    char path[2][1024];
+    int i;
+
+    snprintf(cache_dir, sizeof(cache_dir), "%s/cache-test", dir);
+    clean_cache_dir();
+    for (i = 0; i < 2; i++) {
+        snprintf(path[i], sizeof(path[i]), "%s/cache-test-%d", dir, i);
+        if (write_file(path[i], i) < 0) {
+            fprintf(stderr, "cannot write %s\n", path[i]);
+            return 1;
+        }
+    }
+
+    /* first read: all data is downloaded */
+    if (read_file(path[0], 0, 0) < 0) {
+        fprintf(stderr, "first read failed\n");
+        return 2;
+    }
+    if (index_value(path[0], "misses") != SIZE || index_value(path[0], "hits") != 0 ||
+        total_size() != SIZE) {
+        fprintf(stderr, "wrong index after the first read\n");
+        return 3;
+    }
+
+    /* second read: all data comes from the cache */
+    if (read_file(path[0], 0, 0) < 0) {
+        fprintf(stderr, "cached read failed\n");
+        return 4;
+    }
+    if (index_value(path[0], "misses") != SIZE ||
+        index_value(path[0], "hits") != SIZE || total_size() != SIZE) {
+        fprintf(stderr, "data not read from the cache\n");
+        return 5;
+    }
+
+    /* reading another file exceeds the limit and evicts the first one */
+    if (read_file(path[1], 1, SIZE + SIZE / 2) < 0) {
+        fprintf(stderr, "read of the second file failed\n");
+        return 6;
+    }
+    if (index_value(path[0], "misses") != -1 || index_value(path[1], "misses") != SIZE ||
+        total_size() != SIZE) {
+        fprintf(stderr, "least recently used entry not evicted\n");
+        return 7;
+    }
+
+    clean_cache_dir();
+    for (i = 0; i < 2; i++)
+        avpriv_io_delete(path[i]);
+    return 0;
+}
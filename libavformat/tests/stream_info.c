@@ -0,0 +1,166 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program exports the stream info of a file, imports it when
+ * opening the file again, and checks that the streams are set up as by a
+ * full analysis. It also checks that damaged data or data of another
+ * input are rejected without affecting the analysis.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/mem.h"
+#include "libavformat/avformat.h"
+
+static int open_input(AVFormatContext **ic, const char *filename,
+                      const uint8_t *data, int size, int *import_ret)
+{
+    int ret;
+
+    *ic = NULL;
+    if ((ret = avformat_open_input(ic, filename, NULL, NULL)) < 0) {
+        fprintf(stderr, "cannot open %s: %s\n", filename, av_err2str(ret));
+        return ret;
+    }
+    if (data)
+        *import_ret = avformat_import_stream_info(*ic, data, size);
+    if ((ret = avformat_find_stream_info(*ic, NULL)) < 0)
+        fprintf(stderr, "cannot find the stream info: %s\n", av_err2str(ret));
+    return ret;
+}
+
+#define CHECK_COND(cond, x)                                      \
+    if (cond) {                                                  \
+        fprintf(stderr, "stream %d: " #x " differs\n", i);       \
+        return 1;                                                \
+    }
+#define CHECK(x)   CHECK_COND(a->x != b->x, x)
+/* 0/0 is the usual unknown frame rate, which av_cmp_q() does not order */
+#define CHECK_Q(x) CHECK_COND(a->x.num != b->x.num || a->x.den != b->x.den, x)
+
+static int compare_par(int i, const AVCodecParameters *a, const AVCodecParameters *b)
+{
+    CHECK(codec_type);
+    CHECK(codec_id);
+    CHECK(codec_tag);
+    CHECK(format);
+    CHECK(bit_rate);
+    CHECK(profile);
+    CHECK(level);
+    CHECK(width);
+    CHECK(height);
+    CHECK_Q(sample_aspect_ratio);
+    CHECK(field_order);
+    CHECK(video_delay);
+    CHECK(channel_layout);
+    CHECK(channels);
+    CHECK(sample_rate);
+    CHECK(frame_size);
+    CHECK(extradata_size);
+    if (a->extradata_size && memcmp(a->extradata, b->extradata, a->extradata_size)) {
+        fprintf(stderr, "stream %d: extradata differs\n", i);
+        return 1;
+    }
+    return 0;
+}
+
+static int compare(const AVFormatContext *ref, const AVFormatContext *ic)
+{
+    int i;
+
+    if (ref->nb_streams != ic->nb_streams || ref->start_time != ic->start_time ||
+        ref->duration != ic->duration) {
+        fprintf(stderr, "streams or timings differ\n");
+        return 1;
+    }
+    for (i = 0; i < ref->nb_streams; i++) {
+        const AVStream *a = ref->streams[i], *b = ic->streams[i];
+
+        CHECK(id);
+        CHECK_Q(time_base);
+        CHECK(start_time);
+        CHECK(duration);
+        CHECK_Q(avg_frame_rate);
+        CHECK_Q(r_frame_rate);
+        if (compare_par(i, a->codecpar, b->codecpar))
+            return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    AVFormatContext *ref = NULL, *ic = NULL;
+    uint8_t *data = NULL;
+    int size, import_ret, ret = 1;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s input\n", argv[0]);
+        return 1;
+    }
+
+    if (open_input(&ref, argv[1], NULL, 0, NULL) < 0)
+        goto end;
+    if ((import_ret = avformat_export_stream_info(ref, &data, &size)) < 0) {
+        fprintf(stderr, "cannot export the stream info: %s\n", av_err2str(import_ret));
+        goto end;
+    }
+
+    /* round trip */
+    if (open_input(&ic, argv[1], data, size, &import_ret) < 0)
+        goto end;
+    if (import_ret < 0) {
+        fprintf(stderr, "cannot import the stream info: %s\n", av_err2str(import_ret));
+        goto end;
+    }
+    if (compare(ref, ic))
+        goto end;
+    avformat_close_input(&ic);
+
+    /* truncated data */
+    if (open_input(&ic, argv[1], data, size - 1, &import_ret) < 0)
+        goto end;
+    if (import_ret != AVERROR_INVALIDDATA) {
+        fprintf(stderr, "truncated data not rejected: %s\n", av_err2str(import_ret));
+        goto end;
+    }
+    if (compare(ref, ic))
+        goto end;
+    avformat_close_input(&ic);
+
+    /* data of an input of a different size: the fingerprint starts after
+     * the tag, the version and the format name */
+    data[8 + strlen(ref->iformat->name) + 1 + 7] ^= 1;
+    if (open_input(&ic, argv[1], data, size, &import_ret) < 0)
+        goto end;
+    if (import_ret != AVERROR(EINVAL)) {
+        fprintf(stderr, "data of another input not rejected: %s\n", av_err2str(import_ret));
+        goto end;
+    }
+    if (compare(ref, ic))
+        goto end;
+
+    ret = 0;
+end:
+    av_free(data);
+    avformat_close_input(&ic);
+    avformat_close_input(&ref);
+    return ret;
+}
@@ -0,0 +1,124 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program sends datagrams of varying sizes over the loopback
+ * interface with batched output and input, and checks that they are all
+ * received in order: full batches are sent at once, a partial batch once
+ * batch_delay has passed, and the rest when the output is closed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+#include "libavformat/url.h"
+
+#define BATCH       4
+#define BATCH_DELAY 100000
+#define MAX_SIZE    1472
+
+static int datagram_size(int n)
+{
+    return 100 + n * 37 % (MAX_SIZE - 100);
+}
+
+static int send_datagrams(URLContext *out, int start, int nb)
+{
+    uint8_t buf[MAX_SIZE];
+    int i, ret;
+
+    for (i = start; i < start + nb; i++) {
+        memset(buf, i, sizeof(buf));
+        if ((ret = ffurl_write(out, buf, datagram_size(i))) < 0) {
+            fprintf(stderr, "sending datagram %d failed: %s\n", i, av_err2str(ret));
+            return ret;
+        }
+    }
+    return 0;
+}
+
+static int check_datagrams(URLContext *in, int start, int nb)
+{
+    uint8_t buf[MAX_SIZE + 1];
+    int i, j, ret;
+
+    for (i = start; i < start + nb; i++) {
+        ret = ffurl_read(in, buf, sizeof(buf));
+        if (ret < 0) {
+            fprintf(stderr, "datagram %d not received: %s\n", i, av_err2str(ret));
+            return ret;
+        }
+        for (j = 0; j < ret && buf[j] == (uint8_t)i; j++)
+            ;
+        if (ret != datagram_size(i) || j != ret) {
+            fprintf(stderr, "datagram %d received with wrong contents\n", i);
+            return AVERROR_INVALIDDATA;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    URLContext *in = NULL, *out = NULL;
+    char url[256];
+    /* different ports for concurrent runs of the test */
+    int port = 30000 + av_gettime() / 1000 % 10000;
+    int ret;
+
+    avformat_network_init();
+
+    snprintf(url, sizeof(url), "udp://127.0.0.1:%d?batch=8&timeout=2000000", port);
+    if ((ret = ffurl_open_whitelist(&in, url, AVIO_FLAG_READ, NULL, NULL,
+                                    NULL, NULL, NULL)) < 0) {
+        fprintf(stderr, "cannot open %s: %s\n", url, av_err2str(ret));
+        goto end;
+    }
+    snprintf(url, sizeof(url), "udp://127.0.0.1:%d?batch=%d&batch_delay=%d",
+             port, BATCH, BATCH_DELAY);
+    if ((ret = ffurl_open_whitelist(&out, url, AVIO_FLAG_WRITE, NULL, NULL,
+                                    NULL, NULL, NULL)) < 0) {
+        fprintf(stderr, "cannot open %s: %s\n", url, av_err2str(ret));
+        goto end;
+    }
+
+    /* two full batches are sent, two datagrams stay queued */
+    if ((ret = send_datagrams(out, 0, 2 * BATCH + 2)) < 0 ||
+        (ret = check_datagrams(in, 0, 2 * BATCH)) < 0)
+        goto end;
+
+    /* the next write sends the queue, which has waited long enough */
+    av_usleep(BATCH_DELAY * 3 / 2);
+    if ((ret = send_datagrams(out, 2 * BATCH + 2, 1)) < 0 ||
+        (ret = check_datagrams(in, 2 * BATCH, 3)) < 0)
+        goto end;
+
+    /* closing the output sends the queue */
+    if ((ret = send_datagrams(out, 2 * BATCH + 3, 2)) < 0)
+        goto end;
+    ffurl_closep(&out);
+    ret = check_datagrams(in, 2 * BATCH + 3, 2);
+
+end:
+    ffurl_closep(&out);
+    ffurl_closep(&in);
+    avformat_network_deinit();
+    return ret < 0;
+}
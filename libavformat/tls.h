@@ -53,6 +53,12 @@ typedef struct TLSShared {
 
 int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AVDictionary **options);
 
+/**
+ * Return the connection the TLS context h is layered on, NULL if it is not
+ * connected. Implemented by each TLS backend.
+ */
+URLContext *ff_tls_get_underlying(URLContext *h);
+
 void ff_gnutls_init(void);
 void ff_gnutls_deinit(void);
 
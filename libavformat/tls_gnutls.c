@@ -275,6 +275,12 @@ static int tls_get_short_seek(URLContext *h)
     return ffurl_get_short_seek(s->tls_shared.tcp);
 }
 
+URLContext *ff_tls_get_underlying(URLContext *h)
+{
+    TLSContext *s = h->priv_data;
+    return s->tls_shared.tcp;
+}
+
 static const AVOption options[] = {
     TLS_COMMON_OPTIONS(TLSContext, tls_shared),
     { NULL }
@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() and sendmmsg() */
 
 #include "avformat.h"
 #include "avio_internal.h"
@@ -70,6 +71,13 @@
 #include "libavutil/thread.h"
 #endif
 
+#if HAVE_SENDMMSG && defined(__linux__)
+#include <netinet/udp.h>
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT                                      103
+#endif
+#endif
+
 #ifndef IPV6_ADD_MEMBERSHIP
 #define IPV6_ADD_MEMBERSHIP IPV6_JOIN_GROUP
 #define IPV6_DROP_MEMBERSHIP IPV6_LEAVE_GROUP
@@ -79,6 +87,30 @@
 #define UDP_RX_BUF_SIZE 393216
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_BATCH_MAX 256
+#define UDP_CONTROL_SIZE 64
+#define UDP_GSO_MAX_SEGMENTS 64
+#define UDP_GSO_MAX_SIZE 65507
+
+/* size of the record header of a datagram in the circular buffer */
+#define UDP_FIFO_HEADER_SIZE(s) ((s)->timestamps ? 12 : 4)
+
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+/**
+ * Datagrams received or sent with a single recvmmsg()/sendmmsg() call.
+ */
+typedef struct UDPMsgBatch {
+    struct mmsghdr *msgs;
+    struct iovec *iov;
+    struct sockaddr_storage *addrs;
+    uint8_t *data;              ///< nb slots of slot_size bytes
+    uint8_t *control;           ///< nb slots of UDP_CONTROL_SIZE bytes
+    int nb;
+    int slot_size;
+    int count;                  ///< number of datagrams received or queued
+    int next;                   ///< next received datagram to return
+} UDPMsgBatch;
+#endif
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -117,6 +149,18 @@ typedef struct UDPContext {
     char *sources;
     char *block;
     IPSourceFilters filters;
+    int batch;
+    int batch_delay;
+    int gso;
+    int timestamps;
+    int64_t rx_timestamp;
+#if HAVE_RECVMMSG
+    UDPMsgBatch rx_batch;
+#endif
+#if HAVE_SENDMMSG
+    UDPMsgBatch tx_batch;
+    int64_t tx_batch_start;     ///< time the first queued datagram was written
+#endif
 } UDPContext;
 
 #define OFFSET(x) offsetof(UDPContext, x)
@@ -141,6 +185,11 @@ static const AVOption options[] = {
     { "timeout",        "set raise error timeout, in microseconds (only in read mode)",OFFSET(timeout),         AV_OPT_TYPE_INT,  {.i64 = 0}, 0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    { "batch",          "Number of datagrams received or sent per system call", OFFSET(batch),     AV_OPT_TYPE_INT,    { .i64 = 1 },      1, UDP_BATCH_MAX, D|E },
+    { "batch_delay",    "Maximum time a datagram is held back for batching when writing, in microseconds", OFFSET(batch_delay), AV_OPT_TYPE_INT, { .i64 = 1000 }, 0, INT_MAX, E },
+    { "gso",            "Send batched datagrams with UDP segmentation offload", OFFSET(gso),       AV_OPT_TYPE_BOOL,   { .i64 = 0 },      0, 1,       E },
+    { "timestamps",     "Capture the kernel receive time of the datagrams", OFFSET(timestamps),    AV_OPT_TYPE_BOOL,   { .i64 = 0 },      0, 1,       D },
+    { "rx_timestamp",   "Kernel receive time of the last datagram read, in microseconds since the epoch", OFFSET(rx_timestamp), AV_OPT_TYPE_INT64, { .i64 = AV_NOPTS_VALUE }, INT64_MIN, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { NULL }
 };
 
@@ -448,6 +497,249 @@ int ff_udp_get_local_port(URLContext *h)
     return s->local_port;
 }
 
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+static void udp_batch_free(UDPMsgBatch *b)
+{
+    av_freep(&b->msgs);
+    av_freep(&b->iov);
+    av_freep(&b->addrs);
+    av_freep(&b->data);
+    av_freep(&b->control);
+    b->nb = b->count = b->next = 0;
+}
+
+static int udp_batch_alloc(UDPMsgBatch *b, int nb, int slot_size)
+{
+    b->msgs    = av_calloc(nb, sizeof(*b->msgs));
+    b->iov     = av_calloc(nb, sizeof(*b->iov));
+    b->addrs   = av_calloc(nb, sizeof(*b->addrs));
+    b->data    = av_malloc_array(nb, slot_size);
+    b->control = av_calloc(nb, UDP_CONTROL_SIZE);
+    if (!b->msgs || !b->iov || !b->addrs || !b->data || !b->control) {
+        udp_batch_free(b);
+        return AVERROR(ENOMEM);
+    }
+    b->nb        = nb;
+    b->slot_size = slot_size;
+    b->count     = 0;
+    b->next      = 0;
+    return 0;
+}
+#endif
+
+#if HAVE_RECVMMSG
+static int64_t udp_msg_timestamp(struct msghdr *msg)
+{
+#ifdef SCM_TIMESTAMPNS
+    struct cmsghdr *cmsg;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            return ts.tv_sec * INT64_C(1000000) + ts.tv_nsec / 1000;
+        }
+    }
+#endif
+    return AV_NOPTS_VALUE;
+}
+
+/**
+ * Receive up to b->nb datagrams into the batch.
+ *
+ * @return number of datagrams received or a negative AVERROR code
+ */
+static int udp_batch_recv(int fd, UDPMsgBatch *b, int flags, int timestamps)
+{
+    int i, ret;
+
+    for (i = 0; i < b->nb; i++) {
+        struct msghdr *msg = &b->msgs[i].msg_hdr;
+
+        b->iov[i].iov_base  = b->data + (size_t)i * b->slot_size;
+        b->iov[i].iov_len   = b->slot_size;
+        msg->msg_name       = &b->addrs[i];
+        msg->msg_namelen    = sizeof(b->addrs[i]);
+        msg->msg_iov        = &b->iov[i];
+        msg->msg_iovlen     = 1;
+        msg->msg_control    = timestamps ? b->control + i * UDP_CONTROL_SIZE : NULL;
+        msg->msg_controllen = timestamps ? UDP_CONTROL_SIZE : 0;
+        msg->msg_flags      = 0;
+    }
+    b->count = b->next = 0;
+    ret = recvmmsg(fd, b->msgs, b->nb, flags, NULL);
+    if (ret < 0)
+        return ff_neterrno();
+    b->count = ret;
+    return ret;
+}
+#endif
+
+#if HAVE_SENDMMSG
+static void udp_batch_queue(UDPMsgBatch *b, const uint8_t *buf, int size)
+{
+    struct iovec *iov = &b->iov[b->count];
+
+    iov->iov_base = b->data + (size_t)b->count * b->slot_size;
+    iov->iov_len  = size;
+    memcpy(iov->iov_base, buf, size);
+    b->count++;
+}
+
+/**
+ * Set up the messages sending the queued datagrams from index start on.
+ * With GSO, runs of datagrams of the same size (the last one may be
+ * shorter) are sent as a single message segmented by the kernel.
+ *
+ * @return number of messages
+ */
+static int udp_batch_build(UDPContext *s, UDPMsgBatch *b, int start)
+{
+    int i = start, nb_msgs = 0;
+
+    while (i < b->count) {
+        struct msghdr *msg = &b->msgs[nb_msgs].msg_hdr;
+        size_t seg = b->iov[i].iov_len, total = seg;
+        int n = 1;
+
+        memset(msg, 0, sizeof(*msg));
+        if (!s->is_connected) {
+            msg->msg_name    = &s->dest_addr;
+            msg->msg_namelen = s->dest_addr_len;
+        }
+        msg->msg_iov = &b->iov[i];
+#ifdef UDP_SEGMENT
+        if (s->gso) {
+            while (i + n < b->count && n < UDP_GSO_MAX_SEGMENTS &&
+                   b->iov[i + n - 1].iov_len == seg &&
+                   b->iov[i + n].iov_len <= seg &&
+                   total + b->iov[i + n].iov_len <= UDP_GSO_MAX_SIZE) {
+                total += b->iov[i + n].iov_len;
+                n++;
+            }
+            if (n > 1) {
+                struct cmsghdr *cmsg;
+                uint16_t gso_size = seg;
+
+                msg->msg_control    = b->control + nb_msgs * UDP_CONTROL_SIZE;
+                msg->msg_controllen = CMSG_SPACE(sizeof(gso_size));
+                memset(msg->msg_control, 0, msg->msg_controllen);
+                cmsg = CMSG_FIRSTHDR(msg);
+                cmsg->cmsg_level = IPPROTO_UDP;
+                cmsg->cmsg_type  = UDP_SEGMENT;
+                cmsg->cmsg_len   = CMSG_LEN(sizeof(gso_size));
+                memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+            }
+        }
+#endif
+        msg->msg_iovlen = n;
+        i += n;
+        nb_msgs++;
+    }
+    return nb_msgs;
+}
+
+/**
+ * Send all the queued datagrams.
+ */
+static int udp_batch_send(URLContext *h, UDPMsgBatch *b)
+{
+    UDPContext *s = h->priv_data;
+    int start = 0;
+
+    while (start < b->count) {
+        int nb_msgs = udp_batch_build(s, b, start);
+        int sent = 0, i;
+
+        while (sent < nb_msgs) {
+            int ret = sendmmsg(s->udp_fd, b->msgs + sent, nb_msgs - sent, 0);
+            if (ret < 0) {
+                ret = ff_neterrno();
+                if (ret == AVERROR(EINTR))
+                    continue;
+                if (ret == AVERROR(EAGAIN)) {
+                    ff_network_wait_fd(s->udp_fd, 1);
+                    continue;
+                }
+                if (s->gso && (ret == AVERROR(EIO) || ret == AVERROR(EINVAL))) {
+                    /* the remaining datagrams are sent again without GSO */
+                    av_log(h, AV_LOG_WARNING, "UDP segmentation offload failed, disabling it\n");
+                    s->gso = 0;
+                    break;
+                }
+                b->count = 0;
+                return ret;
+            }
+            for (i = 0; i < ret; i++)
+                start += b->msgs[sent + i].msg_hdr.msg_iovlen;
+            sent += ret;
+        }
+    }
+    b->count = 0;
+    return 0;
+}
+#endif
+
+/**
+ * Receive a datagram without waiting, returning the datagrams of the
+ * last batch first when receiving in batches.
+ */
+static int udp_recv_datagram(URLContext *h, uint8_t *buf, int size,
+                             struct sockaddr_storage *addr, socklen_t *addr_len)
+{
+    UDPContext *s = h->priv_data;
+    int ret;
+
+#if HAVE_RECVMMSG
+    if (s->rx_batch.nb) {
+        UDPMsgBatch *b = &s->rx_batch;
+        struct mmsghdr *mmsg;
+
+        if (b->next >= b->count) {
+            ret = udp_batch_recv(s->udp_fd, b, MSG_DONTWAIT, s->timestamps);
+            if (ret < 0)
+                return ret;
+        }
+        mmsg = &b->msgs[b->next];
+        ret  = mmsg->msg_len;
+        if (ret > size) {
+            av_log(h, AV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
+            ret = size;
+        }
+        memcpy(buf, b->data + (size_t)b->next * b->slot_size, ret);
+        memcpy(addr, &b->addrs[b->next], sizeof(*addr));
+        *addr_len = mmsg->msg_hdr.msg_namelen;
+        s->rx_timestamp = s->timestamps ? udp_msg_timestamp(&mmsg->msg_hdr) : AV_NOPTS_VALUE;
+        b->next++;
+        return ret;
+    }
+#endif
+    ret = recvfrom(s->udp_fd, buf, size, 0, (struct sockaddr *)addr, addr_len);
+    return ret < 0 ? ff_neterrno() : ret;
+}
+
+int ff_udp_recv(URLContext *h, uint8_t *buf, int size,
+                struct sockaddr_storage *addr, socklen_t *addr_len,
+                int64_t *timestamp)
+{
+    UDPContext *s = h->priv_data;
+    int ret = udp_recv_datagram(h, buf, size, addr, addr_len);
+
+    if (ret >= 0 && timestamp)
+        *timestamp = s->rx_timestamp;
+    return ret;
+}
+
+int ff_udp_pending(URLContext *h)
+{
+#if HAVE_RECVMMSG
+    UDPContext *s = h->priv_data;
+    return s->rx_batch.next < s->rx_batch.count;
+#else
+    return 0;
+#endif
+}
+
 /**
  * Return the udp file handle for select() usage to wait for several RTP
  * streams at the same time.
@@ -460,6 +752,35 @@ static int udp_get_file_handle(URLContext *h)
 }
 
 #if HAVE_PTHREAD_CANCEL
+/* Called with the mutex held; a negative return value ends the thread. */
+static int circular_buffer_write(URLContext *h, const uint8_t *data, int len,
+                                 int64_t timestamp)
+{
+    UDPContext *s = h->priv_data;
+    int hdr_size = UDP_FIFO_HEADER_SIZE(s);
+    uint8_t hdr[12];
+
+    if(av_fifo_space(s->fifo) < len + hdr_size) {
+        /* No Space left */
+        if (s->overrun_nonfatal) {
+            av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                    "Surviving due to overrun_nonfatal option\n");
+            return 0;
+        } else {
+            av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                    "To avoid, increase fifo_size URL option. "
+                    "To survive in such case, use overrun_nonfatal option\n");
+            return AVERROR(EIO);
+        }
+    }
+    AV_WL32(hdr, len);
+    if (s->timestamps)
+        AV_WL64(hdr + 4, timestamp);
+    av_fifo_generic_write(s->fifo, hdr, hdr_size, NULL);
+    av_fifo_generic_write(s->fifo, (uint8_t *)data, len, NULL);
+    return 0;
+}
+
 static void *circular_buffer_task_rx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -474,7 +795,7 @@ static void *circular_buffer_task_rx( void *_URLContext)
         goto end;
     }
     while(1) {
-        int len;
+        int len, ret;
         struct sockaddr_storage addr;
         socklen_t addr_len = sizeof(addr);
 
@@ -483,35 +804,52 @@ static void *circular_buffer_task_rx( void *_URLContext)
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
+#if HAVE_RECVMMSG
+        if (s->rx_batch.nb)
+            /* only wait for the first datagram of the batch */
+            len = udp_batch_recv(s->udp_fd, &s->rx_batch, MSG_WAITFORONE, s->timestamps);
+        else
+#endif
         len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
+        if (len < 0)
+            len = ff_neterrno();
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
         pthread_mutex_lock(&s->mutex);
         if (len < 0) {
-            if (ff_neterrno() != AVERROR(EAGAIN) && ff_neterrno() != AVERROR(EINTR)) {
-                s->circular_buffer_error = ff_neterrno();
+            if (len != AVERROR(EAGAIN) && len != AVERROR(EINTR)) {
+                s->circular_buffer_error = len;
                 goto end;
             }
             continue;
         }
+#if HAVE_RECVMMSG
+        if (s->rx_batch.nb) {
+            UDPMsgBatch *b = &s->rx_batch;
+            int i;
+
+            for (i = 0; i < b->count; i++) {
+                struct mmsghdr *mmsg = &b->msgs[i];
+                if (ff_ip_check_source_lists(&b->addrs[i], &s->filters))
+                    continue;
+                ret = circular_buffer_write(h, b->data + (size_t)i * b->slot_size, mmsg->msg_len,
+                                            s->timestamps ? udp_msg_timestamp(&mmsg->msg_hdr) : AV_NOPTS_VALUE);
+                if (ret < 0) {
+                    s->circular_buffer_error = ret;
+                    goto end;
+                }
+            }
+            b->count = 0;
+            pthread_cond_signal(&s->cond);
+            continue;
+        }
+#endif
         if (ff_ip_check_source_lists(&addr, &s->filters))
             continue;
-        AV_WL32(s->tmp, len);
-
-        if(av_fifo_space(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
-                continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
-            }
+        ret = circular_buffer_write(h, s->tmp + 4, len, AV_NOPTS_VALUE);
+        if (ret < 0) {
+            s->circular_buffer_error = ret;
+            goto end;
         }
-        av_fifo_generic_write(s->fifo, s->tmp, len+4, NULL);
         pthread_cond_signal(&s->cond);
     }
 
@@ -556,6 +894,28 @@ static void *circular_buffer_task_tx( void *_URLContext)
             len = av_fifo_size(s->fifo);
         }
 
+#if HAVE_SENDMMSG
+        if (s->tx_batch.nb) {
+            UDPMsgBatch *b = &s->tx_batch;
+
+            /* take the datagrams already queued, up to a full batch */
+            len = 0;
+            do {
+                struct iovec *iov = &b->iov[b->count];
+                int size;
+
+                av_fifo_generic_read(s->fifo, tmp, 4, NULL);
+                size = AV_RL32(tmp);
+                av_assert0(size >= 0 && size <= b->slot_size);
+                iov->iov_base = b->data + (size_t)b->count * b->slot_size;
+                iov->iov_len  = size;
+                av_fifo_generic_read(s->fifo, iov->iov_base, size, NULL);
+                b->count++;
+                len += size;
+            } while (b->count < b->nb && av_fifo_size(s->fifo) >= 4);
+        } else
+#endif
+        {
         av_fifo_generic_read(s->fifo, tmp, 4, NULL);
         len = AV_RL32(tmp);
 
@@ -563,6 +923,7 @@ static void *circular_buffer_task_tx( void *_URLContext)
         av_assert0(len <= sizeof(s->tmp));
 
         av_fifo_generic_read(s->fifo, s->tmp, len, NULL);
+        }
 
         pthread_mutex_unlock(&s->mutex);
 
@@ -586,6 +947,18 @@ static void *circular_buffer_task_tx( void *_URLContext)
             target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
         }
 
+#if HAVE_SENDMMSG
+        if (s->tx_batch.nb) {
+            int ret = udp_batch_send(h, &s->tx_batch);
+            if (ret < 0) {
+                pthread_mutex_lock(&s->mutex);
+                s->circular_buffer_error = ret;
+                pthread_mutex_unlock(&s->mutex);
+                return NULL;
+            }
+            len = 0;
+        }
+#endif
         p = s->tmp;
         while (len) {
             int ret;
@@ -635,6 +1008,7 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     socklen_t len;
 
     h->is_streamed = 1;
+    s->rx_timestamp = AV_NOPTS_VALUE;
 
     is_output = !(flags & AVIO_FLAG_READ);
     if (s->buffer_size < 0)
@@ -719,6 +1093,18 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             if (ff_ip_parse_blocks(h, buf, &s->filters) < 0)
                 goto fail;
         }
+        if (av_find_info_tag(buf, sizeof(buf), "batch", p)) {
+            s->batch = av_clip(strtol(buf, NULL, 10), 1, UDP_BATCH_MAX);
+        }
+        if (is_output && av_find_info_tag(buf, sizeof(buf), "batch_delay", p)) {
+            s->batch_delay = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "gso", p)) {
+            s->gso = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "timestamps", p)) {
+            s->timestamps = strtol(buf, NULL, 10);
+        }
         if (!is_output && av_find_info_tag(buf, sizeof(buf), "timeout", p))
             s->timeout = strtol(buf, NULL, 10);
         if (is_output && av_find_info_tag(buf, sizeof(buf), "broadcast", p))
@@ -865,7 +1251,55 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
         /* make the socket non-blocking */
         ff_socket_nonblock(udp_fd, 1);
+
+        if (s->timestamps) {
+#if HAVE_RECVMMSG && defined(SO_TIMESTAMPNS)
+            tmp = 1;
+            if (setsockopt(udp_fd, SOL_SOCKET, SO_TIMESTAMPNS, &tmp, sizeof(tmp)) < 0) {
+                ff_log_net_error(h, AV_LOG_WARNING, "setsockopt(SO_TIMESTAMPNS)");
+                s->timestamps = 0;
+            }
+#else
+            av_log(h, AV_LOG_WARNING,
+                   "'timestamps' option was set but it is not supported on this build\n");
+            s->timestamps = 0;
+#endif
+        }
+        if (s->batch > 1 || s->timestamps) {
+#if HAVE_RECVMMSG
+            if (udp_batch_alloc(&s->rx_batch, s->batch, UDP_MAX_PKT_SIZE) < 0)
+                goto fail;
+#else
+            av_log(h, AV_LOG_WARNING,
+                   "'batch' option was set but it is not supported on this build "
+                   "(recvmmsg() is required)\n");
+#endif
+        }
+    }
+    if (is_output && s->batch > 1) {
+#if HAVE_SENDMMSG
+        /* datagrams from the circular buffer may be larger than pkt_size */
+        int slot_size = s->bitrate && s->circular_buffer_size ? UDP_MAX_PKT_SIZE : s->pkt_size;
+        if (slot_size <= 0 || udp_batch_alloc(&s->tx_batch, s->batch, slot_size) < 0)
+            goto fail;
+#else
+        av_log(h, AV_LOG_WARNING,
+               "'batch' option was set but it is not supported on this build "
+               "(sendmmsg() is required)\n");
+#endif
+    }
+#if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+    if (s->gso && !s->tx_batch.nb) {
+        av_log(h, AV_LOG_WARNING, "'gso' option requires batched output, ignoring it\n");
+        s->gso = 0;
+    }
+#else
+    if (s->gso) {
+        av_log(h, AV_LOG_WARNING,
+               "'gso' option was set but it is not supported on this build\n");
+        s->gso = 0;
     }
+#endif
     if (s->is_connected) {
         if (connect(udp_fd, (struct sockaddr *) &s->dest_addr, s->dest_addr_len)) {
             ff_log_net_error(h, AV_LOG_ERROR, "connect");
@@ -923,6 +1357,12 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         closesocket(udp_fd);
     av_fifo_freep(&s->fifo);
     ff_ip_reset_filters(&s->filters);
+#if HAVE_RECVMMSG
+    udp_batch_free(&s->rx_batch);
+#endif
+#if HAVE_SENDMMSG
+    udp_batch_free(&s->tx_batch);
+#endif
     return AVERROR(EIO);
 }
 
@@ -950,10 +1390,12 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
         do {
             avail = av_fifo_size(s->fifo);
             if (avail) { // >=size) {
-                uint8_t tmp[4];
+                uint8_t tmp[12];
 
-                av_fifo_generic_read(s->fifo, tmp, 4, NULL);
+                av_fifo_generic_read(s->fifo, tmp, UDP_FIFO_HEADER_SIZE(s), NULL);
                 avail = AV_RL32(tmp);
+                if (s->timestamps)
+                    s->rx_timestamp = AV_RL64(tmp + 4);
                 if(avail > size){
                     av_log(h, AV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
                     avail = size;
@@ -987,14 +1429,14 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
     }
 #endif
 
-    if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
+    if (!(h->flags & AVIO_FLAG_NONBLOCK) && !ff_udp_pending(h)) {
         ret = ff_network_wait_fd(s->udp_fd, 0);
         if (ret < 0)
             return ret;
     }
-    ret = recvfrom(s->udp_fd, buf, size, 0, (struct sockaddr *)&addr, &addr_len);
+    ret = udp_recv_datagram(h, buf, size, &addr, &addr_len);
     if (ret < 0)
-        return ff_neterrno();
+        return ret;
     if (ff_ip_check_source_lists(&addr, &s->filters))
         return AVERROR(EINTR);
     return ret;
@@ -1033,6 +1475,28 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
         pthread_mutex_unlock(&s->mutex);
         return size;
     }
+#endif
+#if HAVE_SENDMMSG
+    if (s->tx_batch.nb) {
+        /* datagrams too large for the batch are sent on their own, in order */
+        if (size > s->tx_batch.slot_size) {
+            if ((ret = udp_batch_send(h, &s->tx_batch)) < 0)
+                return ret;
+        } else {
+            int64_t now = av_gettime_relative();
+
+            /* the queue is sent when it is full, or on the first write once
+             * its oldest datagram has waited batch_delay */
+            if (!s->tx_batch.count)
+                s->tx_batch_start = now;
+            udp_batch_queue(&s->tx_batch, buf, size);
+            if ((s->tx_batch.count == s->tx_batch.nb ||
+                 now - s->tx_batch_start >= s->batch_delay) &&
+                (ret = udp_batch_send(h, &s->tx_batch)) < 0)
+                return ret;
+            return size;
+        }
+    }
 #endif
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 1);
@@ -1087,6 +1551,18 @@ static int udp_close(URLContext *h)
         pthread_mutex_destroy(&s->mutex);
         pthread_cond_destroy(&s->cond);
     }
+#endif
+#if HAVE_SENDMMSG
+    if (s->tx_batch.count) {
+        int ret = udp_batch_send(h, &s->tx_batch);
+        if (ret < 0)
+            av_log(h, AV_LOG_ERROR, "Failed to send the queued datagrams: %s\n",
+                   av_err2str(ret));
+    }
+    udp_batch_free(&s->tx_batch);
+#endif
+#if HAVE_RECVMMSG
+    udp_batch_free(&s->rx_batch);
 #endif
     closesocket(s->udp_fd);
     av_fifo_freep(&s->fifo);
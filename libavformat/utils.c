@@ -25,6 +25,7 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/cpu.h"
 #include "libavutil/dict.h"
 #include "libavutil/internal.h"
 #include "libavutil/mathematics.h"
@@ -314,6 +315,24 @@ int av_get_packet(AVIOContext *s, AVPacket *pkt, int size)
     return append_packet_chunked(s, pkt, size);
 }
 
+int ff_get_packet_zerocopy(AVIOContext *s, AVPacket *pkt, int size)
+{
+    int ret;
+
+    av_init_packet(pkt);
+    pkt->data = NULL;
+    pkt->size = 0;
+    pkt->pos  = avio_tell(s);
+
+    if ((ret = ffio_read_ref(s, &pkt->buf, &pkt->data, size))) {
+        if (ret > 0)
+            pkt->size = ret;
+        return ret;
+    }
+
+    return append_packet_chunked(s, pkt, size);
+}
+
 int av_append_packet(AVIOContext *s, AVPacket *pkt, int size)
 {
     if (!pkt->size)
@@ -464,6 +483,54 @@ int avformat_queue_attached_pictures(AVFormatContext *s)
     return 0;
 }
 
+#define MAX_PROBE_DECODE_THREADS 16
+
+typedef struct ProbeDecodeJob {
+    AVStream *st;
+    AVPacket *pkt;
+    int nb_frames;
+    struct ProbeDecodeJob *next;
+} ProbeDecodeJob;
+
+/**
+ * Threads decoding packets for avformat_find_stream_info().
+ *
+ * Only audio streams are decoded here, as their decoding state does not
+ * affect the timestamps computed when reading. A stream has at most one
+ * pending packet: before the stream is touched by the reading thread again
+ * (parsing, timestamp computation, analysis), wait_probe_decode() waits for
+ * it, so each stream sees the same sequence of operations as when decoding
+ * serially, and the results are identical.
+ */
+typedef struct ProbeDecodePool {
+#if HAVE_THREADS
+    pthread_t threads[MAX_PROBE_DECODE_THREADS];
+    int nb_threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t job_cond;
+    pthread_cond_t done_cond;
+#endif
+    ProbeDecodeJob *first, *last;
+    int exit;
+} ProbeDecodePool;
+
+/**
+ * Wait until the decoding of the pending packet of st, if any, is done.
+ */
+static void wait_probe_decode(AVFormatContext *s, AVStream *st)
+{
+#if HAVE_THREADS
+    ProbeDecodePool *pool = s->internal->probe_decode_pool;
+
+    if (!pool || !st->internal->info)
+        return;
+    pthread_mutex_lock(&pool->mutex);
+    while (st->internal->info->decode_pending)
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+#endif
+}
+
 static int update_stream_avctx(AVFormatContext *s)
 {
     int i, ret;
@@ -473,6 +540,8 @@ static int update_stream_avctx(AVFormatContext *s)
         if (!st->internal->need_context_update)
             continue;
 
+        wait_probe_decode(s, st);
+
         /* close parser, because it depends on the codec */
         if (st->parser && st->internal->avctx->codec_id != st->codecpar->codec_id) {
             av_parser_close(st->parser);
@@ -592,9 +661,13 @@ FF_ENABLE_DEPRECATION_WARNINGS
         ff_id3v2_read_dict(s->pb, &s->internal->id3v2_meta, ID3v2_DEFAULT_MAGIC, &id3v2_extra_meta);
 
 
-    if (!(s->flags&AVFMT_FLAG_PRIV_OPT) && s->iformat->read_header)
-        if ((ret = s->iformat->read_header(s)) < 0)
+    if (!(s->flags&AVFMT_FLAG_PRIV_OPT) && s->iformat->read_header) {
+        void *mem_tag = av_mem_tag_enter(s);
+        ret = s->iformat->read_header(s);
+        av_mem_tag_leave(mem_tag);
+        if (ret < 0)
             goto fail;
+    }
 
     if (!s->metadata) {
         s->metadata = s->internal->id3v2_meta;
@@ -794,6 +867,7 @@ static int update_wrap_reference(AVFormatContext *s, AVStream *st, int stream_in
 int ff_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     int ret, i, err;
+    void *mem_tag;
     AVStream *st;
 
     pkt->data = NULL;
@@ -817,7 +891,9 @@ int ff_read_packet(AVFormatContext *s, AVPacket *pkt)
             }
         }
 
+        mem_tag = av_mem_tag_enter(s);
         ret = s->iformat->read_packet(s, pkt);
+        av_mem_tag_leave(mem_tag);
         if (ret < 0) {
             av_packet_unref(pkt);
 
@@ -1525,8 +1601,10 @@ static int read_frame_internal(AVFormatContext *s, AVPacket *pkt)
             /* flush the parsers */
             for (i = 0; i < s->nb_streams; i++) {
                 st = s->streams[i];
-                if (st->parser && st->need_parsing)
+                if (st->parser && st->need_parsing) {
+                    wait_probe_decode(s, st);
                     parse_packet(s, pkt, st->index, 1);
+                }
             }
             /* all remaining packets are now in parse_queue =>
              * really terminate parsing */
@@ -1537,6 +1615,8 @@ static int read_frame_internal(AVFormatContext *s, AVPacket *pkt)
 
         st->event_flags |= AVSTREAM_EVENT_FLAG_NEW_PACKETS;
 
+        wait_probe_decode(s, st);
+
         /* update context if required */
         if (st->internal->need_context_update) {
             if (avcodec_is_open(st->internal->avctx)) {
@@ -2985,21 +3065,17 @@ static int has_codec_parameters(AVStream *st, const char **errmsg_ptr)
     return 1;
 }
 
-/* returns 1 or 0 if or if not decoded data was returned, or a negative error */
-static int try_decode_frame(AVFormatContext *s, AVStream *st,
-                            const AVPacket *avpkt, AVDictionary **options)
+/**
+ * Open the decoder of st for probing if it is not open yet.
+ *
+ * @return 0 if the decoder is open, a negative value otherwise
+ */
+static int open_probe_decoder(AVFormatContext *s, AVStream *st,
+                              AVDictionary **options)
 {
     AVCodecContext *avctx = st->internal->avctx;
     const AVCodec *codec;
-    int got_picture = 1, ret = 0;
-    AVFrame *frame = av_frame_alloc();
-    AVSubtitle subtitle;
-    AVPacket pkt = *avpkt;
-    int do_skip_frame = 0;
-    enum AVDiscard skip_frame;
-
-    if (!frame)
-        return AVERROR(ENOMEM);
+    int ret;
 
     if (!avcodec_is_open(avctx) &&
         st->internal->info->found_decoder <= 0 &&
@@ -3010,8 +3086,7 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st,
 
         if (!codec) {
             st->internal->info->found_decoder = -st->codecpar->codec_id;
-            ret                     = -1;
-            goto fail;
+            return -1;
         }
 
         /* Force thread count to 1 since the H.264 decoder will not extract
@@ -3024,16 +3099,42 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st,
             av_dict_free(&thread_opt);
         if (ret < 0) {
             st->internal->info->found_decoder = -avctx->codec_id;
-            goto fail;
+            return ret;
         }
         st->internal->info->found_decoder = 1;
     } else if (!st->internal->info->found_decoder)
         st->internal->info->found_decoder = 1;
 
-    if (st->internal->info->found_decoder < 0) {
-        ret = -1;
-        goto fail;
-    }
+    if (st->internal->info->found_decoder < 0)
+        return -1;
+    return 0;
+}
+
+/**
+ * @param nb_frames number of packets of st analyzed before this one
+ * @return 1 if decoding more of st may still provide information
+ */
+static int probe_decode_needed(AVStream *st, int nb_frames)
+{
+    AVCodecContext *avctx = st->internal->avctx;
+
+    return !has_codec_parameters(st, NULL) || !has_decode_delay_been_guessed(st) ||
+           (!nb_frames && (avctx->codec->capabilities & AV_CODEC_CAP_CHANNEL_CONF));
+}
+
+/* returns 1 or 0 if or if not decoded data was returned, or a negative error */
+static int probe_decode_packet(AVStream *st, const AVPacket *avpkt, int nb_frames)
+{
+    AVCodecContext *avctx = st->internal->avctx;
+    int got_picture = 1, ret = 0;
+    AVFrame *frame = av_frame_alloc();
+    AVSubtitle subtitle;
+    AVPacket pkt = *avpkt;
+    int do_skip_frame = 0;
+    enum AVDiscard skip_frame;
+
+    if (!frame)
+        return AVERROR(ENOMEM);
 
     if (avpriv_codec_get_cap_skip_frame_fill_param(avctx->codec)) {
         do_skip_frame = 1;
@@ -3042,10 +3143,7 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st,
     }
 
     while ((pkt.size > 0 || (!pkt.data && got_picture)) &&
-           ret >= 0 &&
-           (!has_codec_parameters(st, NULL) || !has_decode_delay_been_guessed(st) ||
-            (!st->codec_info_nb_frames &&
-             (avctx->codec->capabilities & AV_CODEC_CAP_CHANNEL_CONF)))) {
+           ret >= 0 && probe_decode_needed(st, nb_frames)) {
         got_picture = 0;
         if (avctx->codec_type == AVMEDIA_TYPE_VIDEO ||
             avctx->codec_type == AVMEDIA_TYPE_AUDIO) {
@@ -3077,7 +3175,6 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st,
     if (!pkt.data && !got_picture)
         ret = -1;
 
-fail:
     if (do_skip_frame) {
         avctx->skip_frame = skip_frame;
     }
@@ -3086,6 +3183,178 @@ fail:
     return ret;
 }
 
+/* returns 1 or 0 if or if not decoded data was returned, or a negative error */
+static int try_decode_frame(AVFormatContext *s, AVStream *st,
+                            const AVPacket *avpkt, AVDictionary **options)
+{
+    int ret = open_probe_decoder(s, st, options);
+
+    if (ret < 0)
+        return ret;
+    return probe_decode_packet(st, avpkt, st->codec_info_nb_frames);
+}
+
+#if HAVE_THREADS
+static void *probe_decode_thread(void *arg)
+{
+    ProbeDecodePool *pool = arg;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        ProbeDecodeJob *job;
+
+        while (!pool->first && !pool->exit)
+            pthread_cond_wait(&pool->job_cond, &pool->mutex);
+        if (!pool->first)
+            break;
+
+        job = pool->first;
+        pool->first = job->next;
+        if (!pool->first)
+            pool->last = NULL;
+        pthread_mutex_unlock(&pool->mutex);
+
+        probe_decode_packet(job->st, job->pkt, job->nb_frames);
+
+        pthread_mutex_lock(&pool->mutex);
+        job->st->internal->info->decode_pending = 0;
+        pthread_cond_broadcast(&pool->done_cond);
+        av_packet_free(&job->pkt);
+        av_free(job);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+/**
+ * Wait for all pending packets and stop the probe decode pool.
+ */
+static void probe_decode_pool_free(AVFormatContext *s)
+{
+    ProbeDecodePool *pool = s->internal->probe_decode_pool;
+    int i;
+
+    if (!pool)
+        return;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->exit = 1;
+    pthread_cond_broadcast(&pool->job_cond);
+    pthread_mutex_unlock(&pool->mutex);
+    for (i = 0; i < pool->nb_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+    av_assert0(!pool->first);
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->job_cond);
+    pthread_mutex_destroy(&pool->mutex);
+    av_freep(&s->internal->probe_decode_pool);
+}
+
+static int probe_decode_pool_init(AVFormatContext *s, int nb_threads)
+{
+    ProbeDecodePool *pool = av_mallocz(sizeof(*pool));
+    int ret;
+
+    if (!pool)
+        return AVERROR(ENOMEM);
+    if ((ret = pthread_mutex_init(&pool->mutex, NULL))) {
+        av_free(pool);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&pool->job_cond, NULL))) {
+        pthread_mutex_destroy(&pool->mutex);
+        av_free(pool);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&pool->done_cond, NULL))) {
+        pthread_cond_destroy(&pool->job_cond);
+        pthread_mutex_destroy(&pool->mutex);
+        av_free(pool);
+        return AVERROR(ret);
+    }
+    s->internal->probe_decode_pool = pool;
+
+    for (pool->nb_threads = 0; pool->nb_threads < nb_threads; pool->nb_threads++) {
+        ret = pthread_create(&pool->threads[pool->nb_threads], NULL,
+                             probe_decode_thread, pool);
+        if (ret) {
+            av_log(s, AV_LOG_WARNING, "Failed to create decoding thread: %s\n",
+                   av_err2str(AVERROR(ret)));
+            break;
+        }
+    }
+    if (!pool->nb_threads) {
+        probe_decode_pool_free(s);
+        return AVERROR(ret);
+    }
+    av_log(s, AV_LOG_DEBUG, "Decoding audio streams in %d threads\n", pool->nb_threads);
+    return 0;
+}
+
+static int submit_probe_decode(AVFormatContext *s, AVStream *st, const AVPacket *pkt)
+{
+    ProbeDecodePool *pool = s->internal->probe_decode_pool;
+    ProbeDecodeJob *job = av_mallocz(sizeof(*job));
+
+    if (!job)
+        return AVERROR(ENOMEM);
+    job->pkt = av_packet_clone(pkt);
+    if (!job->pkt) {
+        av_free(job);
+        return AVERROR(ENOMEM);
+    }
+    job->st        = st;
+    job->nb_frames = st->codec_info_nb_frames;
+
+    pthread_mutex_lock(&pool->mutex);
+    st->internal->info->decode_pending = 1;
+    if (pool->last)
+        pool->last->next = job;
+    else
+        pool->first = job;
+    pool->last = job;
+    pthread_cond_signal(&pool->job_cond);
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+#endif
+
+/**
+ * Decode pkt to find the parameters of st, like try_decode_frame().
+ *
+ * If the input has several audio streams, their packets are decoded in
+ * the probe decode pool, concurrently with reading and decoding the other
+ * streams.
+ */
+static void probe_decode(AVFormatContext *s, AVStream *st,
+                         const AVPacket *pkt, AVDictionary **options)
+{
+#if HAVE_THREADS
+    if (st->internal->avctx->codec_type == AVMEDIA_TYPE_AUDIO) {
+        if (!s->internal->probe_decode_pool) {
+            int i, nb_audio = 0;
+
+            for (i = 0; i < s->nb_streams; i++)
+                nb_audio += s->streams[i]->internal->avctx->codec_type == AVMEDIA_TYPE_AUDIO;
+            nb_audio = FFMIN3(nb_audio, av_cpu_count(), MAX_PROBE_DECODE_THREADS);
+            if (nb_audio > 1)
+                probe_decode_pool_init(s, nb_audio);
+        }
+        if (s->internal->probe_decode_pool) {
+            /* opening the decoder uses the options, keep it on this thread */
+            if (open_probe_decoder(s, st, options) < 0 ||
+                !probe_decode_needed(st, st->codec_info_nb_frames))
+                return;
+            if (submit_probe_decode(s, st, pkt) < 0)
+                probe_decode_packet(st, pkt, st->codec_info_nb_frames);
+            return;
+        }
+    }
+#endif
+    try_decode_frame(s, st, pkt, options);
+}
+
 unsigned int ff_codec_get_tag(const AVCodecTag *tags, enum AVCodecID id)
 {
     while (tags->id != AV_CODEC_ID_NONE) {
@@ -3546,6 +3815,23 @@ static int add_coded_side_data(AVStream *st, AVCodecContext *avctx)
     return 0;
 }
 
+/**
+ * Set the parameters of st from the imported stream info the first time
+ * the stream is seen.
+ *
+ * @return 1 if the parameters of st come from the imported stream info
+ */
+static int apply_stream_info_cache(AVFormatContext *ic, AVStream *st)
+{
+    if (!st->internal->info->from_cache) {
+        int ret = ff_stream_info_cache_apply(ic, st);
+        if (ret < 0)
+            av_log(ic, AV_LOG_WARNING, "Failed to apply stream info to stream %d\n", st->index);
+        st->internal->info->from_cache = ret > 0 ? 1 : -1;
+    }
+    return st->internal->info->from_cache > 0;
+}
+
 int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
 {
     int i, count = 0, ret = 0, j;
@@ -3590,6 +3876,8 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         st = ic->streams[i];
         avctx = st->internal->avctx;
 
+        apply_stream_info_cache(ic, st);
+
         if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO ||
             st->codecpar->codec_type == AVMEDIA_TYPE_SUBTITLE) {
 /*            if (!st->time_base.num)
@@ -3651,7 +3939,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
 
         // Try to just open decoders, in case this is enough to get parameters.
-        if (!has_codec_parameters(st, NULL) && st->internal->request_probe <= 0) {
+        if (!has_codec_parameters(st, NULL) && st->internal->request_probe <= 0 &&
+            st->internal->info->from_cache <= 0) {
             if (codec && !avctx->codec)
                 if (avcodec_open2(avctx, codec, options ? &options[i] : &thread_opt) < 0)
                     av_log(ic, AV_LOG_WARNING,
@@ -3685,6 +3974,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
             int count;
 
             st = ic->streams[i];
+            if (apply_stream_info_cache(ic, st))
+                continue;
+            wait_probe_decode(ic, st);
             if (!has_codec_parameters(st, NULL))
                 break;
             /* If the timebase is coarse (like the usual millisecond precision
@@ -3728,8 +4020,11 @@ FF_ENABLE_DEPRECATION_WARNINGS
             if (i == ic->nb_streams) {
                 analyzed_all_streams = 1;
                 /* NOTE: If the format has no header, then we need to read some
-                 * packets to get most of the streams, so we cannot stop here. */
-                if (!(ic->ctx_flags & AVFMTCTX_NOHEADER)) {
+                 * packets to get most of the streams, so we cannot stop here,
+                 * unless all the streams known from the imported stream info
+                 * have been found. */
+                if (!(ic->ctx_flags & AVFMTCTX_NOHEADER) ||
+                    ff_stream_info_cache_complete(ic)) {
                     /* If we found the info for all the codecs, we can stop. */
                     ret = count;
                     av_log(ic, AV_LOG_DEBUG, "All info found\n");
@@ -3782,6 +4077,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
             read_size += pkt->size;
 
         avctx = st->internal->avctx;
+        wait_probe_decode(ic, st);
+        apply_stream_info_cache(ic, st);
         if (!st->internal->avctx_inited) {
             ret = avcodec_parameters_to_context(avctx, st->codecpar);
             if (ret < 0)
@@ -3789,6 +4086,14 @@ FF_ENABLE_DEPRECATION_WARNINGS
             st->internal->avctx_inited = 1;
         }
 
+        /* parameters from the imported stream info need no analysis */
+        if (st->internal->info->from_cache > 0) {
+            if (ic->flags & AVFMT_FLAG_NOBUFFER)
+                av_packet_unref(&pkt1);
+            count++;
+            continue;
+        }
+
         if (pkt->dts != AV_NOPTS_VALUE && st->codec_info_nb_frames > 1) {
             /* check for non-increasing dts */
             if (st->internal->info->fps_last_dts != AV_NOPTS_VALUE &&
@@ -3885,8 +4190,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+        probe_decode(ic, st, pkt,
+                     (options && i < orig_nb_streams) ? &options[i] : NULL);
 
         if (ic->flags & AVFMT_FLAG_NOBUFFER)
             av_packet_unref(&pkt1);
@@ -3895,6 +4200,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
         count++;
     }
 
+#if HAVE_THREADS
+    probe_decode_pool_free(ic);
+#endif
+
     if (eof_reached) {
         int stream_index;
         for (stream_index = 0; stream_index < ic->nb_streams; stream_index++) {
@@ -4040,8 +4349,12 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
     }
 
-    if (probesize)
-        estimate_timings(ic, old_offset);
+    if (probesize) {
+        if (ff_stream_info_cache_complete(ic))
+            ff_stream_info_cache_apply_timings(ic);
+        else
+            estimate_timings(ic, old_offset);
+    }
 
     av_opt_set(ic, "skip_clear", "0", AV_OPT_SEARCH_CHILDREN);
 
@@ -4139,6 +4452,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
     }
 
 find_stream_info_err:
+#if HAVE_THREADS
+    probe_decode_pool_free(ic);
+#endif
+    ff_stream_info_cache_free(&ic->internal->stream_info_cache);
     for (i = 0; i < ic->nb_streams; i++) {
         st = ic->streams[i];
         if (st->internal->info)
@@ -4417,6 +4734,7 @@ void avformat_free_context(AVFormatContext *s)
     av_freep(&s->chapters);
     av_dict_free(&s->metadata);
     av_dict_free(&s->internal->id3v2_meta);
+    ff_stream_info_cache_free(&s->internal->stream_info_cache);
     av_freep(&s->streams);
     flush_packet_queue(s);
     av_freep(&s->internal);
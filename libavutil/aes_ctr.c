@@ -22,9 +22,12 @@
 #include "common.h"
 #include "aes_ctr.h"
 #include "aes.h"
+#include "intreadwrite.h"
 #include "random_seed.h"
 
 #define AES_BLOCK_SIZE (16)
+/* number of counter blocks encrypted with a single av_aes_crypt() call */
+#define AES_CTR_BATCH  (8)
 
 typedef struct AVAESCTR {
     struct AVAES* aes;
@@ -115,6 +118,26 @@ void av_aes_ctr_crypt(struct AVAESCTR *a, uint8_t *dst, const uint8_t *src, int
     uint8_t* encrypted_counter_pos;
 
     while (src < src_end) {
+        /* whole blocks are processed in batches, so that implementations
+         * which pipeline several blocks can do so */
+        if (a->block_offset == 0 && src_end - src >= AES_BLOCK_SIZE) {
+            uint8_t counters[AES_CTR_BATCH * AES_BLOCK_SIZE];
+            uint8_t keystream[AES_CTR_BATCH * AES_BLOCK_SIZE];
+            int i, nb_blocks = FFMIN((src_end - src) / AES_BLOCK_SIZE, AES_CTR_BATCH);
+
+            for (i = 0; i < nb_blocks; i++) {
+                memcpy(counters + i * AES_BLOCK_SIZE, a->counter, AES_BLOCK_SIZE);
+                av_aes_ctr_increment_be64(a->counter + 8);
+            }
+            av_aes_crypt(a->aes, keystream, counters, nb_blocks, NULL, 0);
+
+            for (i = 0; i < nb_blocks * AES_BLOCK_SIZE; i += 8)
+                AV_WN64(dst + i, AV_RN64(src + i) ^ AV_RN64(keystream + i));
+            src += nb_blocks * AES_BLOCK_SIZE;
+            dst += nb_blocks * AES_BLOCK_SIZE;
+            continue;
+        }
+
         if (a->block_offset == 0) {
             av_aes_crypt(a->aes, a->encrypted_counter, a->counter, 1, NULL, 0);
 
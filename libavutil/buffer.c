@@ -16,16 +16,37 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+
+#if HAVE_MADVISE
+#define _DEFAULT_SOURCE
+#endif
+
 #include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
+#if HAVE_MMAP && HAVE_MADVISE
+#include <sys/mman.h>
+#endif
+#if HAVE_LINUX_MEMPOLICY_H && HAVE_MADVISE
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include "avassert.h"
 #include "buffer_internal.h"
 #include "common.h"
 #include "mem.h"
+#include "mem_internal.h"
 #include "thread.h"
 
+#if HAVE_MMAP && HAVE_MADVISE && defined(MAP_ANONYMOUS)
+#define LARGE_BUFFER_MMAP 1
+#else
+#define LARGE_BUFFER_MMAP 0
+#endif
+
 AVBufferRef *av_buffer_create(uint8_t *data, int size,
                               void (*free)(void *opaque, uint8_t *data),
                               void *opaque, int flags)
@@ -90,6 +111,103 @@ AVBufferRef *av_buffer_allocz(int size)
     return ret;
 }
 
+#if LARGE_BUFFER_MMAP
+/* smaller buffers are not worth a system call */
+#define LARGE_BUFFER_MIN (1 << 20)
+/* the huge page size of x86 and of arm with 4 KiB base pages */
+#define HUGE_PAGE_SHIFT  21
+#define HUGE_PAGE_SIZE   (1 << HUGE_PAGE_SHIFT)
+/* a multiple of all common base page sizes */
+#define BASE_PAGE_ALIGN  (1 << 16)
+
+static void large_buffer_free(void *opaque, uint8_t *data)
+{
+    ff_mem_account_unmap(data);
+    munmap(data, (size_t)(uintptr_t)opaque);
+}
+
+static uint8_t *large_buffer_map(int size, size_t *len)
+{
+    uint8_t *data;
+    size_t head;
+
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+    /* explicit huge pages only exist if the administrator reserved some,
+     * and the mapping is rounded up to whole huge pages, so only use them
+     * if little memory is wasted; the size is requested explicitly, as the
+     * default huge page size may be larger, e.g. 512 MiB on arm with 64 KiB
+     * base pages, where the mapping fails if no 2 MiB pages exist */
+    *len = FFALIGN((size_t)size, HUGE_PAGE_SIZE);
+    if (*len - size <= size / 8) {
+        data = mmap(NULL, *len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+                    HUGE_PAGE_SHIFT << MAP_HUGE_SHIFT, -1, 0);
+        if (data != MAP_FAILED)
+            return data;
+    }
+#endif
+
+    /* transparent huge pages are only used for the aligned parts of a
+     * mapping, so map one huge page more and trim both ends */
+    *len = FFALIGN((size_t)size, BASE_PAGE_ALIGN);
+    data = mmap(NULL, *len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED)
+        return NULL;
+    head = -(uintptr_t)data & (HUGE_PAGE_SIZE - 1);
+    if (head)
+        munmap(data, head);
+    munmap(data + head + *len, HUGE_PAGE_SIZE - head);
+    data += head;
+#ifdef MADV_HUGEPAGE
+    madvise(data, *len, MADV_HUGEPAGE);
+#endif
+    return data;
+}
+
+static void large_buffer_bind(uint8_t *data, size_t len)
+{
+#if HAVE_LINUX_MEMPOLICY_H && defined(SYS_getcpu) && defined(SYS_mbind)
+    unsigned cpu, node;
+    unsigned long mask;
+
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) < 0 || node >= sizeof(mask) * 8)
+        return;
+    mask = 1UL << node;
+    /* a preference, the pages are taken from other nodes if this one is
+     * full; the kernel ignores the last bit of the mask, hence the +1 */
+    syscall(SYS_mbind, data, len, MPOL_PREFERRED, &mask, sizeof(mask) * 8 + 1, 0);
+#endif
+}
+#endif /* LARGE_BUFFER_MMAP */
+
+AVBufferRef *av_buffer_alloc_large(int size)
+{
+#if LARGE_BUFFER_MMAP
+    AVBufferRef *ret;
+    uint8_t *data;
+    size_t len;
+
+    if (size >= LARGE_BUFFER_MIN) {
+        /* anonymous mappings are zeroed, and the pages only get allocated
+         * when first written to, after the NUMA policy has been set */
+        data = large_buffer_map(size, &len);
+        if (data) {
+            large_buffer_bind(data, len);
+            ret = av_buffer_create(data, size, large_buffer_free,
+                                   (void *)(uintptr_t)len, 0);
+            if (!ret) {
+                munmap(data, len);
+                return NULL;
+            }
+            ff_mem_account_map(data, len);
+            return ret;
+        }
+    }
+#endif
+    return av_buffer_allocz(size);
+}
+
 AVBufferRef *av_buffer_ref(AVBufferRef *buf)
 {
     AVBufferRef *ret = av_mallocz(sizeof(*ret));
@@ -251,6 +369,7 @@ AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
         return NULL;
 
     ff_mutex_init(&pool->mutex, NULL);
+    atomic_init(&pool->free_list, 0);
 
     pool->size      = size;
     pool->opaque    = opaque;
@@ -270,6 +389,7 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
         return NULL;
 
     ff_mutex_init(&pool->mutex, NULL);
+    atomic_init(&pool->free_list, 0);
 
     pool->size     = size;
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
@@ -279,19 +399,65 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
     return pool;
 }
 
+static BufferPoolEntry *pool_entry(AVBufferPool *pool, uintptr_t index)
+{
+    int chunk = av_log2(index / BUFFER_POOL_CHUNK_SIZE + 1);
+
+    return &pool->entries[chunk][index - BUFFER_POOL_CHUNK_SIZE * (((uintptr_t)1 << chunk) - 1)];
+}
+
+static void pool_push_entry(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    unsigned long long head, new_head;
+
+    if (!BUFFER_POOL_LOCK_FREE)
+        ff_mutex_lock(&pool->mutex);
+    head = atomic_load_explicit(&pool->free_list, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&buf->next, head & BUFFER_POOL_INDEX_MASK, memory_order_relaxed);
+        new_head = (head & ~BUFFER_POOL_INDEX_MASK) + (BUFFER_POOL_INDEX_MASK + 1) +
+                   buf->index + 1;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_list, &head, new_head,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+    if (!BUFFER_POOL_LOCK_FREE)
+        ff_mutex_unlock(&pool->mutex);
+}
+
+/* must be called with the mutex held if BUFFER_POOL_LOCK_FREE is not set */
+static BufferPoolEntry *pool_pop_entry(AVBufferPool *pool)
+{
+    unsigned long long head = atomic_load_explicit(&pool->free_list, memory_order_acquire);
+    unsigned long long new_head;
+    BufferPoolEntry *buf;
+
+    do {
+        if (!(head & BUFFER_POOL_INDEX_MASK))
+            return NULL;
+        buf      = pool_entry(pool, (head & BUFFER_POOL_INDEX_MASK) - 1);
+        new_head = (head & ~BUFFER_POOL_INDEX_MASK) + (BUFFER_POOL_INDEX_MASK + 1) +
+                   atomic_load_explicit(&buf->next, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_list, &head, new_head,
+                                                    memory_order_acquire,
+                                                    memory_order_acquire));
+
+    return buf;
+}
+
 /*
  * This function gets called when the pool has been uninited and
  * all the buffers returned to it.
  */
 static void buffer_pool_free(AVBufferPool *pool)
 {
-    while (pool->pool) {
-        BufferPoolEntry *buf = pool->pool;
-        pool->pool = buf->next;
+    uintptr_t i;
 
+    for (i = 0; i < pool->nb_entries; i++) {
+        BufferPoolEntry *buf = pool_entry(pool, i);
         buf->free(buf->opaque, buf->data);
-        av_freep(&buf);
     }
+    for (i = 0; i < BUFFER_POOL_MAX_CHUNKS; i++)
+        av_freep(&pool->entries[i]);
     ff_mutex_destroy(&pool->mutex);
 
     if (pool->pool_free)
@@ -321,10 +487,7 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     if(CONFIG_MEMORY_POISONING)
         memset(buf->data, FF_MEMORY_POISON, pool->size);
 
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
+    pool_push_entry(pool, buf);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -336,20 +499,30 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
 {
     BufferPoolEntry *buf;
     AVBufferRef     *ret;
+    uintptr_t index = pool->nb_entries;
+    int chunk = av_log2(index / BUFFER_POOL_CHUNK_SIZE + 1);
 
     av_assert0(pool->alloc || pool->alloc2);
 
+    if (index >= BUFFER_POOL_INDEX_MASK || chunk >= BUFFER_POOL_MAX_CHUNKS)
+        return NULL;
+    if (!pool->entries[chunk]) {
+        pool->entries[chunk] = av_mallocz_array(BUFFER_POOL_CHUNK_SIZE << chunk,
+                                                sizeof(*pool->entries[chunk]));
+        if (!pool->entries[chunk])
+            return NULL;
+    }
+
     ret = pool->alloc2 ? pool->alloc2(pool->opaque, pool->size) :
                          pool->alloc(pool->size);
     if (!ret)
         return NULL;
 
-    buf = av_mallocz(sizeof(*buf));
-    if (!buf) {
-        av_buffer_unref(&ret);
-        return NULL;
-    }
+    buf = pool_entry(pool, index);
+    pool->nb_entries++;
 
+    buf->index  = index;
+    atomic_init(&buf->next, 0);
     buf->data   = ret->buffer->data;
     buf->opaque = ret->buffer->opaque;
     buf->free   = ret->buffer->free;
@@ -366,19 +539,20 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
     AVBufferRef *ret;
     BufferPoolEntry *buf;
 
-    ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
+    /* the mutex is only needed to grow the pool */
+    buf = BUFFER_POOL_LOCK_FREE ? pool_pop_entry(pool) : NULL;
+    if (!buf) {
+        ff_mutex_lock(&pool->mutex);
+        buf = pool_pop_entry(pool);
+        ret = buf ? NULL : pool_alloc_buffer(pool);
+        ff_mutex_unlock(&pool->mutex);
+    }
     if (buf) {
         ret = av_buffer_create(buf->data, pool->size, pool_release_buffer,
                                buf, 0);
-        if (ret) {
-            pool->pool = buf->next;
-            buf->next = NULL;
-        }
-    } else {
-        ret = pool_alloc_buffer(pool);
+        if (!ret)
+            pool_push_entry(pool, buf);
     }
-    ff_mutex_unlock(&pool->mutex);
 
     if (ret)
         atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
@@ -106,6 +106,23 @@ AVBufferRef *av_buffer_alloc(int size);
  */
 AVBufferRef *av_buffer_allocz(int size);
 
+/**
+ * Same as av_buffer_allocz(), except that the memory is optimized for large
+ * buffers such as video frames, which are accessed by many threads.
+ *
+ * Where supported, large buffers are mapped directly from the system,
+ * backed by huge pages to reduce TLB misses, and placed on the NUMA node
+ * of the calling thread. Explicit huge pages are used if the system has
+ * reserved some, transparent huge pages otherwise. Small buffers are
+ * allocated with av_buffer_allocz().
+ *
+ * The function has the signature expected by av_buffer_pool_init(), which
+ * is the intended use.
+ *
+ * @return an AVBufferRef of given size or NULL when out of memory
+ */
+AVBufferRef *av_buffer_alloc_large(int size);
+
 /**
  * Always treat the buffer as read-only, even when it has only one
  * reference.
@@ -71,12 +71,48 @@ typedef struct BufferPoolEntry {
     void (*free)(void *opaque, uint8_t *data);
 
     AVBufferPool *pool;
-    struct BufferPoolEntry *next;
+
+    /* position of the entry in the pool */
+    uintptr_t index;
+    /* index + 1 of the next entry in the free list, 0 for the last one */
+    atomic_uintptr_t next;
 } BufferPoolEntry;
 
+/*
+ * Entries are allocated in chunks which are never moved or freed before the
+ * pool, so that they can be referred to by index. Chunk k holds
+ * BUFFER_POOL_CHUNK_SIZE << k entries.
+ */
+#define BUFFER_POOL_CHUNK_SIZE 16
+#define BUFFER_POOL_MAX_CHUNKS 28
+
+/*
+ * The head of the free list holds the index + 1 of the first entry in the
+ * low 32 bits and a counter incremented on every change in the high 32 bits,
+ * so that an entry removed and put back between reading the head and
+ * replacing it is noticed (ABA problem). The counter must not wrap while a
+ * thread is preempted between the two, so the head is 64-bit on all
+ * targets, and the free list is protected by the mutex where 64-bit atomics
+ * are not lock-free.
+ */
+#if defined(ATOMIC_LLONG_LOCK_FREE) && ATOMIC_LLONG_LOCK_FREE == 2
+#define BUFFER_POOL_LOCK_FREE 1
+#else
+#define BUFFER_POOL_LOCK_FREE 0
+#endif
+#define BUFFER_POOL_INDEX_BITS 32
+#define BUFFER_POOL_INDEX_MASK ((1ULL << BUFFER_POOL_INDEX_BITS) - 1)
+
 struct AVBufferPool {
     AVMutex mutex;
-    BufferPoolEntry *pool;
+
+    /* list of the entries available for reuse, lock-free if
+     * BUFFER_POOL_LOCK_FREE is set and protected by mutex otherwise */
+    atomic_ullong free_list;
+
+    /* protected by mutex, only read by others for entries in the free list */
+    BufferPoolEntry *entries[BUFFER_POOL_MAX_CHUNKS];
+    uintptr_t nb_entries;
 
     /*
      * This is used to track when the pool is to be freed.
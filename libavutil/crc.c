@@ -25,6 +25,7 @@
 #include "bswap.h"
 #include "common.h"
 #include "crc.h"
+#include "crc_internal.h"
 
 #if CONFIG_HARDCODED_TABLES
 static const AVCRC av_crc_table[AV_CRC_MAX][257] = {
@@ -371,6 +372,22 @@ int av_crc_init(AVCRC *ctx, int le, int bits, uint32_t poly, int ctx_size)
     return 0;
 }
 
+/* accelerated functions for the tables in av_crc_table, picked once */
+static ff_crc_func crc_funcs[AV_CRC_MAX];
+static AVOnce crc_funcs_once = AV_ONCE_INIT;
+
+av_cold void ff_crc_init_funcs(ff_crc_func funcs[AV_CRC_MAX])
+{
+#if ARCH_X86
+    ff_crc_init_x86(funcs);
+#endif
+}
+
+static av_cold void crc_funcs_init(void)
+{
+    ff_crc_init_funcs(crc_funcs);
+}
+
 const AVCRC *av_crc_get_table(AVCRCId crc_id)
 {
 #if !CONFIG_HARDCODED_TABLES
@@ -386,6 +403,7 @@ const AVCRC *av_crc_get_table(AVCRCId crc_id)
     default: av_assert0(0);
     }
 #endif
+    ff_thread_once(&crc_funcs_once, crc_funcs_init);
     return av_crc_table[crc_id];
 }
 
@@ -394,6 +412,19 @@ uint32_t av_crc(const AVCRC *ctx, uint32_t crc,
 {
     const uint8_t *end = buffer + length;
 
+    if (length >= 64) {
+        uintptr_t offset = (uintptr_t)ctx - (uintptr_t)av_crc_table;
+
+        if (offset < sizeof(av_crc_table) && !(offset % sizeof(*av_crc_table))) {
+            ff_crc_func func = crc_funcs[offset / sizeof(*av_crc_table)];
+
+            if (func) {
+                crc     = func(ctx, crc, buffer, length);
+                buffer += length & ~15;
+            }
+        }
+    }
+
 #if !CONFIG_SMALL
     if (!ctx[256]) {
         while (((intptr_t) buffer & 3) && buffer < end)
@@ -0,0 +1,46 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_CRC_INTERNAL_H
+#define AVUTIL_CRC_INTERNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "crc.h"
+
+/**
+ * Update crc with the largest multiple of 16 bytes of buffer.
+ *
+ * @param ctx    table returned by av_crc_get_table() for the CRC the
+ *               function was set up for
+ * @param length must be at least 64
+ * @return the updated crc
+ */
+typedef uint32_t (*ff_crc_func)(const AVCRC *ctx, uint32_t crc,
+                                const uint8_t *buffer, size_t length);
+
+/**
+ * Set funcs[id] for each standard CRC id that can be computed faster than
+ * with the table on this CPU, leave the other entries unchanged.
+ */
+void ff_crc_init_funcs(ff_crc_func funcs[AV_CRC_MAX]);
+
+void ff_crc_init_x86(ff_crc_func funcs[AV_CRC_MAX]);
+
+#endif /* AVUTIL_CRC_INTERNAL_H */
@@ -18,6 +18,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <limits.h>
 #include <string.h>
 
 #include "avstring.h"
@@ -27,11 +28,136 @@
 #include "time_internal.h"
 #include "bprint.h"
 
+/**
+ * Dictionaries with at least this many entries get a hash index, smaller
+ * ones are searched linearly.
+ */
+#define DICT_INDEX_MIN_COUNT 16
+
+typedef struct DictIndexSlot {
+    uint32_t hash;
+    int      index;     ///< index into elems plus one, 0 for an empty slot
+} DictIndexSlot;
+
 struct AVDictionary {
     int count;
     AVDictionaryEntry *elems;
+    unsigned elems_size;    ///< allocated size of elems in bytes
+    /**
+     * Open addressing hash table with linear probing, mapping the
+     * case-insensitive hash of each key to its position in elems.
+     * The entries are still stored and iterated in elems order.
+     */
+    DictIndexSlot *index;
+    unsigned index_mask;
 };
 
+static uint32_t dict_hash(const char *key)
+{
+    uint32_t hash = 2166136261U;
+
+    while (*key)
+        hash = (hash ^ av_toupper((uint8_t)*key++)) * 16777619U;
+    return hash;
+}
+
+static unsigned dict_index_find(const AVDictionary *m, int idx)
+{
+    unsigned i = dict_hash(m->elems[idx].key) & m->index_mask;
+
+    while (m->index[i].index != idx + 1)
+        i = (i + 1) & m->index_mask;
+    return i;
+}
+
+static void dict_index_insert(AVDictionary *m, int idx)
+{
+    uint32_t hash = dict_hash(m->elems[idx].key);
+    unsigned i    = hash & m->index_mask;
+
+    while (m->index[i].index)
+        i = (i + 1) & m->index_mask;
+    m->index[i].hash  = hash;
+    m->index[i].index = idx + 1;
+}
+
+static void dict_index_build(AVDictionary *m, unsigned size)
+{
+    int i;
+
+    av_freep(&m->index);
+    m->index = av_mallocz_array(size, sizeof(*m->index));
+    if (!m->index)
+        return; /* the linear search keeps working */
+    m->index_mask = size - 1;
+    for (i = 0; i < m->count; i++)
+        dict_index_insert(m, i);
+}
+
+/* Must be called after elems[idx] has been added, with m->count updated */
+static void dict_index_add(AVDictionary *m, int idx)
+{
+    /* keep the load factor at or below 1/2 */
+    if (!m->index || 2 * m->count > m->index_mask + 1) {
+        unsigned size = 4 * DICT_INDEX_MIN_COUNT;
+
+        if (m->count < DICT_INDEX_MIN_COUNT || m->count > INT_MAX / 8) {
+            av_freep(&m->index);
+            return;
+        }
+        while (size < 4U * m->count)
+            size *= 2;
+        dict_index_build(m, size);
+    } else {
+        dict_index_insert(m, idx);
+    }
+}
+
+/* Must be called while elems[idx].key is still valid */
+static void dict_index_remove(AVDictionary *m, int idx)
+{
+    unsigned mask = m->index_mask;
+    unsigned i    = dict_index_find(m, idx);
+    unsigned j    = i;
+
+    /* backward shift deletion, so no tombstones are needed */
+    for (;;) {
+        unsigned home;
+
+        j = (j + 1) & mask;
+        if (!m->index[j].index)
+            break;
+        home = m->index[j].hash & mask;
+        if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+            continue;
+        m->index[i] = m->index[j];
+        i = j;
+    }
+    m->index[i].index = 0;
+}
+
+static AVDictionaryEntry *dict_index_get(const AVDictionary *m, const char *key,
+                                         int flags)
+{
+    AVDictionaryEntry *found = NULL;
+    uint32_t hash = dict_hash(key);
+    unsigned i;
+
+    /* with AV_DICT_MULTIKEY or case variants under AV_DICT_MATCH_CASE
+     * several entries can match, the first one in elems order wins */
+    for (i = hash & m->index_mask; m->index[i].index; i = (i + 1) & m->index_mask) {
+        AVDictionaryEntry *e = &m->elems[m->index[i].index - 1];
+
+        if (m->index[i].hash != hash || (found && e > found))
+            continue;
+        if (flags & AV_DICT_MATCH_CASE ? strcmp(e->key, key)
+                                       : av_strcasecmp(e->key, key))
+            continue;
+        found = e;
+    }
+    return found;
+}
+
 int av_dict_count(const AVDictionary *m)
 {
     return m ? m->count : 0;
@@ -45,6 +171,9 @@ AVDictionaryEntry *av_dict_get(const AVDictionary *m, const char *key,
     if (!m)
         return NULL;
 
+    if (m->index && !prev && !(flags & AV_DICT_IGNORE_SUFFIX))
+        return dict_index_get(m, key, flags);
+
     if (prev)
         i = prev - m->elems + 1;
     else
@@ -73,13 +202,18 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
     AVDictionary *m = *pm;
     AVDictionaryEntry *tag = NULL;
     char *oldval = NULL, *copy_key = NULL, *copy_value = NULL;
+    int reuse_key = 0;
 
     if (!(flags & AV_DICT_MULTIKEY)) {
         tag = av_dict_get(m, key, NULL, flags);
     }
     if (flags & AV_DICT_DONT_STRDUP_KEY)
         copy_key = (void *)key;
-    else
+    else if (tag && !strcmp(tag->key, key)) {
+        /* overwriting with an identical key keeps the existing string */
+        copy_key  = tag->key;
+        reuse_key = 1;
+    } else
         copy_key = av_strdup(key);
     if (flags & AV_DICT_DONT_STRDUP_VAL)
         copy_value = (void *)value;
@@ -92,7 +226,8 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
 
     if (tag) {
         if (flags & AV_DICT_DONT_OVERWRITE) {
-            av_free(copy_key);
+            if (!reuse_key)
+                av_free(copy_key);
             av_free(copy_value);
             return 0;
         }
@@ -100,14 +235,31 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
             oldval = tag->value;
         else
             av_free(tag->value);
-        av_free(tag->key);
+        if (m->index) {
+            int idx = tag - m->elems;
+
+            dict_index_remove(m, idx);
+            /* the last entry is moved into the freed slot */
+            if (idx != m->count - 1)
+                m->index[dict_index_find(m, m->count - 1)].index = idx + 1;
+        }
+        if (!reuse_key)
+            av_free(tag->key);
+        reuse_key = 0;
         *tag = m->elems[--m->count];
     } else if (copy_value) {
-        AVDictionaryEntry *tmp = av_realloc_array(m->elems,
-                                                  m->count + 1, sizeof(*m->elems));
-        if (!tmp)
+        AVDictionaryEntry *tmp;
+
+        if (m->count >= INT_MAX / (2 * sizeof(*m->elems)))
             goto err_out;
-        m->elems = tmp;
+        /* grow geometrically, frame metadata is built one key at a time */
+        if ((m->count + 1) * sizeof(*m->elems) > m->elems_size) {
+            tmp = av_fast_realloc(m->elems, &m->elems_size,
+                                  (m->count + 1 + m->count / 2) * sizeof(*m->elems));
+            if (!tmp)
+                goto err_out;
+            m->elems = tmp;
+        }
     }
     if (copy_value) {
         m->elems[m->count].key = copy_key;
@@ -124,11 +276,13 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
             av_freep(&copy_value);
         }
         m->count++;
+        dict_index_add(m, m->count - 1);
     } else {
         av_freep(&copy_key);
     }
     if (!m->count) {
         av_freep(&m->elems);
+        av_freep(&m->index);
         av_freep(pm);
     }
 
@@ -137,9 +291,11 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
 err_out:
     if (m && !m->count) {
         av_freep(&m->elems);
+        av_freep(&m->index);
         av_freep(pm);
     }
-    av_free(copy_key);
+    if (!reuse_key)
+        av_free(copy_key);
     av_free(copy_value);
     return AVERROR(ENOMEM);
 }
@@ -210,6 +366,7 @@ void av_dict_free(AVDictionary **pm)
             av_freep(&m->elems[m->count].value);
         }
         av_freep(&m->elems);
+        av_freep(&m->index);
     }
     av_freep(pm);
 }
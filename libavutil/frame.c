@@ -22,6 +22,7 @@
 #include "common.h"
 #include "dict.h"
 #include "frame.h"
+#include "frame_internal.h"
 #include "imgutils.h"
 #include "mem.h"
 #include "samplefmt.h"
@@ -735,6 +736,58 @@ AVFrameSideData *av_frame_new_side_data(AVFrame *frame,
     return ret;
 }
 
+#define SIDE_DATA_POOL_MIN_BITS  6
+#define SIDE_DATA_POOL_MAX_BITS 16
+
+struct FrameSideDataPools {
+    AVBufferPool *pools[SIDE_DATA_POOL_MAX_BITS - SIDE_DATA_POOL_MIN_BITS + 1];
+};
+
+AVFrameSideData *avpriv_frame_new_side_data_pooled(FrameSideDataPools **ppools,
+                                                   AVFrame *frame,
+                                                   enum AVFrameSideDataType type,
+                                                   int size)
+{
+    FrameSideDataPools *pools = *ppools;
+    AVFrameSideData *ret;
+    AVBufferRef *buf;
+    int i = 0;
+
+    if (size < 0 || size > 1 << SIDE_DATA_POOL_MAX_BITS)
+        return av_frame_new_side_data(frame, type, size);
+
+    if (!pools && !(pools = *ppools = av_mallocz(sizeof(*pools))))
+        return NULL;
+    while (size > 1 << (SIDE_DATA_POOL_MIN_BITS + i))
+        i++;
+    if (!pools->pools[i]) {
+        pools->pools[i] = av_buffer_pool_init(1 << (SIDE_DATA_POOL_MIN_BITS + i), NULL);
+        if (!pools->pools[i])
+            return NULL;
+    }
+
+    buf = av_buffer_pool_get(pools->pools[i]);
+    if (!buf)
+        return NULL;
+    buf->size = size;
+    ret = av_frame_new_side_data_from_buf(frame, type, buf);
+    if (!ret)
+        av_buffer_unref(&buf);
+    return ret;
+}
+
+void avpriv_frame_side_data_pools_free(FrameSideDataPools **ppools)
+{
+    FrameSideDataPools *pools = *ppools;
+    int i;
+
+    if (!pools)
+        return;
+    for (i = 0; i < FF_ARRAY_ELEMS(pools->pools); i++)
+        av_buffer_pool_uninit(&pools->pools[i]);
+    av_freep(ppools);
+}
+
 AVFrameSideData *av_frame_get_side_data(const AVFrame *frame,
                                         enum AVFrameSideDataType type)
 {
@@ -0,0 +1,48 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_FRAME_INTERNAL_H
+#define AVUTIL_FRAME_INTERNAL_H
+
+#include "frame.h"
+
+/**
+ * Buffer pools for the side data a decoder or filter attaches to every
+ * frame, one per power of two size. They belong to the decoder or filter
+ * and are freed with it; the side data of frames still in use keeps its
+ * pool alive until it is released.
+ */
+typedef struct FrameSideDataPools FrameSideDataPools;
+
+/**
+ * Like av_frame_new_side_data(), but take the payload from *pools, which
+ * are allocated on first use. Large payloads are allocated normally.
+ * The payload is not zeroed.
+ */
+AVFrameSideData *avpriv_frame_new_side_data_pooled(FrameSideDataPools **pools,
+                                                   AVFrame *frame,
+                                                   enum AVFrameSideDataType type,
+                                                   int size);
+
+/**
+ * Free the pools allocated by avpriv_frame_new_side_data_pooled() and set
+ * *pools to NULL.
+ */
+void avpriv_frame_side_data_pools_free(FrameSideDataPools **pools);
+
+#endif /* AVUTIL_FRAME_INTERNAL_H */
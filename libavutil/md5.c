@@ -30,12 +30,14 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <limits.h>
 #include <stdint.h>
 
 #include "bswap.h"
 #include "intreadwrite.h"
 #include "mem.h"
 #include "md5.h"
+#include "md5_internal.h"
 
 typedef struct AVMD5 {
     uint64_t len;
@@ -140,6 +142,82 @@ static void body(uint32_t ABCD[4], const uint8_t *src, int nblocks)
     }
 }
 
+#define MD5_LANES 4
+
+#define CORE_LANES(i, a, b, c, d)                                       \
+    do {                                                                \
+        t = S[i >> 4][i & 3];                                           \
+        for (l = 0; l < MD5_LANES; l++) {                               \
+            uint32_t x = a[l] + T[i];                                   \
+                                                                        \
+            if (i < 32) {                                               \
+                if (i < 16)                                             \
+                    x += (d[l] ^ (b[l] & (c[l] ^ d[l])))                \
+                         + AV_RL32(X[l] + 4 * (       i  & 15));        \
+                else                                                    \
+                    x += ((d[l] & b[l]) | (~d[l] & c[l]))               \
+                         + AV_RL32(X[l] + 4 * ((1 + 5*i) & 15));        \
+            } else {                                                    \
+                if (i < 48)                                             \
+                    x += (b[l] ^ c[l] ^ d[l])                           \
+                         + AV_RL32(X[l] + 4 * ((5 + 3*i) & 15));        \
+                else                                                    \
+                    x += (c[l] ^ (b[l] | ~d[l]))                        \
+                         + AV_RL32(X[l] + 4 * ((    7*i) & 15));        \
+            }                                                           \
+            a[l] = b[l] + (x << t | x >> (32 - t));                     \
+        }                                                               \
+    } while (0)
+
+/**
+ * Process one block for each of MD5_LANES independent hashes. MD5 is a
+ * long chain of dependent operations, interleaving several of them keeps
+ * more execution units busy.
+ */
+static void body_lanes(uint32_t *ABCD[MD5_LANES], const uint8_t *X[MD5_LANES])
+{
+    uint32_t a[MD5_LANES], b[MD5_LANES], c[MD5_LANES], d[MD5_LANES];
+    int i av_unused, l, t;
+
+    for (l = 0; l < MD5_LANES; l++) {
+        a[l] = ABCD[l][3];
+        b[l] = ABCD[l][2];
+        c[l] = ABCD[l][1];
+        d[l] = ABCD[l][0];
+    }
+
+#if CONFIG_SMALL
+    for (i = 0; i < 64; i++) {
+        CORE_LANES(i, a, b, c, d);
+        for (l = 0; l < MD5_LANES; l++) {
+            uint32_t tmp = d[l];
+            d[l] = c[l];
+            c[l] = b[l];
+            b[l] = a[l];
+            a[l] = tmp;
+        }
+    }
+#else
+#define CORE_LANES2(i)                                                  \
+    CORE_LANES(i, a, b, c, d); CORE_LANES((i + 1), d, a, b, c);         \
+    CORE_LANES((i + 2), c, d, a, b); CORE_LANES((i + 3), b, c, d, a)
+#define CORE_LANES4(i)                                                  \
+    CORE_LANES2(i); CORE_LANES2((i + 4));                               \
+    CORE_LANES2((i + 8)); CORE_LANES2((i + 12))
+    CORE_LANES4(0);
+    CORE_LANES4(16);
+    CORE_LANES4(32);
+    CORE_LANES4(48);
+#endif
+
+    for (l = 0; l < MD5_LANES; l++) {
+        ABCD[l][0] += d[l];
+        ABCD[l][1] += c[l];
+        ABCD[l][2] += b[l];
+        ABCD[l][3] += a[l];
+    }
+}
+
 void av_md5_init(AVMD5 *ctx)
 {
     ctx->len     = 0;
@@ -216,3 +294,64 @@ void av_md5_sum(uint8_t *dst, const uint8_t *src, size_t len)
     av_md5_update(&ctx, src, len);
     av_md5_final(&ctx, dst);
 }
+
+void avpriv_md5_sum_multi(uint8_t * const *dst, const uint8_t * const *src,
+                          const size_t *len, int nb)
+{
+    static const uint8_t zero_block[64];
+    uint32_t dummy_ABCD[4];
+    AVMD5 ctx[MD5_LANES];
+    int i, l;
+
+    for (i = 0; i < nb; i += MD5_LANES) {
+        int n = FFMIN(nb - i, MD5_LANES);
+        const uint8_t *pos[MD5_LANES];
+        size_t blocks[MD5_LANES];
+
+        for (l = 0; l < n; l++) {
+            av_md5_init(&ctx[l]);
+            pos[l]    = src[i + l];
+            blocks[l] = len[i + l] / 64;
+        }
+
+        /* hash full blocks in parallel while at least two hashes have some */
+        for (;;) {
+            uint32_t *ABCD[MD5_LANES];
+            const uint8_t *X[MD5_LANES];
+            int active = 0;
+
+            for (l = 0; l < MD5_LANES; l++) {
+                if (l < n && blocks[l]) {
+                    ABCD[l] = ctx[l].ABCD;
+                    X[l]    = pos[l];
+                    active++;
+                } else {
+                    ABCD[l] = dummy_ABCD;
+                    X[l]    = zero_block;
+                }
+            }
+            if (active < 2)
+                break;
+            body_lanes(ABCD, X);
+            for (l = 0; l < n; l++) {
+                if (blocks[l]) {
+                    pos[l] += 64;
+                    blocks[l]--;
+                }
+            }
+        }
+
+        for (l = 0; l < n; l++) {
+            size_t left = src[i + l] + len[i + l] - pos[l];
+
+            ctx[l].len = pos[l] - src[i + l];
+            while (left > 0) {
+                int size = FFMIN(left, INT_MAX & ~63);
+                av_md5_update(&ctx[l], pos[l], size);
+                pos[l] += size;
+                left   -= size;
+            }
+            av_md5_final(&ctx[l], dst[i + l]);
+        }
+    }
+}
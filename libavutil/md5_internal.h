@@ -0,0 +1,39 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_MD5_INTERNAL_H
+#define AVUTIL_MD5_INTERNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Hash several independent arrays of data.
+ *
+ * The arrays are hashed in parallel, which is faster than calling
+ * av_md5_sum() for each of them, e.g. for the planes of a video frame.
+ *
+ * @param dst array of nb output buffers, each receiving a 16-byte digest
+ * @param src array of nb pointers to the data to hash
+ * @param len array of nb lengths of the data, in bytes
+ * @param nb  number of arrays to hash
+ */
+void avpriv_md5_sum_multi(uint8_t * const *dst, const uint8_t * const *src,
+                          const size_t *len, int nb);
+
+#endif /* AVUTIL_MD5_INTERNAL_H */
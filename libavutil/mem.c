@@ -29,6 +29,7 @@
 #include "config.h"
 
 #include <limits.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -41,7 +42,9 @@
 #include "common.h"
 #include "dynarray.h"
 #include "intreadwrite.h"
+#include "log.h"
 #include "mem.h"
+#include "thread.h"
 
 #ifdef MALLOC_PREFIX
 
@@ -74,6 +77,347 @@ void av_max_alloc(size_t max){
     max_alloc_size = max;
 }
 
+/* the current tag is kept in thread-specific storage, which is only
+ * available with pthreads; without threads a global is used */
+#define MEM_ACCOUNTING (HAVE_PTHREADS || !HAVE_THREADS)
+
+typedef struct MemTag {
+    struct MemTag *next;
+    const char *name;
+    const char *item;   ///< the item name part of name
+    int64_t live;
+    int64_t peak;
+} MemTag;
+
+typedef struct MemBlock {
+    void   *ptr;    ///< NULL for an empty slot
+    size_t  size;
+    MemTag *tag;
+} MemBlock;
+
+/* The tags of the last contexts entered by a thread, so that entering a
+ * context again does not need to look up its tag by name. */
+#define MEM_TAG_CACHE_SIZE 16
+
+typedef struct MemTagCacheEntry {
+    const void    *avcl;
+    const AVClass *avc;
+    MemTag        *tag;
+} MemTagCacheEntry;
+
+typedef struct MemThread {
+    MemTag *tag;    ///< the current tag, NULL for "other"
+    MemTagCacheEntry cache[MEM_TAG_CACHE_SIZE];
+} MemThread;
+
+static atomic_int mem_accounting;
+
+/* Everything below is protected by mem_mutex. The tags are never freed,
+ * so that threads can keep pointers to them. The live blocks are kept in
+ * an open addressing hash table with linear probing, allocated with the
+ * system allocator to avoid recursing into the accounting. */
+static AVMutex   mem_mutex = AV_MUTEX_INITIALIZER;
+static MemTag    mem_tag_other = { .name = "other", .item = "other" };
+static MemTag   *mem_tags = &mem_tag_other;
+static int       mem_nb_tags = 1;
+static MemBlock *mem_blocks;
+static size_t    mem_blocks_mask;
+static size_t    mem_nb_blocks;
+
+#if HAVE_PTHREADS
+static pthread_key_t mem_tag_key;
+static AVOnce mem_tag_key_once = AV_ONCE_INIT;
+static int    mem_tag_key_ret;
+
+static void mem_thread_free(void *thread)
+{
+    free(thread);
+}
+
+static void mem_tag_key_init(void)
+{
+    mem_tag_key_ret = pthread_key_create(&mem_tag_key, mem_thread_free);
+}
+
+/* allocated with the system allocator, like the block table */
+static MemThread *mem_thread(void)
+{
+    MemThread *thread = pthread_getspecific(mem_tag_key);
+
+    if (!thread) {
+        thread = malloc(sizeof(*thread));
+        if (!thread)
+            return NULL;
+        memset(thread, 0, sizeof(*thread));
+        if (pthread_setspecific(mem_tag_key, thread)) {
+            free(thread);
+            return NULL;
+        }
+    }
+    return thread;
+}
+
+static MemTag *mem_current_tag(void)
+{
+    MemThread *thread = pthread_getspecific(mem_tag_key);
+    return thread && thread->tag ? thread->tag : &mem_tag_other;
+}
+#else
+static MemThread mem_thread_single;
+
+static MemThread *mem_thread(void)
+{
+    return &mem_thread_single;
+}
+
+static MemTag *mem_current_tag(void)
+{
+    return mem_thread_single.tag ? mem_thread_single.tag : &mem_tag_other;
+}
+#endif
+
+static void mem_set_current_tag(MemTag *tag)
+{
+    MemThread *thread = mem_thread();
+
+    if (thread)
+        thread->tag = tag;
+}
+
+static size_t mem_block_hash(const void *ptr)
+{
+    return (((uint64_t)(uintptr_t)ptr >> 4) * 0x9E3779B97F4A7C15ULL) >> 32;
+}
+
+static void mem_block_insert(MemBlock *blocks, size_t mask, const MemBlock *block)
+{
+    size_t i = mem_block_hash(block->ptr) & mask;
+
+    while (blocks[i].ptr)
+        i = (i + 1) & mask;
+    blocks[i] = *block;
+}
+
+static void mem_block_add(void *ptr, size_t size, MemTag *tag)
+{
+    MemBlock block = { ptr, size, tag };
+
+    if (!mem_blocks)
+        return;
+
+    /* keep the load factor at or below 1/2 */
+    if (2 * (mem_nb_blocks + 1) > mem_blocks_mask + 1) {
+        size_t i, mask = 2 * mem_blocks_mask + 1;
+        MemBlock *blocks = malloc((mask + 1) * sizeof(*blocks));
+
+        if (!blocks)
+            return;
+        memset(blocks, 0, (mask + 1) * sizeof(*blocks));
+        for (i = 0; i <= mem_blocks_mask; i++)
+            if (mem_blocks[i].ptr)
+                mem_block_insert(blocks, mask, &mem_blocks[i]);
+        free(mem_blocks);
+        mem_blocks      = blocks;
+        mem_blocks_mask = mask;
+    }
+
+    mem_block_insert(mem_blocks, mem_blocks_mask, &block);
+    mem_nb_blocks++;
+    tag->live += size;
+    tag->peak  = FFMAX(tag->peak, tag->live);
+}
+
+static int mem_block_remove(void *ptr, MemBlock *block)
+{
+    size_t mask = mem_blocks_mask, i, j;
+
+    if (!mem_blocks)
+        return 0;
+
+    for (i = mem_block_hash(ptr) & mask; mem_blocks[i].ptr != ptr; i = (i + 1) & mask)
+        if (!mem_blocks[i].ptr)
+            return 0;
+    *block = mem_blocks[i];
+    block->tag->live -= block->size;
+    mem_nb_blocks--;
+
+    /* backward shift deletion */
+    for (j = i;;) {
+        size_t home;
+
+        j = (j + 1) & mask;
+        if (!mem_blocks[j].ptr)
+            break;
+        home = mem_block_hash(mem_blocks[j].ptr) & mask;
+        if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+            continue;
+        mem_blocks[i] = mem_blocks[j];
+        i = j;
+    }
+    mem_blocks[i].ptr = NULL;
+    return 1;
+}
+
+static void mem_account_alloc(void *ptr, size_t size)
+{
+    MemTag *tag = mem_current_tag();
+
+    ff_mutex_lock(&mem_mutex);
+    mem_block_add(ptr, size, tag);
+    ff_mutex_unlock(&mem_mutex);
+}
+
+static void mem_account_free(void *ptr)
+{
+    MemBlock block;
+
+    ff_mutex_lock(&mem_mutex);
+    mem_block_remove(ptr, &block);
+    ff_mutex_unlock(&mem_mutex);
+}
+
+int av_mem_accounting_enable(int enable)
+{
+    MemTag *tag;
+
+    if (!MEM_ACCOUNTING)
+        return AVERROR(ENOSYS);
+
+    if (!enable) {
+        atomic_store(&mem_accounting, 0);
+        ff_mutex_lock(&mem_mutex);
+        free(mem_blocks);
+        mem_blocks = NULL;
+        ff_mutex_unlock(&mem_mutex);
+        return 0;
+    }
+
+#if HAVE_PTHREADS
+    if (ff_thread_once(&mem_tag_key_once, mem_tag_key_init) || mem_tag_key_ret)
+        return AVERROR(ENOSYS);
+#endif
+
+    ff_mutex_lock(&mem_mutex);
+    if (!mem_blocks) {
+        mem_blocks_mask = 4095;
+        mem_nb_blocks   = 0;
+        mem_blocks      = malloc((mem_blocks_mask + 1) * sizeof(*mem_blocks));
+        if (!mem_blocks) {
+            ff_mutex_unlock(&mem_mutex);
+            return AVERROR(ENOMEM);
+        }
+        memset(mem_blocks, 0, (mem_blocks_mask + 1) * sizeof(*mem_blocks));
+        for (tag = mem_tags; tag; tag = tag->next)
+            tag->live = tag->peak = 0;
+    }
+    ff_mutex_unlock(&mem_mutex);
+
+    atomic_store(&mem_accounting, 1);
+    return 0;
+}
+
+static MemTag *mem_tag_get(void *avcl)
+{
+    const AVClass *avc = avcl ? *(const AVClass **)avcl : NULL;
+    MemThread *thread = mem_thread();
+    MemTagCacheEntry *entry = NULL;
+    const char *item;
+    MemTag *tag;
+    char name[128];
+    size_t len;
+
+    if (!avc)
+        return &mem_tag_other;
+    item = avc->item_name(avcl);
+
+    /* the item name of a context may change, e.g. when a codec is opened */
+    if (thread) {
+        entry = &thread->cache[mem_block_hash(avcl) & (MEM_TAG_CACHE_SIZE - 1)];
+        if (entry->avcl == avcl && entry->avc == avc && !strcmp(entry->tag->item, item))
+            return entry->tag;
+    }
+
+    snprintf(name, sizeof(name), "%s:%s", avc->class_name, item);
+
+    ff_mutex_lock(&mem_mutex);
+    for (tag = mem_tags; tag; tag = tag->next)
+        if (!strcmp(tag->name, name))
+            break;
+    if (!tag) {
+        len = strlen(name) + 1;
+        tag = malloc(sizeof(*tag) + len);
+        if (tag) {
+            memset(tag, 0, sizeof(*tag));
+            tag->name = memcpy(tag + 1, name, len);
+            tag->item = tag->name + FFMIN(strlen(avc->class_name) + 1, len - 1);
+            tag->next = mem_tags;
+            mem_tags  = tag;
+            mem_nb_tags++;
+        }
+    }
+    ff_mutex_unlock(&mem_mutex);
+
+    if (!tag)
+        return &mem_tag_other;
+    if (entry) {
+        entry->avcl = avcl;
+        entry->avc  = avc;
+        entry->tag  = tag;
+    }
+    return tag;
+}
+
+void *av_mem_tag_enter(void *avcl)
+{
+    MemTag *prev;
+
+    if (!atomic_load_explicit(&mem_accounting, memory_order_acquire))
+        return NULL;
+
+    prev = mem_current_tag();
+    mem_set_current_tag(mem_tag_get(avcl));
+    return prev;
+}
+
+void av_mem_tag_leave(void *prev)
+{
+    if (!atomic_load_explicit(&mem_accounting, memory_order_acquire))
+        return;
+
+    mem_set_current_tag(prev ? prev : &mem_tag_other);
+}
+
+int av_mem_get_stats(AVMemTagStats **pstats, int *nb_stats)
+{
+    AVMemTagStats *stats;
+    MemTag *tag;
+    int i, nb;
+
+    ff_mutex_lock(&mem_mutex);
+    nb = mem_nb_tags;
+    ff_mutex_unlock(&mem_mutex);
+
+    stats = av_malloc_array(nb, sizeof(*stats));
+    if (!stats)
+        return AVERROR(ENOMEM);
+
+    ff_mutex_lock(&mem_mutex);
+    /* tags are only ever prepended, so the last nb of them are the ones
+     * counted above; skip those added since */
+    for (i = nb, tag = mem_tags; i < mem_nb_tags; i++)
+        tag = tag->next;
+    for (i = 0; tag && i < nb; tag = tag->next, i++) {
+        stats[i].name = tag->name;
+        stats[i].live = tag->live;
+        stats[i].peak = tag->peak;
+    }
+    ff_mutex_unlock(&mem_mutex);
+
+    *pstats   = stats;
+    *nb_stats = i;
+    return 0;
+}
+
 void *av_malloc(size_t size)
 {
     void *ptr = NULL;
@@ -123,7 +467,8 @@ void *av_malloc(size_t size)
     if(!ptr && !size) {
         size = 1;
         ptr= av_malloc(1);
-    }
+    } else if (ptr && atomic_load_explicit(&mem_accounting, memory_order_acquire))
+        mem_account_alloc(ptr, size);
 #if CONFIG_MEMORY_POISONING
     if (ptr)
         memset(ptr, FF_MEMORY_POISON, size);
@@ -133,14 +478,39 @@ void *av_malloc(size_t size)
 
 void *av_realloc(void *ptr, size_t size)
 {
+    MemBlock old = { NULL };
+    int accounting;
+    void *ret;
+
     if (size > max_alloc_size)
         return NULL;
 
+    /* the old block is removed first, its address may be reused by
+     * another thread as soon as it has been reallocated */
+    accounting = atomic_load_explicit(&mem_accounting, memory_order_acquire);
+    if (accounting && ptr) {
+        ff_mutex_lock(&mem_mutex);
+        mem_block_remove(ptr, &old);
+        ff_mutex_unlock(&mem_mutex);
+    }
+
 #if HAVE_ALIGNED_MALLOC
-    return _aligned_realloc(ptr, size + !size, ALIGN);
+    ret = _aligned_realloc(ptr, size + !size, ALIGN);
 #else
-    return realloc(ptr, size + !size);
+    ret = realloc(ptr, size + !size);
 #endif
+
+    if (accounting) {
+        MemTag *tag = old.ptr ? old.tag : mem_current_tag();
+
+        ff_mutex_lock(&mem_mutex);
+        if (ret)
+            mem_block_add(ret, size + !size, tag);
+        else if (old.ptr)
+            mem_block_add(old.ptr, old.size, old.tag);
+        ff_mutex_unlock(&mem_mutex);
+    }
+    return ret;
 }
 
 void *av_realloc_f(void *ptr, size_t nelem, size_t elsize)
@@ -216,8 +586,23 @@ int av_reallocp_array(void *ptr, size_t nmemb, size_t size)
     return 0;
 }
 
+void ff_mem_account_map(void *ptr, size_t size)
+{
+    if (atomic_load_explicit(&mem_accounting, memory_order_acquire))
+        mem_account_alloc(ptr, size);
+}
+
+void ff_mem_account_unmap(void *ptr)
+{
+    if (atomic_load_explicit(&mem_accounting, memory_order_acquire))
+        mem_account_free(ptr);
+}
+
 void av_free(void *ptr)
 {
+    if (ptr && atomic_load_explicit(&mem_accounting, memory_order_acquire))
+        mem_account_free(ptr);
+
 #if HAVE_ALIGNED_MALLOC
     _aligned_free(ptr);
 #else
@@ -692,6 +692,80 @@ static inline int av_size_mult(size_t a, size_t b, size_t *r)
  */
 void av_max_alloc(size_t max);
 
+/**
+ * @}
+ */
+
+/**
+ * @defgroup lavu_mem_accounting Allocation Accounting
+ *
+ * Attribute the memory allocated with the @ref lavu_mem_funcs
+ * "heap management functions" to the components using it.
+ *
+ * While accounting is enabled, each allocation is charged to the tag
+ * current on the allocating thread, and credited back to that tag when it
+ * is freed from any thread. The libraries set the tag to the codec,
+ * format, filter or scaler context they are processing. AVBuffer data,
+ * including pooled frame buffers and large buffers mapped directly from
+ * the system, is charged to the tag that was current when the buffer
+ * memory was allocated. Allocations outside of any tag
+ * are charged to "other".
+ *
+ * When disabled, which is the default, accounting costs a load and a
+ * branch per allocation. When enabled, allocations are serialized by a
+ * global lock, so it is meant for diagnostics.
+ *
+ * @{
+ */
+
+typedef struct AVMemTagStats {
+    /**
+     * Name of the tag: the class name and the item name of the context,
+     * e.g. "AVCodecContext:h264", or "other".
+     */
+    const char *name;
+    int64_t live;   ///< bytes currently allocated
+    int64_t peak;   ///< maximum of live since accounting was enabled
+} AVMemTagStats;
+
+/**
+ * Enable or disable allocation accounting.
+ *
+ * Enabling accounting while it is disabled resets all counters. Blocks
+ * allocated while accounting is disabled are never counted.
+ *
+ * @return >= 0 on success, a negative AVERROR code on failure, in
+ *         particular AVERROR(ENOSYS) if accounting is not supported
+ */
+int av_mem_accounting_enable(int enable);
+
+/**
+ * Charge the following allocations of the calling thread to a context.
+ *
+ * @param avcl a context whose first member is a pointer to an AVClass,
+ *             or NULL for the "other" tag
+ * @return a value to pass to av_mem_tag_leave() to restore the previous
+ *         tag
+ */
+void *av_mem_tag_enter(void *avcl);
+
+/**
+ * Restore the tag that was current before the matching
+ * av_mem_tag_enter().
+ */
+void av_mem_tag_leave(void *prev);
+
+/**
+ * Get the allocation statistics of all tags.
+ *
+ * @param stats    pointer to be set to an array of *nb_stats elements,
+ *                 which must be freed with av_free(); the names stay valid
+ *                 until the program exits
+ * @param nb_stats pointer to be set to the number of tags
+ * @return >= 0 on success, a negative AVERROR code on failure
+ */
+int av_mem_get_stats(AVMemTagStats **stats, int *nb_stats);
+
 /**
  * @}
  * @}
@@ -42,4 +42,16 @@ static inline int ff_fast_malloc(void *ptr, unsigned int *size, size_t min_size,
     *size = min_size;
     return 1;
 }
+/**
+ * Charge memory not allocated with av_malloc(), e.g. a mapping, to the
+ * current allocation accounting tag. ptr must be released with
+ * ff_mem_account_unmap().
+ */
+void ff_mem_account_map(void *ptr, size_t size);
+
+/**
+ * Credit memory charged with ff_mem_account_map() back to its tag.
+ */
+void ff_mem_account_unmap(void *ptr);
+
 #endif /* AVUTIL_MEM_INTERNAL_H */
@@ -0,0 +1,209 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program checks that AVBufferPool never hands out a buffer
+ * twice when used from several threads at once, and that pools of large
+ * buffers work.
+ *
+ * With -b it measures the cost of a get/release pair instead:
+ *   buffer_pool -b [-t threads] [-n iterations] [-k buffers] [-m]
+ * -m serializes all pool calls with an external mutex, for comparison
+ * with a fully locked pool.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#include "libavutil/buffer.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#define BUF_SIZE   256
+#define MAX_BUFS   16
+#define LARGE_BUF_SIZE (3 << 20)
+
+typedef struct ThreadData {
+    AVBufferPool *pool;
+    pthread_mutex_t *lock;
+    int id;
+    int iterations;
+    int nb_bufs;
+    int check;
+    int errors;
+} ThreadData;
+
+static void *thread_main(void *arg)
+{
+    ThreadData *td = arg;
+    AVBufferRef *bufs[MAX_BUFS];
+    int i, j, k;
+
+    for (i = 0; i < td->iterations; i++) {
+        uint8_t pattern = td->id * 31 + i;
+
+        for (j = 0; j < td->nb_bufs; j++) {
+            if (td->lock)
+                pthread_mutex_lock(td->lock);
+            bufs[j] = av_buffer_pool_get(td->pool);
+            if (td->lock)
+                pthread_mutex_unlock(td->lock);
+            if (!bufs[j]) {
+                td->errors++;
+                return NULL;
+            }
+            if (td->check)
+                memset(bufs[j]->data, pattern, BUF_SIZE);
+        }
+        for (j = 0; j < td->nb_bufs; j++) {
+            if (td->check)
+                for (k = 0; k < BUF_SIZE; k++)
+                    if (bufs[j]->data[k] != pattern) {
+                        td->errors++;
+                        break;
+                    }
+            if (td->lock)
+                pthread_mutex_lock(td->lock);
+            av_buffer_unref(&bufs[j]);
+            if (td->lock)
+                pthread_mutex_unlock(td->lock);
+        }
+    }
+    return NULL;
+}
+
+static int run(int nb_threads, int iterations, int nb_bufs, int check,
+               pthread_mutex_t *lock, int64_t *time)
+{
+    AVBufferPool *pool = av_buffer_pool_init(BUF_SIZE, NULL);
+    pthread_t threads[64];
+    ThreadData td[64];
+    int64_t start;
+    int i, ret, errors = 0;
+
+    if (!pool)
+        return -1;
+
+    start = av_gettime_relative();
+    for (i = 0; i < nb_threads; i++) {
+        td[i] = (ThreadData){ pool, lock, i, iterations, nb_bufs, check };
+        if ((ret = pthread_create(&threads[i], NULL, thread_main, &td[i]))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            nb_threads = i;
+            errors++;
+            break;
+        }
+    }
+    for (i = 0; i < nb_threads; i++) {
+        pthread_join(threads[i], NULL);
+        errors += td[i].errors;
+    }
+    *time = av_gettime_relative() - start;
+
+    av_buffer_pool_uninit(&pool);
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    int nb_threads = 4, iterations = 20000, nb_bufs = 4;
+    int bench = 0, locked = 0, opt, errors, i;
+    AVBufferPool *pool;
+    AVBufferRef *buf;
+    uint8_t *data;
+    int64_t time;
+
+    while ((opt = getopt(argc, argv, "bt:n:k:m")) != -1) {
+        switch (opt) {
+        case 'b': bench = 1;                 break;
+        case 't': nb_threads = atoi(optarg); break;
+        case 'n': iterations = atoi(optarg); break;
+        case 'k': nb_bufs    = atoi(optarg); break;
+        case 'm': locked = 1;                break;
+        default:
+            return 1;
+        }
+    }
+    if (nb_threads < 1 || nb_threads > 64 || iterations < 1 ||
+        nb_bufs < 1 || nb_bufs > MAX_BUFS) {
+        fprintf(stderr, "invalid parameters\n");
+        return 1;
+    }
+
+    if (bench) {
+        errors = run(nb_threads, iterations, nb_bufs, 0, locked ? &lock : NULL, &time);
+        printf("%d threads%s: %.1f ns per get/release\n", nb_threads,
+               locked ? " (locked)" : "",
+               time * 1000.0 / ((double)iterations * nb_bufs * nb_threads));
+        return !!errors;
+    }
+
+    /* a released buffer is reused by the next request */
+    pool = av_buffer_pool_init(BUF_SIZE, NULL);
+    if (!pool)
+        return 1;
+    buf  = av_buffer_pool_get(pool);
+    if (!buf)
+        return 1;
+    data = buf->data;
+    av_buffer_unref(&buf);
+    buf  = av_buffer_pool_get(pool);
+    if (!buf || buf->data != data) {
+        fprintf(stderr, "buffer not reused\n");
+        return 2;
+    }
+    av_buffer_unref(&buf);
+    av_buffer_pool_uninit(&pool);
+
+    /* large buffers are zeroed and writable */
+    pool = av_buffer_pool_init(LARGE_BUF_SIZE, av_buffer_alloc_large);
+    if (!pool)
+        return 1;
+    buf  = av_buffer_pool_get(pool);
+    if (!buf)
+        return 1;
+    for (i = 0; i < LARGE_BUF_SIZE; i++)
+        if (buf->data[i])
+            break;
+    if (i < LARGE_BUF_SIZE || buf->size != LARGE_BUF_SIZE) {
+        fprintf(stderr, "large buffer not zeroed\n");
+        return 2;
+    }
+    memset(buf->data, 0xff, LARGE_BUF_SIZE);
+    av_buffer_unref(&buf);
+    av_buffer_pool_uninit(&pool);
+
+    errors = run(nb_threads, iterations, nb_bufs, 1, NULL, &time);
+    if (errors) {
+        fprintf(stderr, "%d errors\n", errors);
+        return 3;
+    }
+
+    return 0;
+}
@@ -20,6 +20,51 @@
 #include <stdio.h>
 
 #include "libavutil/crc.h"
+#include "libavutil/lfg.h"
+
+/* Check the standard tables, which may be processed with CPU specific code,
+ * against tables initialized by the caller, which never are. */
+static int check_optimized(const uint8_t *buf, int size)
+{
+    static const struct {
+        AVCRCId id;
+        int le, bits;
+        uint32_t poly;
+    } crcs[] = {
+        { AV_CRC_8_ATM,      0,  8,       0x07 },
+        { AV_CRC_8_EBU,      0,  8,       0x1D },
+        { AV_CRC_16_ANSI,    0, 16,     0x8005 },
+        { AV_CRC_16_CCITT,   0, 16,     0x1021 },
+        { AV_CRC_24_IEEE,    0, 24,   0x864CFB },
+        { AV_CRC_32_IEEE,    0, 32, 0x04C11DB7 },
+        { AV_CRC_32_IEEE_LE, 1, 32, 0xEDB88320 },
+        { AV_CRC_16_ANSI_LE, 1, 16,     0xA001 },
+    };
+    AVCRC ref[1024];
+    AVLFG lfg;
+    int i, j, errors = 0;
+
+    av_lfg_init(&lfg, 0xC2C);
+    for (i = 0; i < sizeof(crcs) / sizeof(crcs[0]); i++) {
+        const AVCRC *ctx = av_crc_get_table(crcs[i].id);
+
+        av_crc_init(ref, crcs[i].le, crcs[i].bits, crcs[i].poly, sizeof(ref));
+        for (j = 0; j < 200; j++) {
+            int offset = av_lfg_get(&lfg) % 16;
+            int len    = j < 100 ? j : av_lfg_get(&lfg) % (size - offset);
+            uint32_t init = av_lfg_get(&lfg);
+            uint32_t a = av_crc(ctx, init, buf + offset, len);
+            uint32_t b = av_crc(ref, init, buf + offset, len);
+
+            if (a != b) {
+                printf("mismatch for crc %d, offset %d, length %d: %X != %X\n",
+                       crcs[i].id, offset, len, a, b);
+                errors++;
+            }
+        }
+    }
+    return errors;
+}
 
 int main(void)
 {
@@ -43,5 +88,5 @@ int main(void)
         ctx = av_crc_get_table(p[i][0]);
         printf("crc %08X = %X\n", p[i][1], av_crc(ctx, 0, buf, sizeof(buf)));
     }
-    return 0;
+    return !!check_optimized(buf, sizeof(buf));
 }
@@ -18,7 +18,14 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+/*
+ * With -b this program measures av_dict_set()/av_dict_get() on
+ * dictionaries of various sizes instead of running the tests.
+ */
+
 #include "libavutil/dict.c"
+#include "libavutil/lfg.h"
+#include "libavutil/time.h"
 
 static void print_dict(const AVDictionary *m)
 {
@@ -49,12 +56,117 @@ static void test_separators(const AVDictionary *m, const char pair, const char v
     av_dict_free(&dict);
 }
 
-int main(void)
+/* the plain scan used for dictionaries without an index */
+static AVDictionaryEntry *linear_get(const AVDictionary *m, const char *key, int flags)
+{
+    int i;
+
+    for (i = 0; m && i < m->count; i++)
+        if (!(flags & AV_DICT_MATCH_CASE ? strcmp(m->elems[i].key, key)
+                                         : av_strcasecmp(m->elems[i].key, key)))
+            return &m->elems[i];
+    return NULL;
+}
+
+static int check_index(const AVDictionary *m)
+{
+    int i, used = 0;
+
+    if (!m || !m->index)
+        return m && m->count >= DICT_INDEX_MIN_COUNT;
+    for (i = 0; i <= (int)m->index_mask; i++)
+        used += !!m->index[i].index;
+    for (i = 0; i < m->count; i++) {
+        unsigned slot = dict_index_find(m, i);
+        if (m->index[slot].hash != dict_hash(m->elems[i].key))
+            return 1;
+    }
+    return used != m->count;
+}
+
+static void test_index(void)
+{
+    static const int set_flags[] = {
+        0, AV_DICT_MATCH_CASE, AV_DICT_MULTIKEY, AV_DICT_APPEND, AV_DICT_DONT_OVERWRITE,
+    };
+    AVDictionary *dict = NULL;
+    AVLFG lfg;
+    char key[16];
+    int i, j, errors = 0;
+
+    av_lfg_init(&lfg, 0xdeadbeef);
+    for (i = 0; i < 20000; i++) {
+        int flags = set_flags[av_lfg_get(&lfg) % FF_ARRAY_ELEMS(set_flags)];
+        int del   = av_lfg_get(&lfg) % 3 == 0;
+
+        snprintf(key, sizeof(key), "%s%u", av_lfg_get(&lfg) & 1 ? "key" : "KEY",
+                 av_lfg_get(&lfg) % (i < 10000 ? 500 : 50));
+        av_dict_set(&dict, key, del ? NULL : "v", del ? flags & AV_DICT_MATCH_CASE : flags);
+        errors += check_index(dict);
+
+        for (j = 0; j < 4; j++) {
+            flags = av_lfg_get(&lfg) & 1 ? AV_DICT_MATCH_CASE : 0;
+            snprintf(key, sizeof(key), "%s%u", av_lfg_get(&lfg) & 1 ? "key" : "Key",
+                     av_lfg_get(&lfg) % 600);
+            errors += av_dict_get(dict, key, NULL, flags) != linear_get(dict, key, flags);
+        }
+    }
+    printf("%d entries, %d errors\n", av_dict_count(dict), errors);
+    av_dict_free(&dict);
+}
+
+static void bench(void)
+{
+    static const int sizes[] = { 8, 64, 512, 4096 };
+    int i, j, k;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(sizes); i++) {
+        int n = sizes[i], runs = FFMAX(1, 65536 / n);
+        int64_t t_set = 0, t_get = 0, t_ovr = 0;
+        char key[32];
+
+        for (k = 0; k < runs; k++) {
+            AVDictionary *dict = NULL;
+            int64_t t0 = av_gettime_relative(), t1, t2;
+
+            for (j = 0; j < n; j++) {
+                snprintf(key, sizeof(key), "lavfi.signalstats.KEY%d", j);
+                av_dict_set(&dict, key, "0", 0);
+            }
+            t1 = av_gettime_relative();
+            for (j = 0; j < n; j++) {
+                snprintf(key, sizeof(key), "lavfi.signalstats.key%d", (j * 7) % n);
+                if (!av_dict_get(dict, key, NULL, 0))
+                    abort();
+            }
+            t2 = av_gettime_relative();
+            for (j = 0; j < n; j++) {
+                snprintf(key, sizeof(key), "lavfi.signalstats.KEY%d", j);
+                av_dict_set(&dict, key, "1", 0);
+            }
+            t_ovr += av_gettime_relative() - t2;
+            t_get += t2 - t1;
+            t_set += t1 - t0;
+            av_dict_free(&dict);
+        }
+        printf("%5d entries: set %8.1f ns, get %8.1f ns, overwrite %8.1f ns\n", n,
+               t_set * 1000.0 / ((double)n * runs),
+               t_get * 1000.0 / ((double)n * runs),
+               t_ovr * 1000.0 / ((double)n * runs));
+    }
+}
+
+int main(int argc, char **argv)
 {
     AVDictionary *dict = NULL;
     AVDictionaryEntry *e;
     char *buffer = NULL;
 
+    if (argc > 1 && !strcmp(argv[1], "-b")) {
+        bench();
+        return 0;
+    }
+
     printf("Testing av_dict_get_string() and av_dict_parse_string()\n");
     av_dict_get_string(dict, &buffer, '=', ',');
     printf("%s\n", buffer);
@@ -132,5 +244,8 @@ int main(void)
     printf("%s\n", e->value);
     av_dict_free(&dict);
 
+    printf("\nTesting the hash index\n");
+    test_index();
+
     return 0;
 }
@@ -20,6 +20,7 @@
 #include <stdio.h>
 
 #include "libavutil/md5.h"
+#include "libavutil/md5_internal.h"
 
 static void print_md5(uint8_t *md5)
 {
@@ -31,10 +32,15 @@ static void print_md5(uint8_t *md5)
 
 int main(void)
 {
-    uint8_t md5val[16];
+    uint8_t md5val[16], md5multi[6][16];
     int i;
     volatile uint8_t in[1000]; // volatile to workaround http://llvm.org/bugs/show_bug.cgi?id=20849
     // FIXME remove volatile once it has been fixed and all fate clients are updated
+    uint8_t in1[1000], in2[1000];
+    const uint8_t *src[6] = { in1, in1, in1, in1, in2, in2 + 1 };
+    uint8_t *dst[6]       = { md5multi[0], md5multi[1], md5multi[2],
+                              md5multi[3], md5multi[4], md5multi[5] };
+    static const size_t len[6] = { 1000, 63, 64, 65, 999, 500 };
 
     for (i = 0; i < 1000; i++)
         in[i] = i * i;
@@ -51,5 +57,13 @@ int main(void)
     av_md5_sum(md5val, in, 999);
     print_md5(md5val);
 
+    for (i = 0; i < 1000; i++) {
+        in1[i] = i * i;
+        in2[i] = i % 127;
+    }
+    avpriv_md5_sum_multi(dst, src, len, 6);
+    for (i = 0; i < 6; i++)
+        print_md5(md5multi[i]);
+
     return 0;
 }
@@ -0,0 +1,122 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+
+typedef struct TestContext {
+    const AVClass *class;
+    const char *name;
+} TestContext;
+
+static const char *test_item_name(void *ctx)
+{
+    return ((TestContext *)ctx)->name;
+}
+
+static const AVClass test_class = {
+    .class_name = "TestContext",
+    .item_name  = test_item_name,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+/* a negative live value checks for at least -live bytes */
+static int check(const char *name, int64_t live, int64_t peak)
+{
+    AVMemTagStats *stats;
+    int i, nb, ret = 1;
+
+    if (av_mem_get_stats(&stats, &nb) < 0)
+        return 1;
+    for (i = 0; i < nb; i++)
+        if (!strcmp(stats[i].name, name)) {
+            ret = (live < 0 ? stats[i].live < -live : stats[i].live != live) ||
+                  stats[i].peak != peak;
+            if (ret)
+                fprintf(stderr, "%s: live %"PRId64" peak %"PRId64", expected %"PRId64" %"PRId64"\n",
+                        name, stats[i].live, stats[i].peak, live, peak);
+        }
+    av_free(stats);
+    return ret;
+}
+
+int main(void)
+{
+    TestContext ctx = { &test_class, "test" };
+    AVBufferRef *buf;
+    uint8_t *a, *b;
+    void *prev;
+    int ret;
+
+    ret = av_mem_accounting_enable(1);
+    if (ret == AVERROR(ENOSYS))
+        return 0;
+    if (ret < 0)
+        return 1;
+
+    prev = av_mem_tag_enter(&ctx);
+    a    = av_malloc(1000);
+    b    = av_strdup("0123456789");
+    av_mem_tag_leave(prev);
+    if (!a || !b || check("TestContext:test", 1011, 1011))
+        return 2;
+
+    /* a reallocated block stays with its tag */
+    a = av_realloc(a, 3000);
+    if (!a || check("TestContext:test", 3011, 3011))
+        return 3;
+    av_free(a);
+    av_free(b);
+    if (check("TestContext:test", 0, 3011))
+        return 4;
+
+    /* buffers are charged with their data and bookkeeping */
+    prev = av_mem_tag_enter(&ctx);
+    buf  = av_buffer_alloc(100);
+    av_mem_tag_leave(prev);
+    if (!buf || check("TestContext:test", -100, 3011))
+        return 5;
+    av_buffer_unref(&buf);
+    if (check("TestContext:test", 0, 3011))
+        return 6;
+
+    /* re-enabling resets the counters */
+    av_mem_accounting_enable(0);
+    a = av_malloc(100);
+    av_mem_accounting_enable(1);
+    av_free(a);
+    if (check("TestContext:test", 0, 0))
+        return 7;
+
+    /* a context whose item name changed is charged to the new name */
+    ctx.name = "renamed";
+    prev = av_mem_tag_enter(&ctx);
+    a    = av_malloc(50);
+    av_mem_tag_leave(prev);
+    if (!a || check("TestContext:renamed", 50, 50) || check("TestContext:test", 0, 0))
+        return 8;
+    av_free(a);
+    av_mem_accounting_enable(0);
+
+    return 0;
+}
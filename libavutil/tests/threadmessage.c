@@ -0,0 +1,203 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program checks that locked and SPSC message queues deliver
+ * all messages in order, and that errors, non-blocking operation and
+ * flushing work.
+ *
+ * With -b it measures the throughput of one sender and one receiver
+ * instead:
+ *   threadmessage -b [-n messages] [-q queue_size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+#include "libavutil/time.h"
+
+/* about the size of an AVPacket */
+typedef struct Message {
+    int64_t seq;
+    uint8_t payload[80];
+} Message;
+
+typedef struct SenderData {
+    AVThreadMessageQueue *mq;
+    int nb_msgs;
+    int ret;
+} SenderData;
+
+static int nb_freed;
+
+static void free_msg(void *msg)
+{
+    nb_freed++;
+}
+
+static void *sender(void *arg)
+{
+    SenderData *sd = arg;
+    Message msg = { 0 };
+    int i;
+
+    for (i = 0; i < sd->nb_msgs; i++) {
+        msg.seq = i;
+        if ((sd->ret = av_thread_message_queue_send(sd->mq, &msg, 0)) < 0)
+            break;
+    }
+    av_thread_message_queue_set_err_recv(sd->mq, AVERROR_EOF);
+    return NULL;
+}
+
+/* pass nb_msgs messages from a sender thread to the calling thread */
+static int run(unsigned flags, int queue_size, int nb_msgs, int64_t *time)
+{
+    AVThreadMessageQueue *mq;
+    SenderData sd = { .nb_msgs = nb_msgs };
+    pthread_t thread;
+    Message msg;
+    int64_t start;
+    int i, ret, errors = 0;
+
+    if (av_thread_message_queue_alloc2(&mq, queue_size, sizeof(msg), flags) < 0)
+        return -1;
+    sd.mq = mq;
+
+    start = av_gettime_relative();
+    if ((ret = pthread_create(&thread, NULL, sender, &sd))) {
+        fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+        av_thread_message_queue_free(&mq);
+        return -1;
+    }
+    for (i = 0; (ret = av_thread_message_queue_recv(mq, &msg, 0)) >= 0; i++)
+        if (msg.seq != i)
+            errors++;
+    pthread_join(thread, NULL);
+    *time = av_gettime_relative() - start;
+
+    if (ret != AVERROR_EOF || i != nb_msgs || sd.ret < 0)
+        errors++;
+    av_thread_message_queue_free(&mq);
+    return errors;
+}
+
+static int check_single_thread(unsigned flags)
+{
+    AVThreadMessageQueue *mq;
+    Message msg = { 0 };
+    int i;
+
+    if (av_thread_message_queue_alloc2(&mq, 4, sizeof(msg), flags) < 0)
+        return 1;
+    av_thread_message_queue_set_free_func(mq, free_msg);
+
+    if (av_thread_message_queue_recv(mq, &msg, AV_THREAD_MESSAGE_NONBLOCK) != AVERROR(EAGAIN))
+        return 2;
+    for (i = 0; i < 4; i++)
+        if (av_thread_message_queue_send(mq, &msg, AV_THREAD_MESSAGE_NONBLOCK) < 0)
+            return 3;
+    if (av_thread_message_queue_send(mq, &msg, AV_THREAD_MESSAGE_NONBLOCK) != AVERROR(EAGAIN) ||
+        av_thread_message_queue_nb_elems(mq) != 4)
+        return 4;
+
+    nb_freed = 0;
+    av_thread_message_flush(mq);
+    if (nb_freed != 4 || av_thread_message_queue_nb_elems(mq) != 0)
+        return 5;
+
+    /* queued messages are received before the error */
+    av_thread_message_queue_send(mq, &msg, 0);
+    av_thread_message_queue_set_err_recv(mq, AVERROR_EOF);
+    if (av_thread_message_queue_recv(mq, &msg, 0) < 0 ||
+        av_thread_message_queue_recv(mq, &msg, 0) != AVERROR_EOF)
+        return 6;
+
+    av_thread_message_queue_set_err_send(mq, AVERROR(EPIPE));
+    if (av_thread_message_queue_send(mq, &msg, 0) != AVERROR(EPIPE))
+        return 7;
+
+    av_thread_message_queue_free(&mq);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct {
+        const char *name;
+        unsigned flags;
+    } modes[] = {
+        { "locked", 0                            },
+        { "spsc",   AV_THREAD_MESSAGE_QUEUE_SPSC },
+    };
+    int nb_msgs = 1000000, queue_size = 64, bench = 0, opt, i, ret;
+    int64_t time;
+
+    while ((opt = getopt(argc, argv, "bn:q:")) != -1) {
+        switch (opt) {
+        case 'b': bench = 1;                 break;
+        case 'n': nb_msgs    = atoi(optarg); break;
+        case 'q': queue_size = atoi(optarg); break;
+        default:
+            return 1;
+        }
+    }
+    if (nb_msgs < 1 || queue_size < 1) {
+        fprintf(stderr, "invalid parameters\n");
+        return 1;
+    }
+
+    if (bench) {
+        for (i = 0; i < FF_ARRAY_ELEMS(modes); i++) {
+            if (run(modes[i].flags, queue_size, nb_msgs, &time))
+                return 1;
+            printf("%-6s: %6.1f ns per message, %.2f M messages/s\n",
+                   modes[i].name, time * 1000.0 / nb_msgs,
+                   nb_msgs / (double)FFMAX(time, 1));
+        }
+        return 0;
+    }
+
+    for (i = 0; i < FF_ARRAY_ELEMS(modes); i++) {
+        if ((ret = check_single_thread(modes[i].flags))) {
+            fprintf(stderr, "%s: check %d failed\n", modes[i].name, ret);
+            return ret;
+        }
+        /* a small queue, so that both sides have to wait */
+        if (run(modes[i].flags, 2, 100000, &time)) {
+            fprintf(stderr, "%s: messages lost or reordered\n", modes[i].name);
+            return 8;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/trace.h"
+
+#define NB_EVENTS 16
+
+static int count(const char *str, const char *pattern)
+{
+    int n = 0;
+
+    while ((str = strstr(str, pattern))) {
+        str += strlen(pattern);
+        n++;
+    }
+    return n;
+}
+
+static void *thread_main(void *arg)
+{
+    int i;
+
+    /* overflows the ring buffer, only the last events are kept */
+    for (i = 0; i < NB_EVENTS; i++) {
+        av_trace_begin("test", "worker");
+        av_trace_end("test", "worker");
+    }
+    return NULL;
+}
+
+static void *thread_reuse(void *arg)
+{
+    av_trace_begin("test", "reuse");
+    av_trace_end("test", "reuse");
+    return NULL;
+}
+
+int main(void)
+{
+    pthread_t thread;
+    char *json;
+    int ret;
+
+    if (av_trace_enable(NB_EVENTS) < 0)
+        return 1;
+
+    av_trace_begin("test", "outer");
+    av_trace_begin("test", "in\"ner");
+    av_trace_end("test", "in\"ner");
+    av_trace_end("test", "outer");
+
+    if (pthread_create(&thread, NULL, thread_main, NULL))
+        return 1;
+    pthread_join(thread, NULL);
+
+    av_trace_disable();
+    av_trace_begin("test", "ignored");
+
+    if ((ret = av_trace_get_json(&json)) < 0)
+        return 1;
+    if (strncmp(json, "{\"traceEvents\":[", 16) ||
+        count(json, "\"tid\":1}") != 4 || count(json, "\"tid\":2}") != NB_EVENTS ||
+        count(json, "\"ph\":\"B\"") != count(json, "\"ph\":\"E\"") ||
+        !strstr(json, "\"in\\\"ner\"") || strstr(json, "ignored")) {
+        fprintf(stderr, "unexpected trace:\n%s", json);
+        av_free(json);
+        return 2;
+    }
+    av_free(json);
+
+    /* the buffer of an exited thread is reused with a new id, the events
+     * of the previous owner that are not overwritten keep theirs */
+    if (av_trace_enable(NB_EVENTS) < 0)
+        return 1;
+    if (pthread_create(&thread, NULL, thread_main, NULL))
+        return 1;
+    pthread_join(thread, NULL);
+    if (pthread_create(&thread, NULL, thread_reuse, NULL))
+        return 1;
+    pthread_join(thread, NULL);
+    av_trace_disable();
+    if ((ret = av_trace_get_json(&json)) < 0)
+        return 1;
+    ret = count(json, "\"tid\":3}") != NB_EVENTS - 2 || count(json, "\"tid\":4}") != 2 ||
+          count(json, "\"ph\":\"B\"") != count(json, "\"ph\":\"E\"");
+    if (ret)
+        fprintf(stderr, "unexpected trace:\n%s", json);
+    av_free(json);
+    if (ret)
+        return 3;
+
+    /* enabling again discards the recorded events */
+    if (av_trace_enable(NB_EVENTS) < 0)
+        return 1;
+    av_trace_begin("test", "again");
+    av_trace_disable();
+    if ((ret = av_trace_get_json(&json)) < 0)
+        return 1;
+    ret = count(json, "\"ph\"") != 1;
+    av_free(json);
+    if (ret)
+        return 4;
+
+    /* recording works again after freeing */
+    av_trace_free();
+    if ((ret = av_trace_get_json(&json)) < 0)
+        return 1;
+    ret = count(json, "\"ph\"") != 0;
+    av_free(json);
+    if (ret || av_trace_enable(NB_EVENTS) < 0)
+        return 5;
+    av_trace_begin("test", "freed");
+    av_trace_disable();
+    if ((ret = av_trace_get_json(&json)) < 0)
+        return 1;
+    ret = count(json, "\"ph\"") != 1;
+    av_free(json);
+    av_trace_free();
+
+    return ret ? 5 : 0;
+}
@@ -18,20 +18,49 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+#include <string.h>
+
+#include "config.h"
+#include "attributes.h"
+#include "common.h"
+#include "cpu.h"
 #include "fifo.h"
 #include "threadmessage.h"
 #include "thread.h"
 
+/* upper bound of the adaptive spinning of a SPSC queue, in polls */
+#define MAX_SPIN 1024
+
 struct AVThreadMessageQueue {
 #if HAVE_THREADS
     AVFifoBuffer *fifo;
     pthread_mutex_t lock;
     pthread_cond_t cond_recv;
     pthread_cond_t cond_send;
-    int err_send;
-    int err_recv;
+    atomic_int err_send;
+    atomic_int err_recv;
     unsigned elsize;
     void (*free_func)(void *msg);
+
+    /* SPSC queue: a ring of nelem + 1 slots, empty if head == tail */
+    int spsc;
+    uint8_t *ring;
+    unsigned nb_slots;
+    int max_spin;
+    atomic_int recv_waiting;
+    atomic_int send_waiting;
+
+    /* the state of each side is kept on its own cache line */
+    uint8_t pad0[64];
+    atomic_uint tail;       ///< next slot to write, only written by the sender
+    unsigned send_head;     ///< last seen head, may lag behind
+    int send_spin;
+    uint8_t pad1[64];
+    atomic_uint head;       ///< next slot to read, only written by the receiver
+    unsigned recv_tail;     ///< last seen tail, may lag behind
+    int recv_spin;
+    uint8_t pad2[64];
 #else
     int dummy;
 #endif
@@ -40,6 +69,14 @@ struct AVThreadMessageQueue {
 int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
                                   unsigned nelem,
                                   unsigned elsize)
+{
+    return av_thread_message_queue_alloc2(mq, nelem, elsize, 0);
+}
+
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags)
 {
 #if HAVE_THREADS
     AVThreadMessageQueue *rmq;
@@ -64,7 +101,18 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
         av_free(rmq);
         return AVERROR(ret);
     }
-    if (!(rmq->fifo = av_fifo_alloc(elsize * nelem))) {
+    if (flags & AV_THREAD_MESSAGE_QUEUE_SPSC) {
+        rmq->spsc     = 1;
+        rmq->nb_slots = nelem + 1;
+        rmq->ring     = av_malloc_array(rmq->nb_slots, elsize);
+        /* spinning only helps if the other side can run meanwhile */
+        rmq->max_spin = av_cpu_count() > 1 ? MAX_SPIN : 0;
+        atomic_init(&rmq->head, 0);
+        atomic_init(&rmq->tail, 0);
+    } else {
+        rmq->fifo = av_fifo_alloc(elsize * nelem);
+    }
+    if (!rmq->fifo && !rmq->ring) {
         pthread_cond_destroy(&rmq->cond_send);
         pthread_cond_destroy(&rmq->cond_recv);
         pthread_mutex_destroy(&rmq->lock);
@@ -94,6 +142,7 @@ void av_thread_message_queue_free(AVThreadMessageQueue **mq)
     if (*mq) {
         av_thread_message_flush(*mq);
         av_fifo_freep(&(*mq)->fifo);
+        av_freep(&(*mq)->ring);
         pthread_cond_destroy(&(*mq)->cond_send);
         pthread_cond_destroy(&(*mq)->cond_recv);
         pthread_mutex_destroy(&(*mq)->lock);
@@ -106,6 +155,13 @@ int av_thread_message_queue_nb_elems(AVThreadMessageQueue *mq)
 {
 #if HAVE_THREADS
     int ret;
+
+    if (mq->spsc) {
+        unsigned head = atomic_load(&mq->head);
+        unsigned tail = atomic_load(&mq->tail);
+        return tail >= head ? tail - head : tail + mq->nb_slots - head;
+    }
+
     pthread_mutex_lock(&mq->lock);
     ret = av_fifo_size(mq->fifo);
     pthread_mutex_unlock(&mq->lock);
@@ -151,6 +207,122 @@ static int av_thread_message_queue_recv_locked(AVThreadMessageQueue *mq,
     return 0;
 }
 
+static av_always_inline void cpu_relax(void)
+{
+#if HAVE_INLINE_ASM && ARCH_X86
+    __asm__ volatile ("pause");
+#elif HAVE_INLINE_ASM && ARCH_AARCH64
+    __asm__ volatile ("yield");
+#endif
+}
+
+/* Sleep until *pos differs from val or *err is set. */
+static void spsc_sleep(AVThreadMessageQueue *mq, atomic_int *waiting,
+                       pthread_cond_t *cond, atomic_uint *pos, unsigned val,
+                       atomic_int *err)
+{
+    pthread_mutex_lock(&mq->lock);
+    /* pairs with the check in spsc_wake(): either the other side sees the
+     * flag, or this side sees the new position */
+    atomic_store(waiting, 1);
+    while (atomic_load(pos) == val && !atomic_load(err))
+        pthread_cond_wait(cond, &mq->lock);
+    atomic_store(waiting, 0);
+    pthread_mutex_unlock(&mq->lock);
+}
+
+static void spsc_wake(AVThreadMessageQueue *mq, atomic_int *waiting,
+                      pthread_cond_t *cond)
+{
+    if (atomic_load(waiting)) {
+        pthread_mutex_lock(&mq->lock);
+        pthread_cond_signal(cond);
+        pthread_mutex_unlock(&mq->lock);
+    }
+}
+
+/* Spin for a bit less than twice the recent waiting time, which is
+ * estimated from the number of polls that were needed, and forget it
+ * slowly when sleeping was needed anyway. */
+static void spsc_update_spin(int *spin, int polls, int slept)
+{
+    if (slept)
+        *spin -= *spin >> 3;
+    else if (polls)
+        *spin += (polls - *spin) / 8;
+}
+
+static int spsc_send(AVThreadMessageQueue *mq, void *msg, unsigned flags)
+{
+    unsigned tail = atomic_load_explicit(&mq->tail, memory_order_relaxed);
+    unsigned next = tail + 1 == mq->nb_slots ? 0 : tail + 1;
+    int limit = FFMIN(2 * mq->send_spin + 16, mq->max_spin);
+    int polls = 0, slept = 0, err;
+
+    if ((err = atomic_load_explicit(&mq->err_send, memory_order_relaxed)))
+        return err;
+
+    while (next == mq->send_head) {
+        mq->send_head = atomic_load_explicit(&mq->head, memory_order_acquire);
+        if (next != mq->send_head)
+            break;
+        if ((err = atomic_load(&mq->err_send)))
+            return err;
+        if (flags & AV_THREAD_MESSAGE_NONBLOCK)
+            return AVERROR(EAGAIN);
+        if (polls < limit) {
+            polls++;
+            cpu_relax();
+            continue;
+        }
+        spsc_sleep(mq, &mq->send_waiting, &mq->cond_send, &mq->head, next,
+                   &mq->err_send);
+        slept = 1;
+    }
+    spsc_update_spin(&mq->send_spin, polls, slept);
+
+    memcpy(mq->ring + (size_t)tail * mq->elsize, msg, mq->elsize);
+    atomic_store(&mq->tail, next);
+    spsc_wake(mq, &mq->recv_waiting, &mq->cond_recv);
+    return 0;
+}
+
+static int spsc_recv(AVThreadMessageQueue *mq, void *msg, unsigned flags)
+{
+    unsigned head = atomic_load_explicit(&mq->head, memory_order_relaxed);
+    int limit = FFMIN(2 * mq->recv_spin + 16, mq->max_spin);
+    int polls = 0, slept = 0, err;
+
+    while (head == mq->recv_tail) {
+        mq->recv_tail = atomic_load_explicit(&mq->tail, memory_order_acquire);
+        if (head != mq->recv_tail)
+            break;
+        if ((err = atomic_load(&mq->err_recv))) {
+            /* the messages sent before the error was set are delivered */
+            mq->recv_tail = atomic_load_explicit(&mq->tail, memory_order_acquire);
+            if (head != mq->recv_tail)
+                break;
+            return err;
+        }
+        if (flags & AV_THREAD_MESSAGE_NONBLOCK)
+            return AVERROR(EAGAIN);
+        if (polls < limit) {
+            polls++;
+            cpu_relax();
+            continue;
+        }
+        spsc_sleep(mq, &mq->recv_waiting, &mq->cond_recv, &mq->tail, head,
+                   &mq->err_recv);
+        slept = 1;
+    }
+    spsc_update_spin(&mq->recv_spin, polls, slept);
+
+    memcpy(msg, mq->ring + (size_t)head * mq->elsize, mq->elsize);
+    atomic_store(&mq->head, head + 1 == mq->nb_slots ? 0 : head + 1);
+    spsc_wake(mq, &mq->send_waiting, &mq->cond_send);
+    return 0;
+}
+
 #endif /* HAVE_THREADS */
 
 int av_thread_message_queue_send(AVThreadMessageQueue *mq,
@@ -160,6 +332,9 @@ int av_thread_message_queue_send(AVThreadMessageQueue *mq,
 #if HAVE_THREADS
     int ret;
 
+    if (mq->spsc)
+        return spsc_send(mq, msg, flags);
+
     pthread_mutex_lock(&mq->lock);
     ret = av_thread_message_queue_send_locked(mq, msg, flags);
     pthread_mutex_unlock(&mq->lock);
@@ -176,6 +351,9 @@ int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
 #if HAVE_THREADS
     int ret;
 
+    if (mq->spsc)
+        return spsc_recv(mq, msg, flags);
+
     pthread_mutex_lock(&mq->lock);
     ret = av_thread_message_queue_recv_locked(mq, msg, flags);
     pthread_mutex_unlock(&mq->lock);
@@ -221,6 +399,21 @@ void av_thread_message_flush(AVThreadMessageQueue *mq)
     int used, off;
     void *free_func = mq->free_func;
 
+    if (mq->spsc) {
+        unsigned head = atomic_load(&mq->head);
+        unsigned tail = atomic_load(&mq->tail);
+
+        for (; head != tail; head = head + 1 == mq->nb_slots ? 0 : head + 1)
+            if (mq->free_func)
+                mq->free_func(mq->ring + (size_t)head * mq->elsize);
+        mq->recv_tail = tail;
+        atomic_store(&mq->head, tail);
+        pthread_mutex_lock(&mq->lock);
+        pthread_cond_broadcast(&mq->cond_send);
+        pthread_mutex_unlock(&mq->lock);
+        return;
+    }
+
     pthread_mutex_lock(&mq->lock);
     used = av_fifo_size(mq->fifo);
     if (free_func)
@@ -45,6 +45,37 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
                                   unsigned nelem,
                                   unsigned elsize);
 
+/**
+ * The queue is used by at most one sending thread and one receiving thread
+ * at a time.
+ *
+ * Such a queue does not take a lock to pass messages: send and receive only
+ * touch a ring buffer, and a thread finding the queue full or empty spins
+ * for a while before going to sleep. The spinning time adapts to how long
+ * the thread had to wait recently, and is zero on systems with a single
+ * CPU.
+ *
+ * av_thread_message_flush() must then only be called by the receiving
+ * thread, or while no thread is receiving. The error codes can still be
+ * set from any thread.
+ */
+#define AV_THREAD_MESSAGE_QUEUE_SPSC (1 << 0)
+
+/**
+ * Allocate a new message queue.
+ *
+ * @param mq      pointer to the message queue
+ * @param nelem   maximum number of elements in the queue
+ * @param elsize  size of each element in the queue
+ * @param flags   a combination of AV_THREAD_MESSAGE_QUEUE_* flags
+ * @return  >=0 for success; <0 for error, in particular AVERROR(ENOSYS) if
+ *          lavu was built without thread support
+ */
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags);
+
 /**
  * Free a message queue.
  *
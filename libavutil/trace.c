@@ -0,0 +1,285 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "config.h"
+
+#include "bprint.h"
+#include "common.h"
+#include "error.h"
+#include "mem.h"
+#include "thread.h"
+#include "time.h"
+#include "trace.h"
+
+/* per-thread buffers need thread-specific storage, which is only
+ * available with pthreads; without threads a single buffer is used */
+#define TRACE_SUPPORTED (HAVE_PTHREADS || !HAVE_THREADS)
+
+typedef struct TraceEvent {
+    const char *category;
+    const char *name;
+    int64_t     ts;
+    int         tid;
+    char        phase;
+} TraceEvent;
+
+typedef struct TraceBuffer {
+    struct TraceBuffer *next;
+    TraceEvent *events;
+    unsigned    nb_events;  ///< a power of two
+    /* number of events written so far, only modified by the owner */
+    atomic_uint pos;
+    /* the id of the owner thread; a buffer handed to a new thread gets a
+     * new id, while the events of the previous owner keep theirs */
+    int         tid;
+    /* set while a thread records into this buffer, the buffers of
+     * exited threads are handed to new threads to bound memory use */
+    int         in_use;
+} TraceBuffer;
+
+static atomic_int trace_enabled;
+static AVMutex    trace_mutex = AV_MUTEX_INITIALIZER;
+static TraceBuffer *trace_buffers;
+static unsigned   trace_nb_events;
+static int        trace_nb_tids;
+static int64_t    trace_start;
+
+#if HAVE_PTHREADS
+static pthread_key_t trace_key;
+static AVOnce trace_key_once = AV_ONCE_INIT;
+static int    trace_key_ret;
+
+static void trace_buffer_release(void *opaque)
+{
+    TraceBuffer *buf = opaque;
+
+    ff_mutex_lock(&trace_mutex);
+    buf->in_use = 0;
+    ff_mutex_unlock(&trace_mutex);
+}
+
+static void trace_key_init(void)
+{
+    trace_key_ret = pthread_key_create(&trace_key, trace_buffer_release);
+}
+#endif
+
+/* must be called with trace_mutex locked */
+static int trace_buffer_alloc_events(TraceBuffer *buf)
+{
+    /* zeroed, so that a reader never sees uninitialized names */
+    buf->events = av_mallocz_array(trace_nb_events, sizeof(*buf->events));
+    if (!buf->events)
+        return AVERROR(ENOMEM);
+    buf->nb_events = trace_nb_events;
+    atomic_store(&buf->pos, 0);
+    return 0;
+}
+
+/* must be called with trace_mutex locked */
+static TraceBuffer *trace_buffer_acquire(void)
+{
+    TraceBuffer *buf;
+
+    for (buf = trace_buffers; buf; buf = buf->next)
+        if (!buf->in_use)
+            break;
+
+    if (!buf) {
+        buf = av_mallocz(sizeof(*buf));
+        if (!buf)
+            return NULL;
+        buf->next     = trace_buffers;
+        trace_buffers = buf;
+    }
+    if (!buf->events && trace_buffer_alloc_events(buf) < 0)
+        return NULL;
+    buf->tid    = ++trace_nb_tids;
+    buf->in_use = 1;
+    return buf;
+}
+
+static TraceBuffer *trace_thread_buffer(void)
+{
+    TraceBuffer *buf;
+
+#if HAVE_PTHREADS
+    if (ff_thread_once(&trace_key_once, trace_key_init) || trace_key_ret)
+        return NULL;
+    buf = pthread_getspecific(trace_key);
+    if (buf && buf->events)
+        return buf;
+
+    ff_mutex_lock(&trace_mutex);
+    if (buf) {
+        /* the events were freed by av_trace_free() */
+        if (trace_buffer_alloc_events(buf) < 0)
+            buf = NULL;
+    } else {
+        buf = trace_buffer_acquire();
+        if (buf && pthread_setspecific(trace_key, buf)) {
+            buf->in_use = 0;
+            buf = NULL;
+        }
+    }
+    ff_mutex_unlock(&trace_mutex);
+#else
+    buf = trace_buffers;
+    if (!buf)
+        buf = trace_buffer_acquire();
+    else if (!buf->events && trace_buffer_alloc_events(buf) < 0)
+        buf = NULL;
+#endif
+
+    return buf;
+}
+
+static void trace_event(const char *category, const char *name, char phase)
+{
+    TraceBuffer *buf;
+    TraceEvent *ev;
+    unsigned pos;
+
+    if (!atomic_load_explicit(&trace_enabled, memory_order_relaxed))
+        return;
+
+    buf = trace_thread_buffer();
+    if (!buf)
+        return;
+
+    pos = atomic_load_explicit(&buf->pos, memory_order_relaxed);
+    ev  = &buf->events[pos & (buf->nb_events - 1)];
+    ev->category = category;
+    ev->name     = name;
+    ev->ts       = av_gettime_relative();
+    ev->tid      = buf->tid;
+    ev->phase    = phase;
+    atomic_store_explicit(&buf->pos, pos + 1, memory_order_release);
+}
+
+void av_trace_begin(const char *category, const char *name)
+{
+    trace_event(category, name, 'B');
+}
+
+void av_trace_end(const char *category, const char *name)
+{
+    trace_event(category, name, 'E');
+}
+
+int av_trace_enable(int nb_events)
+{
+    TraceBuffer *buf;
+
+    if (!TRACE_SUPPORTED)
+        return AVERROR(ENOSYS);
+    if (nb_events <= 0 || nb_events > INT_MAX / 2 / sizeof(TraceEvent))
+        return AVERROR(EINVAL);
+    if (atomic_load(&trace_enabled))
+        return AVERROR(EINVAL);
+
+    ff_mutex_lock(&trace_mutex);
+    trace_nb_events = 1;
+    while (trace_nb_events < nb_events)
+        trace_nb_events <<= 1;
+    for (buf = trace_buffers; buf; buf = buf->next)
+        atomic_store(&buf->pos, 0);
+    trace_start = av_gettime_relative();
+    ff_mutex_unlock(&trace_mutex);
+
+    atomic_store(&trace_enabled, 1);
+    return 0;
+}
+
+void av_trace_disable(void)
+{
+    atomic_store(&trace_enabled, 0);
+}
+
+void av_trace_free(void)
+{
+    TraceBuffer **next, *buf;
+
+    ff_mutex_lock(&trace_mutex);
+    for (next = &trace_buffers; (buf = *next);) {
+        av_freep(&buf->events);
+        atomic_store(&buf->pos, 0);
+        /* the buffers of running threads are still referenced by them */
+        if (buf->in_use) {
+            next = &buf->next;
+        } else {
+            *next = buf->next;
+            av_free(buf);
+        }
+    }
+    ff_mutex_unlock(&trace_mutex);
+}
+
+static void json_string(AVBPrint *bp, const char *str)
+{
+    av_bprint_chars(bp, '"', 1);
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\')
+            av_bprint_chars(bp, '\\', 1);
+        if ((uint8_t)*str >= 0x20)
+            av_bprint_chars(bp, *str, 1);
+    }
+    av_bprint_chars(bp, '"', 1);
+}
+
+int av_trace_get_json(char **json)
+{
+    TraceBuffer *buf;
+    AVBPrint bp;
+    int nb = 0;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&bp, "{\"traceEvents\":[");
+
+    ff_mutex_lock(&trace_mutex);
+    for (buf = trace_buffers; buf; buf = buf->next) {
+        unsigned end   = atomic_load_explicit(&buf->pos, memory_order_acquire);
+        unsigned start = end > buf->nb_events ? end - buf->nb_events : 0;
+
+        if (!buf->events)
+            continue;
+        for (; start != end; start++) {
+            const TraceEvent *ev = &buf->events[start & (buf->nb_events - 1)];
+
+            if (!ev->name || !ev->category)
+                continue;
+            av_bprintf(&bp, "%s\n{\"name\":", nb++ ? "," : "");
+            json_string(&bp, ev->name);
+            av_bprintf(&bp, ",\"cat\":");
+            json_string(&bp, ev->category);
+            av_bprintf(&bp, ",\"ph\":\"%c\",\"ts\":%"PRId64",\"pid\":1,\"tid\":%d}",
+                       ev->phase, ev->ts - trace_start, ev->tid);
+        }
+    }
+    ff_mutex_unlock(&trace_mutex);
+
+    av_bprintf(&bp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    if (!av_bprint_is_complete(&bp)) {
+        av_bprint_finalize(&bp, NULL);
+        return AVERROR(ENOMEM);
+    }
+    return av_bprint_finalize(&bp, json);
+}
@@ -0,0 +1,102 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * @ingroup lavu_trace
+ * Public header for runtime event tracing.
+ */
+
+#ifndef AVUTIL_TRACE_H
+#define AVUTIL_TRACE_H
+
+/**
+ * @defgroup lavu_trace Tracing
+ * @ingroup lavu_misc
+ * Record timed begin/end events from all threads.
+ *
+ * The libraries mark the main processing stages (decoding, encoding,
+ * filtering, scaling, muxing) with trace events. Recording is off by
+ * default, in which case an event costs a function call and a load.
+ * When enabled, each thread appends its events to its own ring buffer,
+ * so the oldest events are overwritten once a buffer is full. The
+ * recorded events can be exported in the Chrome trace event JSON
+ * format, which is understood by chrome://tracing and Perfetto.
+ *
+ * @{
+ */
+
+/**
+ * Start recording events, discarding any previously recorded ones.
+ *
+ * Must not be called while recording is already enabled.
+ *
+ * @param nb_events number of events kept for each thread, rounded up to
+ *                  a power of two
+ * @return >= 0 on success, a negative AVERROR code on failure, in
+ *         particular AVERROR(ENOSYS) if tracing is not supported
+ */
+int av_trace_enable(int nb_events);
+
+/**
+ * Stop recording events. The recorded events are kept.
+ */
+void av_trace_disable(void);
+
+/**
+ * Free the recorded events and the memory used to record them.
+ *
+ * Recording must be disabled, and no thread may be in av_trace_begin() or
+ * av_trace_end(). Recording can be enabled again afterwards.
+ */
+void av_trace_free(void);
+
+/**
+ * Begin an event on the calling thread.
+ *
+ * @param category group of the event, e.g. "decode"
+ * @param name     name of the event, e.g. the codec name
+ *
+ * Both strings are stored by reference and must stay valid until the
+ * events have been exported, typically they are string literals.
+ */
+void av_trace_begin(const char *category, const char *name);
+
+/**
+ * End the innermost event begun on the calling thread.
+ * The arguments should match those given to av_trace_begin().
+ */
+void av_trace_end(const char *category, const char *name);
+
+/**
+ * Export the recorded events in Chrome trace event JSON format.
+ *
+ * Events recorded while this function runs may be missing or
+ * incomplete, call av_trace_disable() first for a consistent trace.
+ *
+ * @param json pointer to be set to the JSON text, which must be freed
+ *             with av_free()
+ * @return >= 0 on success, a negative AVERROR code on failure
+ */
+int av_trace_get_json(char **json);
+
+/**
+ * @}
+ */
+
+#endif /* AVUTIL_TRACE_H */
@@ -0,0 +1,177 @@
+;******************************************************************************
+;* AES-NI accelerated AES
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "x86util.asm"
+
+SECTION .text
+
+; The key schedule built by av_aes_init() starts the AVAES context and is
+; applied from round_key[rounds] down to round_key[0]. The decryption keys
+; already have InvMixColumns applied to the middle rounds, which is what
+; aesdec expects. The keys are loaded unaligned since av_aes_size() allows
+; the context to be allocated by the caller.
+
+; apply %1 with key %3 to m0, or to m0-m3 if %2 is 4
+%macro OP 3
+    %1        m0, %3
+%if %2 == 4
+    %1        m1, %3
+    %1        m2, %3
+    %1        m3, %3
+%endif
+%endmacro
+
+; run all rounds of %1 (aesenc or aesdec) on %2 blocks, clobbers m4 and kq
+%macro CRYPT 2
+    movu      m4, [endq]
+    OP      pxor, %2, m4
+    lea       kq, [endq - 16]
+%%round:
+    movu      m4, [kq]
+    OP        %1, %2, m4
+    sub       kq, 16
+    cmp       kq, aq
+    jne %%round
+    movu      m4, [aq]
+    OP  %1 %+ last, %2, m4
+%endmacro
+
+%macro LOAD4 0
+    movu      m0, [srcq]
+    movu      m1, [srcq + 16]
+    movu      m2, [srcq + 32]
+    movu      m3, [srcq + 48]
+%endmacro
+
+%macro STORE4 0
+    movu [dstq     ], m0
+    movu [dstq + 16], m1
+    movu [dstq + 32], m2
+    movu [dstq + 48], m3
+%endmacro
+
+; ECB, 4 blocks at a time to hide the latency of aesenc/aesdec
+%macro ECB 1
+    sub   countd, 4
+    jl .tail
+.loop4:
+    LOAD4
+    CRYPT     %1, 4
+    STORE4
+    add     srcq, 64
+    add     dstq, 64
+    sub   countd, 4
+    jge .loop4
+.tail:
+    add   countd, 4
+    jle .end
+.loop1:
+    movu      m0, [srcq]
+    CRYPT     %1, 1
+    movu  [dstq], m0
+    add     srcq, 16
+    add     dstq, 16
+    dec   countd
+    jnz .loop1
+.end:
+    RET
+%endmacro
+
+INIT_XMM aesni
+;-----------------------------------------------------------------------------
+; void ff_aes_encrypt(AVAES *a, uint8_t *dst, const uint8_t *src, int count,
+;                     uint8_t *iv, int rounds)
+;-----------------------------------------------------------------------------
+cglobal aes_encrypt, 6, 7, 6, a, dst, src, count, iv, end, k
+    shl     endd, 4
+    add     endq, aq
+    test     ivq, ivq
+    jnz .cbc
+    ECB   aesenc
+
+    ; CBC encryption is inherently serial
+.cbc:
+    movu      m5, [ivq]
+    test  countd, countd
+    jle .cbc_end
+.cbc_loop:
+    movu      m0, [srcq]
+    pxor      m0, m5
+    CRYPT aesenc, 1
+    mova      m5, m0
+    movu  [dstq], m0
+    add     srcq, 16
+    add     dstq, 16
+    dec   countd
+    jnz .cbc_loop
+.cbc_end:
+    movu   [ivq], m5
+    RET
+
+;-----------------------------------------------------------------------------
+; void ff_aes_decrypt(AVAES *a, uint8_t *dst, const uint8_t *src, int count,
+;                     uint8_t *iv, int rounds)
+;-----------------------------------------------------------------------------
+cglobal aes_decrypt, 6, 7, 6, a, dst, src, count, iv, end, k
+    shl     endd, 4
+    add     endq, aq
+    test     ivq, ivq
+    jnz .cbc
+    ECB   aesdec
+
+    ; CBC decryption is parallel; dst may be equal to src, so all source
+    ; blocks are read before the output is stored
+.cbc:
+    movu      m5, [ivq]
+    sub   countd, 4
+    jl .cbc_tail
+.cbc_loop4:
+    LOAD4
+    CRYPT aesdec, 4
+    pxor      m0, m5
+    movu      m4, [srcq]
+    pxor      m1, m4
+    movu      m4, [srcq + 16]
+    pxor      m2, m4
+    movu      m4, [srcq + 32]
+    pxor      m3, m4
+    movu      m5, [srcq + 48]
+    STORE4
+    add     srcq, 64
+    add     dstq, 64
+    sub   countd, 4
+    jge .cbc_loop4
+.cbc_tail:
+    add   countd, 4
+    jle .cbc_end
+.cbc_loop1:
+    movu      m0, [srcq]
+    CRYPT aesdec, 1
+    movu      m4, [srcq]
+    pxor      m0, m5
+    mova      m5, m4
+    movu  [dstq], m0
+    add     srcq, 16
+    add     dstq, 16
+    dec   countd
+    jnz .cbc_loop1
+.cbc_end:
+    movu   [ivq], m5
+    RET
@@ -0,0 +1,97 @@
+;******************************************************************************
+;* CRC folding with carry-less multiplication
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "x86util.asm"
+
+SECTION .text
+
+struc CRCFoldConsts
+    .k512: resq 2
+    .k128: resq 2
+    .shuf: resb 16
+endstruc
+
+; %1 = 16 bytes at bufq + %2, in the bit order of the CRC
+%macro LOAD 2
+    movu      %1, [bufq + %2]
+    pshufb    %1, m5
+%endmacro
+
+; %1 = %1 * %2 + %3
+%macro FOLD 3
+    mova      m6, %1
+    pclmulqdq %1, %2, 0x00
+    pclmulqdq m6, %2, 0x11
+    pxor      %1, m6
+    pxor      %1, %3
+%endmacro
+
+;-----------------------------------------------------------------------------
+; void ff_crc_fold_clmul(uint8_t last[16], const uint8_t *buf, size_t len,
+;                        const CRCFoldConsts *k, uint32_t crc)
+;
+; Fold len bytes of buf, a multiple of 16 and at least 64, xored with crc at
+; the start, into a 16-byte block with the same CRC, stored to last.
+;-----------------------------------------------------------------------------
+INIT_XMM ssse3
+cglobal crc_fold_clmul, 5, 5, 8, last, buf, len, k, crc
+    mova      m5, [kq + CRCFoldConsts.shuf]
+    movd      m6, crcd
+    movu      m0, [bufq]
+    pxor      m0, m6
+    pshufb    m0, m5
+    LOAD      m1, 16
+    LOAD      m2, 32
+    LOAD      m3, 48
+    add     bufq, 64
+    sub     lenq, 64
+    mova      m4, [kq + CRCFoldConsts.k512]
+    cmp     lenq, 64
+    jb .fold4
+.loop64:
+    LOAD      m7, 0
+    FOLD      m0, m4, m7
+    LOAD      m7, 16
+    FOLD      m1, m4, m7
+    LOAD      m7, 32
+    FOLD      m2, m4, m7
+    LOAD      m7, 48
+    FOLD      m3, m4, m7
+    add     bufq, 64
+    sub     lenq, 64
+    cmp     lenq, 64
+    jae .loop64
+.fold4:
+    mova      m4, [kq + CRCFoldConsts.k128]
+    FOLD      m0, m4, m1
+    FOLD      m0, m4, m2
+    FOLD      m0, m4, m3
+    test    lenq, lenq
+    jz .end
+.loop16:
+    LOAD      m7, 0
+    FOLD      m0, m4, m7
+    add     bufq, 16
+    sub     lenq, 16
+    jnz .loop16
+.end:
+    pshufb    m0, m5
+    movu [lastq], m0
+    RET
@@ -0,0 +1,119 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/crc_internal.h"
+#include "libavutil/mem.h"
+#include "cpu.h"
+
+/*
+ * The table driven code computes every CRC as a 32-bit CRC, the generator
+ * polynomial being multiplied by x^(32 - bits). The input is folded 16 bytes
+ * at a time with four independent accumulators, each 128-bit block B being
+ * replaced by B_hi * (x^(F + 64) mod P) + B_lo * (x^F mod P), where F is the
+ * folding distance in bits. This keeps the message unchanged modulo P, so
+ * the CRC of the last folded block, computed with the table, is the CRC of
+ * the whole input.
+ *
+ * The non-reflected CRCs are byte swapped to compute in the natural bit
+ * order. For the reflected ones, the product of two reflected 64-bit values
+ * is the reflected product shifted right by one bit, which is compensated
+ * for by using x^(F - 1) and x^(F + 63) instead.
+ *
+ * Each entry holds the constants for F = 512 followed by those for F = 128,
+ * in the order matching the 64-bit halves of the folded block, then the
+ * byte shuffle to the bit order of the CRC.
+ */
+typedef struct CRCFoldConsts {
+    uint64_t k[4];
+    uint8_t shuf[16];
+} CRCFoldConsts;
+
+#define SHUF_LE { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 }
+#define SHUF_BE { 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 }
+
+DECLARE_ALIGNED(16, static const CRCFoldConsts, fold_consts)[AV_CRC_MAX] = {
+    [AV_CRC_8_ATM]      = { { 0x00000000bc000000, 0x0000000032000000,
+                              0x0000000094000000, 0x00000000c4000000 }, SHUF_BE },
+    [AV_CRC_16_ANSI]    = { { 0x00000000807d0000, 0x00000000f9e30000,
+                              0x00000000ff830000, 0x00000000f9130000 }, SHUF_BE },
+    [AV_CRC_16_CCITT]   = { { 0x0000000059b00000, 0x0000000060190000,
+                              0x0000000045630000, 0x00000000d5f60000 }, SHUF_BE },
+    [AV_CRC_32_IEEE]    = { { 0x00000000e6228b11, 0x000000008833794c,
+                              0x00000000e8a45605, 0x00000000c5b9cd4c }, SHUF_BE },
+    [AV_CRC_32_IEEE_LE] = { { 0x653d982200000000, 0xcad38e8f00000000,
+                              0x65673b4600000000, 0x9ba54c6f00000000 }, SHUF_LE },
+    [AV_CRC_16_ANSI_LE] = { { 0x0000cf3d00000000, 0x00003c0100000000,
+                              0x0000d13d00000000, 0x0000c3fd00000000 }, SHUF_LE },
+    [AV_CRC_24_IEEE]    = { { 0x00000000467d2400, 0x000000001f428700,
+                              0x0000000064e4d700, 0x000000002c8c9d00 }, SHUF_BE },
+    [AV_CRC_8_EBU]      = { { 0x00000000f3000000, 0x00000000b5000000,
+                              0x000000000d000000, 0x00000000fc000000 }, SHUF_BE },
+};
+
+void ff_crc_fold_clmul_ssse3(uint8_t *last, const uint8_t *buffer, size_t length,
+                             const CRCFoldConsts *k, uint32_t crc);
+
+static av_always_inline uint32_t crc_clmul(const AVCRC *ctx, uint32_t crc,
+                                           const uint8_t *buffer, size_t length,
+                                           AVCRCId crc_id)
+{
+    DECLARE_ALIGNED(16, uint8_t, last)[16];
+    int i;
+
+    ff_crc_fold_clmul_ssse3(last, buffer, length & ~15, &fold_consts[crc_id], crc);
+    crc = 0;
+    for (i = 0; i < 16; i++)
+        crc = ctx[(uint8_t)crc ^ last[i]] ^ (crc >> 8);
+    return crc;
+}
+
+#define CRC_CLMUL(name, id)                                                 \
+static uint32_t crc_ ## name ## _clmul(const AVCRC *ctx, uint32_t crc,      \
+                                       const uint8_t *buffer, size_t length)\
+{                                                                           \
+    return crc_clmul(ctx, crc, buffer, length, id);                         \
+}
+
+CRC_CLMUL(8_atm,      AV_CRC_8_ATM)
+CRC_CLMUL(16_ansi,    AV_CRC_16_ANSI)
+CRC_CLMUL(16_ccitt,   AV_CRC_16_CCITT)
+CRC_CLMUL(32_ieee,    AV_CRC_32_IEEE)
+CRC_CLMUL(32_ieee_le, AV_CRC_32_IEEE_LE)
+CRC_CLMUL(16_ansi_le, AV_CRC_16_ANSI_LE)
+CRC_CLMUL(24_ieee,    AV_CRC_24_IEEE)
+CRC_CLMUL(8_ebu,      AV_CRC_8_EBU)
+
+av_cold void ff_crc_init_x86(ff_crc_func funcs[AV_CRC_MAX])
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (EXTERNAL_SSSE3(cpu_flags) && EXTERNAL_CLMUL(cpu_flags)) {
+        funcs[AV_CRC_8_ATM]      = crc_8_atm_clmul;
+        funcs[AV_CRC_16_ANSI]    = crc_16_ansi_clmul;
+        funcs[AV_CRC_16_CCITT]   = crc_16_ccitt_clmul;
+        funcs[AV_CRC_32_IEEE]    = crc_32_ieee_clmul;
+        funcs[AV_CRC_32_IEEE_LE] = crc_32_ieee_le_clmul;
+        funcs[AV_CRC_16_ANSI_LE] = crc_16_ansi_le_clmul;
+        funcs[AV_CRC_24_IEEE]    = crc_24_ieee_clmul;
+        funcs[AV_CRC_8_EBU]      = crc_8_ebu_clmul;
+    }
+}
@@ -0,0 +1,362 @@
+;******************************************************************************
+;* SHA-1 and SHA-256 block transforms using the SHA extensions
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "x86util.asm"
+
+SECTION_RODATA
+
+sha1_shuf:   db 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+sha256_shuf: db 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+
+K256: dd 0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5
+      dd 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5
+      dd 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3
+      dd 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174
+      dd 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc
+      dd 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da
+      dd 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7
+      dd 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967
+      dd 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13
+      dd 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85
+      dd 0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3
+      dd 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070
+      dd 0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5
+      dd 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3
+      dd 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208
+      dd 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+
+SECTION .text
+
+; %2 = 16 bytes at bufq + %1, as big endian words
+%macro LOAD 2
+    movu          %2, [bufq + %1]
+    pshufb        %2, SHUF
+%endmacro
+
+; SHA-1: m1 = ABCD, m2/m3 = E, m4-m7 = message schedule, m0 = byte shuffle
+%macro SHA1_FIRST 2 ; msg, e
+    paddd         %2, %1
+%endmacro
+
+%macro SHA1_NEXTE 2 ; msg, e
+    sha1nexte     %2, %1
+%endmacro
+
+%macro SHA1_COPY 1 ; e
+    mova          %1, m1
+%endmacro
+
+%macro SHA1_RNDS 2 ; function, e
+    sha1rnds4     m1, %2, %1
+%endmacro
+
+%macro SHA1_MSG1 2 ; src, dst
+    sha1msg1      %2, %1
+%endmacro
+
+%macro SHA1_MSG2 2 ; src, dst
+    sha1msg2      %2, %1
+%endmacro
+
+%macro SHA1_XOR 2 ; src, dst
+    pxor          %2, %1
+%endmacro
+
+; The SHA instructions need SSE4.1 at most, which every CPU supporting them
+; has, so no cpu suffix is used.
+INIT_XMM
+;-----------------------------------------------------------------------------
+; void ff_sha1_transform_shani(uint32_t *state, const uint8_t buffer[64])
+;-----------------------------------------------------------------------------
+%define SHUF m0
+cglobal sha1_transform_shani, 2, 2, 8, 32, state, buf
+    mova          m0, [sha1_shuf]
+    movu          m1, [stateq]
+    movd          m2, [stateq + 16]
+    pshufd        m1, m1, 0x1B
+    pslldq        m2, 12
+    mova   [rsp     ], m1
+    mova   [rsp + 16], m2
+
+    LOAD         0, m4
+    SHA1_FIRST   m4, m2
+    SHA1_COPY    m3
+    SHA1_RNDS    0, m2
+
+    LOAD         16, m5
+    SHA1_NEXTE   m5, m3
+    SHA1_COPY    m2
+    SHA1_RNDS    0, m3
+    SHA1_MSG1    m5, m4
+
+    LOAD         32, m6
+    SHA1_NEXTE   m6, m2
+    SHA1_COPY    m3
+    SHA1_RNDS    0, m2
+    SHA1_MSG1    m6, m5
+    SHA1_XOR     m6, m4
+
+    LOAD         48, m7
+    SHA1_NEXTE   m7, m3
+    SHA1_COPY    m2
+    SHA1_MSG2    m7, m4
+    SHA1_RNDS    0, m3
+    SHA1_MSG1    m7, m6
+    SHA1_XOR     m7, m5
+
+    SHA1_NEXTE   m4, m2
+    SHA1_COPY    m3
+    SHA1_MSG2    m4, m5
+    SHA1_RNDS    0, m2
+    SHA1_MSG1    m4, m7
+    SHA1_XOR     m4, m6
+
+    SHA1_NEXTE   m5, m3
+    SHA1_COPY    m2
+    SHA1_MSG2    m5, m6
+    SHA1_RNDS    1, m3
+    SHA1_MSG1    m5, m4
+    SHA1_XOR     m5, m7
+
+    SHA1_NEXTE   m6, m2
+    SHA1_COPY    m3
+    SHA1_MSG2    m6, m7
+    SHA1_RNDS    1, m2
+    SHA1_MSG1    m6, m5
+    SHA1_XOR     m6, m4
+
+    SHA1_NEXTE   m7, m3
+    SHA1_COPY    m2
+    SHA1_MSG2    m7, m4
+    SHA1_RNDS    1, m3
+    SHA1_MSG1    m7, m6
+    SHA1_XOR     m7, m5
+
+    SHA1_NEXTE   m4, m2
+    SHA1_COPY    m3
+    SHA1_MSG2    m4, m5
+    SHA1_RNDS    1, m2
+    SHA1_MSG1    m4, m7
+    SHA1_XOR     m4, m6
+
+    SHA1_NEXTE   m5, m3
+    SHA1_COPY    m2
+    SHA1_MSG2    m5, m6
+    SHA1_RNDS    1, m3
+    SHA1_MSG1    m5, m4
+    SHA1_XOR     m5, m7
+
+    SHA1_NEXTE   m6, m2
+    SHA1_COPY    m3
+    SHA1_MSG2    m6, m7
+    SHA1_RNDS    2, m2
+    SHA1_MSG1    m6, m5
+    SHA1_XOR     m6, m4
+
+    SHA1_NEXTE   m7, m3
+    SHA1_COPY    m2
+    SHA1_MSG2    m7, m4
+    SHA1_RNDS    2, m3
+    SHA1_MSG1    m7, m6
+    SHA1_XOR     m7, m5
+
+    SHA1_NEXTE   m4, m2
+    SHA1_COPY    m3
+    SHA1_MSG2    m4, m5
+    SHA1_RNDS    2, m2
+    SHA1_MSG1    m4, m7
+    SHA1_XOR     m4, m6
+
+    SHA1_NEXTE   m5, m3
+    SHA1_COPY    m2
+    SHA1_MSG2    m5, m6
+    SHA1_RNDS    2, m3
+    SHA1_MSG1    m5, m4
+    SHA1_XOR     m5, m7
+
+    SHA1_NEXTE   m6, m2
+    SHA1_COPY    m3
+    SHA1_MSG2    m6, m7
+    SHA1_RNDS    2, m2
+    SHA1_MSG1    m6, m5
+    SHA1_XOR     m6, m4
+
+    SHA1_NEXTE   m7, m3
+    SHA1_COPY    m2
+    SHA1_MSG2    m7, m4
+    SHA1_RNDS    3, m3
+    SHA1_MSG1    m7, m6
+    SHA1_XOR     m7, m5
+
+    SHA1_NEXTE   m4, m2
+    SHA1_COPY    m3
+    SHA1_MSG2    m4, m5
+    SHA1_RNDS    3, m2
+    SHA1_MSG1    m4, m7
+    SHA1_XOR     m4, m6
+
+    SHA1_NEXTE   m5, m3
+    SHA1_COPY    m2
+    SHA1_MSG2    m5, m6
+    SHA1_RNDS    3, m3
+    SHA1_XOR     m5, m7
+
+    SHA1_NEXTE   m6, m2
+    SHA1_COPY    m3
+    SHA1_MSG2    m6, m7
+    SHA1_RNDS    3, m2
+
+    SHA1_NEXTE   m7, m3
+    SHA1_COPY    m2
+    SHA1_RNDS    3, m3
+
+    sha1nexte     m2, [rsp + 16]
+    paddd         m1, [rsp]
+    pshufd        m1, m1, 0x1B
+    movu    [stateq], m1
+    pextrd  [stateq + 16], m2, 3
+    RET
+
+; SHA-256: m1 = ABEF, m2 = CDGH, m3-m6 = message schedule,
+; m0 = message plus round constants, the implicit sha256rnds2 operand
+%macro SHA256_RNDS 2 ; offset in K256, msg
+    mova          m0, %2
+    paddd         m0, [K256 + %1]
+    sha256rnds2   m2, m1, xmm0
+%endmacro
+
+%macro SHA256_RNDS2 0
+    pshufd        m0, m0, 0x0E
+    sha256rnds2   m1, m2, xmm0
+%endmacro
+
+%macro SHA256_MSG1 2 ; src, dst
+    sha256msg1    %2, %1
+%endmacro
+
+%macro SHA256_MSG2 3 ; cur, prev, next
+    mova          m7, %1
+    palignr       m7, %2, 4
+    paddd         %3, m7
+    sha256msg2    %3, %1
+%endmacro
+
+;-----------------------------------------------------------------------------
+; void ff_sha256_transform_shani(uint32_t *state, const uint8_t buffer[64])
+;-----------------------------------------------------------------------------
+%define SHUF [sha256_shuf]
+cglobal sha256_transform_shani, 2, 2, 8, 32, state, buf
+    ; ABCD EFGH -> ABEF CDGH, in the lane order sha256rnds2 uses
+    movu          m7, [stateq]
+    movu          m2, [stateq + 16]
+    pshufd        m7, m7, 0xB1
+    pshufd        m2, m2, 0x1B
+    mova          m1, m7
+    palignr       m1, m2, 8
+    pblendw       m2, m7, 0xF0
+    mova   [rsp     ], m1
+    mova   [rsp + 16], m2
+
+    LOAD         0, m3
+    SHA256_RNDS  0, m3
+    SHA256_RNDS2
+
+    LOAD         16, m4
+    SHA256_RNDS  16, m4
+    SHA256_RNDS2
+    SHA256_MSG1  m4, m3
+
+    LOAD         32, m5
+    SHA256_RNDS  32, m5
+    SHA256_RNDS2
+    SHA256_MSG1  m5, m4
+
+    LOAD         48, m6
+    SHA256_RNDS  48, m6
+    SHA256_MSG2  m6, m5, m3
+    SHA256_RNDS2
+    SHA256_MSG1  m6, m5
+
+    SHA256_RNDS  64, m3
+    SHA256_MSG2  m3, m6, m4
+    SHA256_RNDS2
+    SHA256_MSG1  m3, m6
+
+    SHA256_RNDS  80, m4
+    SHA256_MSG2  m4, m3, m5
+    SHA256_RNDS2
+    SHA256_MSG1  m4, m3
+
+    SHA256_RNDS  96, m5
+    SHA256_MSG2  m5, m4, m6
+    SHA256_RNDS2
+    SHA256_MSG1  m5, m4
+
+    SHA256_RNDS  112, m6
+    SHA256_MSG2  m6, m5, m3
+    SHA256_RNDS2
+    SHA256_MSG1  m6, m5
+
+    SHA256_RNDS  128, m3
+    SHA256_MSG2  m3, m6, m4
+    SHA256_RNDS2
+    SHA256_MSG1  m3, m6
+
+    SHA256_RNDS  144, m4
+    SHA256_MSG2  m4, m3, m5
+    SHA256_RNDS2
+    SHA256_MSG1  m4, m3
+
+    SHA256_RNDS  160, m5
+    SHA256_MSG2  m5, m4, m6
+    SHA256_RNDS2
+    SHA256_MSG1  m5, m4
+
+    SHA256_RNDS  176, m6
+    SHA256_MSG2  m6, m5, m3
+    SHA256_RNDS2
+    SHA256_MSG1  m6, m5
+
+    SHA256_RNDS  192, m3
+    SHA256_MSG2  m3, m6, m4
+    SHA256_RNDS2
+    SHA256_MSG1  m3, m6
+
+    SHA256_RNDS  208, m4
+    SHA256_MSG2  m4, m3, m5
+    SHA256_RNDS2
+
+    SHA256_RNDS  224, m5
+    SHA256_MSG2  m5, m4, m6
+    SHA256_RNDS2
+
+    SHA256_RNDS  240, m6
+    SHA256_RNDS2
+
+    paddd         m1, [rsp]
+    paddd         m2, [rsp + 16]
+    pshufd        m7, m1, 0x1B
+    pshufd        m2, m2, 0xB1
+    mova          m1, m7
+    pblendw       m1, m2, 0xF0
+    palignr       m2, m7, 8
+    movu    [stateq], m1
+    movu [stateq + 16], m2
+    RET
@@ -1176,8 +1176,8 @@ static enum AVPixelFormat alphaless_fmt(enum AVPixelFormat fmt)
     }
 }
 
-av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
-                             SwsFilter *dstFilter)
+static av_cold int init_context(SwsContext *c, SwsFilter *srcFilter,
+                                SwsFilter *dstFilter)
 {
     int i;
     int usesVFilter, usesHFilter;
@@ -1889,6 +1889,15 @@ fail: // FIXME replace things by appropriate error codes
     return ret;
 }
 
+av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
+                             SwsFilter *dstFilter)
+{
+    void *mem_tag = av_mem_tag_enter(c);
+    int ret = init_context(c, srcFilter, dstFilter);
+    av_mem_tag_leave(mem_tag);
+    return ret;
+}
+
 SwsContext *sws_alloc_set_opts(int srcW, int srcH, enum AVPixelFormat srcFormat,
                                int dstW, int dstH, enum AVPixelFormat dstFormat,
                                int flags, const double *param)
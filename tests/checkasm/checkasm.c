@@ -186,6 +186,7 @@ static const struct {
     { "sw_scale", checkasm_check_sw_scale },
 #endif
 #if CONFIG_AVUTIL
+        { "crc", checkasm_check_crc },
         { "fixed_dsp", checkasm_check_fixed_dsp },
         { "float_dsp", checkasm_check_float_dsp },
 #endif
@@ -228,6 +229,8 @@ static const struct {
     { "SSE4.1",   "sse4",     AV_CPU_FLAG_SSE4 },
     { "SSE4.2",   "sse42",    AV_CPU_FLAG_SSE42 },
     { "AES-NI",   "aesni",    AV_CPU_FLAG_AESNI },
+    { "CLMUL",    "clmul",    AV_CPU_FLAG_CLMUL },
+    { "SHA-NI",   "shani",    AV_CPU_FLAG_SHANI },
     { "AVX",      "avx",      AV_CPU_FLAG_AVX },
     { "XOP",      "xop",      AV_CPU_FLAG_XOP },
     { "FMA3",     "fma3",     AV_CPU_FLAG_FMA3 },
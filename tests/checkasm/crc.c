@@ -0,0 +1,81 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "checkasm.h"
+#include "libavutil/common.h"
+#include "libavutil/crc.h"
+#include "libavutil/crc_internal.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+
+#define BUF_SIZE 4096
+
+static uint32_t crc_c(const AVCRC *ctx, uint32_t crc,
+                      const uint8_t *buffer, size_t length)
+{
+    const uint8_t *end = buffer + (length & ~15);
+
+    while (buffer < end)
+        crc = ctx[(uint8_t)crc ^ *buffer++] ^ (crc >> 8);
+    return crc;
+}
+
+void checkasm_check_crc(void)
+{
+    static const char *const names[AV_CRC_MAX] = {
+        [AV_CRC_8_ATM]      = "8_atm",
+        [AV_CRC_16_ANSI]    = "16_ansi",
+        [AV_CRC_16_CCITT]   = "16_ccitt",
+        [AV_CRC_32_IEEE]    = "32_ieee",
+        [AV_CRC_32_IEEE_LE] = "32_ieee_le",
+        [AV_CRC_16_ANSI_LE] = "16_ansi_le",
+        [AV_CRC_24_IEEE]    = "24_ieee",
+        [AV_CRC_8_EBU]      = "8_ebu",
+    };
+    LOCAL_ALIGNED_16(uint8_t, buf, [BUF_SIZE + 16]);
+    ff_crc_func funcs[AV_CRC_MAX];
+    int id, i;
+
+    for (i = 0; i < BUF_SIZE + 16; i++)
+        buf[i] = rnd();
+    for (id = 0; id < AV_CRC_MAX; id++)
+        funcs[id] = crc_c;
+    ff_crc_init_funcs(funcs);
+
+    for (id = 0; id < AV_CRC_MAX; id++) {
+        const AVCRC *ctx = av_crc_get_table(id);
+
+        declare_func(uint32_t, const AVCRC *ctx, uint32_t crc,
+                     const uint8_t *buffer, size_t length);
+
+        if (check_func(funcs[id], "crc_%s", names[id])) {
+            for (i = 0; i < 32; i++) {
+                /* unaligned buffers, all lengths modulo 64 */
+                size_t length = 64 + rnd() % (BUF_SIZE - 63);
+                int offset    = rnd() & 15;
+                uint32_t crc  = rnd();
+
+                if (call_ref(ctx, crc, buf + offset, length) !=
+                    call_new(ctx, crc, buf + offset, length))
+                    fail();
+            }
+            bench_new(ctx, 0, buf, BUF_SIZE);
+        }
+    }
+    report("crc");
+}
@@ -41,6 +41,13 @@ fate-ffmpeg-filter_colorkey: CMD = framecrc -auto_conversion_filters -idct simpl
 FATE_FFMPEG-$(CONFIG_COLOR_FILTER) += fate-ffmpeg-lavfi
 fate-ffmpeg-lavfi: CMD = framecrc -lavfi color=d=1:r=5 -fflags +bitexact
 
+# the same output written by slave threads, with and without a full queue,
+# and by the muxing thread
+FATE_TEE_THREAD-$(HAVE_THREADS) += fate-tee-thread
+FATE_FFMPEG-$(call ALLYES, COLOR_FILTER RAWVIDEO_ENCODER TEE_MUXER FRAMECRC_MUXER MD5_PROTOCOL) += $(FATE_TEE_THREAD-yes)
+fate-tee-thread: CMD = ffmpeg -lavfi color=d=1:r=5 -c:v rawvideo -flags +bitexact -fflags +bitexact \
+  -f tee -use_thread 1 "[f=framecrc]md5:|[f=framecrc:queue_size=1]md5:|[f=framecrc:use_thread=0]md5:"
+
 FATE_SAMPLES_FFMPEG-$(CONFIG_RAWVIDEO_DEMUXER) += fate-force_key_frames
 fate-force_key_frames: tests/data/vsynth_lena.yuv
 fate-force_key_frames: CMD = enc_dec \
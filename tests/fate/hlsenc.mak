@@ -41,6 +41,22 @@ fate-hls-live-endlist: CMD = md5 -i $(SRC) -af hdcd=process_stereo=false -t 20 -
 fate-hls-live-endlist: CMP = oneline
 fate-hls-live-endlist: REF = e189ce781d9c87882f58e3929455167b
 
+tests/data/hls_async_io.m3u8: TAG = GEN
+tests/data/hls_async_io.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
+        -f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=20" -f hls -hls_time 3 -map 0 \
+        -hls_list_size 0 -hls_flags temp_file -async_io 1 -codec:a mp2fixed \
+        -hls_segment_filename $(TARGET_PATH)/tests/data/hls_async_io_%d.ts \
+        $(TARGET_PATH)/tests/data/hls_async_io.m3u8 2>/dev/null
+
+# same output as fate-hls-live-endlist, written from the background thread
+FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-hls-async-io
+fate-hls-async-io: tests/data/hls_async_io.m3u8
+fate-hls-async-io: SRC = $(TARGET_PATH)/tests/data/hls_async_io.m3u8
+fate-hls-async-io: CMD = md5 -i $(SRC) -af hdcd=process_stereo=false -t 20 -f s24le
+fate-hls-async-io: CMP = oneline
+fate-hls-async-io: REF = e189ce781d9c87882f58e3929455167b
+
 tests/data/hls_segment_size.m3u8: TAG = GEN
 tests/data/hls_segment_size.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
 	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
@@ -2,6 +2,22 @@
 #fate-async: libavformat/tests/async$(EXESUF)
 #fate-async: CMD = run libavformat/tests/async
 
+FATE_LIBAVFORMAT-$(CONFIG_CACHE_PROTOCOL) += fate-cache
+fate-cache: libavformat/tests/cache$(EXESUF)
+fate-cache: CMD = run libavformat/tests/cache$(EXESUF) $(TARGET_PATH)/tests/data/fate
+fate-cache: CMP = null
+
+FATE_HTTP_POOL-$(HAVE_THREADS) += fate-http-pool
+FATE_LIBAVFORMAT-$(CONFIG_HTTP_PROTOCOL) += $(FATE_HTTP_POOL-yes)
+fate-http-pool: libavformat/tests/http_pool$(EXESUF)
+fate-http-pool: CMD = run libavformat/tests/http_pool$(EXESUF) $(TARGET_PATH)/tests/data/fate
+fate-http-pool: CMP = null
+
+FATE_LIBAVFORMAT-$(CONFIG_UDP_PROTOCOL) += fate-udp-batch
+fate-udp-batch: libavformat/tests/udp_batch$(EXESUF)
+fate-udp-batch: CMD = run libavformat/tests/udp_batch$(EXESUF)
+fate-udp-batch: CMP = null
+
 FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/tests/noproxy$(EXESUF)
 fate-noproxy: CMD = run libavformat/tests/noproxy$(EXESUF)
@@ -22,6 +38,13 @@ FATE_LIBAVFORMAT-$(CONFIG_MOV_MUXER) += fate-movenc
 fate-movenc: libavformat/tests/movenc$(EXESUF)
 fate-movenc: CMD = run libavformat/tests/movenc$(EXESUF)
 
+# the stream info of a file made by fate-lavf-ts
+FATE_STREAM_INFO-$(call ENCDEC2, MPEG2VIDEO, MP2, MPEGTS) += fate-stream-info
+fate-stream-info: fate-lavf-ts libavformat/tests/stream_info$(EXESUF)
+fate-stream-info: CMD = run libavformat/tests/stream_info$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.ts
+fate-stream-info: CMP = null
+FATE_AVCONV += $(FATE_STREAM_INFO-yes)
+
 FATE_LIBAVFORMAT += $(FATE_LIBAVFORMAT-yes)
 FATE-$(CONFIG_AVFORMAT) += $(FATE_LIBAVFORMAT)
 fate-libavformat: $(FATE_LIBAVFORMAT)
@@ -30,6 +30,7 @@
 
 #include "libavutil/avutil.h"
 #include "libavutil/avstring.h"
+#include "libavutil/cpu.h"
 #include "libavutil/crc.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/timer.h"
@@ -76,6 +77,7 @@ struct hash_impl {
 #include "libavutil/sha512.h"
 #include "libavutil/ripemd.h"
 #include "libavutil/aes.h"
+#include "libavutil/aes_ctr.h"
 #include "libavutil/blowfish.h"
 #include "libavutil/camellia.h"
 #include "libavutil/cast5.h"
@@ -120,6 +122,30 @@ static void run_lavu_aes128(uint8_t *output,
     av_aes_crypt(aes, output, input, size >> 4, NULL, 0);
 }
 
+static void run_lavu_aes128cbc(uint8_t *output,
+                               const uint8_t *input, unsigned size)
+{
+    static struct AVAES *aes;
+    uint8_t iv[16];
+    if (!aes && !(aes = av_aes_alloc()))
+        fatal_error("out of memory");
+    memcpy(iv, hardcoded_key + 16, 16);
+    av_aes_init(aes, hardcoded_key, 128, 0);
+    av_aes_crypt(aes, output, input, size >> 4, iv, 0);
+}
+
+static void run_lavu_aes128ctr(uint8_t *output,
+                               const uint8_t *input, unsigned size)
+{
+    static struct AVAESCTR *aes;
+    if (!aes) {
+        if (!(aes = av_aes_ctr_alloc()) || av_aes_ctr_init(aes, hardcoded_key) < 0)
+            fatal_error("out of memory");
+    }
+    av_aes_ctr_set_iv(aes, hardcoded_key + 16);
+    av_aes_ctr_crypt(aes, output, input, size);
+}
+
 static void run_lavu_blowfish(uint8_t *output,
                               const uint8_t *input, unsigned size)
 {
@@ -647,6 +673,8 @@ struct hash_impl implementations[] = {
     IMPL(tomcrypt, "RIPEMD-128", ripemd128, "9ab8bfba2ddccc5d99c9d4cdfb844a5f")
     IMPL_ALL("RIPEMD-160", ripemd160, "62a5321e4fc8784903bb43ab7752c75f8b25af00")
     IMPL_ALL("AES-128",    aes128,    "crc:ff6bc888")
+    IMPL(lavu,     "AES-128-CBC", aes128cbc, "crc:3ef899a4")
+    IMPL(lavu,     "AES-128-CTR", aes128ctr, "crc:71dba440")
     IMPL_ALL("CAMELLIA",   camellia,  "crc:7abb59a7")
     IMPL(lavu,     "CAST-128", cast128, "crc:456aa584")
     IMPL(crypto,   "CAST-128", cast128, "crc:456aa584")
@@ -670,8 +698,11 @@ int main(int argc, char **argv)
     unsigned i, impl, size;
     int opt;
 
-    while ((opt = getopt(argc, argv, "hl:a:r:")) != -1) {
+    while ((opt = getopt(argc, argv, "hl:a:r:c")) != -1) {
         switch (opt) {
+        case 'c':
+            av_force_cpu_flags(0);
+            break;
         case 'l':
             enabled_libs = optarg;
             break;
@@ -683,7 +714,8 @@ int main(int argc, char **argv)
             break;
         case 'h':
         default:
-            fprintf(stderr, "Usage: %s [-l libs] [-a algos] [-r runs]\n",
+            fprintf(stderr, "Usage: %s [-l libs] [-a algos] [-r runs] [-c]\n"
+                    "-c disables CPU-specific optimizations in libavutil\n",
                     argv[0]);
             if ((USE_EXT_LIBS)) {
                 char buf[1024];